@@ -42,13 +42,26 @@ if "%ARGS:debug=%" neq "%ARGS%" (
 if "%TARGET_ARCH%" equ "arm64" set CL=%CL% /arch:armv8.1
 if "%TARGET_ARCH%" equ "x64" set LINK=%LINK% /FIXED /merge:_RDATA=.rdata
 
-call :fxc ResizePassH            || exit /b 1
-call :fxc ResizePassV            || exit /b 1
-call :fxc ResizeLinearPassH      || exit /b 1
-call :fxc ResizeLinearPassV      || exit /b 1
-call :fxc ConvertSinglePass      || exit /b 1
-call :fxc ConvertPass1           || exit /b 1
-call :fxc ConvertPass2           || exit /b 1
+call :fxc ResizePassH              || exit /b 1
+call :fxc ResizePassV              || exit /b 1
+call :fxc ResizeLinearPassH        || exit /b 1
+call :fxc ResizeLinearPassV        || exit /b 1
+call :fxc ResizeReduce             || exit /b 1
+call :fxc ResizeLinearReduce       || exit /b 1
+call :fxc ConvertSinglePass        || exit /b 1
+call :fxc ConvertImprovedNV12      || exit /b 1
+call :fxc ConvertImprovedP010      || exit /b 1
+call :fxc ConvertSinglePassTiles   || exit /b 1
+call :fxc ConvertImprovedNV12Tiles || exit /b 1
+call :fxc ConvertImprovedP010Tiles || exit /b 1
+call :fxc ConvertHdr               || exit /b 1
+call :fxc ResizeConvertPassH       || exit /b 1
+call :fxc ResizeConvertPassV       || exit /b 1
+call :fxc ResizeLinearConvertPassH || exit /b 1
+call :fxc ResizeLinearConvertPassV || exit /b 1
+call :fxc FrameHash                || exit /b 1
+call :fxc FrameHashDirty           || exit /b 1
+call :fxc CursorBlend              || exit /b 1
 
 for /f %%i in ('call git describe --always --dirty') do set CL=%CL% -DWCAP_GIT_INFO=\"%%i\"
 
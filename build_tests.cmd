@@ -0,0 +1,52 @@
+@echo off
+setlocal enabledelayedexpansion
+
+if "%PROCESSOR_ARCHITECTURE%" equ "AMD64" (
+  set HOST_ARCH=x64
+) else if "%PROCESSOR_ARCHITECTURE%" equ "ARM64" (
+  set HOST_ARCH=arm64
+)
+
+set ARGS=%*
+if "%ARGS%" equ "" set ARGS=%HOST_ARCH%
+
+if "%ARGS:x64=%" neq "!ARGS!" (
+  set TARGET_ARCH=x64
+) else if "%ARGS:arm64=%" neq "!ARGS!" (
+  set TARGET_ARCH=arm64
+) else (
+  set TARGET_ARCH=%HOST_ARCH%
+)
+
+where /Q cl.exe || (
+  set __VSCMD_ARG_NO_LOGO=1
+  for /f "tokens=*" %%i in ('"C:\Program Files (x86)\Microsoft Visual Studio\Installer\vswhere.exe" -latest -requires Microsoft.VisualStudio.Workload.NativeDesktop -property installationPath') do set VS=%%i
+  if "!VS!" equ "" (
+    echo ERROR: Visual Studio installation not found
+    exit /b 1
+  )
+  call "!VS!\Common7\Tools\VsDevCmd.bat" -arch=%TARGET_ARCH% -host_arch=%HOST_ARCH% -startdir=none -no_logo || exit /b 1
+)
+
+if "%ARGS:debug=%" neq "%ARGS%" (
+  set CL=/MTd /Od /Z7 /D_DEBUG /RTC1
+  if "%TARGET_ARCH%" equ "x64" set CL=!CL! /fsanitize=address
+) else (
+  set CL=/O2 /DNDEBUG
+)
+
+if "%TARGET_ARCH%" equ "arm64" set CL=%CL% /arch:armv8.1
+
+rem every tests\test_*.c file is separate executable, pass test name to build & run only that one
+set FILTER=test_*
+for %%a in (%*) do (
+  if "%%a" neq "x64" if "%%a" neq "arm64" if "%%a" neq "debug" set FILTER=%%a
+)
+
+for %%i in (tests\%FILTER%.c) do (
+  cl.exe /nologo /std:c11 /experimental:c11atomics /W3 /WX /I. %%i /Fotests\ /Fetests\%%~ni.exe /link /INCREMENTAL:NO /SUBSYSTEM:CONSOLE || exit /b 1
+  tests\%%~ni.exe || exit /b 1
+)
+del tests\*.obj >nul
+
+goto :eof
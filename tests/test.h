@@ -0,0 +1,113 @@
+#pragma once
+
+// minimal helpers for tests of portable wcap_cpu_*.h headers
+// every test is separate executable that returns non-zero exit code when any check fails
+
+#include "wcap_cpu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#if !defined(_WIN32)
+#	include <time.h>
+#	include <sched.h>
+#endif
+
+//
+// interface
+//
+
+// prints failed condition with location & continues, so one run shows all failures
+#define TEST_CHECK(Cond, ...) do { if (!(Cond)) { Test__Fail(__FILE__, __LINE__, #Cond); printf(" " __VA_ARGS__); printf("\n"); } } while (0)
+
+// returns seconds from some fixed point in time
+static double Test_Time(void);
+
+// gives rest of time slice to other threads
+static void Test_Yield(void);
+
+// deterministic pseudo-random numbers, same sequence on every platform
+static uint32_t Test_Random(uint32_t* State);
+
+// prints summary & returns exit code for main
+static int Test_Finish(const char* Name);
+
+// all explicit kernels, ones not supported by current CPU must be skipped with Test_HasKernel
+static const CpuKernel Test_Kernels[] = { CpuKernel_Scalar, CpuKernel_SSE41, CpuKernel_AVX2, CpuKernel_NEON };
+#define TEST_KERNEL_COUNT (sizeof(Test_Kernels) / sizeof(*Test_Kernels))
+
+static bool Test_HasKernel(CpuKernel Kernel);
+static const char* Test_KernelName(CpuKernel Kernel);
+
+//
+// implementation
+//
+
+static uint32_t Test__FailCount;
+
+static void Test__Fail(const char* File, int Line, const char* Cond)
+{
+	Test__FailCount++;
+	printf("%s(%d): check failed: %s", File, Line, Cond);
+}
+
+double Test_Time(void)
+{
+#if defined(_WIN32)
+	LARGE_INTEGER Freq, Counter;
+	QueryPerformanceFrequency(&Freq);
+	QueryPerformanceCounter(&Counter);
+	return (double)Counter.QuadPart / Freq.QuadPart;
+#else
+	struct timespec Time;
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+	return Time.tv_sec + Time.tv_nsec * 1e-9;
+#endif
+}
+
+void Test_Yield(void)
+{
+#if defined(_WIN32)
+	SwitchToThread();
+#else
+	sched_yield();
+#endif
+}
+
+uint32_t Test_Random(uint32_t* State)
+{
+	// xorshift32
+	uint32_t Value = *State;
+	Value ^= Value << 13;
+	Value ^= Value >> 17;
+	Value ^= Value << 5;
+	*State = Value;
+	return Value;
+}
+
+int Test_Finish(const char* Name)
+{
+	if (Test__FailCount == 0)
+	{
+		printf("%s: OK\n", Name);
+		return 0;
+	}
+	printf("%s: %u checks FAILED\n", Name, Test__FailCount);
+	return 1;
+}
+
+bool Test_HasKernel(CpuKernel Kernel)
+{
+	return Cpu_SelectKernel(Kernel) == Kernel;
+}
+
+const char* Test_KernelName(CpuKernel Kernel)
+{
+	switch (Kernel)
+	{
+	case CpuKernel_Scalar: return "Scalar";
+	case CpuKernel_SSE41:  return "SSE4.1";
+	case CpuKernel_AVX2:   return "AVX2";
+	case CpuKernel_NEON:   return "NEON";
+	default:               return "Auto";
+	}
+}
@@ -0,0 +1,334 @@
+// discrete-event simulation of capture & encode timing of one recording, with real CpuLimit & CpuDrop logic
+// capture callback limits frames & pushes them to encode queue, same as OnCaptureFrame in wcap.c
+// encode thread decides drop action & submits GPU passes, same as Encoder_NewFrame on OnEncodeCommand thread
+// encoder holds sample buffer until frame is encoded, same as Encoder__VideoInvoke returning samples
+
+#include "test.h"
+#include "wcap_cpu_limit.h"
+#include "wcap_cpu_drop.h"
+
+#define PIPELINE_FREQ 10000000ULL  // same as usual QueryPerformanceFrequency
+#define PIPELINE_QUEUE_SIZE 8      // same as WCAP_ENCODE_QUEUE_SIZE, includes frame that is being processed
+#define PIPELINE_BUFFER_COUNT 8    // same as ENCODER_VIDEO_BUFFER_COUNT
+#define PIPELINE_SECONDS 30
+#define PIPELINE_MAX_FRAMES (PIPELINE_SECONDS * 250)
+#define PIPELINE_SUBMIT_COST 200   // encode thread time for issuing GPU work & writing sample, in microseconds
+
+typedef struct
+{
+	const char* Name;
+	uint32_t Rate;         // compositor rate, as DwmGetCompositionTimingInfo returns
+	uint32_t Jitter;       // percent of period that every frame callback can be late
+	bool Vrr;              // period is random between half & double of compositor period
+	uint32_t MaxFramerate; // 0 for no limit
+	uint32_t Copy;         // GPU pass costs in microseconds, passes run one after another on GPU
+	uint32_t Hash;         // skipped by cheap encoding
+	uint32_t Convert;
+	uint32_t Encode;       // encoder time per frame in microseconds, one frame at a time
+	uint32_t StallEvery;   // every Nth frame blocks encode thread for StallCost microseconds, like slow disk write
+	uint32_t StallCost;
+}
+PipelineScenario;
+
+typedef struct
+{
+	uint32_t Captured;
+	uint32_t Accepted;     // passed frame limiter
+	uint32_t Encoded;
+	uint32_t Cheap;
+	uint32_t QueueDrops;   // encode queue was full
+	uint32_t PolicyDrops;  // dropped by policy while buffers were free
+	uint32_t BufferDrops;  // all encoder buffers were busy
+	uint32_t MaxQueued;
+	uint32_t MaxBuffers;
+	double Latency[3];     // 50th, 95th & 99th percentile of capture to encoded time, in milliseconds
+	double AverageBuffers; // time weighted average of busy encoder buffers
+	double FullTime;       // fraction of time when all encoder buffers were busy
+	double EncodedRate;    // encoded frames per second
+}
+PipelineStats;
+
+typedef struct
+{
+	CpuLimit Limit;
+	CpuDrop Drop;
+
+	uint64_t Queue[PIPELINE_QUEUE_SIZE]; // capture times of frames in encode queue
+	uint32_t QueueRead;
+	uint32_t QueueCount;
+
+	uint64_t ThreadFree;  // encode thread finishes current frame
+	uint64_t GpuFree;     // GPU finishes all submitted passes
+	uint64_t EncoderFree; // encoder finishes all submitted frames
+	uint64_t Done[PIPELINE_BUFFER_COUNT];   // buffer is returned by encoder, 0 when free
+	uint64_t Submit[PIPELINE_BUFFER_COUNT];
+
+	uint64_t Latency[PIPELINE_MAX_FRAMES];
+	int64_t Events[2 * PIPELINE_MAX_FRAMES]; // buffer acquire & release times, release is negative
+	uint32_t EventCount;
+}
+PipelineSim;
+
+static PipelineSim Sim;
+
+static uint64_t Pipeline_Micro(uint32_t Micro)
+{
+	return (uint64_t)Micro * PIPELINE_FREQ / 1000000;
+}
+
+static uint32_t Pipeline_MakeTrace(uint64_t* Times, const PipelineScenario* Scenario)
+{
+	uint32_t State = Scenario->Rate * 13 + Scenario->Jitter + Scenario->Vrr;
+	uint64_t Period = PIPELINE_FREQ / Scenario->Rate;
+	uint64_t End = PIPELINE_FREQ * PIPELINE_SECONDS;
+
+	uint32_t Count = 0;
+	uint64_t Base = PIPELINE_FREQ;
+	uint64_t Last = 0;
+	while (Base < End && Count < PIPELINE_MAX_FRAMES)
+	{
+		// frame callback can be late, but frames still arrive in order
+		uint64_t Time = Base + (Scenario->Jitter ? Test_Random(&State) % (Period * Scenario->Jitter / 100) : 0);
+		Time = Time > Last ? Time : Last + 1;
+		Times[Count++] = Last = Time;
+
+		Base += Scenario->Vrr ? Period / 2 + Test_Random(&State) % (Period * 3 / 2) : Period;
+	}
+	return Count;
+}
+
+static int Pipeline_Compare(const void* A, const void* B)
+{
+	int64_t ValueA = *(const int64_t*)A;
+	int64_t ValueB = *(const int64_t*)B;
+	uint64_t TimeA = ValueA < 0 ? -ValueA : ValueA;
+	uint64_t TimeB = ValueB < 0 ? -ValueB : ValueB;
+	// release before acquire at same time
+	return TimeA != TimeB ? (TimeA < TimeB ? -1 : 1) : (ValueA < ValueB ? -1 : ValueA > ValueB);
+}
+
+// encode thread takes next frame from queue, same as Encoder_NewFrame
+static void Pipeline_EncodeFrame(const PipelineScenario* Scenario, uint64_t Now, uint64_t FramePeriod, PipelineStats* Stats)
+{
+	uint64_t Time = Sim.Queue[Sim.QueueRead % PIPELINE_QUEUE_SIZE];
+	uint32_t Queued = Sim.QueueCount - 1;
+	uint32_t Frame = Stats->Encoded + Stats->PolicyDrops + Stats->BufferDrops;
+
+	uint32_t Free = 0;
+	for (uint32_t Buffer = 0; Buffer < PIPELINE_BUFFER_COUNT; Buffer++)
+	{
+		Free += Sim.Done[Buffer] <= Now;
+	}
+
+	uint64_t Cost = Pipeline_Micro(PIPELINE_SUBMIT_COST);
+	if (Scenario->StallEvery && Frame % Scenario->StallEvery == Scenario->StallEvery - 1)
+	{
+		Cost += Pipeline_Micro(Scenario->StallCost);
+	}
+
+	CpuDropAction Action = CpuDrop_Decide(&Sim.Drop, Queued, Free, Now, FramePeriod);
+	if (Action == CpuDropAction_Drop)
+	{
+		Stats->PolicyDrops += Free != 0;
+		Stats->BufferDrops += Free == 0;
+		if (Free != 0 && Queued == 0)
+		{
+			// input is still copied & hashed, so Encoder_Update can encode it later
+			uint64_t Start = Sim.GpuFree > Now ? Sim.GpuFree : Now;
+			Sim.GpuFree = Start + Pipeline_Micro(Scenario->Copy + Scenario->Hash);
+		}
+	}
+	else
+	{
+		uint32_t Buffer = 0;
+		while (Sim.Done[Buffer] > Now)
+		{
+			Buffer++;
+		}
+
+		// latency of previous use of buffer is known when it is acquired again, same as Encoder__AcquireVideoSample
+		if (Sim.Submit[Buffer] != 0)
+		{
+			CpuDrop_AddLatency(&Sim.Drop, Sim.Done[Buffer] - Sim.Submit[Buffer]);
+		}
+
+		bool Cheap = Action == CpuDropAction_EncodeCheap;
+		uint64_t GpuStart = Sim.GpuFree > Now ? Sim.GpuFree : Now;
+		Sim.GpuFree = GpuStart + Pipeline_Micro(Scenario->Copy + (Cheap ? 0 : Scenario->Hash) + Scenario->Convert);
+
+		uint64_t EncodeStart = Sim.EncoderFree > Sim.GpuFree ? Sim.EncoderFree : Sim.GpuFree;
+		Sim.EncoderFree = EncodeStart + Pipeline_Micro(Scenario->Encode);
+
+		Sim.Submit[Buffer] = Now;
+		Sim.Done[Buffer] = Sim.EncoderFree;
+		Sim.Events[Sim.EventCount++] = (int64_t)Now;
+		Sim.Events[Sim.EventCount++] = -(int64_t)Sim.EncoderFree;
+		Sim.Latency[Stats->Encoded++] = Sim.EncoderFree - Time;
+		Stats->Cheap += Cheap;
+	}
+
+	Sim.ThreadFree = Now + Cost;
+}
+
+static void Pipeline_Run(const PipelineScenario* Scenario, CpuDropPolicy Policy, PipelineStats* Stats)
+{
+	static uint64_t Times[PIPELINE_MAX_FRAMES];
+	uint32_t Count = Pipeline_MakeTrace(Times, Scenario);
+
+	Sim = (PipelineSim) { 0 };
+	*Stats = (PipelineStats) { 0 };
+
+	uint32_t Framerate = Scenario->Rate;
+	if (CpuLimit_Create(&Sim.Limit, Scenario->MaxFramerate, Scenario->Rate, 1, PIPELINE_FREQ))
+	{
+		Framerate = Scenario->MaxFramerate;
+	}
+	uint64_t FramePeriod = PIPELINE_FREQ / Framerate;
+	CpuDrop_Create(&Sim.Drop, Policy, PIPELINE_BUFFER_COUNT);
+
+	uint32_t Next = 0;
+	while (Next < Count || Sim.QueueCount != 0)
+	{
+		// frame leaves queue only after encode thread has finished it
+		if (Sim.QueueCount != 0 && Sim.ThreadFree <= (Next < Count ? Times[Next] : UINT64_MAX))
+		{
+			if (Sim.ThreadFree != 0)
+			{
+				Sim.QueueRead++;
+				Sim.QueueCount--;
+			}
+			if (Sim.QueueCount != 0)
+			{
+				uint64_t Now = Sim.Queue[Sim.QueueRead % PIPELINE_QUEUE_SIZE];
+				Now = Now > Sim.ThreadFree ? Now : Sim.ThreadFree;
+				Pipeline_EncodeFrame(Scenario, Now, FramePeriod, Stats);
+			}
+			else
+			{
+				Sim.ThreadFree = 0;
+			}
+			continue;
+		}
+
+		// capture callback
+		uint64_t Time = Times[Next++];
+		Stats->Captured++;
+		if (CpuLimit_Accept(&Sim.Limit, Time))
+		{
+			Stats->Accepted++;
+			if (Sim.QueueCount == PIPELINE_QUEUE_SIZE)
+			{
+				Stats->QueueDrops++;
+			}
+			else
+			{
+				Sim.Queue[(Sim.QueueRead + Sim.QueueCount++) % PIPELINE_QUEUE_SIZE] = Time;
+				Stats->MaxQueued = Sim.QueueCount > Stats->MaxQueued ? Sim.QueueCount : Stats->MaxQueued;
+				if (Sim.ThreadFree == 0)
+				{
+					// encode thread was waiting for frames
+					Pipeline_EncodeFrame(Scenario, Time, FramePeriod, Stats);
+				}
+			}
+		}
+	}
+
+	// latency percentiles
+	qsort(Sim.Latency, Stats->Encoded, sizeof(*Sim.Latency), &Pipeline_Compare);
+	static const uint32_t Percentiles[] = { 50, 95, 99 };
+	for (uint32_t Index = 0; Index < 3; Index++)
+	{
+		uint32_t Position = Stats->Encoded ? (Stats->Encoded - 1) * Percentiles[Index] / 100 : 0;
+		Stats->Latency[Index] = Stats->Encoded ? Sim.Latency[Position] * 1000.0 / PIPELINE_FREQ : 0;
+	}
+
+	// buffer occupancy over time, from acquire & release events in time order
+	qsort(Sim.Events, Sim.EventCount, sizeof(*Sim.Events), &Pipeline_Compare);
+	uint64_t BusyTime = 0;
+	uint64_t FullTime = 0;
+	uint32_t Busy = 0;
+	for (uint32_t Index = 0; Index + 1 < Sim.EventCount; Index++)
+	{
+		Busy += Sim.Events[Index] >= 0 ? 1 : -1;
+		Stats->MaxBuffers = Busy > Stats->MaxBuffers ? Busy : Stats->MaxBuffers;
+
+		uint64_t Start = Sim.Events[Index] < 0 ? -Sim.Events[Index] : Sim.Events[Index];
+		uint64_t End = Sim.Events[Index + 1] < 0 ? -Sim.Events[Index + 1] : Sim.Events[Index + 1];
+		BusyTime += Busy * (End - Start);
+		FullTime += Busy == PIPELINE_BUFFER_COUNT ? End - Start : 0;
+	}
+	uint64_t Duration = Count ? Times[Count - 1] - Times[0] : 1;
+	Stats->AverageBuffers = (double)BusyTime / Duration;
+	Stats->FullTime = (double)FullTime / Duration;
+	Stats->EncodedRate = Stats->Encoded * (double)PIPELINE_FREQ / Duration;
+}
+
+static const char* PipelinePolicyNames[] = { "DropNewest", "ReplaceOldest", "HalveFramerate", "SkipExtras", "Auto" };
+
+static void Pipeline_Print(const PipelineScenario* Scenario, CpuDropPolicy Policy, const PipelineStats* Stats)
+{
+	printf("  %-18s %-14s %5u %5u %5u %5u | %4u %4u %4u | %6.1f %6.1f %6.1f | %3u %4.1f %4.0f%%\n",
+		Scenario->Name, PipelinePolicyNames[Policy], Stats->Captured, Stats->Accepted, Stats->Encoded, Stats->Cheap,
+		Stats->QueueDrops, Stats->PolicyDrops, Stats->BufferDrops,
+		Stats->Latency[0], Stats->Latency[1], Stats->Latency[2],
+		Stats->MaxBuffers, Stats->AverageBuffers, Stats->FullTime * 100);
+}
+
+int main(void)
+{
+	//                                         rate jit vrr  max copy hash conv encode   stall
+	static const PipelineScenario Light    = { "60 Hz",           60, 30, false,  0, 300, 200, 1500,  6000,   0,      0 };
+	static const PipelineScenario Limited  = { "144 Hz limit 60", 144, 30, false, 60, 300, 200, 1500,  6000,   0,      0 };
+	static const PipelineScenario Vrr      = { "75 Hz VRR limit 60", 75, 0, true, 60, 300, 200, 1500,  6000,   0,      0 };
+	static const PipelineScenario Overload = { "60 Hz slow encoder", 60, 30, false, 0, 300, 200, 1500, 25000,   0,      0 };
+	static const PipelineScenario Stall    = { "60 Hz thread stall", 60, 30, false, 0, 300, 200, 1500,  6000, 120, 200000 };
+
+	printf("  %-18s %-14s %5s %5s %5s %5s | %4s %4s %4s | %6s %6s %6s | %3s %4s %5s\n",
+		"scenario", "policy", "frame", "limit", "enc", "cheap", "queu", "pol", "buf", "p50 ms", "p95 ms", "p99 ms", "buf", "avg", "full");
+
+	PipelineStats Stats;
+
+	for (CpuDropPolicy Policy = CpuDropPolicy_DropNewest; Policy <= CpuDropPolicy_Auto; Policy++)
+	{
+		const char* Name = PipelinePolicyNames[Policy];
+
+		// encoder keeps up, nothing is dropped & every frame is encoded well within one period
+		Pipeline_Run(&Light, Policy, &Stats);
+		Pipeline_Print(&Light, Policy, &Stats);
+		TEST_CHECK(Stats.Encoded == Stats.Captured && Stats.Cheap == 0, "%s %s: encoded %u of %u, %u cheap", Light.Name, Name, Stats.Encoded, Stats.Captured, Stats.Cheap);
+		TEST_CHECK(Stats.Latency[2] < 1000.0 / Light.Rate, "%s %s: p99 latency %.1f ms", Light.Name, Name, Stats.Latency[2]);
+
+		// limiter output is at limit rate, also with variable refresh near it
+		const PipelineScenario* LimitScenarios[] = { &Limited, &Vrr };
+		for (uint32_t Index = 0; Index < 2; Index++)
+		{
+			const PipelineScenario* Scenario = LimitScenarios[Index];
+			Pipeline_Run(Scenario, Policy, &Stats);
+			Pipeline_Print(Scenario, Policy, &Stats);
+			TEST_CHECK(Stats.Encoded == Stats.Accepted, "%s %s: encoded %u of %u accepted", Scenario->Name, Name, Stats.Encoded, Stats.Accepted);
+			TEST_CHECK(Stats.EncodedRate >= Scenario->MaxFramerate * 0.97 && Stats.EncodedRate <= Scenario->MaxFramerate * 1.03, "%s %s: %.2f fps", Scenario->Name, Name, Stats.EncodedRate);
+		}
+
+		// encoder slower than capture, buffers never grow latency past what all of them hold
+		Pipeline_Run(&Overload, Policy, &Stats);
+		Pipeline_Print(&Overload, Policy, &Stats);
+		double Capacity = 1000000.0 / Overload.Encode;
+		TEST_CHECK(Stats.EncodedRate <= Capacity * 1.01 && Stats.EncodedRate >= Capacity * 0.7, "%s %s: %.2f fps, encoder can do %.2f", Overload.Name, Name, Stats.EncodedRate, Capacity);
+		TEST_CHECK(Stats.Latency[2] <= (PIPELINE_BUFFER_COUNT + 1) * Overload.Encode / 1000.0, "%s %s: p99 latency %.1f ms", Overload.Name, Name, Stats.Latency[2]);
+		TEST_CHECK(Stats.MaxBuffers <= PIPELINE_BUFFER_COUNT && Stats.MaxQueued <= PIPELINE_QUEUE_SIZE, "%s %s: %u buffers, %u queued", Overload.Name, Name, Stats.MaxBuffers, Stats.MaxQueued);
+		if (Policy == CpuDropPolicy_HalveFramerate || Policy == CpuDropPolicy_Auto)
+		{
+			// these drop frames before buffers are exhausted, cheaper encoding alone does not help slow encoder
+			TEST_CHECK(Stats.FullTime < 0.5, "%s %s: all buffers busy %.0f%% of time", Overload.Name, Name, Stats.FullTime * 100);
+		}
+
+		// stalls longer than queue holds drop frames in capture callback, encoder recovers between them
+		Pipeline_Run(&Stall, Policy, &Stats);
+		Pipeline_Print(&Stall, Policy, &Stats);
+		TEST_CHECK(Stats.QueueDrops > 0 && Stats.MaxQueued == PIPELINE_QUEUE_SIZE, "%s %s: %u queue drops, max %u queued", Stall.Name, Name, Stats.QueueDrops, Stats.MaxQueued);
+		TEST_CHECK(Stats.Latency[0] < 1000.0 / Stall.Rate, "%s %s: p50 latency %.1f ms", Stall.Name, Name, Stats.Latency[0]);
+		TEST_CHECK(Stats.Encoded + Stats.QueueDrops + Stats.PolicyDrops + Stats.BufferDrops == Stats.Captured, "%s %s: %u frames lost", Stall.Name, Name, Stats.Captured - Stats.Encoded - Stats.QueueDrops - Stats.PolicyDrops - Stats.BufferDrops);
+	}
+
+	return Test_Finish("test_capture_pipeline");
+}
@@ -0,0 +1,568 @@
+// compares every CpuConvert kernel against scalar reference, tile model of improved conversion shader against two passes, fused resize against two separate steps,
+// improved luma of every kernel against shader formula in double precision, and HDR output values
+
+#include "test.h"
+#include "wcap_cpu_convert.h"
+
+// SIMD float kernels use fma & different rounding, results can differ by one step
+#define CONVERT_TOLERANCE 1
+// improved luma is solved from chroma, one step difference of 16-bit chroma moves it few 16-bit steps
+// this allows up to one step of 10 bits that encoder keeps from P010 values
+#define CONVERT_TOLERANCE_IMPROVED_P010 64
+
+static const uint32_t ConvertSizes[][2] =
+{
+	{    2,    2 },
+	{    6,    4 },
+	{   18,    4 },
+	{   34,    6 }, // tails after full 16 & 32 pixel blocks
+	{   66,    2 },
+	{   64,   64 }, // exactly 2x2 tiles of improved conversion shader
+	{  102,   46 },
+	{ 1922, 1082 },
+};
+#define CONVERT_SIZE_COUNT (sizeof(ConvertSizes) / sizeof(*ConvertSizes))
+
+static const char* ConvertFormatNames[] = { "NV12", "P010", "P010_HDR" };
+static const char* ConvertColorSpaceNames[] = { "BT601", "BT709", "BT2020" };
+
+enum
+{
+	ConvertPattern_Noise,
+	ConvertPattern_Checker, // black & white pixels, largest chroma & luma steps
+	ConvertPattern_Gradient,
+	ConvertPattern_Saturated,
+	ConvertPattern_Count,
+};
+
+static void Convert_Fill(uint8_t* Image, uint32_t Width, uint32_t Height, uint32_t Pattern)
+{
+	uint32_t State = Width * 31 + Height + Pattern;
+	for (uint32_t Y = 0; Y < Height; Y++)
+	{
+		for (uint32_t X = 0; X < Width; X++)
+		{
+			uint8_t* Pixel = Image + ((size_t)Y * Width + X) * 4;
+			uint32_t Noise = Test_Random(&State);
+			switch (Pattern)
+			{
+			case ConvertPattern_Noise:
+				memcpy(Pixel, &Noise, 4);
+				break;
+			case ConvertPattern_Checker:
+				memset(Pixel, (X ^ Y) & 1 ? 255 : 0, 4);
+				break;
+			case ConvertPattern_Gradient:
+				Pixel[0] = (uint8_t)(X * 255 / Width);
+				Pixel[1] = (uint8_t)(Y * 255 / Height);
+				Pixel[2] = (uint8_t)((X + Y) * 255 / (Width + Height));
+				Pixel[3] = 255;
+				break;
+			case ConvertPattern_Saturated:
+				Pixel[0] = Noise & 1 ? 255 : 0;
+				Pixel[1] = Noise & 2 ? 255 : 0;
+				Pixel[2] = Noise & 4 ? 255 : 0;
+				Pixel[3] = 255;
+				break;
+			}
+		}
+	}
+}
+
+static uint32_t Convert_Value(const uint8_t* Plane, size_t Index, uint32_t SampleSize)
+{
+	return SampleSize == 2 ? ((const uint16_t*)Plane)[Index] : Plane[Index];
+}
+
+static uint32_t Convert_MaxDiff(const uint8_t* Ref, const uint8_t* Out, size_t Count, uint32_t SampleSize)
+{
+	uint32_t MaxDiff = 0;
+	for (size_t Index = 0; Index < Count; Index++)
+	{
+		int Diff = abs((int)Convert_Value(Ref, Index, SampleSize) - (int)Convert_Value(Out, Index, SampleSize));
+		MaxDiff = Diff > (int)MaxDiff ? (uint32_t)Diff : MaxDiff;
+	}
+	return MaxDiff;
+}
+
+typedef struct
+{
+	uint8_t* Y;
+	uint8_t* UV;
+	size_t SizeY;
+	size_t SizeUV;
+	size_t Pitch;
+}
+ConvertOutput;
+
+static void ConvertOutput_Create(ConvertOutput* Output, uint32_t Width, uint32_t Height, uint32_t SampleSize)
+{
+	Output->Pitch = (size_t)Width * SampleSize;
+	Output->SizeY = Output->Pitch * Height;
+	Output->SizeUV = Output->Pitch * Height / 2;
+	Output->Y = Cpu_Alloc(Output->SizeY);
+	Output->UV = Cpu_Alloc(Output->SizeUV);
+}
+
+static void ConvertOutput_Release(ConvertOutput* Output)
+{
+	Cpu_Free(Output->Y);
+	Cpu_Free(Output->UV);
+}
+
+static void Convert_Run(ConvertOutput* Output, const uint8_t* Input, uint32_t Width, uint32_t Height, YuvColorSpace ColorSpace, CpuConvertFormat Format, bool Improved, bool FixedPoint, CpuKernel Kernel)
+{
+	CpuConvert Convert;
+	CpuConvert_Create(&Convert, Width, Height, ColorSpace, Format, Improved, FixedPoint, Kernel);
+	memset(Output->Y, 0xcc, Output->SizeY);
+	memset(Output->UV, 0xcc, Output->SizeUV);
+	CpuConvert_Run(&Convert, Input, Width * 4, Output->Y, Output->Pitch, Output->UV, Output->Pitch);
+	CpuConvert_Release(&Convert);
+}
+
+static void Convert_TestKernels(uint32_t Width, uint32_t Height)
+{
+	uint8_t* Input = Cpu_Alloc((size_t)Width * Height * 4);
+
+	ConvertOutput Ref, Out, Single;
+	ConvertOutput_Create(&Ref, Width, Height, 2);
+	ConvertOutput_Create(&Out, Width, Height, 2);
+	ConvertOutput_Create(&Single, Width, Height, 2);
+
+	for (uint32_t Pattern = 0; Pattern < ConvertPattern_Count; Pattern++)
+	{
+		Convert_Fill(Input, Width, Height, Pattern);
+
+		for (YuvColorSpace ColorSpace = YuvColorSpace_BT601; ColorSpace <= YuvColorSpace_BT2020; ColorSpace++)
+		{
+			for (CpuConvertFormat Format = CpuConvertFormat_NV12; Format <= CpuConvertFormat_P010; Format++)
+			{
+				uint32_t SampleSize = Format == CpuConvertFormat_NV12 ? 1 : 2;
+				size_t CountY = (size_t)Width * Height;
+				size_t CountUV = CountY / 2;
+
+				for (uint32_t Mode = 0; Mode < 4; Mode++)
+				{
+					bool Improved = Mode & 1;
+					bool FixedPoint = Mode & 2;
+					if (FixedPoint && Format != CpuConvertFormat_NV12)
+					{
+						continue;
+					}
+
+					Convert_Run(&Ref, Input, Width, Height, ColorSpace, Format, Improved, FixedPoint, CpuKernel_Scalar);
+
+					for (uint32_t KernelIndex = 0; KernelIndex < TEST_KERNEL_COUNT; KernelIndex++)
+					{
+						CpuKernel Kernel = Test_Kernels[KernelIndex];
+						if (!Test_HasKernel(Kernel))
+						{
+							continue;
+						}
+
+						Convert_Run(&Out, Input, Width, Height, ColorSpace, Format, Improved, FixedPoint, Kernel);
+
+						// fixed point is exact on every kernel, improved conversion still calculates luma in float
+						uint32_t ToleranceY = FixedPoint && !Improved ? 0 : Improved && Format == CpuConvertFormat_P010 ? CONVERT_TOLERANCE_IMPROVED_P010 : CONVERT_TOLERANCE;
+						uint32_t ToleranceUV = FixedPoint ? 0 : CONVERT_TOLERANCE;
+
+						uint32_t DiffY = Convert_MaxDiff(Ref.Y, Out.Y, CountY, SampleSize);
+						uint32_t DiffUV = Convert_MaxDiff(Ref.UV, Out.UV, CountUV, SampleSize);
+						TEST_CHECK(DiffY <= ToleranceY && DiffUV <= ToleranceUV, "%ux%u pattern %u %s %s%s%s %s max diff Y %u, UV %u", Width, Height, Pattern, ConvertColorSpaceNames[ColorSpace], ConvertFormatNames[Format], Improved ? " improved" : "", FixedPoint ? " fixed" : "", Test_KernelName(Kernel), DiffY, DiffUV);
+
+						// improved conversion changes only luma
+						if (Improved)
+						{
+							Convert_Run(&Single, Input, Width, Height, ColorSpace, Format, false, FixedPoint, Kernel);
+							TEST_CHECK(memcmp(Single.UV, Out.UV, CountUV * SampleSize) == 0, "%ux%u pattern %u %s %s%s %s improved chroma differs from single pass", Width, Height, Pattern, ConvertColorSpaceNames[ColorSpace], ConvertFormatNames[Format], FixedPoint ? " fixed" : "", Test_KernelName(Kernel));
+						}
+					}
+				}
+			}
+		}
+	}
+
+	ConvertOutput_Release(&Ref);
+	ConvertOutput_Release(&Out);
+	ConvertOutput_Release(&Single);
+	Cpu_Free(Input);
+}
+
+static void Convert_TestTiles(uint32_t Width, uint32_t Height)
+{
+	// tile model of single dispatch shader must give exactly same output as two pass improved conversion
+	uint8_t* Input = Cpu_Alloc((size_t)Width * Height * 4);
+
+	ConvertOutput Ref, Out;
+	ConvertOutput_Create(&Ref, Width, Height, 2);
+	ConvertOutput_Create(&Out, Width, Height, 2);
+
+	for (uint32_t Pattern = 0; Pattern < ConvertPattern_Count; Pattern++)
+	{
+		Convert_Fill(Input, Width, Height, Pattern);
+
+		for (YuvColorSpace ColorSpace = YuvColorSpace_BT601; ColorSpace <= YuvColorSpace_BT2020; ColorSpace++)
+		{
+			for (CpuConvertFormat Format = CpuConvertFormat_NV12; Format <= CpuConvertFormat_P010; Format++)
+			{
+				uint32_t SampleSize = Format == CpuConvertFormat_NV12 ? 1 : 2;
+				size_t CountY = (size_t)Width * Height;
+				size_t CountUV = CountY / 2;
+
+				Convert_Run(&Ref, Input, Width, Height, ColorSpace, Format, true, false, CpuKernel_Scalar);
+
+				CpuConvert Convert;
+				CpuConvert_Create(&Convert, Width, Height, ColorSpace, Format, true, false, CpuKernel_Scalar);
+				memset(Out.Y, 0xcc, Out.SizeY);
+				memset(Out.UV, 0xcc, Out.SizeUV);
+				CpuConvert_RunTiles(&Convert, Input, Width * 4, Out.Y, Out.Pitch, Out.UV, Out.Pitch);
+				CpuConvert_Release(&Convert);
+
+				uint32_t DiffY = Convert_MaxDiff(Ref.Y, Out.Y, CountY, SampleSize);
+				uint32_t DiffUV = Convert_MaxDiff(Ref.UV, Out.UV, CountUV, SampleSize);
+				TEST_CHECK(DiffY == 0 && DiffUV == 0, "%ux%u pattern %u %s %s tiles max diff Y %u, UV %u", Width, Height, Pattern, ConvertColorSpaceNames[ColorSpace], ConvertFormatNames[Format], DiffY, DiffUV);
+			}
+		}
+	}
+
+	ConvertOutput_Release(&Ref);
+	ConvertOutput_Release(&Out);
+	Cpu_Free(Input);
+}
+
+static const uint32_t ConvertResizeSizes[][4] =
+{
+	{ 1920, 1080, 1280,  720 },
+	{  333,  777,  102,   46 },
+	{  800, 3000,  800, 1000 },
+	{ 3000,  200, 1000,  190 },
+	{   64,   64,    2,    2 },
+	{  100,  100,  100,  100 }, // nothing to resize
+};
+#define CONVERT_RESIZE_SIZE_COUNT (sizeof(ConvertResizeSizes) / sizeof(*ConvertResizeSizes))
+
+static void Convert_TestResize(const uint32_t* Size)
+{
+	uint32_t InputWidth = Size[0];
+	uint32_t InputHeight = Size[1];
+	uint32_t OutputWidth = Size[2];
+	uint32_t OutputHeight = Size[3];
+
+	uint8_t* Input = Cpu_Alloc((size_t)InputWidth * InputHeight * 4);
+	uint8_t* Resized = Cpu_Alloc((size_t)OutputWidth * OutputHeight * 4);
+	Convert_Fill(Input, InputWidth, InputHeight, ConvertPattern_Noise);
+
+	ConvertOutput Ref, Out;
+	ConvertOutput_Create(&Ref, OutputWidth, OutputHeight, 2);
+	ConvertOutput_Create(&Out, OutputWidth, OutputHeight, 2);
+
+	static const ResizeFilter Filters[] = { ResizeFilter_Bilinear, ResizeFilter_Lanczos3 };
+	for (uint32_t FilterIndex = 0; FilterIndex < 2; FilterIndex++)
+	{
+		for (uint32_t KernelIndex = 0; KernelIndex < TEST_KERNEL_COUNT; KernelIndex++)
+		{
+			CpuKernel Kernel = Test_Kernels[KernelIndex];
+			if (!Test_HasKernel(Kernel))
+			{
+				continue;
+			}
+
+			// linear space only with Lanczos3, it does not change how rows are passed to converter
+			bool Linear = FilterIndex == 1;
+			CpuResize Resize;
+			CpuResize_Create(&Resize, InputWidth, InputHeight, OutputWidth, OutputHeight, Filters[FilterIndex], Linear, Kernel, NULL);
+			CpuResize_Run(&Resize, Input, InputWidth * 4, Resized, OutputWidth * 4);
+
+			for (CpuConvertFormat Format = CpuConvertFormat_NV12; Format <= CpuConvertFormat_P010; Format++)
+			{
+				for (uint32_t Mode = 0; Mode < 4; Mode++)
+				{
+					bool Improved = Mode & 1;
+					bool FixedPoint = Mode & 2;
+					if (FixedPoint && Format != CpuConvertFormat_NV12)
+					{
+						continue;
+					}
+
+					CpuConvert Convert;
+					CpuConvert_Create(&Convert, OutputWidth, OutputHeight, YuvColorSpace_BT709, Format, Improved, FixedPoint, Kernel);
+
+					memset(Ref.Y, 0xcc, Ref.SizeY);
+					memset(Ref.UV, 0xcc, Ref.SizeUV);
+					CpuConvert_Run(&Convert, Resized, OutputWidth * 4, Ref.Y, Ref.Pitch, Ref.UV, Ref.Pitch);
+
+					memset(Out.Y, 0xcc, Out.SizeY);
+					memset(Out.UV, 0xcc, Out.SizeUV);
+					CpuConvert_RunResize(&Convert, &Resize, Input, InputWidth * 4, Out.Y, Out.Pitch, Out.UV, Out.Pitch);
+
+					CpuConvert_Release(&Convert);
+
+					TEST_CHECK(memcmp(Ref.Y, Out.Y, Ref.SizeY) == 0 && memcmp(Ref.UV, Out.UV, Ref.SizeUV) == 0, "%ux%u -> %ux%u %s%s %s%s%s %s RunResize differs from Resize + Run", InputWidth, InputHeight, OutputWidth, OutputHeight, Linear ? "linear " : "", Linear ? "Lanczos3" : "Bilinear", ConvertFormatNames[Format], Improved ? " improved" : "", FixedPoint ? " fixed" : "", Test_KernelName(Kernel));
+				}
+			}
+
+			CpuResize_Release(&Resize);
+		}
+	}
+
+	ConvertOutput_Release(&Ref);
+	ConvertOutput_Release(&Out);
+	Cpu_Free(Resized);
+	Cpu_Free(Input);
+}
+
+static double Convert_ShaderY(const float (*Matrix)[4], const uint8_t* Pixel, double U, double V)
+{
+	// ConvertImprovedY shader formula in double precision, U & V are chroma values as decoder loads them from UNORM texture
+	double Range = 224.0 / 255;
+	double Offset = 0.5 / 255 + 0.5;
+	double W[3] = { 0.2126, 0.7152, 0.0722 };
+	double Color[3] = { Pixel[2] / 255.0, Pixel[1] / 255.0, Pixel[0] / 255.0 };
+
+	double L = 0, A = 0, B = 0;
+	for (int Channel = 0; Channel < 3; Channel++)
+	{
+		const float* Row = Matrix[3 + Channel];
+		double K = Row[1] * (U / Range - Offset / Range) + Row[2] * (V / Range - Offset / Range);
+		L += W[Channel] * Color[Channel] * Color[Channel];
+		A += W[Channel] * K;
+		B += W[Channel] * K * K;
+	}
+	double C = A * A - B + L;
+
+	// saturate, NaN from negative C becomes 0
+	double Y = C < 0 ? 0 : sqrt(C) - A;
+	Y = Y < 0 ? 0 : Y > 1 ? 1 : Y;
+	return Y * (219.0 / 255) + 16.0 / 255;
+}
+
+static void Convert_TestShaderY(void)
+{
+	// every improved luma value against shader formula evaluated in double precision for chroma values in output
+	// so it measures only how precisely luma is solved, including approximate rsqrt of SIMD kernels
+	// deviation is in steps of output format, 0.5 comes from rounding to integer value
+	static const uint32_t Sizes[][2] =
+	{
+		{   34,    6 },
+		{  102,   46 },
+		{ 1922, 1082 },
+	};
+
+	// float solve adds less than 1/100 of 8-bit step to rounding, and less than one 16-bit step
+	static const double MaxDeviation[] = { 0.51, 1.0 };
+
+	printf("improved conversion luma against shader formula in double precision, max & mean deviation in output steps\n");
+	for (uint32_t KernelIndex = 0; KernelIndex < TEST_KERNEL_COUNT; KernelIndex++)
+	{
+		CpuKernel Kernel = Test_Kernels[KernelIndex];
+		if (!Test_HasKernel(Kernel))
+		{
+			continue;
+		}
+
+		for (CpuConvertFormat Format = CpuConvertFormat_NV12; Format <= CpuConvertFormat_P010; Format++)
+		{
+			uint32_t SampleSize = Format == CpuConvertFormat_NV12 ? 1 : 2;
+			double MaxValue = Format == CpuConvertFormat_NV12 ? 255.0 : 65535.0;
+
+			double MaxDiff = 0;
+			double SumDiff = 0;
+			size_t Count = 0;
+			for (uint32_t SizeIndex = 0; SizeIndex < sizeof(Sizes) / sizeof(*Sizes); SizeIndex++)
+			{
+				uint32_t Width = Sizes[SizeIndex][0];
+				uint32_t Height = Sizes[SizeIndex][1];
+
+				uint8_t* Input = Cpu_Alloc((size_t)Width * Height * 4);
+				ConvertOutput Out;
+				ConvertOutput_Create(&Out, Width, Height, SampleSize);
+
+				for (uint32_t Pattern = 0; Pattern < ConvertPattern_Count; Pattern++)
+				{
+					Convert_Fill(Input, Width, Height, Pattern);
+
+					for (YuvColorSpace ColorSpace = YuvColorSpace_BT601; ColorSpace <= YuvColorSpace_BT2020; ColorSpace++)
+					{
+						Convert_Run(&Out, Input, Width, Height, ColorSpace, Format, true, false, Kernel);
+
+						double CaseDiff = 0;
+						for (uint32_t Y = 0; Y < Height; Y++)
+						{
+							// vertically chroma is at 1/4 between rows of pixel pair, horizontally odd pixels are in middle of two chroma values
+							uint32_t Chroma = Y / 2;
+							uint32_t Other = Y % 2 == 0 ? (Chroma == 0 ? 0 : Chroma - 1) : (Chroma + 1 < Height / 2 ? Chroma + 1 : Chroma);
+							const uint8_t* RowUV = Out.UV + Chroma * Out.Pitch;
+							const uint8_t* OtherUV = Out.UV + Other * Out.Pitch;
+
+							for (uint32_t X = 0; X < Width; X++)
+							{
+								uint32_t Index = X / 2;
+								uint32_t Right = X % 2 == 0 ? Index : Index + 1 < Width / 2 ? Index + 1 : Index;
+
+								double UV[2];
+								for (uint32_t Channel = 0; Channel < 2; Channel++)
+								{
+									double Value0 = 0.75 * Convert_Value(RowUV, Index * 2 + Channel, SampleSize) + 0.25 * Convert_Value(OtherUV, Index * 2 + Channel, SampleSize);
+									double Value1 = 0.75 * Convert_Value(RowUV, Right * 2 + Channel, SampleSize) + 0.25 * Convert_Value(OtherUV, Right * 2 + Channel, SampleSize);
+									UV[Channel] = (Value0 + Value1) * 0.5 / MaxValue;
+								}
+
+								double Expected = Convert_ShaderY(YuvMatrix[ColorSpace], Input + ((size_t)Y * Width + X) * 4, UV[0], UV[1]) * MaxValue;
+								double Diff = fabs(Convert_Value(Out.Y + Y * Out.Pitch, X, SampleSize) - Expected);
+								CaseDiff = Diff > CaseDiff ? Diff : CaseDiff;
+								SumDiff += Diff;
+								Count++;
+							}
+						}
+
+						TEST_CHECK(CaseDiff <= MaxDeviation[Format], "%ux%u pattern %u %s %s %s max luma deviation %.3f from shader formula", Width, Height, Pattern, ConvertColorSpaceNames[ColorSpace], ConvertFormatNames[Format], Test_KernelName(Kernel), CaseDiff);
+						MaxDiff = CaseDiff > MaxDiff ? CaseDiff : MaxDiff;
+					}
+				}
+
+				ConvertOutput_Release(&Out);
+				Cpu_Free(Input);
+			}
+
+			printf("  %-6s %-4s %7.3f %7.3f\n", Test_KernelName(Kernel), ConvertFormatNames[Format], MaxDiff, SumDiff / Count);
+		}
+	}
+}
+
+static double Convert_PQ(double Nits)
+{
+	double M1 = 2610.0 / 16384;
+	double M2 = 2523.0 / 4096 * 128;
+	double C1 = 3424.0 / 4096;
+	double C2 = 2413.0 / 4096 * 32;
+	double C3 = 2392.0 / 4096 * 32;
+	double P = pow(Nits / 10000.0, M1);
+	return pow((C1 + C2 * P) / (1 + C3 * P), M2);
+}
+
+static void Convert_TestHdr(void)
+{
+	// scRGB gray levels as half floats: 0, 1.0 = 80 nits, 2.5 = 200 nits, 125.0 = 10000 nits, and 200.0 above PQ range
+	static const uint16_t Levels[] = { 0x0000, 0x3c00, 0x4100, 0x57d0, 0x5a40 };
+	static const double Nits[] = { 0.0, 80.0, 200.0, 10000.0, 10000.0 };
+	enum { LevelCount = sizeof(Levels) / sizeof(*Levels) };
+
+	uint32_t Width = 2 * LevelCount;
+	uint32_t Height = 2;
+
+	// each level is 2x2 block, so chroma is not mixed with neighbors
+	uint16_t* Input = Cpu_Alloc((size_t)Width * Height * 8);
+	for (uint32_t Y = 0; Y < Height; Y++)
+	{
+		for (uint32_t X = 0; X < Width; X++)
+		{
+			uint16_t* Pixel = Input + ((size_t)Y * Width + X) * 4;
+			Pixel[0] = Pixel[1] = Pixel[2] = Levels[X / 2];
+			Pixel[3] = 0x3c00;
+		}
+	}
+
+	ConvertOutput Out;
+	ConvertOutput_Create(&Out, Width, Height, 2);
+
+	CpuConvert Convert;
+	CpuConvert_Create(&Convert, Width, Height, YuvColorSpace_BT2020, CpuConvertFormat_P010_HDR, false, false, CpuKernel_Auto);
+	CpuConvert_Run(&Convert, (const uint8_t*)Input, Width * 8, Out.Y, Out.Pitch, Out.UV, Out.Pitch);
+	CpuConvert_Release(&Convert);
+
+	const uint16_t* PlaneY = (const uint16_t*)Out.Y;
+	const uint16_t* PlaneUV = (const uint16_t*)Out.UV;
+	for (uint32_t Level = 0; Level < LevelCount; Level++)
+	{
+		// limited range 10-bit: 64 + 876 * PQ
+		uint32_t Expected = (uint32_t)(64 + 876 * Convert_PQ(Nits[Level]) + 0.5);
+		for (uint32_t Index = 0; Index < 2; Index++)
+		{
+			uint32_t Y0 = PlaneY[Level * 2 + Index];
+			uint32_t Y1 = PlaneY[Width + Level * 2 + Index];
+			TEST_CHECK((Y0 & 63) == 0 && (Y1 & 63) == 0, "HDR Y values must have 10 bits in high bits, got %04x %04x", Y0, Y1);
+			TEST_CHECK(abs((int)(Y0 >> 6) - (int)Expected) <= 1 && Y0 == Y1, "HDR %.0f nits Y expected %u, got %u %u", Nits[Level], Expected, Y0 >> 6, Y1 >> 6);
+			// gray has no chroma
+			uint32_t Chroma = PlaneUV[Level * 2 + Index];
+			TEST_CHECK(Chroma == 512 << 6, "HDR %.0f nits gray chroma expected 512, got %u", Nits[Level], Chroma >> 6);
+		}
+	}
+
+	ConvertOutput_Release(&Out);
+	Cpu_Free(Input);
+}
+
+static void Convert_Benchmark(void)
+{
+	uint32_t Width = 1920;
+	uint32_t Height = 1080;
+
+	uint8_t* Input = Cpu_Alloc((size_t)Width * Height * 4);
+	Convert_Fill(Input, Width, Height, ConvertPattern_Noise);
+
+	ConvertOutput Out;
+	ConvertOutput_Create(&Out, Width, Height, 2);
+
+	printf("%ux%u BT709 conversion, ms per frame\n", Width, Height);
+	for (uint32_t KernelIndex = 0; KernelIndex < TEST_KERNEL_COUNT; KernelIndex++)
+	{
+		CpuKernel Kernel = Test_Kernels[KernelIndex];
+		if (!Test_HasKernel(Kernel))
+		{
+			continue;
+		}
+
+		for (CpuConvertFormat Format = CpuConvertFormat_NV12; Format <= CpuConvertFormat_P010; Format++)
+		{
+			for (uint32_t Mode = 0; Mode < 4; Mode++)
+			{
+				bool Improved = Mode & 1;
+				bool FixedPoint = Mode & 2;
+				if (FixedPoint && Format != CpuConvertFormat_NV12)
+				{
+					continue;
+				}
+
+				CpuConvert Convert;
+				CpuConvert_Create(&Convert, Width, Height, YuvColorSpace_BT709, Format, Improved, FixedPoint, Kernel);
+
+				uint32_t Count = 0;
+				double Start = Test_Time();
+				double Elapsed;
+				do
+				{
+					CpuConvert_Run(&Convert, Input, Width * 4, Out.Y, Out.Pitch, Out.UV, Out.Pitch);
+					Count++;
+					Elapsed = Test_Time() - Start;
+				}
+				while (Elapsed < 0.1);
+
+				CpuConvert_Release(&Convert);
+				printf("  %-6s %s %-8s %-5s %6.2f\n", Test_KernelName(Kernel), ConvertFormatNames[Format], Improved ? "improved" : "single", FixedPoint ? "fixed" : "float", Elapsed * 1000.0 / Count);
+			}
+		}
+	}
+
+	ConvertOutput_Release(&Out);
+	Cpu_Free(Input);
+}
+
+int main(void)
+{
+	for (uint32_t SizeIndex = 0; SizeIndex < CONVERT_SIZE_COUNT; SizeIndex++)
+	{
+		Convert_TestKernels(ConvertSizes[SizeIndex][0], ConvertSizes[SizeIndex][1]);
+		Convert_TestTiles(ConvertSizes[SizeIndex][0], ConvertSizes[SizeIndex][1]);
+	}
+
+	for (uint32_t SizeIndex = 0; SizeIndex < CONVERT_RESIZE_SIZE_COUNT; SizeIndex++)
+	{
+		Convert_TestResize(ConvertResizeSizes[SizeIndex]);
+	}
+
+	Convert_TestShaderY();
+	Convert_TestHdr();
+	Convert_Benchmark();
+
+	return Test_Finish("test_cpu_convert");
+}
@@ -0,0 +1,192 @@
+// checks CpuCursor_Convert against known pixels of all cursor types, clipping of CpuCursor_Blend at frame edges,
+// and blending of every cursor & background value against float formula of CursorBlend shader
+
+#include "test.h"
+#include "wcap_cpu_cursor.h"
+
+#include <math.h>
+
+#define CURSOR_FRAME_WIDTH 16
+#define CURSOR_FRAME_HEIGHT 12
+#define CURSOR_FRAME_PAD 3  // extra pixels after each frame row & extra rows around frame, must stay untouched
+#define CURSOR_SIZE 4
+
+static void Cursor_CheckPixel(const char* Name, const uint8_t* Output, uint32_t Index, uint8_t B, uint8_t G, uint8_t R, uint8_t A)
+{
+	const uint8_t* Pixel = Output + Index * 4;
+	TEST_CHECK(Pixel[0] == B && Pixel[1] == G && Pixel[2] == R && Pixel[3] == A, "%s pixel %u is (%u,%u,%u,%u), expected (%u,%u,%u,%u)", Name, Index, Pixel[0], Pixel[1], Pixel[2], Pixel[3], B, G, R, A);
+}
+
+static void Cursor_TestConvert(void)
+{
+	uint8_t Output[4 * 4];
+
+	// monochrome, AND mask row followed by XOR mask row, pixels are AND=0 XOR=0, AND=0 XOR=1, AND=1 XOR=0, AND=1 XOR=1
+	{
+		const uint8_t Mask[] = { 0x30, 0x50 };
+		CpuCursor_Convert(Output, NULL, 0, Mask, 1, 4, 1);
+		Cursor_CheckPixel("mono black", Output, 0, 0, 0, 0, 255);
+		Cursor_CheckPixel("mono white", Output, 1, 255, 255, 255, 255);
+		Cursor_CheckPixel("mono transparent", Output, 2, 0, 0, 0, 0);
+		Cursor_CheckPixel("mono inverted", Output, 3, 255, 255, 255, 0);
+	}
+
+	// color without alpha, mask selects opaque color or XOR with it
+	{
+		const uint8_t Color[] =
+		{
+			10, 20, 30, 0,    200, 100, 50, 0,
+			0, 0, 0, 0,       255, 255, 255, 0,
+		};
+		const uint8_t Mask[] = { 0x00, 0xc0 };
+		CpuCursor_Convert(Output, Color, 8, Mask, 1, 2, 2);
+		Cursor_CheckPixel("color opaque", Output, 0, 10, 20, 30, 255);
+		Cursor_CheckPixel("color opaque", Output, 1, 200, 100, 50, 255);
+		Cursor_CheckPixel("color transparent", Output, 2, 0, 0, 0, 0);
+		Cursor_CheckPixel("color inverted", Output, 3, 255, 255, 255, 0);
+	}
+
+	// color with alpha is premultiplied with rounding, mask is ignored
+	{
+		const uint8_t Color[] =
+		{
+			200, 100, 50, 128,    200, 100, 50, 255,
+			200, 100, 50, 0,      255, 255, 255, 1,
+		};
+		const uint8_t Mask[] = { 0xc0, 0xc0 };
+		CpuCursor_Convert(Output, Color, 8, Mask, 1, 2, 2);
+		Cursor_CheckPixel("alpha translucent", Output, 0, 100, 50, 25, 128);
+		Cursor_CheckPixel("alpha opaque", Output, 1, 200, 100, 50, 255);
+		Cursor_CheckPixel("alpha transparent", Output, 2, 0, 0, 0, 0);
+		Cursor_CheckPixel("alpha almost transparent", Output, 3, 1, 1, 1, 1);
+	}
+
+	// inverted pixels are difference with background, transparent ones keep it
+	{
+		const uint8_t Mask[] = { 0xc0, 0x80 };
+		CpuCursor_Convert(Output, NULL, 0, Mask, 1, 2, 1);
+
+		uint8_t Frame[] = { 10, 128, 250, 255,   10, 128, 250, 255 };
+		CpuCursor_Blend(Frame, sizeof(Frame), 2, 1, Output, 2, 1, 0, 0);
+		Cursor_CheckPixel("blend inverted", Frame, 0, 245, 127, 5, 255);
+		Cursor_CheckPixel("blend transparent", Frame, 1, 10, 128, 250, 255);
+	}
+}
+
+static void Cursor_TestClip(void)
+{
+	// opaque cursor with different value in every pixel, at positions that cross every edge & corner or miss the frame
+	static const int32_t Positions[][2] =
+	{
+		{  5,  4 },
+		{ -2,  4 }, { CURSOR_FRAME_WIDTH - 2,  4 }, {  5, -3 }, {  5, CURSOR_FRAME_HEIGHT - 1 },
+		{ -3, -3 }, { CURSOR_FRAME_WIDTH - 1, CURSOR_FRAME_HEIGHT - 1 }, { -1, CURSOR_FRAME_HEIGHT - 2 }, { CURSOR_FRAME_WIDTH - 3, -1 },
+		{ -CURSOR_SIZE, 0 }, { CURSOR_FRAME_WIDTH, 0 }, { 0, -CURSOR_SIZE }, { 0, CURSOR_FRAME_HEIGHT }, { -100, 100 },
+	};
+
+	uint8_t Cursor[CURSOR_SIZE * CURSOR_SIZE * 4];
+	for (uint32_t Index = 0; Index < CURSOR_SIZE * CURSOR_SIZE; Index++)
+	{
+		Cursor[Index * 4 + 0] = (uint8_t)(100 + Index);
+		Cursor[Index * 4 + 1] = (uint8_t)(150 + Index);
+		Cursor[Index * 4 + 2] = (uint8_t)(200 + Index);
+		Cursor[Index * 4 + 3] = 255;
+	}
+
+	size_t FramePitch = (CURSOR_FRAME_WIDTH + CURSOR_FRAME_PAD) * 4;
+	size_t BufferSize = FramePitch * (CURSOR_FRAME_HEIGHT + 2 * CURSOR_FRAME_PAD);
+	uint8_t* Buffer = Cpu_Alloc(BufferSize);
+	uint8_t* Frame = Buffer + CURSOR_FRAME_PAD * FramePitch;
+
+	for (size_t PositionIndex = 0; PositionIndex < sizeof(Positions) / sizeof(*Positions); PositionIndex++)
+	{
+		int32_t X = Positions[PositionIndex][0];
+		int32_t Y = Positions[PositionIndex][1];
+
+		memset(Buffer, 7, BufferSize);
+		CpuCursor_Blend(Frame, FramePitch, CURSOR_FRAME_WIDTH, CURSOR_FRAME_HEIGHT, Cursor, CURSOR_SIZE, CURSOR_SIZE, X, Y);
+
+		uint32_t Errors = 0;
+		for (int32_t Row = -CURSOR_FRAME_PAD; Row < CURSOR_FRAME_HEIGHT + CURSOR_FRAME_PAD; Row++)
+		{
+			for (int32_t Column = 0; Column < CURSOR_FRAME_WIDTH + CURSOR_FRAME_PAD; Column++)
+			{
+				const uint8_t* Pixel = Frame + Row * (ptrdiff_t)FramePitch + Column * 4;
+
+				bool InFrame = Row >= 0 && Row < CURSOR_FRAME_HEIGHT && Column < CURSOR_FRAME_WIDTH;
+				bool InCursor = Column >= X && Column < X + CURSOR_SIZE && Row >= Y && Row < Y + CURSOR_SIZE;
+
+				// alpha of frame is never written
+				uint8_t Expected[4] = { 7, 7, 7, 7 };
+				if (InFrame && InCursor)
+				{
+					memcpy(Expected, Cursor + ((Row - Y) * CURSOR_SIZE + (Column - X)) * 4, 3);
+				}
+				Errors += memcmp(Pixel, Expected, 4) != 0;
+			}
+		}
+		TEST_CHECK(Errors == 0, "cursor at %d,%d: %u pixels wrong or written outside of frame", X, Y, Errors);
+	}
+
+	Cpu_Free(Buffer);
+}
+
+static uint32_t Cursor_ShaderBlend(uint32_t Cursor, uint32_t Alpha, uint32_t Frame)
+{
+	// CursorBlend shader with UNORM loads & PackToBGR
+	float C = Cursor / 255.f;
+	float A = Alpha / 255.f;
+	float F = Frame / 255.f;
+	float Color = A == 0 ? fabsf(C - F) : C + F * (1 - A);
+	Color = Color < 0.f ? 0.f : Color > 1.f ? 1.f : Color;
+	return (uint32_t)(Color * 255 + 0.5f);
+}
+
+static void Cursor_TestShader(void)
+{
+	// every cursor value & alpha over every background value, also color above alpha that premultiplied cursor never has
+	uint8_t Cursor[256 * 4];
+	uint8_t Frame[256 * 4];
+
+	uint32_t MaxDiff = 0;
+	uint32_t DiffCount = 0;
+	for (uint32_t Alpha = 0; Alpha < 256; Alpha++)
+	{
+		for (uint32_t Value = 0; Value < 256; Value++)
+		{
+			for (uint32_t Index = 0; Index < 256; Index++)
+			{
+				// channels get different cursor values, so all three are compared
+				Cursor[Index * 4 + 0] = (uint8_t)Value;
+				Cursor[Index * 4 + 1] = (uint8_t)(255 - Value);
+				Cursor[Index * 4 + 2] = (uint8_t)(Value ^ 0x55);
+				Cursor[Index * 4 + 3] = (uint8_t)Alpha;
+				memset(Frame + Index * 4, (int)Index, 4);
+			}
+			CpuCursor_Blend(Frame, sizeof(Frame), 256, 1, Cursor, 256, 1, 0, 0);
+
+			for (uint32_t Index = 0; Index < 256; Index++)
+			{
+				for (uint32_t Channel = 0; Channel < 3; Channel++)
+				{
+					uint32_t Expected = Cursor_ShaderBlend(Cursor[Index * 4 + Channel], Alpha, Index);
+					uint32_t Diff = (uint32_t)abs((int)Frame[Index * 4 + Channel] - (int)Expected);
+					MaxDiff = Diff > MaxDiff ? Diff : MaxDiff;
+					DiffCount += Diff != 0;
+				}
+			}
+		}
+	}
+
+	TEST_CHECK(MaxDiff <= 1, "blend max diff from shader formula %u", MaxDiff);
+	printf("  blend vs shader formula: max diff %u, %.3f%% of values differ\n", MaxDiff, DiffCount * 100.0 / (256.0 * 256.0 * 256.0 * 3.0));
+}
+
+int main(void)
+{
+	Cursor_TestConvert();
+	Cursor_TestClip();
+	Cursor_TestShader();
+
+	return Test_Finish("test_cpu_cursor");
+}
@@ -0,0 +1,287 @@
+// trace driven simulation of every CpuDrop policy with encoder that has fixed count of buffers
+
+#include "test.h"
+#include "wcap_cpu_drop.h"
+
+#define DROP_PERIOD 1000
+#define DROP_BUFFERS 4
+
+static const char* DropPolicyNames[] = { "DropNewest", "ReplaceOldest", "HalveFramerate", "SkipExtras", "Auto" };
+
+// one phase of trace, frames arrive every DROP_PERIOD in groups of Burst frames with same time
+// encoder processes one frame at a time, Cost is its encode time & CheapCost is time without optional work
+typedef struct
+{
+	uint32_t Frames;
+	uint32_t Burst;
+	uint64_t Cost;
+	uint64_t CheapCost;
+}
+DropPhase;
+
+typedef struct
+{
+	uint32_t Encoded;
+	uint32_t Cheap;
+	uint32_t Dropped;
+	uint32_t DroppedWithFree;   // drops while encoder buffer was free
+	uint32_t DroppedNotQueued;  // drops of frame without newer one waiting, while buffer was free
+	uint32_t ConsecutiveDrops;  // longest run of dropped frames
+	uint32_t CheapLast;         // EncodeCheap actions in last 10 frames of phase
+	uint32_t DroppedLast;       // Drop actions in last 10 frames of phase
+	uint64_t MaxLatency;
+	uint32_t Ticks;             // stream ticks sent for dropped frames
+	uint32_t DroppedFirst;      // frames dropped before first encoded frame, these have nothing to tick
+	uint32_t TimelineErrors;    // overlapping samples & ticks, gaps without discontinuity, drops without tick
+}
+DropStats;
+
+typedef struct
+{
+	CpuDrop Drop;
+	uint64_t Done[DROP_BUFFERS]; // time when buffer becomes free again, 0 when free
+	uint64_t Submit[DROP_BUFFERS];
+	uint64_t EncoderFree;        // time when encoder finishes all submitted frames
+	uint64_t Time;
+	uint32_t Consecutive;
+
+	// output timeline, same samples & stream ticks as Encoder_NewFrame writes with duplicate skipping
+	// sample is pending until next frame or drop, timestamps are times after first encoded frame
+	uint64_t StartTime;
+	uint64_t PendingTime;
+	uint64_t LastEnd;           // end of last written sample or time of last stream tick
+	bool Pending;
+	bool PendingDiscontinuity;
+	bool Discontinuity;         // set on drop, next sample is marked with it
+	bool Written;
+}
+DropSim;
+
+static void DropSim_Create(DropSim* Sim, CpuDropPolicy Policy)
+{
+	*Sim = (DropSim) { .Time = DROP_PERIOD };
+	CpuDrop_Create(&Sim->Drop, Policy, DROP_BUFFERS);
+}
+
+// same as Encoder__WritePendingVideo, sample is shown until Time
+static void DropSim_WritePending(DropSim* Sim, uint64_t Time, DropStats* Stats)
+{
+	if (Sim->Pending)
+	{
+		uint64_t Timestamp = Sim->PendingTime;
+		bool Gap = Sim->Written && Timestamp != Sim->LastEnd;
+
+		// sample never starts before end of previous one, & only discontinuity can start later
+		Stats->TimelineErrors += Sim->Written && Timestamp < Sim->LastEnd;
+		Stats->TimelineErrors += Gap && !Sim->PendingDiscontinuity;
+
+		Sim->LastEnd = Time - Sim->StartTime;
+		Sim->Written = true;
+		Sim->Pending = false;
+	}
+}
+
+// same as Encoder__DropVideo
+static void DropSim_DropFrame(DropSim* Sim, uint64_t Time, DropStats* Stats)
+{
+	DropSim_WritePending(Sim, Time, Stats);
+	if (Sim->StartTime != 0)
+	{
+		uint64_t Timestamp = Time - Sim->StartTime;
+		Stats->TimelineErrors += Sim->Written && Timestamp < Sim->LastEnd;
+		Stats->Ticks++;
+		Sim->LastEnd = Timestamp;
+		Sim->Written = true;
+	}
+	else
+	{
+		Stats->DroppedFirst++;
+	}
+	Sim->Discontinuity = true;
+}
+
+// same as end of Encoder__EncodeInput
+static void DropSim_EncodeFrame(DropSim* Sim, uint64_t Time, DropStats* Stats)
+{
+	if (Sim->StartTime == 0)
+	{
+		Sim->StartTime = Time;
+	}
+	uint64_t Timestamp = Time - Sim->StartTime;
+	bool Discontinuity = Sim->Discontinuity;
+	Sim->Discontinuity = false;
+
+	DropSim_WritePending(Sim, Time, Stats);
+	Sim->PendingTime = Timestamp;
+	Sim->PendingDiscontinuity = Discontinuity;
+	Sim->Pending = true;
+}
+
+static void DropSim_Run(DropSim* Sim, const DropPhase* Phase, DropStats* Stats)
+{
+	*Stats = (DropStats) { 0 };
+
+	for (uint32_t Frame = 0; Frame < Phase->Frames; Frame += Phase->Burst)
+	{
+		uint64_t Time = Sim->Time;
+		Sim->Time += (uint64_t)DROP_PERIOD * Phase->Burst;
+
+		// latency is known only when buffer is released, same as in encoder sample callback
+		uint32_t Free = 0;
+		for (uint32_t Buffer = 0; Buffer < DROP_BUFFERS; Buffer++)
+		{
+			if (Sim->Done[Buffer] != 0 && Sim->Done[Buffer] <= Time)
+			{
+				CpuDrop_AddLatency(&Sim->Drop, Sim->Done[Buffer] - Sim->Submit[Buffer]);
+				Sim->Done[Buffer] = 0;
+			}
+			Free += Sim->Done[Buffer] == 0;
+		}
+
+		for (uint32_t Index = 0; Index < Phase->Burst; Index++)
+		{
+			uint32_t Queued = Phase->Burst - 1 - Index;
+			CpuDropAction Action = CpuDrop_Decide(&Sim->Drop, Queued, Free, Time, DROP_PERIOD);
+			bool Last = Frame + Index + 10 >= Phase->Frames;
+
+			if (Action == CpuDropAction_Drop)
+			{
+				DropSim_DropFrame(Sim, Time, Stats);
+				Stats->Dropped++;
+				Stats->DroppedWithFree += Free != 0;
+				Stats->DroppedNotQueued += Free != 0 && Queued == 0;
+				Stats->DroppedLast += Last;
+				Sim->Consecutive++;
+				Stats->ConsecutiveDrops = Sim->Consecutive > Stats->ConsecutiveDrops ? Sim->Consecutive : Stats->ConsecutiveDrops;
+				continue;
+			}
+			Sim->Consecutive = 0;
+
+			bool Cheap = Action == CpuDropAction_EncodeCheap;
+			Stats->Encoded++;
+			Stats->Cheap += Cheap;
+			Stats->CheapLast += Cheap && Last;
+
+			uint32_t Buffer = 0;
+			while (Sim->Done[Buffer] != 0)
+			{
+				Buffer++;
+			}
+			Assert(Buffer < DROP_BUFFERS);
+
+			uint64_t Start = Sim->EncoderFree > Time ? Sim->EncoderFree : Time;
+			Sim->EncoderFree = Start + (Cheap ? Phase->CheapCost : Phase->Cost);
+			Sim->Done[Buffer] = Sim->EncoderFree;
+			Sim->Submit[Buffer] = Time;
+			Free--;
+			DropSim_EncodeFrame(Sim, Time, Stats);
+
+			uint64_t Latency = Sim->EncoderFree - Time;
+			Stats->MaxLatency = Latency > Stats->MaxLatency ? Latency : Stats->MaxLatency;
+		}
+	}
+}
+
+static void Drop_Print(CpuDropPolicy Policy, const char* Name, const DropPhase* Phase, const DropStats* Stats)
+{
+	printf("  %-14s %-10s %4u frames: %4u encoded (%4u cheap), %4u dropped, max latency %.1f periods\n", DropPolicyNames[Policy], Name, Phase->Frames, Stats->Encoded, Stats->Cheap, Stats->Dropped, (double)Stats->MaxLatency / DROP_PERIOD);
+}
+
+static void Drop_CheckTimeline(CpuDropPolicy Policy, const char* Name, const DropStats* Stats)
+{
+	// every dropped frame ends pending sample & sends stream tick, also ones dropped by policy while buffers are free
+	// samples never overlap, and only sample after drop can start later than previous one ends
+	TEST_CHECK(Stats->Ticks + Stats->DroppedFirst == Stats->Dropped, "%s %s: %u stream ticks for %u dropped frames", DropPolicyNames[Policy], Name, Stats->Ticks, Stats->Dropped - Stats->DroppedFirst);
+	TEST_CHECK(Stats->TimelineErrors == 0, "%s %s: %u timeline errors", DropPolicyNames[Policy], Name, Stats->TimelineErrors);
+}
+
+int main(void)
+{
+	// light load, then overload that cheap encoding fixes, severe overload, bursts of two frames, and recovery
+	static const DropPhase Light     = { 300, 1, DROP_PERIOD / 2,     DROP_PERIOD / 3     };
+	static const DropPhase Overload  = { 300, 1, DROP_PERIOD * 3 / 2, DROP_PERIOD * 8 / 10 };
+	static const DropPhase Severe    = { 300, 1, DROP_PERIOD * 3,     DROP_PERIOD * 2     };
+	static const DropPhase Burst     = { 300, 2, DROP_PERIOD / 2,     DROP_PERIOD / 3     };
+
+	for (CpuDropPolicy Policy = CpuDropPolicy_DropNewest; Policy <= CpuDropPolicy_Auto; Policy++)
+	{
+		const char* Name = DropPolicyNames[Policy];
+		DropSim Sim;
+		DropStats Stats;
+
+		// nothing is dropped or made cheaper when encoder keeps up
+		DropSim_Create(&Sim, Policy);
+		DropSim_Run(&Sim, &Light, &Stats);
+		Drop_Print(Policy, "light", &Light, &Stats);
+		Drop_CheckTimeline(Policy, "light", &Stats);
+		TEST_CHECK(Stats.Dropped == 0 && Stats.Cheap == 0, "%s light load: %u dropped, %u cheap", Name, Stats.Dropped, Stats.Cheap);
+
+		DropSim_Run(&Sim, &Overload, &Stats);
+		Drop_Print(Policy, "overload", &Overload, &Stats);
+		Drop_CheckTimeline(Policy, "overload", &Stats);
+		switch (Policy)
+		{
+		case CpuDropPolicy_DropNewest:
+		case CpuDropPolicy_ReplaceOldest:
+			// without newer frames in queue these two drop only when all buffers are busy
+			TEST_CHECK(Stats.DroppedWithFree == 0 && Stats.Cheap == 0, "%s overload: %u dropped with free buffer, %u cheap", Name, Stats.DroppedWithFree, Stats.Cheap);
+			TEST_CHECK(Stats.Dropped > 0, "%s overload: nothing dropped when encoder is slower than capture", Name);
+			break;
+		case CpuDropPolicy_HalveFramerate:
+			// every other frame, so encoder at 1.5 periods per frame keeps up
+			TEST_CHECK(Stats.Cheap == 0 && Stats.DroppedWithFree == Stats.Dropped && Stats.ConsecutiveDrops == 1, "%s overload: %u cheap, %u of %u drops with free buffer, %u consecutive", Name, Stats.Cheap, Stats.DroppedWithFree, Stats.Dropped, Stats.ConsecutiveDrops);
+			TEST_CHECK(Stats.Dropped >= Overload.Frames * 4 / 10 && Stats.Dropped <= Overload.Frames * 6 / 10, "%s overload: %u of %u dropped", Name, Stats.Dropped, Overload.Frames);
+			break;
+		case CpuDropPolicy_SkipExtras:
+		case CpuDropPolicy_Auto:
+			// cheap encoding is enough, only few frames are dropped when hold time ends & full encoding fills buffers again
+			TEST_CHECK(Stats.Cheap >= Overload.Frames * 3 / 4 && Stats.Dropped <= Overload.Frames / 20, "%s overload: %u cheap, %u dropped", Name, Stats.Cheap, Stats.Dropped);
+			break;
+		default:
+			break;
+		}
+		// no policy lets latency grow without bound, every buffer has at most one frame
+		TEST_CHECK(Stats.MaxLatency <= (uint64_t)DROP_BUFFERS * Overload.Cost, "%s overload: max latency %llu", Name, (unsigned long long)Stats.MaxLatency);
+
+		DropSim_Run(&Sim, &Severe, &Stats);
+		Drop_Print(Policy, "severe", &Severe, &Stats);
+		Drop_CheckTimeline(Policy, "severe", &Stats);
+		if (Policy == CpuDropPolicy_Auto)
+		{
+			// cheap encoding alone is not enough, so it also halves framerate instead of waiting for buffers
+			TEST_CHECK(Stats.DroppedWithFree > 0 && Stats.Cheap >= Stats.Encoded * 9 / 10, "%s severe: %u drops with free buffer, %u of %u cheap", Name, Stats.DroppedWithFree, Stats.Cheap, Stats.Encoded);
+		}
+		// encoder at 2 periods per cheap frame can encode at most half of frames
+		TEST_CHECK(Stats.Encoded <= Severe.Frames / 2 + DROP_BUFFERS, "%s severe: encoded %u of %u", Name, Stats.Encoded, Severe.Frames);
+		TEST_CHECK(Stats.MaxLatency <= (uint64_t)DROP_BUFFERS * Severe.Cost, "%s severe: max latency %llu", Name, (unsigned long long)Stats.MaxLatency);
+
+		// policy returns to normal encoding after load goes away & hold time passes
+		DropSim_Run(&Sim, &Light, &Stats);
+		Drop_Print(Policy, "recovery", &Light, &Stats);
+		Drop_CheckTimeline(Policy, "recovery", &Stats);
+		TEST_CHECK(Stats.CheapLast == 0 && Stats.DroppedLast == 0, "%s recovery: %u cheap, %u dropped in last frames", Name, Stats.CheapLast, Stats.DroppedLast);
+		TEST_CHECK(Stats.Encoded + Stats.Dropped == Light.Frames && Stats.Cheap + Stats.Dropped <= 2 * CPU_DROP_HOLD_FRAMES + 2 * DROP_BUFFERS, "%s recovery: %u cheap, %u dropped", Name, Stats.Cheap, Stats.Dropped);
+
+		// two frames arriving at once, encoder keeps up on average
+		DropSim_Create(&Sim, Policy);
+		DropSim_Run(&Sim, &Burst, &Stats);
+		Drop_Print(Policy, "burst", &Burst, &Stats);
+		Drop_CheckTimeline(Policy, "burst", &Stats);
+		switch (Policy)
+		{
+		case CpuDropPolicy_DropNewest:
+			TEST_CHECK(Stats.Dropped == 0, "%s burst: %u dropped", Name, Stats.Dropped);
+			break;
+		case CpuDropPolicy_ReplaceOldest:
+			// older frame of every pair is replaced by newer one
+			TEST_CHECK(Stats.Dropped == Burst.Frames / 2 && Stats.DroppedNotQueued == 0, "%s burst: %u dropped, %u without newer frame", Name, Stats.Dropped, Stats.DroppedNotQueued);
+			break;
+		default:
+			// queue depth alone is sign of overload, never drop newest frame of pair while buffers are free
+			TEST_CHECK(Stats.DroppedNotQueued == 0 || Policy == CpuDropPolicy_HalveFramerate, "%s burst: %u newest frames dropped", Name, Stats.DroppedNotQueued);
+			break;
+		}
+	}
+
+	return Test_Finish("test_cpu_drop");
+}
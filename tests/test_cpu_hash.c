@@ -0,0 +1,296 @@
+// compares every CpuHash kernel against scalar reference at odd sizes, measures hashing throughput,
+// and drives synthetic static & animated frame sequences through duplicate frame detection
+
+#include "test.h"
+#include "wcap_cpu_hash.h"
+
+static const uint32_t HashSizes[][2] =
+{
+	{    1,    1 },
+	{    3,    5 },
+	{   31,   33 },
+	{   33,   31 },
+	{   37,   65 }, // tails after full 4 & 8 pixel vectors
+	{  100,   37 },
+	{  255,    7 },
+	{ 1921, 1081 },
+};
+#define HASH_SIZE_COUNT (sizeof(HashSizes) / sizeof(*HashSizes))
+
+// extra bytes at end of every input row, so kernels must use pitch instead of width
+#define HASH_PITCH_PADDING 12
+
+static void Hash_Fill(uint8_t* Image, size_t Pitch, uint32_t Width, uint32_t Height, uint32_t* State)
+{
+	for (uint32_t Y = 0; Y < Height; Y++)
+	{
+		for (uint32_t X = 0; X < Width; X++)
+		{
+			uint32_t Noise = Test_Random(State);
+			memcpy(Image + Y * Pitch + X * 4, &Noise, 4);
+		}
+	}
+}
+
+static void Hash_TestKernels(uint32_t Width, uint32_t Height)
+{
+	size_t Pitch = Width * 4 + HASH_PITCH_PADDING;
+	uint8_t* Input = Cpu_Alloc(Pitch * Height);
+
+	uint32_t State = Width * 7 + Height;
+	Hash_Fill(Input, Pitch, Width, Height, &State);
+
+	CpuHash Ref;
+	CpuHash_Create(&Ref, Width, Height, CpuKernel_Scalar);
+
+	size_t HashSize = 2 * Ref.BlockCountX * Ref.BlockCountY * sizeof(uint32_t);
+	uint32_t* RefHashes = Cpu_Alloc(HashSize);
+	uint32_t* Hashes = Cpu_Alloc(HashSize);
+	CpuHash_Run(&Ref, Input, Pitch, RefHashes);
+
+	for (uint32_t KernelIndex = 0; KernelIndex < TEST_KERNEL_COUNT; KernelIndex++)
+	{
+		CpuKernel Kernel = Test_Kernels[KernelIndex];
+		if (!Test_HasKernel(Kernel))
+		{
+			continue;
+		}
+
+		CpuHash Hash;
+		CpuHash_Create(&Hash, Width, Height, Kernel);
+
+		memset(Hashes, 0xcc, HashSize);
+		CpuHash_Run(&Hash, Input, Pitch, Hashes);
+		TEST_CHECK(memcmp(RefHashes, Hashes, HashSize) == 0, "%ux%u %s hashes differ from scalar", Width, Height, Test_KernelName(Kernel));
+
+		// block rows split between threads give same hashes
+		memset(Hashes, 0xcc, HashSize);
+		uint32_t Middle = Hash.BlockCountY / 2;
+		CpuHash_RunRows(&Hash, Input, Pitch, Hashes, Middle, Hash.BlockCountY);
+		CpuHash_RunRows(&Hash, Input, Pitch, Hashes, 0, Middle);
+		TEST_CHECK(memcmp(RefHashes, Hashes, HashSize) == 0, "%ux%u %s hashes of split rows differ", Width, Height, Test_KernelName(Kernel));
+
+		// alpha is ignored
+		for (uint32_t Y = 0; Y < Height; Y++)
+		{
+			for (uint32_t X = 0; X < Width; X++)
+			{
+				Input[Y * Pitch + X * 4 + 3] ^= 0xff;
+			}
+		}
+		CpuHash_Run(&Hash, Input, Pitch, Hashes);
+		TEST_CHECK(memcmp(RefHashes, Hashes, HashSize) == 0, "%ux%u %s hashes depend on alpha", Width, Height, Test_KernelName(Kernel));
+	}
+
+	Cpu_Free(Hashes);
+	Cpu_Free(RefHashes);
+	Cpu_Free(Input);
+}
+
+// synthetic sequences
+
+#define HASH_SEQUENCE_WIDTH 1280
+#define HASH_SEQUENCE_HEIGHT 720
+#define HASH_SEQUENCE_FRAMES 60
+
+typedef enum
+{
+	HashSequence_Static,   // same pixels in every frame, only alpha changes
+	HashSequence_Caret,    // blinking 2x16 caret, on for 15 frames & off for 15 frames
+	HashSequence_Square,   // 48x48 square moving 5 pixels every frame
+	HashSequence_Noise,    // every pixel changes in every frame, like video
+	HashSequence_Count,
+}
+HashSequence;
+
+static const char* HashSequenceNames[] = { "static", "caret", "square", "noise" };
+
+static void Hash_DrawFrame(uint8_t* Image, const uint8_t* Background, HashSequence Sequence, uint32_t Frame, uint32_t* State)
+{
+	size_t Pitch = HASH_SEQUENCE_WIDTH * 4;
+	memcpy(Image, Background, Pitch * HASH_SEQUENCE_HEIGHT);
+
+	switch (Sequence)
+	{
+	case HashSequence_Static:
+		for (uint32_t Index = 0; Index < HASH_SEQUENCE_WIDTH * HASH_SEQUENCE_HEIGHT; Index++)
+		{
+			Image[Index * 4 + 3] = (uint8_t)Frame;
+		}
+		break;
+	case HashSequence_Caret:
+		if (Frame / 15 % 2 == 0)
+		{
+			for (uint32_t Y = 300; Y < 316; Y++)
+			{
+				memset(Image + Y * Pitch + 500 * 4, 0, 2 * 4);
+			}
+		}
+		break;
+	case HashSequence_Square:
+		for (uint32_t Y = 100 + Frame * 5; Y < 148 + Frame * 5; Y++)
+		{
+			memset(Image + Y * Pitch + (200 + Frame * 5) * 4, 0xff, 48 * 4);
+		}
+		break;
+	case HashSequence_Noise:
+		Hash_Fill(Image, Pitch, HASH_SEQUENCE_WIDTH, HASH_SEQUENCE_HEIGHT, State);
+		break;
+	default:
+		break;
+	}
+}
+
+static bool Hash_BlockChanged(const uint8_t* Previous, const uint8_t* Current, uint32_t BlockX, uint32_t BlockY)
+{
+	// exact comparison of RGB values in block
+	size_t Pitch = HASH_SEQUENCE_WIDTH * 4;
+	for (uint32_t Y = BlockY * CPU_HASH_BLOCK_SIZE; Y < (BlockY + 1) * CPU_HASH_BLOCK_SIZE && Y < HASH_SEQUENCE_HEIGHT; Y++)
+	{
+		for (uint32_t X = BlockX * CPU_HASH_BLOCK_SIZE; X < (BlockX + 1) * CPU_HASH_BLOCK_SIZE && X < HASH_SEQUENCE_WIDTH; X++)
+		{
+			if (memcmp(Previous + Y * Pitch + X * 4, Current + Y * Pitch + X * 4, 3) != 0)
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+static void Hash_TestSequences(void)
+{
+	size_t Pitch = HASH_SEQUENCE_WIDTH * 4;
+	uint8_t* Background = Cpu_Alloc(Pitch * HASH_SEQUENCE_HEIGHT);
+	uint8_t* Frames[2] = { Cpu_Alloc(Pitch * HASH_SEQUENCE_HEIGHT), Cpu_Alloc(Pitch * HASH_SEQUENCE_HEIGHT) };
+
+	uint32_t State = 1;
+	Hash_Fill(Background, Pitch, HASH_SEQUENCE_WIDTH, HASH_SEQUENCE_HEIGHT, &State);
+
+	CpuHash Hash;
+	CpuHash_Create(&Hash, HASH_SEQUENCE_WIDTH, HASH_SEQUENCE_HEIGHT, CpuKernel_Auto);
+
+	uint32_t BlockCount = Hash.BlockCountX * Hash.BlockCountY;
+	uint32_t* Hashes[2] = { Cpu_Alloc(2 * BlockCount * sizeof(uint32_t)), Cpu_Alloc(2 * BlockCount * sizeof(uint32_t)) };
+	uint32_t* Blocks = Cpu_Alloc(BlockCount * sizeof(uint32_t));
+
+	// duplicate frames are the ones encoder skips & shows previous frame longer instead
+	static const uint32_t ExpectedDuplicates[] =
+	{
+		[HashSequence_Static] = HASH_SEQUENCE_FRAMES - 1,
+		[HashSequence_Caret]  = HASH_SEQUENCE_FRAMES - 1 - (HASH_SEQUENCE_FRAMES - 1) / 15,
+		[HashSequence_Square] = 0,
+		[HashSequence_Noise]  = 0,
+	};
+
+	for (HashSequence Sequence = 0; Sequence < HashSequence_Count; Sequence++)
+	{
+		uint32_t Duplicates = 0;
+		uint32_t DirtyBlocks = 0;
+		uint32_t WrongBlocks = 0;
+
+		for (uint32_t Frame = 0; Frame < HASH_SEQUENCE_FRAMES; Frame++)
+		{
+			uint8_t* Current = Frames[Frame % 2];
+			uint8_t* Previous = Frames[(Frame + 1) % 2];
+			uint32_t* CurrentHashes = Hashes[Frame % 2];
+			uint32_t* PreviousHashes = Hashes[(Frame + 1) % 2];
+
+			Hash_DrawFrame(Current, Background, Sequence, Frame, &State);
+			CpuHash_Run(&Hash, Current, Pitch, CurrentHashes);
+			if (Frame == 0)
+			{
+				continue;
+			}
+
+			// every block hash changes exactly when its pixels change
+			for (uint32_t BlockY = 0; BlockY < Hash.BlockCountY; BlockY++)
+			{
+				for (uint32_t BlockX = 0; BlockX < Hash.BlockCountX; BlockX++)
+				{
+					size_t Index = 2 * (BlockY * Hash.BlockCountX + BlockX);
+					bool HashChanged = CurrentHashes[Index + 0] != PreviousHashes[Index + 0] || CurrentHashes[Index + 1] != PreviousHashes[Index + 1];
+					WrongBlocks += HashChanged != Hash_BlockChanged(Previous, Current, BlockX, BlockY);
+				}
+			}
+
+			uint32_t Count = CpuHash_DirtyBlocks(PreviousHashes, CurrentHashes, Hash.BlockCountX, Hash.BlockCountY, Blocks);
+			Duplicates += Count == 0;
+			DirtyBlocks += Count;
+		}
+
+		TEST_CHECK(WrongBlocks == 0, "%s sequence: %u block hashes do not match pixel changes", HashSequenceNames[Sequence], WrongBlocks);
+		TEST_CHECK(Duplicates == ExpectedDuplicates[Sequence], "%s sequence: %u duplicate frames, expected %u", HashSequenceNames[Sequence], Duplicates, ExpectedDuplicates[Sequence]);
+		printf("  %-6s sequence: %2u of %u frames skipped as duplicates, %6.2f%% of blocks converted\n", HashSequenceNames[Sequence], Duplicates, HASH_SEQUENCE_FRAMES - 1, DirtyBlocks * 100.0 / (BlockCount * (HASH_SEQUENCE_FRAMES - 1)));
+	}
+
+	Cpu_Free(Blocks);
+	Cpu_Free(Hashes[0]);
+	Cpu_Free(Hashes[1]);
+	Cpu_Free(Frames[0]);
+	Cpu_Free(Frames[1]);
+	Cpu_Free(Background);
+}
+
+static void Hash_Benchmark(void)
+{
+	static const uint32_t Sizes[][2] = { { 1920, 1080 }, { 2560, 1440 }, { 3840, 2160 } };
+
+	uint32_t Width = 3840;
+	uint32_t Height = 2160;
+	uint8_t* Input = Cpu_Alloc((size_t)Width * Height * 4);
+
+	uint32_t State = 1;
+	Hash_Fill(Input, Width * 4, Width, Height, &State);
+
+	printf("hashing throughput, GB/s of BGRA input\n");
+	for (uint32_t SizeIndex = 0; SizeIndex < sizeof(Sizes) / sizeof(*Sizes); SizeIndex++)
+	{
+		uint32_t SizeX = Sizes[SizeIndex][0];
+		uint32_t SizeY = Sizes[SizeIndex][1];
+
+		printf("  %ux%u", SizeX, SizeY);
+		for (uint32_t KernelIndex = 0; KernelIndex < TEST_KERNEL_COUNT; KernelIndex++)
+		{
+			CpuKernel Kernel = Test_Kernels[KernelIndex];
+			if (!Test_HasKernel(Kernel))
+			{
+				continue;
+			}
+
+			CpuHash Hash;
+			CpuHash_Create(&Hash, SizeX, SizeY, Kernel);
+			uint32_t* Hashes = Cpu_Alloc(2 * Hash.BlockCountX * Hash.BlockCountY * sizeof(uint32_t));
+
+			uint32_t Count = 0;
+			double Start = Test_Time();
+			double Elapsed;
+			do
+			{
+				CpuHash_Run(&Hash, Input, Width * 4, Hashes);
+				Count++;
+				Elapsed = Test_Time() - Start;
+			}
+			while (Elapsed < 0.1);
+
+			Cpu_Free(Hashes);
+			printf("  %s %6.2f", Test_KernelName(Kernel), (double)SizeX * SizeY * 4 * Count / Elapsed * 1e-9);
+		}
+		printf("\n");
+	}
+
+	Cpu_Free(Input);
+}
+
+int main(void)
+{
+	for (uint32_t SizeIndex = 0; SizeIndex < HASH_SIZE_COUNT; SizeIndex++)
+	{
+		Hash_TestKernels(HashSizes[SizeIndex][0], HashSizes[SizeIndex][1]);
+	}
+
+	Hash_TestSequences();
+	Hash_Benchmark();
+
+	return Test_Finish("test_cpu_hash");
+}
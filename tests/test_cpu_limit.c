@@ -0,0 +1,188 @@
+// simulates captured frame timestamps with jitter, variable refresh & idle gaps, and checks CpuLimit output rate
+
+#include "test.h"
+#include "wcap_cpu_limit.h"
+
+#define LIMIT_FREQ 10000000ULL // same as usual QueryPerformanceFrequency
+#define LIMIT_MAX_FRAMES 100000
+
+typedef enum
+{
+	LimitTrace_Steady, // every frame exactly at compositor rate
+	LimitTrace_Jitter, // each frame is late by random amount of up to 40% of period
+	LimitTrace_Vrr,    // random period between half & double of compositor period
+	LimitTrace_Idle,   // steady frames with 1 second gaps when nothing changes on screen
+}
+LimitTrace;
+
+static const char* LimitTraceNames[] = { "steady", "jitter", "vrr", "idle" };
+
+static uint32_t Limit_MakeTrace(uint64_t* Times, LimitTrace Trace, uint32_t Rate, double Seconds)
+{
+	uint32_t State = Rate * 7 + Trace;
+	uint64_t Period = LIMIT_FREQ / Rate;
+	uint64_t Start = 123456789;
+	uint64_t End = Start + (uint64_t)(Seconds * LIMIT_FREQ);
+
+	uint32_t Count = 0;
+	uint64_t Base = Start;
+	while (Base < End && Count < LIMIT_MAX_FRAMES)
+	{
+		uint64_t Time = Base;
+		switch (Trace)
+		{
+		case LimitTrace_Steady:
+			Base += Period;
+			break;
+		case LimitTrace_Jitter:
+			Time += Test_Random(&State) % (Period * 4 / 10);
+			Base += Period;
+			break;
+		case LimitTrace_Vrr:
+			Base += Period / 2 + Test_Random(&State) % (Period * 3 / 2);
+			break;
+		case LimitTrace_Idle:
+			Base += Period;
+			if (Test_Random(&State) % (Rate * 2) == 0)
+			{
+				Base += LIMIT_FREQ;
+			}
+			break;
+		}
+		Times[Count++] = Time;
+	}
+	return Count;
+}
+
+static void Limit_Test(LimitTrace Trace, uint32_t Rate, uint32_t MaxFramerate)
+{
+	static uint64_t Times[LIMIT_MAX_FRAMES];
+	static uint64_t Accepted[LIMIT_MAX_FRAMES];
+
+	double Seconds = 20.0;
+	uint32_t Count = Limit_MakeTrace(Times, Trace, Rate, Seconds);
+
+	CpuLimit Limit;
+	bool Limited = CpuLimit_Create(&Limit, MaxFramerate, Rate, 1, LIMIT_FREQ);
+	TEST_CHECK(Limited == (MaxFramerate != 0 && MaxFramerate < Rate), "%u fps limited to %u: Create returned %d", Rate, MaxFramerate, Limited);
+
+	uint32_t AcceptedCount = 0;
+	for (uint32_t Index = 0; Index < Count; Index++)
+	{
+		if (CpuLimit_Accept(&Limit, Times[Index]))
+		{
+			Accepted[AcceptedCount++] = Times[Index];
+		}
+	}
+
+	if (!Limited)
+	{
+		TEST_CHECK(AcceptedCount == Count, "%s %u fps not limited by %u: accepted %u of %u", LimitTraceNames[Trace], Rate, MaxFramerate, AcceptedCount, Count);
+		return;
+	}
+
+	// no one second window has more frames than limit, with one extra for frame exactly at window edge
+	// and ones accepted sooner than limit period after previous one while grid catches up after delay
+	uint32_t MaxWindow = 0;
+	uint32_t First = 0;
+	for (uint32_t Last = 0; Last < AcceptedCount; Last++)
+	{
+		while (Accepted[Last] - Accepted[First] >= LIMIT_FREQ)
+		{
+			First++;
+		}
+		MaxWindow = Last - First + 1 > MaxWindow ? Last - First + 1 : MaxWindow;
+	}
+	TEST_CHECK(MaxWindow <= MaxFramerate + CPU_LIMIT_RESTART_PERIODS, "%s %u fps limited to %u: %u frames in one second window", LimitTraceNames[Trace], Rate, MaxFramerate, MaxWindow);
+
+	// average rate while frames arrive is limit, or what source delivers when it is lower
+	uint64_t Active = 0;
+	uint32_t ActiveFrames = 0;
+	for (uint32_t Index = 1; Index < AcceptedCount; Index++)
+	{
+		uint64_t Delta = Accepted[Index] - Accepted[Index - 1];
+		if (Delta < LIMIT_FREQ / 2)
+		{
+			Active += Delta;
+			ActiveFrames++;
+		}
+	}
+	double Average = ActiveFrames ? ActiveFrames * (double)LIMIT_FREQ / Active : 0;
+	double Source = Trace == LimitTrace_Vrr ? Rate * 0.8 : Rate;
+	double Expected = Source < MaxFramerate ? Source : MaxFramerate;
+	TEST_CHECK(Average >= Expected * 0.97 && Average <= Expected * 1.03, "%s %u fps limited to %u: average %.2f fps, expected %.2f", LimitTraceNames[Trace], Rate, MaxFramerate, Average, Expected);
+
+	printf("  %-6s %3u fps limited to %3u: accepted %5u of %5u, average %6.2f fps, max %3u in 1 second\n", LimitTraceNames[Trace], Rate, MaxFramerate, AcceptedCount, Count, Average, MaxWindow);
+}
+
+static void Limit_TestOrder(void)
+{
+	// frames with same or older time than previous one are ignored, even when not limited
+	CpuLimit Limit;
+	CpuLimit_Create(&Limit, 0, 60, 1, LIMIT_FREQ);
+	TEST_CHECK(CpuLimit_Accept(&Limit, 1000), "first frame not accepted");
+	TEST_CHECK(!CpuLimit_Accept(&Limit, 1000), "frame with same time accepted");
+	TEST_CHECK(!CpuLimit_Accept(&Limit, 900), "frame from past accepted");
+	TEST_CHECK(CpuLimit_Accept(&Limit, 1100), "newer frame not accepted");
+}
+
+static void Limit_TestGap(void)
+{
+	// 240 fps limited to 60, so every 4th frame is on grid
+	uint64_t Period = LIMIT_FREQ / 240;
+	uint64_t Time = 1000;
+
+	CpuLimit Limit;
+	CpuLimit_Create(&Limit, 60, 240, 1, LIMIT_FREQ);
+	for (uint32_t Index = 0; Index < 40; Index++, Time += Period)
+	{
+		CpuLimit_Accept(&Limit, Time);
+	}
+
+	// after short gap grid keeps its phase, so frames are accepted right away until it catches up
+	Time += 6 * Period;
+	uint32_t Accepted = 0;
+	for (uint32_t Index = 0; Index < 4; Index++, Time += Period)
+	{
+		Accepted += CpuLimit_Accept(&Limit, Time);
+	}
+	TEST_CHECK(Accepted >= 2, "after 1.5 period gap accepted %u of 4 frames", Accepted);
+
+	// after long gap grid restarts from first frame, so next one is accepted only one limit period later
+	Time += LIMIT_FREQ;
+	TEST_CHECK(CpuLimit_Accept(&Limit, Time), "first frame after 1 second gap not accepted");
+	Accepted = 0;
+	for (uint32_t Index = 1; Index < 4; Index++)
+	{
+		Accepted += CpuLimit_Accept(&Limit, Time + Index * Period);
+	}
+	TEST_CHECK(Accepted == 0, "after 1 second gap accepted %u frames within one limit period", Accepted);
+	TEST_CHECK(CpuLimit_Accept(&Limit, Time + LIMIT_FREQ / 60 + 1), "frame one limit period after gap not accepted");
+}
+
+int main(void)
+{
+	Limit_TestOrder();
+	Limit_TestGap();
+
+	static const uint32_t Rates[][2] =
+	{
+		{  60, 30 },
+		{  60, 60 }, // same as compositor, not limited
+		{  60,  0 },
+		{  75, 60 },
+		{ 144, 60 },
+		{ 144, 30 },
+		{ 240, 50 },
+		{ 165, 24 },
+	};
+	for (LimitTrace Trace = LimitTrace_Steady; Trace <= LimitTrace_Idle; Trace++)
+	{
+		for (uint32_t Index = 0; Index < sizeof(Rates) / sizeof(*Rates); Index++)
+		{
+			Limit_Test(Trace, Rates[Index][0], Rates[Index][1]);
+		}
+	}
+
+	return Test_Finish("test_cpu_limit");
+}
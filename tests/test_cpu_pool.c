@@ -0,0 +1,128 @@
+// checks that CpuPool runs every task exactly once, and that no worker runs two tasks at same time
+
+#include "test.h"
+#include "wcap_cpu_pool.h"
+
+#define POOL_MAX_TASKS 4096
+#define POOL_MAX_WORKERS 1024
+
+typedef struct
+{
+	_Atomic(uint32_t) Runs[POOL_MAX_TASKS];
+	_Atomic(uint32_t) Busy[POOL_MAX_WORKERS]; // for each worker, set while it runs task
+	_Atomic(uint32_t) Overlaps;               // tasks started while same worker was busy
+	_Atomic(uint32_t) BadWorker;              // tasks with Worker index outside of pool
+	_Atomic(uint32_t) Stolen;                 // tasks not run by worker that got them at start
+	uint32_t ThreadCount;
+	uint32_t Count;
+	uint32_t SlowEvery;                       // every this task takes longer, so others have something to steal
+}
+PoolState;
+
+static void Pool_Task(void* Context, uint32_t Index, uint32_t Worker)
+{
+	PoolState* State = Context;
+
+	if (Worker >= State->ThreadCount || Worker >= POOL_MAX_WORKERS)
+	{
+		atomic_fetch_add(&State->BadWorker, 1);
+		return;
+	}
+
+	if (atomic_exchange(&State->Busy[Worker], 1) != 0)
+	{
+		atomic_fetch_add(&State->Overlaps, 1);
+	}
+
+	if (Index < POOL_MAX_TASKS)
+	{
+		atomic_fetch_add(&State->Runs[Index], 1);
+	}
+
+	// same split as CpuPool_Run uses for initial ranges
+	uint32_t Owner = 0;
+	while ((uint64_t)State->Count * (Owner + 1) / State->ThreadCount <= Index)
+	{
+		Owner++;
+	}
+	if (Owner != Worker)
+	{
+		atomic_fetch_add(&State->Stolen, 1);
+	}
+
+	if (State->SlowEvery && Index % State->SlowEvery == 0)
+	{
+		double Start = Test_Time();
+		while (Test_Time() - Start < 0.0002)
+		{
+		}
+	}
+
+	atomic_store(&State->Busy[Worker], 0);
+}
+
+static void Pool_Test(uint32_t ThreadCount)
+{
+	CpuPool Pool;
+	CpuPool_Create(&Pool, ThreadCount);
+	TEST_CHECK(Pool.ThreadCount == (ThreadCount ? ThreadCount : Cpu_GetProcessorCount()), "pool created with %u threads has %u", ThreadCount, Pool.ThreadCount);
+
+	static const uint32_t Counts[] = { 0, 1, 2, 3, 5, 8, 63, 64, 65, 1000, POOL_MAX_TASKS };
+	static PoolState State;
+
+	uint32_t Stolen = 0;
+	for (uint32_t CountIndex = 0; CountIndex < sizeof(Counts) / sizeof(*Counts); CountIndex++)
+	{
+		uint32_t Count = Counts[CountIndex];
+		for (uint32_t Run = 0; Run < 50; Run++)
+		{
+			memset(&State, 0, sizeof(State));
+			State.ThreadCount = Pool.ThreadCount;
+			State.Count = Count;
+			State.SlowEvery = Run % 2 ? 7 : 0;
+
+			CpuPool_Run(&Pool, &Pool_Task, &State, Count);
+
+			uint32_t Missing = 0;
+			uint32_t Repeated = 0;
+			for (uint32_t Index = 0; Index < POOL_MAX_TASKS; Index++)
+			{
+				uint32_t Runs = atomic_load(&State.Runs[Index]);
+				Missing += Index < Count && Runs == 0;
+				Repeated += Runs > 1 || (Index >= Count && Runs != 0);
+			}
+			TEST_CHECK(Missing == 0 && Repeated == 0, "%u threads, %u tasks, run %u: %u tasks not run, %u run wrong number of times", Pool.ThreadCount, Count, Run, Missing, Repeated);
+			TEST_CHECK(atomic_load(&State.Overlaps) == 0 && atomic_load(&State.BadWorker) == 0, "%u threads, %u tasks, run %u: %u tasks overlapped on same worker, %u with bad worker index", Pool.ThreadCount, Count, Run, atomic_load(&State.Overlaps), atomic_load(&State.BadWorker));
+			Stolen += atomic_load(&State.Stolen);
+		}
+	}
+
+	// overhead of waking workers & waiting for them, with trivial tasks
+	memset(&State, 0, sizeof(State));
+	State.ThreadCount = Pool.ThreadCount;
+	State.Count = 64;
+	uint32_t RunCount = 0;
+	double Start = Test_Time();
+	double Elapsed;
+	do
+	{
+		CpuPool_Run(&Pool, &Pool_Task, &State, 64);
+		RunCount++;
+		Elapsed = Test_Time() - Start;
+	}
+	while (Elapsed < 0.1);
+
+	printf("  %2u threads: %6u tasks stolen, %6.2f us per run of 64 trivial tasks\n", Pool.ThreadCount, Stolen, Elapsed * 1e6 / RunCount);
+	CpuPool_Release(&Pool);
+}
+
+int main(void)
+{
+	static const uint32_t ThreadCounts[] = { 1, 2, 3, 4, 7, 16, 0 };
+	for (uint32_t Index = 0; Index < sizeof(ThreadCounts) / sizeof(*ThreadCounts); Index++)
+	{
+		Pool_Test(ThreadCounts[Index]);
+	}
+
+	return Test_Finish("test_cpu_pool");
+}
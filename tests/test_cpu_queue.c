@@ -0,0 +1,325 @@
+// checks CpuQueue capacity, FIFO order, wake up of sleeping queue thread, flags & draining in CpuQueue_Release
+
+#include "test.h"
+#include "wcap_cpu_queue.h"
+
+typedef struct
+{
+	uint32_t Sequence;
+	uint32_t Payload[5]; // derived from Sequence, so torn copies are seen
+}
+QueueItem;
+
+typedef struct
+{
+	_Atomic(uint32_t) Gate;      // queue thread waits in Func while this is 0
+	_Atomic(uint32_t) Processed;
+	_Atomic(uint32_t) OrderErrors;
+	_Atomic(uint32_t) PayloadErrors;
+	_Atomic(uint32_t) Entered;   // queue thread is inside Func
+	uint32_t Expected;           // accessed only on queue thread
+	double Delay;                // seconds spent on each item
+	_Atomic(uint32_t) Flags;     // all flags passed to Queue_Flags
+	_Atomic(uint32_t) FlagCalls;
+	_Atomic(uint32_t) FlagsProcessed; // items processed before first call of Queue_Flags
+}
+QueueState;
+
+static void Queue_MakeItem(QueueItem* Item, uint32_t Sequence)
+{
+	Item->Sequence = Sequence;
+	for (uint32_t Index = 0; Index < 5; Index++)
+	{
+		Item->Payload[Index] = Sequence * 2654435761U + Index;
+	}
+}
+
+static void Queue_Func(void* Context, void* Arg)
+{
+	QueueState* State = Context;
+	QueueItem* Item = Arg;
+
+	atomic_store(&State->Entered, 1);
+	while (!atomic_load(&State->Gate))
+	{
+		Test_Yield();
+	}
+
+	if (Item->Sequence != State->Expected)
+	{
+		atomic_fetch_add(&State->OrderErrors, 1);
+	}
+	State->Expected = Item->Sequence + 1;
+
+	QueueItem Check;
+	Queue_MakeItem(&Check, Item->Sequence);
+	if (memcmp(&Check, Item, sizeof(Check)) != 0)
+	{
+		atomic_fetch_add(&State->PayloadErrors, 1);
+	}
+
+	if (State->Delay)
+	{
+		double Start = Test_Time();
+		while (Test_Time() - Start < State->Delay)
+		{
+			Test_Yield();
+		}
+	}
+
+	atomic_fetch_add(&State->Processed, 1);
+}
+
+static void Queue_Flags(void* Context, uint32_t Flags)
+{
+	QueueState* State = Context;
+
+	if (atomic_fetch_add(&State->FlagCalls, 1) == 0)
+	{
+		atomic_store(&State->FlagsProcessed, atomic_load(&State->Processed));
+	}
+	atomic_fetch_or(&State->Flags, Flags);
+}
+
+// returns false on timeout
+static bool Queue_WaitProcessed(QueueState* State, uint32_t Count, double Timeout)
+{
+	double Start = Test_Time();
+	while (atomic_load(&State->Processed) < Count)
+	{
+		if (Test_Time() - Start > Timeout)
+		{
+			return false;
+		}
+		Test_Yield();
+	}
+	return true;
+}
+
+static void Queue_TestFull(uint32_t Count)
+{
+	static QueueState State;
+	memset(&State, 0, sizeof(State));
+
+	CpuQueue Queue;
+	CpuQueue_Create(&Queue, Count, sizeof(QueueItem), &Queue_Func, NULL, &State);
+
+	// first item is held inside Func, its space is freed only after Func returns
+	QueueItem Item;
+	uint32_t Sequence = 0;
+	Queue_MakeItem(&Item, Sequence);
+	TEST_CHECK(CpuQueue_Push(&Queue, &Item), "count %u: push to empty queue failed", Count);
+	Sequence++;
+	while (!atomic_load(&State.Entered))
+	{
+		Test_Yield();
+	}
+
+	uint32_t Pushed = 1;
+	for (uint32_t Index = 0; Index < Count + 5; Index++)
+	{
+		Queue_MakeItem(&Item, Sequence);
+		if (CpuQueue_Push(&Queue, &Item))
+		{
+			Pushed++;
+			Sequence++;
+		}
+	}
+	TEST_CHECK(Pushed == Count, "count %u: %u pushes succeeded while queue thread is blocked", Count, Pushed);
+
+	atomic_store(&State.Gate, 1);
+	TEST_CHECK(Queue_WaitProcessed(&State, Pushed, 5.0), "count %u: only %u of %u items processed", Count, atomic_load(&State.Processed), Pushed);
+
+	// space is available again after items are processed
+	for (uint32_t Index = 0; Index < Count; Index++)
+	{
+		Queue_MakeItem(&Item, Sequence++);
+		TEST_CHECK(CpuQueue_Push(&Queue, &Item), "count %u: push %u after drain failed", Count, Index);
+	}
+
+	CpuQueue_Release(&Queue);
+	TEST_CHECK(atomic_load(&State.Processed) == Sequence, "count %u: %u items processed of %u", Count, atomic_load(&State.Processed), Sequence);
+	TEST_CHECK(atomic_load(&State.OrderErrors) == 0 && atomic_load(&State.PayloadErrors) == 0, "count %u: %u items out of order, %u corrupted", Count, atomic_load(&State.OrderErrors), atomic_load(&State.PayloadErrors));
+}
+
+static void Queue_TestRelease(void)
+{
+	// release processes all items still in queue, even when queue thread is slow
+	static QueueState State;
+	memset(&State, 0, sizeof(State));
+	atomic_store(&State.Gate, 1);
+	State.Delay = 0.002;
+
+	CpuQueue Queue;
+	CpuQueue_Create(&Queue, 16, sizeof(QueueItem), &Queue_Func, NULL, &State);
+
+	QueueItem Item;
+	uint32_t Pushed = 0;
+	for (uint32_t Index = 0; Index < 16; Index++)
+	{
+		Queue_MakeItem(&Item, Pushed);
+		Pushed += CpuQueue_Push(&Queue, &Item);
+	}
+
+	CpuQueue_Release(&Queue);
+	TEST_CHECK(Pushed >= 16 && atomic_load(&State.Processed) == Pushed, "release processed %u of %u items", atomic_load(&State.Processed), Pushed);
+	TEST_CHECK(atomic_load(&State.OrderErrors) == 0 && atomic_load(&State.PayloadErrors) == 0, "release: %u items out of order, %u corrupted", atomic_load(&State.OrderErrors), atomic_load(&State.PayloadErrors));
+}
+
+static void Queue_TestStream(uint32_t Count, uint32_t Total)
+{
+	// producer pushes as fast as it can & retries when queue is full
+	static QueueState State;
+	memset(&State, 0, sizeof(State));
+	atomic_store(&State.Gate, 1);
+
+	CpuQueue Queue;
+	CpuQueue_Create(&Queue, Count, sizeof(QueueItem), &Queue_Func, NULL, &State);
+
+	uint32_t Full = 0;
+	double Start = Test_Time();
+	QueueItem Item;
+	for (uint32_t Sequence = 0; Sequence < Total; Sequence++)
+	{
+		Queue_MakeItem(&Item, Sequence);
+		while (!CpuQueue_Push(&Queue, &Item))
+		{
+			Full++;
+			Test_Yield();
+		}
+	}
+	CpuQueue_Release(&Queue);
+	double Elapsed = Test_Time() - Start;
+
+	TEST_CHECK(atomic_load(&State.Processed) == Total, "count %u: stream processed %u of %u", Count, atomic_load(&State.Processed), Total);
+	TEST_CHECK(atomic_load(&State.OrderErrors) == 0 && atomic_load(&State.PayloadErrors) == 0, "count %u: stream has %u items out of order, %u corrupted", Count, atomic_load(&State.OrderErrors), atomic_load(&State.PayloadErrors));
+	printf("  count %4u: %7.3f us per item, queue was full %u times\n", Count, Elapsed * 1e6 / Total, Full);
+}
+
+static void Queue_TestWake(void)
+{
+	// every push to idle queue must wake sleeping thread, lost wake up would hang item until next push
+	static QueueState State;
+	memset(&State, 0, sizeof(State));
+	atomic_store(&State.Gate, 1);
+
+	CpuQueue Queue;
+	CpuQueue_Create(&Queue, 4, sizeof(QueueItem), &Queue_Func, NULL, &State);
+
+	uint32_t Lost = 0;
+	double Latency = 0;
+	QueueItem Item;
+	for (uint32_t Sequence = 0; Sequence < 2000; Sequence++)
+	{
+		// give queue thread time to go to sleep, sometimes push right away to hit race with going to sleep
+		if (Sequence % 3 != 0)
+		{
+			Test_Yield();
+		}
+
+		Queue_MakeItem(&Item, Sequence);
+		double Start = Test_Time();
+		TEST_CHECK(CpuQueue_Push(&Queue, &Item), "push to idle queue failed");
+		if (!Queue_WaitProcessed(&State, Sequence + 1, 2.0))
+		{
+			Lost++;
+			break;
+		}
+		Latency += Test_Time() - Start;
+	}
+	CpuQueue_Release(&Queue);
+
+	TEST_CHECK(Lost == 0, "queue thread did not wake up for item %u", atomic_load(&State.Processed));
+	printf("  %.2f us average latency from push to processed item\n", Latency * 1e6 / 2000);
+}
+
+static void Queue_TestFlags(void)
+{
+	static QueueState State;
+	memset(&State, 0, sizeof(State));
+
+	CpuQueue Queue;
+	CpuQueue_Create(&Queue, 4, sizeof(QueueItem), &Queue_Func, &Queue_Flags, &State);
+
+	// fill queue while queue thread is blocked in first item
+	QueueItem Item;
+	uint32_t Pushed = 0;
+	Queue_MakeItem(&Item, Pushed);
+	Pushed += CpuQueue_Push(&Queue, &Item);
+	while (!atomic_load(&State.Entered))
+	{
+		Test_Yield();
+	}
+	for (uint32_t Index = 0; Index < 4; Index++)
+	{
+		Queue_MakeItem(&Item, Pushed);
+		Pushed += CpuQueue_Push(&Queue, &Item);
+	}
+	TEST_CHECK(Pushed == 4, "flags: %u items pushed to queue of 4", Pushed);
+
+	// signals never fail & do not take space of items, repeated ones are coalesced
+	for (uint32_t Index = 0; Index < 100; Index++)
+	{
+		CpuQueue_Signal(&Queue, 1u << (Index % 3));
+	}
+	Queue_MakeItem(&Item, Pushed);
+	TEST_CHECK(!CpuQueue_Push(&Queue, &Item), "flags: push to full queue succeeded after signals");
+
+	atomic_store(&State.Gate, 1);
+	TEST_CHECK(Queue_WaitProcessed(&State, Pushed, 5.0), "flags: only %u of %u items processed", atomic_load(&State.Processed), Pushed);
+	TEST_CHECK(atomic_load(&State.Flags) == 7, "flags: got 0x%x, expected 0x7", atomic_load(&State.Flags));
+	TEST_CHECK(atomic_load(&State.FlagCalls) == 1, "flags: %u calls for coalesced signals", atomic_load(&State.FlagCalls));
+	// flags do not wait until queue is empty
+	TEST_CHECK(atomic_load(&State.FlagsProcessed) < Pushed, "flags: handled after all %u items", atomic_load(&State.FlagsProcessed));
+
+	// signal must wake sleeping queue thread, same as push
+	uint32_t Lost = 0;
+	for (uint32_t Index = 0; Index < 2000 && !Lost; Index++)
+	{
+		if (Index % 3 != 0)
+		{
+			Test_Yield();
+		}
+
+		uint32_t Calls = atomic_load(&State.FlagCalls);
+		CpuQueue_Signal(&Queue, 8);
+		double Start = Test_Time();
+		while (atomic_load(&State.FlagCalls) == Calls)
+		{
+			if (Test_Time() - Start > 2.0)
+			{
+				Lost++;
+				break;
+			}
+			Test_Yield();
+		}
+	}
+	TEST_CHECK(Lost == 0, "flags: queue thread did not wake up for signal");
+
+	// flags signaled before release are still handled
+	atomic_store(&State.Flags, 0);
+	CpuQueue_Signal(&Queue, 16);
+	CpuQueue_Release(&Queue);
+	TEST_CHECK(atomic_load(&State.Flags) == 16, "flags: release lost signaled flags");
+	TEST_CHECK(atomic_load(&State.OrderErrors) == 0 && atomic_load(&State.PayloadErrors) == 0, "flags: %u items out of order, %u corrupted", atomic_load(&State.OrderErrors), atomic_load(&State.PayloadErrors));
+}
+
+int main(void)
+{
+	static const uint32_t Counts[] = { 1, 2, 4, 16, 256 };
+	for (uint32_t Index = 0; Index < sizeof(Counts) / sizeof(*Counts); Index++)
+	{
+		Queue_TestFull(Counts[Index]);
+	}
+
+	Queue_TestRelease();
+	Queue_TestWake();
+	Queue_TestFlags();
+
+	for (uint32_t Index = 0; Index < sizeof(Counts) / sizeof(*Counts); Index++)
+	{
+		Queue_TestStream(Counts[Index], 200000);
+	}
+
+	return Test_Finish("test_cpu_queue");
+}
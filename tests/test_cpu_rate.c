@@ -0,0 +1,365 @@
+// replays recorded desktop change patterns through model of Encoder frame skipping with adaptive framerate & checks framerate
+// it chooses for small changes, large changes & video, how fast it ramps back to full framerate, and that sample timestamps
+// & durations cover whole recording without gaps or overlaps, then reports encoder submissions saved
+
+#include "test.h"
+#include "wcap_cpu_rate.h"
+
+// 60 fps capture, times are in ticks
+#define RATE_TICK_FREQ   60000
+#define RATE_FRAME_TICKS (RATE_TICK_FREQ / 60)
+#define RATE_MAX_FRAMES  4096
+#define RATE_MAX_SAMPLES 4096
+
+#define RATE_BLOCK_COUNT  (60 * 34)   // 1920x1080 in 32x32 blocks, same as FrameHash
+#define RATE_HASH_LAG     2           // FrameHash compares frame after this many newer frames, FRAME_HASH_STAGING_COUNT - 1
+#define RATE_UPDATE_TICKS (RATE_TICK_FREQ / 10) // Encoder_Update is called every 100 msec
+
+typedef enum
+{
+	RateChange_None,    // no frames captured
+	RateChange_Caret,   // caret blinks every 500 msec, other frames are not captured
+	RateChange_Spinner, // small animation in 4 blocks every frame
+	RateChange_Scroll,  // whole screen changes every frame
+	RateChange_Video,   // quarter of screen changes every frame
+}
+RateChange;
+
+static const char* RateChangeNames[] = { "none", "caret", "spinner", "scroll", "video" };
+
+typedef struct
+{
+	RateChange Change;
+	uint32_t Frames;
+}
+RateSegment;
+
+// recorded sessions as runs of same kind of changes
+static const RateSegment RateDesktop[] =
+{
+	{ RateChange_Caret,   120 },
+	{ RateChange_Spinner, 120 },
+	{ RateChange_Scroll,  60  },
+	{ RateChange_Spinner, 120 },
+	{ RateChange_Video,   60  },
+	{ RateChange_None,    90  },
+	{ RateChange_Caret,   60  },
+};
+
+typedef struct
+{
+	uint64_t Timestamp; // ticks from first encoded frame
+	uint64_t Duration;
+	uint64_t Time;      // capture time of encoded input
+	bool Discontinuity;
+}
+RateSample;
+
+typedef struct
+{
+	bool Adaptive;
+	CpuRate Rate;
+
+	// FrameHash, frame numbers start with 1
+	uint32_t Dirty[RATE_MAX_FRAMES + 1]; // dirty blocks of every frame compared to frame before it
+	uint64_t Frames;
+	uint64_t Compared;
+	uint64_t ChangedFrame;
+	uint64_t LastCompared;
+	uint32_t DirtyCount;
+
+	// Encoder
+	uint64_t HashFrame;
+	bool SkippedChange;
+	bool Discontinuity;
+	uint64_t StartTime;
+	uint64_t LastTime;
+	bool Pending;
+	RateSample PendingSample;
+	RateSample Samples[RATE_MAX_SAMPLES];
+	uint32_t SampleCount;
+	uint32_t DuplicateCount;
+	uint32_t StaticCount;
+}
+RateModel;
+
+static void Rate_Compare(RateModel* Model, bool All)
+{
+	// same as FrameHash__Read & FrameHash__Process
+	while (Model->Compared < Model->Frames && (All || Model->Frames - Model->Compared >= RATE_HASH_LAG))
+	{
+		uint64_t Frame = ++Model->Compared;
+		Model->LastCompared = Frame;
+		if (Frame != 1 && Model->Dirty[Frame] == 0)
+		{
+			Model->DirtyCount = 0;
+			continue;
+		}
+		Model->DirtyCount = Frame == 1 ? RATE_BLOCK_COUNT : Model->Dirty[Frame];
+		Model->ChangedFrame = Frame;
+	}
+}
+
+static bool Rate_IsStatic(RateModel* Model, uint64_t Time)
+{
+	return Model->Adaptive && CpuRate_IsStatic(&Model->Rate, Model->DirtyCount, RATE_BLOCK_COUNT, Time, RATE_TICK_FREQ);
+}
+
+static void Rate_WritePending(RateModel* Model, uint64_t Time)
+{
+	if (Model->Pending)
+	{
+		Model->PendingSample.Duration = Time - Model->StartTime - Model->PendingSample.Timestamp;
+		Model->Samples[Model->SampleCount++] = Model->PendingSample;
+		Model->Pending = false;
+	}
+}
+
+static void Rate_Encode(RateModel* Model, uint64_t Time)
+{
+	// Encoder__EncodeInput with skipped duplicates, sample is pending until next one
+	Model->HashFrame = Model->Frames;
+	Model->SkippedChange = false;
+	CpuRate_Encoded(&Model->Rate, Time, RATE_TICK_FREQ);
+
+	if (Model->StartTime == 0)
+	{
+		Model->StartTime = Time;
+	}
+
+	RateSample Sample =
+	{
+		.Timestamp = Time - Model->StartTime,
+		.Duration = RATE_FRAME_TICKS,
+		.Time = Time,
+		.Discontinuity = Model->Discontinuity,
+	};
+	Model->Discontinuity = false;
+
+	Rate_WritePending(Model, Time);
+	Model->PendingSample = Sample;
+	Model->Pending = true;
+}
+
+static void Rate_NewFrame(RateModel* Model, uint32_t Dirty, uint64_t Time)
+{
+	// Encoder_NewFrame without drops
+	Model->LastTime = Time;
+
+	Rate_Compare(Model, false);
+	Model->Dirty[++Model->Frames] = Dirty;
+
+	bool Changed = Model->ChangedFrame > Model->HashFrame || Model->ChangedFrame == Model->LastCompared;
+	bool Static = Rate_IsStatic(Model, Time);
+
+	if (Model->Pending)
+	{
+		bool Skip = false;
+		if (!Changed && !Model->SkippedChange)
+		{
+			Model->DuplicateCount++;
+			Skip = true;
+		}
+		else if (Static && Time < Model->Rate.NextEncode)
+		{
+			Model->SkippedChange = true;
+			Model->StaticCount++;
+			Skip = true;
+		}
+
+		if (Skip)
+		{
+			// extend pending sample to one frame after this time, in case this is last frame
+			Model->PendingSample.Duration = Time - Model->StartTime - Model->PendingSample.Timestamp + RATE_FRAME_TICKS;
+			return;
+		}
+	}
+
+	Rate_Encode(Model, Time);
+}
+
+static void Rate_Update(RateModel* Model, uint64_t Time)
+{
+	// Encoder_Update
+	Rate_Compare(Model, true);
+	if (Model->ChangedFrame > Model->HashFrame && !Model->SkippedChange)
+	{
+		Model->SkippedChange = true;
+		if (!Rate_IsStatic(Model, Time))
+		{
+			Model->Rate.NextEncode = Time;
+		}
+	}
+
+	if (Model->SkippedChange && Time >= Model->Rate.NextEncode)
+	{
+		Model->LastTime = Time;
+		Rate_Encode(Model, Time);
+	}
+
+	if (Time - Model->LastTime >= RATE_TICK_FREQ)
+	{
+		// Encoder__DropVideo
+		Model->LastTime = Time;
+		Rate_WritePending(Model, Time);
+		Model->Discontinuity = true;
+	}
+}
+
+static uint32_t Rate_Dirty(RateChange Change, uint32_t Frame, uint32_t* State)
+{
+	// dirty blocks of frame, 0 when nothing is captured
+	switch (Change)
+	{
+	case RateChange_Caret:   return Frame % 30 == 0 ? 9 : 0;
+	case RateChange_Spinner: return 16;
+	case RateChange_Scroll:  return RATE_BLOCK_COUNT;
+	case RateChange_Video:   return RATE_BLOCK_COUNT / 4 + Test_Random(State) % 64;
+	default:                 return 0;
+	}
+}
+
+static void Rate_Run(RateModel* Model, bool Adaptive, const RateSegment* Segments, uint32_t SegmentCount, uint64_t* SegmentStart)
+{
+	memset(Model, 0, sizeof(*Model));
+	Model->Adaptive = Adaptive;
+	Model->LastTime = 0x8000000000000000ULL;
+	CpuRate_Create(&Model->Rate);
+
+	// updates happen between frames, frames are processed immediately
+	uint64_t Time = RATE_TICK_FREQ;
+	uint64_t NextUpdate = Time + RATE_UPDATE_TICKS + RATE_FRAME_TICKS / 2;
+	uint32_t State = 1;
+
+	for (uint32_t Index = 0; Index < SegmentCount; Index++)
+	{
+		SegmentStart[Index] = Time;
+		for (uint32_t Frame = 0; Frame < Segments[Index].Frames; Frame++, Time += RATE_FRAME_TICKS)
+		{
+			for (; NextUpdate < Time; NextUpdate += RATE_UPDATE_TICKS)
+			{
+				Rate_Update(Model, NextUpdate);
+			}
+
+			uint32_t Dirty = Rate_Dirty(Segments[Index].Change, Frame, &State);
+			if (Dirty != 0 || Model->Frames == 0)
+			{
+				Rate_NewFrame(Model, Dirty, Time);
+			}
+		}
+	}
+	SegmentStart[SegmentCount] = Time;
+
+	// last changes are encoded by updates after capture ends, then Encoder_Stop writes pending sample
+	for (; NextUpdate < Time + RATE_TICK_FREQ; NextUpdate += RATE_UPDATE_TICKS)
+	{
+		Rate_Update(Model, NextUpdate);
+	}
+	if (Model->Pending)
+	{
+		Model->Samples[Model->SampleCount++] = Model->PendingSample;
+	}
+}
+
+static uint32_t Rate_CountSamples(const RateModel* Model, uint64_t From, uint64_t To)
+{
+	uint32_t Count = 0;
+	for (uint32_t Index = 0; Index < Model->SampleCount; Index++)
+	{
+		Count += Model->Samples[Index].Time >= From && Model->Samples[Index].Time < To;
+	}
+	return Count;
+}
+
+static void Rate_CheckMotion(const RateModel* Model, const char* Name, uint64_t Start, uint32_t Frames)
+{
+	// larger change is encoded at full framerate as soon as its hashes are compared, every frame after it is encoded
+	uint32_t Ramp = 0;
+	while (Ramp <= RATE_HASH_LAG && Rate_CountSamples(Model, Start + Ramp * RATE_FRAME_TICKS, Start + (Ramp + 1) * RATE_FRAME_TICKS) == 0)
+	{
+		Ramp++;
+	}
+	uint32_t Count = Rate_CountSamples(Model, Start, Start + Frames * RATE_FRAME_TICKS);
+	TEST_CHECK(Ramp <= RATE_HASH_LAG && Count == Frames - Ramp, "%s: first frame encoded after %u frames, %u of %u frames encoded", Name, Ramp, Count, Frames);
+}
+
+static void Rate_CheckTimestamps(const RateModel* Model, const char* Name)
+{
+	// every sample is shown until next one starts, gaps are allowed only before discontinuity
+	uint32_t Errors = 0;
+	for (uint32_t Index = 0; Index < Model->SampleCount; Index++)
+	{
+		const RateSample* Sample = &Model->Samples[Index];
+		Errors += Sample->Duration == 0 || Sample->Timestamp != Sample->Time - Model->StartTime;
+		if (Index + 1 < Model->SampleCount)
+		{
+			const RateSample* Next = &Model->Samples[Index + 1];
+			uint64_t End = Sample->Timestamp + Sample->Duration;
+			Errors += Next->Discontinuity ? End > Next->Timestamp : End != Next->Timestamp;
+		}
+	}
+	TEST_CHECK(Errors == 0, "%s: %u samples with wrong timestamp or duration", Name, Errors);
+
+	// nothing changed after last encoded input
+	TEST_CHECK(Model->HashFrame == Model->Frames, "%s: last encoded frame %llu, captured %llu", Name, (unsigned long long)Model->HashFrame, (unsigned long long)Model->Frames);
+}
+
+static void Rate_TestDesktop(void)
+{
+	const uint32_t SegmentCount = sizeof(RateDesktop) / sizeof(*RateDesktop);
+	uint64_t Start[sizeof(RateDesktop) / sizeof(*RateDesktop) + 1];
+
+	static RateModel Full, Adaptive;
+	Rate_Run(&Full, false, RateDesktop, SegmentCount, Start);
+	Rate_Run(&Adaptive, true, RateDesktop, SegmentCount, Start);
+
+	Rate_CheckTimestamps(&Full, "full");
+	Rate_CheckTimestamps(&Adaptive, "adaptive");
+
+	uint64_t Hold = RATE_TICK_FREQ * CPU_RATE_MOTION_HOLD / 1000;
+	uint64_t Second = RATE_TICK_FREQ;
+
+	// static screen, caret blinks are small changes encoded when they arrive, because they are rarer than static framerate
+	TEST_CHECK(Rate_CountSamples(&Adaptive, Start[0] + Second, Start[1]) == 2, "caret: %u frames encoded in 1 second", Rate_CountSamples(&Adaptive, Start[0] + Second, Start[1]));
+
+	// small changes every frame after static screen are encoded at static framerate from start
+	for (uint64_t Time = Start[1]; Time < Start[2]; Time += Second / 2)
+	{
+		uint32_t Count = Rate_CountSamples(&Adaptive, Time, Time + Second / 2);
+		TEST_CHECK(Count == CPU_RATE_STATIC_FRAMERATE / 2 || Count == (CPU_RATE_STATIC_FRAMERATE + 1) / 2, "spinner after static: %u frames encoded in 0.5 seconds", Count);
+	}
+
+	Rate_CheckMotion(&Adaptive, "scroll", Start[2], RateDesktop[2].Frames);
+
+	// full framerate is kept for small changes during motion hold, then they are encoded at static framerate again
+	uint32_t HoldCount = Rate_CountSamples(&Adaptive, Start[3], Start[3] + Hold);
+	uint32_t StaticCount = Rate_CountSamples(&Adaptive, Start[3] + Hold + Second / 2, Start[4]);
+	TEST_CHECK(HoldCount >= Hold / RATE_FRAME_TICKS - 1, "spinner after scroll: %u frames encoded during motion hold", HoldCount);
+	TEST_CHECK(StaticCount == CPU_RATE_STATIC_FRAMERATE, "spinner after scroll: %u frames encoded in 1 second", StaticCount);
+
+	// video is larger change in every frame, static screen before it
+	Rate_CheckMotion(&Adaptive, "video", Start[4], RateDesktop[4].Frames);
+
+	// without adaptive framerate every changed frame is encoded
+	uint32_t Changed = 0;
+	for (uint32_t Frame = 1; Frame <= Full.Frames; Frame++)
+	{
+		Changed += Frame == 1 || Full.Dirty[Frame] != 0;
+	}
+	TEST_CHECK(Full.SampleCount == Changed && Full.StaticCount == 0, "full framerate: %u samples for %u changed frames", Full.SampleCount, Changed);
+	TEST_CHECK(Adaptive.SampleCount + Adaptive.StaticCount == Changed, "adaptive: %u samples & %u skipped for %u changed frames", Adaptive.SampleCount, Adaptive.StaticCount, Changed);
+
+	printf("  %-8s %8s %8s\n", "segment", "full", "adaptive");
+	for (uint32_t Index = 0; Index < SegmentCount; Index++)
+	{
+		printf("  %-8s %8u %8u\n", RateChangeNames[RateDesktop[Index].Change], Rate_CountSamples(&Full, Start[Index], Start[Index + 1]), Rate_CountSamples(&Adaptive, Start[Index], Start[Index + 1]));
+	}
+	printf("  encoder submissions %u -> %u, %.1f%% saved\n", Full.SampleCount, Adaptive.SampleCount, (Full.SampleCount - Adaptive.SampleCount) * 100.0 / Full.SampleCount);
+}
+
+int main(void)
+{
+	Rate_TestDesktop();
+
+	return Test_Finish("test_cpu_rate");
+}
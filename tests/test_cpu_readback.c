@@ -0,0 +1,288 @@
+// drives CpuReadback with fake device, where copy to staging buffer finishes some frames after it was queued
+
+#include "test.h"
+#include "wcap_cpu_readback.h"
+
+#define READBACK_WIDTH 6
+#define READBACK_HEIGHT 4
+#define READBACK_PERIOD 1000
+
+typedef struct
+{
+	uint64_t Now;       // frames submitted so far, fake GPU time
+	uint32_t Latency;   // copy finishes this many frames after it was queued
+	uint32_t Jitter;    // plus random amount in [0, Jitter]
+	uint32_t Seed;
+
+	uint8_t PlaneY[CPU_READBACK_MAX_COUNT][READBACK_WIDTH * READBACK_HEIGHT];
+	uint8_t PlaneUV[CPU_READBACK_MAX_COUNT][READBACK_WIDTH * READBACK_HEIGHT / 2];
+	uint64_t Ready[CPU_READBACK_MAX_COUNT];    // time when copy to slot finishes
+	uint8_t Value[CPU_READBACK_MAX_COUNT];     // what finished copy writes to slot
+	bool Pending[CPU_READBACK_MAX_COUNT];      // copied, but not yet unmapped
+	bool Mapped[CPU_READBACK_MAX_COUNT];
+	uint32_t CopyValue;
+
+	uint32_t Errors;    // copy to slot that is still in use, map of busy or unmapped slot, etc
+	uint32_t Waits;     // maps that had to wait for GPU
+	uint32_t Busy;      // maps that returned false
+}
+ReadbackDevice;
+
+typedef struct
+{
+	uint64_t Indices[1024];
+	uint32_t Count;
+	uint32_t OrderErrors;
+	uint32_t DataErrors;
+	bool Closed;        // set after Flush, sink must not be called anymore
+	uint32_t LateCalls;
+}
+ReadbackSink;
+
+static void Readback_Copy(void* Context, uint32_t Slot)
+{
+	ReadbackDevice* Device = Context;
+	if (Device->Pending[Slot] || Device->Mapped[Slot])
+	{
+		Device->Errors++;
+	}
+	Device->Pending[Slot] = true;
+	Device->Ready[Slot] = Device->Now + Device->Latency + (Device->Jitter ? Test_Random(&Device->Seed) % (Device->Jitter + 1) : 0);
+	Device->Value[Slot] = (uint8_t)Device->CopyValue++;
+}
+
+static bool Readback_Map(void* Context, uint32_t Slot, bool Wait, CpuReadbackFrame* Frame)
+{
+	ReadbackDevice* Device = Context;
+	if (!Device->Pending[Slot] || Device->Mapped[Slot])
+	{
+		Device->Errors++;
+	}
+
+	if (Device->Now < Device->Ready[Slot])
+	{
+		if (!Wait)
+		{
+			Device->Busy++;
+			return false;
+		}
+		Device->Waits++;
+	}
+
+	// data appears in staging buffer only when copy finishes
+	memset(Device->PlaneY[Slot], Device->Value[Slot], sizeof(Device->PlaneY[Slot]));
+	memset(Device->PlaneUV[Slot], 255 - Device->Value[Slot], sizeof(Device->PlaneUV[Slot]));
+	Device->Mapped[Slot] = true;
+
+	Frame->PlaneY = Device->PlaneY[Slot];
+	Frame->PlaneUV = Device->PlaneUV[Slot];
+	Frame->PitchY = READBACK_WIDTH;
+	Frame->PitchUV = READBACK_WIDTH;
+	Frame->Width = READBACK_WIDTH;
+	Frame->Height = READBACK_HEIGHT;
+	Frame->SampleSize = 1;
+	return true;
+}
+
+static void Readback_Unmap(void* Context, uint32_t Slot)
+{
+	ReadbackDevice* Device = Context;
+	if (!Device->Mapped[Slot])
+	{
+		Device->Errors++;
+	}
+	Device->Mapped[Slot] = false;
+	Device->Pending[Slot] = false;
+
+	// GPU memory is not readable after unmap
+	memset(Device->PlaneY[Slot], 0xcd, sizeof(Device->PlaneY[Slot]));
+}
+
+static void Readback_Sink(void* Context, const CpuReadbackFrame* Frame)
+{
+	ReadbackSink* Sink = Context;
+	if (Sink->Closed)
+	{
+		Sink->LateCalls++;
+		return;
+	}
+
+	if (Sink->Count != 0 && Frame->Index <= Sink->Indices[Sink->Count - 1])
+	{
+		Sink->OrderErrors++;
+	}
+	if (Frame->Time != READBACK_PERIOD * (Frame->Index + 1))
+	{
+		Sink->OrderErrors++;
+	}
+	if (Sink->Count < sizeof(Sink->Indices) / sizeof(*Sink->Indices))
+	{
+		Sink->Indices[Sink->Count] = Frame->Index;
+	}
+
+	// copies are made only for frames that are not dropped, so copy number is count of frames delivered before
+	uint8_t Expected = (uint8_t)Sink->Count;
+	if (Frame->PlaneY[0] != Expected || Frame->PlaneY[(Frame->Height - 1) * Frame->PitchY + Frame->Width - 1] != Expected || Frame->PlaneUV[0] != 255 - Expected)
+	{
+		Sink->DataErrors++;
+	}
+	Sink->Count++;
+}
+
+static void Readback_Create(CpuReadback* Readback, uint32_t Count, ReadbackDevice* Device, ReadbackSink* Sink, uint32_t Latency, uint32_t Jitter)
+{
+	*Device = (ReadbackDevice) { .Latency = Latency, .Jitter = Jitter, .Seed = 1 + Count * 16 + Latency * 4 + Jitter };
+	*Sink = (ReadbackSink) { 0 };
+
+	CpuReadbackDevice Fake = { .Copy = &Readback_Copy, .Map = &Readback_Map, .Unmap = &Readback_Unmap, .Context = Device };
+	CpuReadback_Create(Readback, Count, &Fake, &Readback_Sink, Sink);
+}
+
+static bool Readback_Submit(CpuReadback* Readback, ReadbackDevice* Device)
+{
+	Device->Now++;
+	return CpuReadback_Submit(Readback, READBACK_PERIOD * Device->Now);
+}
+
+static void Readback_TestSteady(uint32_t Count)
+{
+	// GPU finishes copy before it is mapped, every frame is delivered exactly Lag frames later & nothing waits
+	CpuReadback Readback;
+	ReadbackDevice Device;
+	ReadbackSink Sink;
+	Readback_Create(&Readback, Count, &Device, &Sink, Count - 1, 0);
+
+	uint32_t Late = 0;
+	for (uint32_t Frame = 0; Frame < 100; Frame++)
+	{
+		TEST_CHECK(Readback_Submit(&Readback, &Device), "count %u: frame %u dropped when GPU keeps up", Count, Frame);
+		uint32_t Expected = Frame + 1 >= Readback.Lag ? Frame + 1 - Readback.Lag : 0;
+		Late += Sink.Count != Expected;
+	}
+	TEST_CHECK(Late == 0, "count %u: %u frames not delivered exactly %u frames later", Count, Late, Readback.Lag);
+	TEST_CHECK(Device.Waits == 0 && Device.Busy == 0, "count %u: %u maps waited, %u were busy while GPU keeps up", Count, Device.Waits, Device.Busy);
+
+	CpuReadback_Flush(&Readback);
+	Sink.Closed = true;
+	CpuReadback_Poll(&Readback, true);
+
+	TEST_CHECK(Sink.Count == 100 && Readback.Dropped == 0, "count %u: %u of 100 frames delivered, %llu dropped", Count, Sink.Count, (unsigned long long)Readback.Dropped);
+	TEST_CHECK(Sink.OrderErrors == 0 && Sink.DataErrors == 0 && Sink.LateCalls == 0, "count %u: %u out of order, %u with wrong data, %u after flush", Count, Sink.OrderErrors, Sink.DataErrors, Sink.LateCalls);
+	TEST_CHECK(Device.Errors == 0, "count %u: %u wrong uses of staging buffers", Count, Device.Errors);
+}
+
+static void Readback_TestSlow(uint32_t Count, uint32_t Latency, uint32_t Jitter)
+{
+	// GPU is slower than frames are submitted, Submit drops frames instead of waiting
+	CpuReadback Readback;
+	ReadbackDevice Device;
+	ReadbackSink Sink;
+	Readback_Create(&Readback, Count, &Device, &Sink, Latency, Jitter);
+
+	uint32_t Accepted = 0;
+	for (uint32_t Frame = 0; Frame < 200; Frame++)
+	{
+		Accepted += Readback_Submit(&Readback, &Device);
+	}
+	TEST_CHECK(Device.Waits == 0, "count %u, latency %u+%u: %u maps waited for GPU in Submit", Count, Latency, Jitter, Device.Waits);
+
+	CpuReadback_Flush(&Readback);
+	Sink.Closed = true;
+	CpuReadback_Poll(&Readback, true);
+
+	// every dropped frame is visible as gap in delivered indices
+	uint32_t Gaps = 0;
+	for (uint32_t Index = 0; Index < Sink.Count; Index++)
+	{
+		Gaps += (uint32_t)(Sink.Indices[Index] - (Index ? Sink.Indices[Index - 1] + 1 : 0));
+	}
+	Gaps += (uint32_t)(200 - (Sink.Count ? Sink.Indices[Sink.Count - 1] + 1 : 0));
+
+	// frame copied Count frames ago is finished when next one is submitted, later than that needs one more buffer
+	if (Latency > Count)
+	{
+		TEST_CHECK(Readback.Dropped > 0, "count %u, latency %u+%u: nothing dropped when GPU is slow", Count, Latency, Jitter);
+	}
+	TEST_CHECK(Sink.Count == Accepted && Accepted + Readback.Dropped == 200, "count %u, latency %u+%u: %u delivered, %u accepted, %llu dropped", Count, Latency, Jitter, Sink.Count, Accepted, (unsigned long long)Readback.Dropped);
+	TEST_CHECK(Gaps == Readback.Dropped, "count %u, latency %u+%u: %u frames missing from indices, %llu dropped", Count, Latency, Jitter, Gaps, (unsigned long long)Readback.Dropped);
+	TEST_CHECK(Sink.OrderErrors == 0 && Sink.DataErrors == 0 && Sink.LateCalls == 0, "count %u, latency %u+%u: %u out of order, %u with wrong data, %u after flush", Count, Latency, Jitter, Sink.OrderErrors, Sink.DataErrors, Sink.LateCalls);
+	TEST_CHECK(Device.Errors == 0, "count %u, latency %u+%u: %u wrong uses of staging buffers", Count, Latency, Jitter, Device.Errors);
+
+	printf("  count %u, latency %u+%u frames: %3u delivered, %3llu dropped, %3u maps busy\n", Count, Latency, Jitter, Sink.Count, (unsigned long long)Readback.Dropped, Device.Busy);
+}
+
+static void Readback_TestPoll(uint32_t Count)
+{
+	// after last submitted frame, Poll delivers finished frames without waiting for more frames
+	CpuReadback Readback;
+	ReadbackDevice Device;
+	ReadbackSink Sink;
+	Readback_Create(&Readback, Count, &Device, &Sink, 1, 0);
+
+	for (uint32_t Frame = 0; Frame < Count - 1; Frame++)
+	{
+		Readback_Submit(&Readback, &Device);
+	}
+	TEST_CHECK(Sink.Count == 0, "count %u: %u frames delivered before they are %u frames old", Count, Sink.Count, Readback.Lag);
+
+	// copy of last frame is not finished yet, Poll without All delivers only oldest frame that is Lag frames old
+	// & Poll with All delivers everything before last one
+	CpuReadback_Poll(&Readback, false);
+	TEST_CHECK(Sink.Count == (Count > 2 ? 1 : 0), "count %u: Poll without All delivered %u frames", Count, Sink.Count);
+	CpuReadback_Poll(&Readback, true);
+	TEST_CHECK(Sink.Count == Count - 2, "count %u: Poll with All delivered %u of %u finished frames", Count, Sink.Count, Count - 2);
+
+	// no new frames come, but GPU finishes last copy
+	Device.Now++;
+	CpuReadback_Poll(&Readback, true);
+	TEST_CHECK(Sink.Count == Count - 1, "count %u: Poll with All delivered %u of %u frames", Count, Sink.Count, Count - 1);
+	TEST_CHECK(Device.Waits == 0, "count %u: Poll waited %u times for GPU", Count, Device.Waits);
+
+	CpuReadback_Flush(&Readback);
+	Sink.Closed = true;
+	CpuReadback_Poll(&Readback, true);
+	TEST_CHECK(Sink.LateCalls == 0 && Device.Errors == 0, "count %u: %u sink calls after flush, %u wrong uses of staging buffers", Count, Sink.LateCalls, Device.Errors);
+}
+
+static void Readback_TestFlush(uint32_t Count)
+{
+	// flush right after submit waits for copies that are not finished
+	CpuReadback Readback;
+	ReadbackDevice Device;
+	ReadbackSink Sink;
+	Readback_Create(&Readback, Count, &Device, &Sink, 10, 0);
+
+	uint32_t Accepted = 0;
+	for (uint32_t Frame = 0; Frame < Count + 2; Frame++)
+	{
+		Accepted += Readback_Submit(&Readback, &Device);
+	}
+	TEST_CHECK(Sink.Count == 0 && Accepted == Count, "count %u: %u delivered & %u accepted before any copy finished", Count, Sink.Count, Accepted);
+
+	CpuReadback_Flush(&Readback);
+	Sink.Closed = true;
+	CpuReadback_Poll(&Readback, true);
+	CpuReadback_Flush(&Readback);
+
+	TEST_CHECK(Sink.Count == Count && Device.Waits == Count, "count %u: flush delivered %u frames, waited %u times", Count, Sink.Count, Device.Waits);
+	TEST_CHECK(Sink.OrderErrors == 0 && Sink.DataErrors == 0 && Sink.LateCalls == 0, "count %u: flush gave %u out of order, %u with wrong data, %u after flush", Count, Sink.OrderErrors, Sink.DataErrors, Sink.LateCalls);
+	TEST_CHECK(Device.Errors == 0, "count %u: flush did %u wrong uses of staging buffers", Count, Device.Errors);
+}
+
+int main(void)
+{
+	for (uint32_t Count = 2; Count <= CPU_READBACK_MAX_COUNT; Count++)
+	{
+		Readback_TestSteady(Count);
+		Readback_TestPoll(Count);
+		Readback_TestFlush(Count);
+
+		// copies late by up to one frame still fit in spare buffer, slower GPU makes drops
+		Readback_TestSlow(Count, Count - 1, 1);
+		Readback_TestSlow(Count, Count, 0);
+		Readback_TestSlow(Count, Count + 2, 0);
+		Readback_TestSlow(Count, 1, Count + 2);
+	}
+
+	return Test_Finish("test_cpu_readback");
+}
@@ -0,0 +1,350 @@
+// compares every CpuResize kernel against scalar reference, and tiled Pool output against single thread
+// then measures how resize of 1080p, 4K & 8K inputs scales with thread count
+
+#include "test.h"
+#include "wcap_cpu_resize.h"
+
+// SIMD kernels use fma & different summation order, rounding can differ by one step
+#define RESIZE_TOLERANCE 1
+
+static const uint32_t ResizeSizes[][4] =
+{
+	{ 1920, 1080, 1280,  720 },
+	{ 1000,  500,  999,  500 }, // only horizontal, by one pixel
+	{  333,  777,  102,   46 }, // odd sizes, reduction in both directions
+	{   64,   64,    2,    2 },
+	{    1,  301,    1,   77 }, // single column
+	{  301,    1,   77,    1 }, // single row
+	{  101,   37,  203,   75 }, // upscale
+	{  127,  129,  127,  129 }, // same size
+	{  800, 3000,  800, 1000 }, // only vertical
+	{ 3000,  200, 1000,  190 },
+	{ 3840, 2160,  320,  180 }, // large integer reduction
+};
+#define RESIZE_SIZE_COUNT (sizeof(ResizeSizes) / sizeof(*ResizeSizes))
+
+static const char* ResizeFilterNames[] = { "Bilinear", "Area", "CatmullRom", "Mitchell", "Lanczos3" };
+
+static void Resize_Fill(uint8_t* Image, uint32_t Width, uint32_t Height, uint32_t Seed)
+{
+	// noise on top of gradient, so both smooth areas & sharp edges are covered
+	uint32_t State = Seed;
+	for (uint32_t Y = 0; Y < Height; Y++)
+	{
+		for (uint32_t X = 0; X < Width; X++)
+		{
+			uint8_t* Pixel = Image + ((size_t)Y * Width + X) * 4;
+			uint32_t Noise = Test_Random(&State);
+			Pixel[0] = (uint8_t)(X * 255 / Width) ^ (uint8_t)(Noise & 0x1f);
+			Pixel[1] = (uint8_t)(Y * 255 / Height);
+			Pixel[2] = (uint8_t)(Noise >> 8);
+			Pixel[3] = (uint8_t)(Noise >> 16);
+		}
+	}
+}
+
+// returns max difference of BGR channels, alpha must be 0 everywhere
+static uint32_t Resize_Compare(const uint8_t* Ref, const uint8_t* Out, uint32_t Width, uint32_t Height, uint32_t* AlphaErrors)
+{
+	uint32_t MaxDiff = 0;
+	for (size_t Index = 0; Index < (size_t)Width * Height; Index++)
+	{
+		for (uint32_t Channel = 0; Channel < 3; Channel++)
+		{
+			int Diff = abs((int)Ref[Index * 4 + Channel] - (int)Out[Index * 4 + Channel]);
+			MaxDiff = Diff > (int)MaxDiff ? (uint32_t)Diff : MaxDiff;
+		}
+		*AlphaErrors += Out[Index * 4 + 3] != 0;
+	}
+	return MaxDiff;
+}
+
+static void Resize_Test(const uint32_t* Size, CpuPool* Pools, uint32_t PoolCount)
+{
+	uint32_t InputWidth = Size[0];
+	uint32_t InputHeight = Size[1];
+	uint32_t OutputWidth = Size[2];
+	uint32_t OutputHeight = Size[3];
+
+	size_t InputSize = (size_t)InputWidth * InputHeight * 4;
+	size_t OutputSize = (size_t)OutputWidth * OutputHeight * 4;
+
+	uint8_t* Input = Cpu_Alloc(InputSize);
+	uint8_t* Ref = Cpu_Alloc(OutputSize);
+	uint8_t* Single = Cpu_Alloc(OutputSize);
+	uint8_t* Output = Cpu_Alloc(OutputSize);
+
+	Resize_Fill(Input, InputWidth, InputHeight, InputWidth * 7919 + InputHeight);
+
+	for (ResizeFilter Filter = ResizeFilter_Bilinear; Filter <= ResizeFilter_Lanczos3; Filter++)
+	{
+		for (uint32_t Linear = 0; Linear < 2; Linear++)
+		{
+			CpuResize Resize;
+			CpuResize_Create(&Resize, InputWidth, InputHeight, OutputWidth, OutputHeight, Filter, Linear, CpuKernel_Scalar, NULL);
+			CpuResize_Run(&Resize, Input, InputWidth * 4, Ref, OutputWidth * 4);
+			CpuResize_Release(&Resize);
+
+			for (uint32_t KernelIndex = 0; KernelIndex < TEST_KERNEL_COUNT; KernelIndex++)
+			{
+				CpuKernel Kernel = Test_Kernels[KernelIndex];
+				if (!Test_HasKernel(Kernel))
+				{
+					continue;
+				}
+
+				CpuResize_Create(&Resize, InputWidth, InputHeight, OutputWidth, OutputHeight, Filter, Linear, Kernel, NULL);
+				memset(Single, 0xcc, OutputSize);
+				CpuResize_Run(&Resize, Input, InputWidth * 4, Single, OutputWidth * 4);
+
+				// split run must produce same output as full run
+				if (Resize.Middle)
+				{
+					memset(Output, 0xcc, OutputSize);
+					CpuResize_RunMiddle(&Resize, Input, InputWidth * 4);
+					uint32_t Split = OutputHeight / 3;
+					CpuResize_RunRows(&Resize, Output, OutputWidth * 4, 0, Split);
+					CpuResize_RunRows(&Resize, Output + (size_t)Split * OutputWidth * 4, OutputWidth * 4, Split, OutputHeight);
+					TEST_CHECK(memcmp(Single, Output, OutputSize) == 0, "%ux%u -> %ux%u %s%s %s RunRows", InputWidth, InputHeight, OutputWidth, OutputHeight, ResizeFilterNames[Filter], Linear ? " linear" : "", Test_KernelName(Kernel));
+				}
+				CpuResize_Release(&Resize);
+
+				uint32_t AlphaErrors = 0;
+				uint32_t MaxDiff = Resize_Compare(Ref, Single, OutputWidth, OutputHeight, &AlphaErrors);
+				if (InputWidth == OutputWidth && InputHeight == OutputHeight)
+				{
+					// same size is plain copy that keeps input alpha
+					TEST_CHECK(memcmp(Input, Single, OutputSize) == 0, "%ux%u %s copy", InputWidth, InputHeight, Test_KernelName(Kernel));
+					AlphaErrors = 0;
+				}
+				TEST_CHECK(MaxDiff <= RESIZE_TOLERANCE && AlphaErrors == 0, "%ux%u -> %ux%u %s%s %s max diff %u, %u non-zero alpha", InputWidth, InputHeight, OutputWidth, OutputHeight, ResizeFilterNames[Filter], Linear ? " linear" : "", Test_KernelName(Kernel), MaxDiff, AlphaErrors);
+
+				// tiles use same per-pixel math, so output must be exactly same as single thread
+				for (uint32_t PoolIndex = 0; PoolIndex < PoolCount; PoolIndex++)
+				{
+					CpuResize_Create(&Resize, InputWidth, InputHeight, OutputWidth, OutputHeight, Filter, Linear, Kernel, &Pools[PoolIndex]);
+					for (uint32_t Run = 0; Run < 2; Run++)
+					{
+						memset(Output, 0xcc, OutputSize);
+						CpuResize_Run(&Resize, Input, InputWidth * 4, Output, OutputWidth * 4);
+						TEST_CHECK(memcmp(Single, Output, OutputSize) == 0, "%ux%u -> %ux%u %s%s %s pool with %u threads, run %u", InputWidth, InputHeight, OutputWidth, OutputHeight, ResizeFilterNames[Filter], Linear ? " linear" : "", Test_KernelName(Kernel), Pools[PoolIndex].ThreadCount, Run);
+					}
+					CpuResize_Release(&Resize);
+				}
+			}
+		}
+	}
+
+	Cpu_Free(Input);
+	Cpu_Free(Ref);
+	Cpu_Free(Single);
+	Cpu_Free(Output);
+}
+
+static void Resize_TestEncodeLut(void)
+{
+	CpuResize Resize;
+	CpuResize_Create(&Resize, 64, 64, 32, 32, ResizeFilter_Bilinear, true, CpuKernel_Scalar, NULL);
+
+	// interpolated gamma table against exact curve in double precision
+	double MaxError = 0;
+	uint32_t Count = 1 << 20;
+	for (uint32_t Index = 0; Index <= Count; Index++)
+	{
+		double Linear = (double)Index / Count;
+		double Exact = 255.0 * (Linear < 0.0031308 ? Linear * 12.92 : 1.055 * pow(Linear, 1 / 2.4) - 0.055);
+		double Error = fabs(CpuResize__Encode_Scalar((float)Linear, Resize.Lut) - Exact);
+		MaxError = Error > MaxError ? Error : MaxError;
+	}
+	TEST_CHECK(MaxError < 0.01, "gamma table max error %.4f of 8-bit step", MaxError);
+
+	// out of range values saturate, store rounds & clamps result to byte
+	float Low = CpuResize__Encode_Scalar(-1.f, Resize.Lut);
+	float High = CpuResize__Encode_Scalar(2.f, Resize.Lut);
+	TEST_CHECK(fabsf(Low) < 0.01f && fabsf(High - 255.f) < 0.01f, "gamma table saturates to %f and %f", Low, High);
+
+	CpuResize_Release(&Resize);
+
+	// decoding & encoding every byte value gives same byte, so flat color stays same on every kernel
+	uint8_t* Input = Cpu_Alloc(64 * 64 * 4);
+	uint8_t* Output = Cpu_Alloc(21 * 21 * 4);
+	for (uint32_t KernelIndex = 0; KernelIndex < TEST_KERNEL_COUNT; KernelIndex++)
+	{
+		CpuKernel Kernel = Test_Kernels[KernelIndex];
+		if (!Test_HasKernel(Kernel))
+		{
+			continue;
+		}
+
+		CpuResize_Create(&Resize, 64, 64, 21, 21, ResizeFilter_Mitchell, true, Kernel, NULL);
+		uint32_t Errors = 0;
+		for (uint32_t Value = 0; Value < 256; Value++)
+		{
+			for (uint32_t Index = 0; Index < 64 * 64; Index++)
+			{
+				Input[Index * 4 + 0] = (uint8_t)Value;
+				Input[Index * 4 + 1] = (uint8_t)(255 - Value);
+				Input[Index * 4 + 2] = (uint8_t)(Value * 7);
+			}
+			CpuResize_Run(&Resize, Input, 64 * 4, Output, 21 * 4);
+			for (uint32_t Index = 0; Index < 21 * 21; Index++)
+			{
+				Errors += memcmp(Input, Output + Index * 4, 3) != 0;
+			}
+		}
+		CpuResize_Release(&Resize);
+		TEST_CHECK(Errors == 0, "%s flat color changed in linear space for %u pixels", Test_KernelName(Kernel), Errors);
+	}
+	Cpu_Free(Input);
+	Cpu_Free(Output);
+}
+
+static void Resize_Benchmark(CpuPool* Pool)
+{
+	uint32_t InputWidth = 2560;
+	uint32_t InputHeight = 1440;
+	uint32_t OutputWidth = 1280;
+	uint32_t OutputHeight = 720;
+
+	uint8_t* Input = Cpu_Alloc((size_t)InputWidth * InputHeight * 4);
+	uint8_t* Output = Cpu_Alloc((size_t)OutputWidth * OutputHeight * 4);
+	Resize_Fill(Input, InputWidth, InputHeight, 1);
+
+	printf("%ux%u -> %ux%u Lanczos3, ms per frame\n", InputWidth, InputHeight, OutputWidth, OutputHeight);
+	for (uint32_t KernelIndex = 0; KernelIndex < TEST_KERNEL_COUNT; KernelIndex++)
+	{
+		CpuKernel Kernel = Test_Kernels[KernelIndex];
+		if (!Test_HasKernel(Kernel))
+		{
+			continue;
+		}
+
+		for (uint32_t Linear = 0; Linear < 2; Linear++)
+		{
+			for (uint32_t Threaded = 0; Threaded < 2; Threaded++)
+			{
+				CpuResize Resize;
+				CpuResize_Create(&Resize, InputWidth, InputHeight, OutputWidth, OutputHeight, ResizeFilter_Lanczos3, Linear, Kernel, Threaded ? Pool : NULL);
+
+				uint32_t Count = 0;
+				double Start = Test_Time();
+				double Elapsed;
+				do
+				{
+					CpuResize_Run(&Resize, Input, InputWidth * 4, Output, OutputWidth * 4);
+					Count++;
+					Elapsed = Test_Time() - Start;
+				}
+				while (Elapsed < 0.25);
+
+				CpuResize_Release(&Resize);
+				printf("  %-6s %-6s %-10s %7.2f\n", Test_KernelName(Kernel), Linear ? "linear" : "gamma", Threaded ? "pool" : "single", Elapsed * 1000.0 / Count);
+			}
+		}
+	}
+
+	Cpu_Free(Input);
+	Cpu_Free(Output);
+}
+
+static void Resize_BenchmarkScaling(void)
+{
+	// recording of large monitor downscaled to half size, with 1, 2, 4, ... threads up to one for each processor
+	static const uint32_t Sizes[][4] =
+	{
+		{ 1920, 1080,  960,  540 },
+		{ 3840, 2160, 1920, 1080 },
+		{ 7680, 4320, 3840, 2160 },
+	};
+	static const char* SizeNames[] = { "1080p", "4K", "8K" };
+	enum { SizeCount = sizeof(Sizes) / sizeof(*Sizes) };
+
+	uint32_t ProcessorCount = Cpu_GetProcessorCount();
+
+	printf("Lanczos3 downscale to half size on pool with 1..%u threads, ms per frame & speedup\n", ProcessorCount);
+	printf("  %-7s", "threads");
+	for (uint32_t SizeIndex = 0; SizeIndex < SizeCount; SizeIndex++)
+	{
+		printf(" %15s", SizeNames[SizeIndex]);
+	}
+	printf("\n");
+
+	uint8_t* Input = Cpu_Alloc((size_t)Sizes[SizeCount - 1][0] * Sizes[SizeCount - 1][1] * 4);
+	uint8_t* Output = Cpu_Alloc((size_t)Sizes[SizeCount - 1][2] * Sizes[SizeCount - 1][3] * 4);
+	Resize_Fill(Input, Sizes[SizeCount - 1][0], Sizes[SizeCount - 1][1], 1);
+
+	double Single[SizeCount];
+	for (uint32_t ThreadCount = 1; ; ThreadCount = ThreadCount * 2 < ProcessorCount ? ThreadCount * 2 : ProcessorCount)
+	{
+		CpuPool Pool;
+		CpuPool_Create(&Pool, ThreadCount);
+
+		printf("  %-7u", ThreadCount);
+		for (uint32_t SizeIndex = 0; SizeIndex < SizeCount; SizeIndex++)
+		{
+			const uint32_t* Size = Sizes[SizeIndex];
+
+			CpuResize Resize;
+			CpuResize_Create(&Resize, Size[0], Size[1], Size[2], Size[3], ResizeFilter_Lanczos3, false, CpuKernel_Auto, &Pool);
+
+			uint32_t Count = 0;
+			double Start = Test_Time();
+			double Elapsed;
+			do
+			{
+				CpuResize_Run(&Resize, Input, Size[0] * 4, Output, Size[2] * 4);
+				Count++;
+				Elapsed = Test_Time() - Start;
+			}
+			while (Elapsed < 0.25);
+
+			CpuResize_Release(&Resize);
+
+			double Time = Elapsed * 1000.0 / Count;
+			if (ThreadCount == 1)
+			{
+				Single[SizeIndex] = Time;
+			}
+			printf(" %8.2f %5.2fx", Time, Single[SizeIndex] / Time);
+		}
+		printf("\n");
+
+		CpuPool_Release(&Pool);
+		if (ThreadCount == ProcessorCount)
+		{
+			break;
+		}
+	}
+
+	Cpu_Free(Input);
+	Cpu_Free(Output);
+}
+
+int main(void)
+{
+	// 0 = one thread for each processor
+	static const uint32_t ThreadCounts[] = { 1, 2, 3, 7, 0 };
+	enum { PoolCount = sizeof(ThreadCounts) / sizeof(*ThreadCounts) };
+
+	CpuPool Pools[PoolCount];
+	for (uint32_t PoolIndex = 0; PoolIndex < PoolCount; PoolIndex++)
+	{
+		CpuPool_Create(&Pools[PoolIndex], ThreadCounts[PoolIndex]);
+	}
+
+	for (uint32_t SizeIndex = 0; SizeIndex < RESIZE_SIZE_COUNT; SizeIndex++)
+	{
+		Resize_Test(ResizeSizes[SizeIndex], Pools, PoolCount);
+	}
+
+	Resize_TestEncodeLut();
+	Resize_Benchmark(&Pools[PoolCount - 1]);
+	Resize_BenchmarkScaling();
+
+	for (uint32_t PoolIndex = 0; PoolIndex < PoolCount; PoolIndex++)
+	{
+		CpuPool_Release(&Pools[PoolIndex]);
+	}
+
+	return Test_Finish("test_cpu_resize");
+}
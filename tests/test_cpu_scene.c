@@ -0,0 +1,449 @@
+// CpuScene thresholds on synthetic thumbnails, labeled synthetic screen recordings, and SAD kernels against scalar
+// thumbnail is average luma of every 32x32 block, same as FrameHash gives for 1920x1080 frame
+
+#include "test.h"
+#include "wcap_cpu_scene.h"
+
+#define SCENE_WIDTH 60
+#define SCENE_HEIGHT 34
+#define SCENE_COUNT (SCENE_WIDTH * SCENE_HEIGHT)
+#define SCENE_MAX_FRAMES 1024
+
+static uint8_t Scene_Clamp(int Value)
+{
+	return (uint8_t)(Value < 0 ? 0 : Value > 255 ? 255 : Value);
+}
+
+//
+// thresholds
+//
+
+static bool Scene_Pair(const uint8_t* First, const uint8_t* Second, uint32_t Count)
+{
+	CpuScene Scene;
+	CpuScene_Create(&Scene, Count, CpuKernel_Auto);
+	TEST_CHECK(!CpuScene_Detect(&Scene, First), "first thumbnail is reported as scene change");
+	bool Cut = CpuScene_Detect(&Scene, Second);
+	CpuScene_Release(&Scene);
+	return Cut;
+}
+
+static void Scene_TestThresholds(void)
+{
+	// 2048 pixels, so fractions of 256 are exact
+	enum { Count = 2048 };
+	static uint8_t First[Count];
+	static uint8_t Second[Count];
+
+	// whole frame gets brighter, histogram moves completely, SAD decides
+	for (int Shift = 6; Shift <= 10; Shift++)
+	{
+		memset(First, 100, Count);
+		memset(Second, 100 + Shift, Count);
+		bool Cut = Scene_Pair(First, Second, Count);
+		TEST_CHECK(Cut == (Shift >= CPU_SCENE_MIN_SAD), "brightness change by %d: cut %d", Shift, Cut);
+	}
+
+	// content rearranged with same histogram, half of pixels are A & half B, and they swap places
+	// only SAD of at least CPU_SCENE_CUT_SAD makes it a scene change
+	for (int Diff = 28; Diff <= 36; Diff++)
+	{
+		for (uint32_t Index = 0; Index < Count; Index++)
+		{
+			bool Odd = (Index / 3) % 2;
+			First[Index] = Odd ? 100 : (uint8_t)(100 + Diff);
+			Second[Index] = Odd ? (uint8_t)(100 + Diff) : 100;
+		}
+		bool Cut = Scene_Pair(First, Second, Count);
+		TEST_CHECK(Cut == (Diff >= CPU_SCENE_CUT_SAD), "same histogram, swapped values with difference %d: cut %d", Diff, Cut);
+	}
+
+	// part of frame changes from dark to bright, SAD is above minimum but below cut level
+	// so fraction of pixels moved to other histogram bin decides
+	for (uint32_t Moved = 20; Moved <= 28; Moved++)
+	{
+		uint32_t Changed = Moved * Count / 256;
+		memset(First, 20, Count);
+		memset(Second, 20, Count);
+		memset(Second, 220, Changed);
+		bool Cut = Scene_Pair(First, Second, Count);
+		TEST_CHECK(Cut == (Moved >= CPU_SCENE_MIN_MOVED), "%u/256 of pixels changed by 200: cut %d", Moved, Cut);
+	}
+
+	// after steady changes every frame, scene change must be CPU_SCENE_SAD_RATIO times larger than them
+	for (int Shift = 36; Shift <= 44; Shift += 2)
+	{
+		CpuScene Scene;
+		CpuScene_Create(&Scene, Count, CpuKernel_Auto);
+
+		uint32_t Seed = 7;
+		uint8_t Base[Count];
+		for (uint32_t Index = 0; Index < Count; Index++)
+		{
+			Base[Index] = (uint8_t)(50 + Test_Random(&Seed) % 100);
+		}
+
+		// playback where every pixel flips by 10 levels every frame, so average SAD is 10
+		// first few frames after static screen can be reported, while recent SAD follows playback
+		uint32_t Cuts = 0;
+		for (uint32_t Frame = 0; Frame < 64; Frame++)
+		{
+			for (uint32_t Index = 0; Index < Count; Index++)
+			{
+				First[Index] = (uint8_t)(Base[Index] + (Frame % 2) * 10);
+			}
+			bool Cut = CpuScene_Detect(&Scene, First);
+			Cuts += Frame >= 8 && Cut;
+		}
+		TEST_CHECK(Cuts == 0, "steady playback: %u scene changes", Cuts);
+
+		for (uint32_t Index = 0; Index < Count; Index++)
+		{
+			Second[Index] = (uint8_t)(First[Index] + Shift);
+		}
+		bool Cut = CpuScene_Detect(&Scene, Second);
+		TEST_CHECK(Cut == (Shift >= CPU_SCENE_SAD_RATIO * 10), "change by %d during playback with SAD 10: cut %d", Shift, Cut);
+		CpuScene_Release(&Scene);
+	}
+}
+
+//
+// labeled sequences
+//
+
+typedef struct
+{
+	uint8_t Luma[SCENE_MAX_FRAMES][SCENE_COUNT];
+	uint8_t Label[SCENE_MAX_FRAMES]; // SceneLabel
+	uint32_t Count;
+}
+SceneSequence;
+
+typedef enum
+{
+	SceneLabel_None,
+	SceneLabel_Cut,
+	SceneLabel_Any,  // ambiguous change, for example video starting to play, either result is fine
+}
+SceneLabel;
+
+typedef struct
+{
+	uint32_t X, Y, Width, Height;
+}
+SceneRect;
+
+// desktop with background & few windows, text in windows makes block averages vary a bit
+static void Scene_Desktop(uint8_t* Luma, uint32_t Seed)
+{
+	uint8_t Background = (uint8_t)(30 + Test_Random(&Seed) % 80);
+	for (uint32_t Index = 0; Index < SCENE_COUNT; Index++)
+	{
+		Luma[Index] = (uint8_t)(Background + Test_Random(&Seed) % 6);
+	}
+
+	uint32_t Windows = 2 + Test_Random(&Seed) % 3;
+	for (uint32_t Window = 0; Window < Windows; Window++)
+	{
+		uint32_t Width = 15 + Test_Random(&Seed) % 40;
+		uint32_t Height = 8 + Test_Random(&Seed) % 24;
+		uint32_t X = Test_Random(&Seed) % (SCENE_WIDTH - Width);
+		uint32_t Y = Test_Random(&Seed) % (SCENE_HEIGHT - Height);
+		// dark or light theme
+		int Fill = Test_Random(&Seed) % 2 ? 20 + Test_Random(&Seed) % 30 : 200 + Test_Random(&Seed) % 40;
+		for (uint32_t Row = Y; Row < Y + Height; Row++)
+		{
+			for (uint32_t Col = X; Col < X + Width; Col++)
+			{
+				int Text = (int)(Test_Random(&Seed) % 24);
+				Luma[Row * SCENE_WIDTH + Col] = Scene_Clamp(Fill > 128 ? Fill - Text : Fill + Text);
+			}
+		}
+	}
+}
+
+static void Scene_Add(SceneSequence* Sequence, const uint8_t* Luma, SceneLabel Label)
+{
+	Assert(Sequence->Count < SCENE_MAX_FRAMES);
+	memcpy(Sequence->Luma[Sequence->Count], Luma, SCENE_COUNT);
+	Sequence->Label[Sequence->Count] = (uint8_t)Label;
+	Sequence->Count++;
+}
+
+// typing or cursor blink, only changed frames are passed to detector
+static void Scene_Typing(SceneSequence* Sequence, uint8_t* Luma, uint32_t Frames, uint32_t* Seed)
+{
+	for (uint32_t Frame = 0; Frame < Frames; Frame++)
+	{
+		for (uint32_t Count = 0; Count < 3; Count++)
+		{
+			uint32_t Index = Test_Random(Seed) % SCENE_COUNT;
+			Luma[Index] = Scene_Clamp(Luma[Index] + (int)(Test_Random(Seed) % 41) - 20);
+		}
+		Scene_Add(Sequence, Luma, SceneLabel_None);
+	}
+}
+
+// content inside Rect moves up by one block row every frame, new row comes from page of text with some images
+// block averages of text line are similar, and image is smooth at block size
+static void Scene_Scroll(SceneSequence* Sequence, uint8_t* Luma, SceneRect Rect, uint32_t Frames, uint32_t* Seed)
+{
+	// same page continues in next call
+	static uint32_t ImageRows;
+	static int ImageLuma;
+	static int ImageStep;
+
+	for (uint32_t Frame = 0; Frame < Frames; Frame++)
+	{
+		for (uint32_t Row = Rect.Y; Row + 1 < Rect.Y + Rect.Height; Row++)
+		{
+			memcpy(Luma + Row * SCENE_WIDTH + Rect.X, Luma + (Row + 1) * SCENE_WIDTH + Rect.X, Rect.Width);
+		}
+
+		if (ImageRows == 0 && Test_Random(Seed) % 12 == 0)
+		{
+			ImageRows = 3 + Test_Random(Seed) % 5;
+			ImageLuma = 60 + (int)(Test_Random(Seed) % 100);
+			ImageStep = (int)(Test_Random(Seed) % 9) - 4;
+		}
+
+		int Line = ImageRows ? 0 : 210 + (int)(Test_Random(Seed) % 25);
+		uint8_t* Last = Luma + (Rect.Y + Rect.Height - 1) * SCENE_WIDTH + Rect.X;
+		for (uint32_t Col = 0; Col < Rect.Width; Col++)
+		{
+			int Noise = (int)(Test_Random(Seed) % 9) - 4;
+			Last[Col] = Scene_Clamp(ImageRows ? ImageLuma + ImageStep * (int)Col / 2 + Noise : Line + Noise);
+		}
+		if (ImageRows)
+		{
+			ImageRows--;
+			ImageLuma += ImageStep * 2;
+		}
+		Scene_Add(Sequence, Luma, SceneLabel_None);
+	}
+}
+
+// gradual fade to black
+static void Scene_Fade(SceneSequence* Sequence, uint8_t* Luma, uint32_t Frames)
+{
+	static uint8_t Start[SCENE_COUNT];
+	memcpy(Start, Luma, SCENE_COUNT);
+	for (uint32_t Frame = 1; Frame <= Frames; Frame++)
+	{
+		for (uint32_t Index = 0; Index < SCENE_COUNT; Index++)
+		{
+			Luma[Index] = (uint8_t)(Start[Index] * (Frames - Frame) / Frames);
+		}
+		Scene_Add(Sequence, Luma, SceneLabel_None);
+	}
+}
+
+// video player in Rect, every frame is noisy & moving
+// video has its own cuts every 40 frames, those are reported only if change is large compared to playback itself
+static void Scene_Video(SceneSequence* Sequence, uint8_t* Luma, SceneRect Rect, uint32_t Frames, uint32_t* Seed)
+{
+	uint8_t Shot = (uint8_t)(60 + Test_Random(Seed) % 100);
+	for (uint32_t Frame = 0; Frame < Frames; Frame++)
+	{
+		if (Frame != 0 && Frame % 40 == 0)
+		{
+			Shot = (uint8_t)(60 + Test_Random(Seed) % 100);
+		}
+		for (uint32_t Row = Rect.Y; Row < Rect.Y + Rect.Height; Row++)
+		{
+			for (uint32_t Col = Rect.X; Col < Rect.X + Rect.Width; Col++)
+			{
+				Luma[Row * SCENE_WIDTH + Col] = Scene_Clamp(Shot + (int)((Row * 7 + Col * 3 + Frame * 5) % 40) + (int)(Test_Random(Seed) % 16) - 28);
+			}
+		}
+		Scene_Add(Sequence, Luma, Frame % 40 == 0 ? SceneLabel_Any : SceneLabel_None);
+	}
+}
+
+static void Scene_MakeSequence(SceneSequence* Sequence)
+{
+	static uint8_t Luma[SCENE_COUNT];
+	uint32_t Seed = 99;
+	Sequence->Count = 0;
+
+	// typing in editor, then presentation with slide changes
+	Scene_Desktop(Luma, 1);
+	Scene_Add(Sequence, Luma, SceneLabel_None);
+	Scene_Typing(Sequence, Luma, 60, &Seed);
+	for (uint32_t Slide = 0; Slide < 5; Slide++)
+	{
+		Scene_Desktop(Luma, 100 + Slide);
+		Scene_Add(Sequence, Luma, SceneLabel_Cut);
+		Scene_Typing(Sequence, Luma, 10 + Slide * 7, &Seed);
+	}
+
+	// switch to browser & scroll long page, then scroll again after reading a while
+	memset(Luma, 235, SCENE_COUNT);
+	SceneRect Page = { 10, 2, 40, 32 };
+	Scene_Scroll(Sequence, Luma, Page, 1, &Seed);
+	Sequence->Label[Sequence->Count - 1] = SceneLabel_Cut;
+	Scene_Scroll(Sequence, Luma, Page, 80, &Seed);
+	Scene_Typing(Sequence, Luma, 20, &Seed);
+	Scene_Scroll(Sequence, Luma, Page, 40, &Seed);
+
+	// fade out & back to desktop
+	Scene_Fade(Sequence, Luma, 60);
+	Scene_Desktop(Luma, 200);
+	Scene_Add(Sequence, Luma, SceneLabel_Cut);
+	Scene_Typing(Sequence, Luma, 20, &Seed);
+
+	// video playback with its own cuts in third of screen, then switch to other window while it plays
+	SceneRect Player = { 5, 5, 34, 20 };
+	Scene_Video(Sequence, Luma, Player, 200, &Seed);
+	Scene_Desktop(Luma, 300);
+	Scene_Add(Sequence, Luma, SceneLabel_Cut);
+	Scene_Typing(Sequence, Luma, 30, &Seed);
+
+	// fullscreen video, then back to desktop
+	SceneRect Fullscreen = { 0, 0, SCENE_WIDTH, SCENE_HEIGHT };
+	Scene_Video(Sequence, Luma, Fullscreen, 160, &Seed);
+	Scene_Desktop(Luma, 400);
+	Scene_Add(Sequence, Luma, SceneLabel_Cut);
+	Scene_Typing(Sequence, Luma, 10, &Seed);
+}
+
+static void Scene_TestSequence(void)
+{
+	static SceneSequence Sequence;
+	Scene_MakeSequence(&Sequence);
+
+	uint32_t Cuts = 0;
+	for (uint32_t Frame = 0; Frame < Sequence.Count; Frame++)
+	{
+		Cuts += Sequence.Label[Frame] == SceneLabel_Cut;
+	}
+
+	for (uint32_t KernelIndex = 0; KernelIndex < TEST_KERNEL_COUNT; KernelIndex++)
+	{
+		CpuKernel Kernel = Test_Kernels[KernelIndex];
+		if (!Test_HasKernel(Kernel))
+		{
+			continue;
+		}
+
+		CpuScene Scene;
+		CpuScene_Create(&Scene, SCENE_COUNT, Kernel);
+
+		uint32_t Detected = 0;
+		uint32_t Missed = 0;
+		uint32_t FalseCuts = 0;
+		for (uint32_t Frame = 0; Frame < Sequence.Count; Frame++)
+		{
+			bool Cut = CpuScene_Detect(&Scene, Sequence.Luma[Frame]);
+			SceneLabel Label = Sequence.Label[Frame];
+			if (Label == SceneLabel_Cut && !Cut)
+			{
+				Missed++;
+				printf("  %s: missed scene change at frame %u\n", Test_KernelName(Kernel), Frame);
+			}
+			else if (Label == SceneLabel_None && Cut)
+			{
+				FalseCuts++;
+				printf("  %s: false scene change at frame %u\n", Test_KernelName(Kernel), Frame);
+			}
+			Detected += Cut;
+		}
+		CpuScene_Release(&Scene);
+
+		TEST_CHECK(Missed == 0 && FalseCuts == 0, "%s: %u of %u scene changes missed, %u false ones", Test_KernelName(Kernel), Missed, Cuts, FalseCuts);
+		printf("  %-6s %u frames: %u scene changes detected, %u labeled\n", Test_KernelName(Kernel), Sequence.Count, Detected, Cuts);
+	}
+}
+
+//
+// kernels
+//
+
+static void Scene_TestKernels(void)
+{
+	// odd sizes for tails after 16 & 32 byte blocks, and extreme values
+	static const uint32_t Sizes[] = { 1, 15, 16, 17, 31, 33, 63, 100, 2040, 8163 };
+	static uint8_t Previous[8192];
+	static uint8_t Current[8192];
+
+	uint32_t Seed = 5;
+	for (uint32_t SizeIndex = 0; SizeIndex < sizeof(Sizes) / sizeof(*Sizes); SizeIndex++)
+	{
+		uint32_t Count = Sizes[SizeIndex];
+		for (uint32_t Pattern = 0; Pattern < 3; Pattern++)
+		{
+			for (uint32_t Index = 0; Index < Count; Index++)
+			{
+				Previous[Index] = Pattern == 0 ? (uint8_t)Test_Random(&Seed) : Pattern == 1 ? 0 : 255;
+				Current[Index] = Pattern == 0 ? (uint8_t)Test_Random(&Seed) : Pattern == 1 ? 255 : 0;
+			}
+
+			uint32_t Expected = CpuScene__Sad_Scalar(Previous, Current, Count);
+			for (uint32_t KernelIndex = 0; KernelIndex < TEST_KERNEL_COUNT; KernelIndex++)
+			{
+				CpuKernel Kernel = Test_Kernels[KernelIndex];
+				if (!Test_HasKernel(Kernel))
+				{
+					continue;
+				}
+
+				CpuScene Scene;
+				CpuScene_Create(&Scene, Count, Kernel);
+				uint32_t Sad = Scene.Sad(Previous, Current, Count);
+				TEST_CHECK(Sad == Expected, "%s SAD of %u bytes, pattern %u: %u, expected %u", Test_KernelName(Kernel), Count, Pattern, Sad, Expected);
+				CpuScene_Release(&Scene);
+			}
+		}
+	}
+}
+
+static void Scene_Benchmark(void)
+{
+	static uint8_t Luma[2][SCENE_COUNT];
+	uint32_t Seed = 3;
+	for (uint32_t Index = 0; Index < SCENE_COUNT; Index++)
+	{
+		Luma[0][Index] = (uint8_t)Test_Random(&Seed);
+		Luma[1][Index] = (uint8_t)Test_Random(&Seed);
+	}
+
+	for (uint32_t KernelIndex = 0; KernelIndex < TEST_KERNEL_COUNT; KernelIndex++)
+	{
+		CpuKernel Kernel = Test_Kernels[KernelIndex];
+		if (!Test_HasKernel(Kernel))
+		{
+			continue;
+		}
+
+		CpuScene Scene;
+		CpuScene_Create(&Scene, SCENE_COUNT, Kernel);
+
+		uint32_t Runs = 0;
+		uint32_t Cuts = 0;
+		double Start = Test_Time();
+		double Elapsed;
+		do
+		{
+			for (uint32_t Index = 0; Index < 100; Index++)
+			{
+				Cuts += CpuScene_Detect(&Scene, Luma[Index % 2]);
+			}
+			Runs += 100;
+			Elapsed = Test_Time() - Start;
+		}
+		while (Elapsed < 0.1);
+
+		printf("  %-6s %6.2f us per %ux%u thumbnail (%u cuts)\n", Test_KernelName(Kernel), Elapsed * 1e6 / Runs, SCENE_WIDTH, SCENE_HEIGHT, Cuts);
+		CpuScene_Release(&Scene);
+	}
+}
+
+int main(void)
+{
+	Scene_TestThresholds();
+	Scene_TestSequence();
+	Scene_TestKernels();
+	Scene_Benchmark();
+
+	return Test_Finish("test_cpu_scene");
+}
@@ -0,0 +1,242 @@
+// stress test of CpuSlots with many threads acquiring & recycling, also across threads like encoder callbacks do
+
+#include "test.h"
+#include "wcap_cpu_slots.h"
+
+#define SLOTS_MAX_THREADS 8
+#define SLOTS_ITERATIONS 100000
+
+typedef struct
+{
+	CpuSlots Slots;
+	_Atomic(uint32_t) Owned[64]; // set while slot is acquired, so same index handed out twice is seen
+	_Atomic(uint32_t) Mailbox;   // slot index + 1 passed to other thread for recycling, 0 when empty
+	_Atomic(uint32_t) Duplicates;
+	_Atomic(uint32_t) BadIndex;
+	bool UseMailbox;
+}
+SlotsState;
+
+typedef struct
+{
+	SlotsState* State;
+	CpuThread Thread;
+	uint32_t Seed;
+	uint32_t Acquired;
+}
+SlotsWorker;
+
+static void Slots_Take(SlotsState* State, uint32_t Index)
+{
+	if (Index >= State->Slots.Count)
+	{
+		atomic_fetch_add(&State->BadIndex, 1);
+		return;
+	}
+	if (atomic_exchange(&State->Owned[Index], 1) != 0)
+	{
+		atomic_fetch_add(&State->Duplicates, 1);
+	}
+}
+
+static void Slots_Give(SlotsState* State, uint32_t Index)
+{
+	if (Index < State->Slots.Count)
+	{
+		atomic_store(&State->Owned[Index], 0);
+		CpuSlots_Recycle(&State->Slots, Index);
+	}
+}
+
+static void Slots_Worker(void* Arg)
+{
+	SlotsWorker* Worker = Arg;
+	SlotsState* State = Worker->State;
+
+	for (uint32_t Iteration = 0; Iteration < SLOTS_ITERATIONS; Iteration++)
+	{
+		uint32_t Random = Test_Random(&Worker->Seed);
+
+		uint32_t Index;
+		if (Random & 1)
+		{
+			Index = CpuSlots_Acquire(&State->Slots);
+		}
+		else if (!CpuSlots_TryAcquire(&State->Slots, &Index))
+		{
+			continue;
+		}
+		Slots_Take(State, Index);
+		Worker->Acquired++;
+
+		if ((Random & 6) == 0)
+		{
+			// let other threads run while slot is held
+			Test_Yield();
+		}
+
+		if (State->UseMailbox && (Random & 8))
+		{
+			// slot is recycled by whichever thread takes it from mailbox, previous one is recycled here
+			// so at most one slot is outside of threads, and waiting threads never hold any
+			uint32_t Previous = atomic_exchange(&State->Mailbox, Index + 1);
+			if (Previous != 0)
+			{
+				Slots_Give(State, Previous - 1);
+			}
+		}
+		else
+		{
+			Slots_Give(State, Index);
+		}
+	}
+}
+
+static void Slots_TestOrder(void)
+{
+	CpuSlots Slots;
+	CpuSlots_Create(&Slots, 5);
+	TEST_CHECK(CpuSlots_GetFreeCount(&Slots) == 5, "new pool has %u free slots", CpuSlots_GetFreeCount(&Slots));
+
+	uint32_t Index;
+	for (uint32_t Expected = 0; Expected < 5; Expected++)
+	{
+		TEST_CHECK(CpuSlots_TryAcquire(&Slots, &Index) && Index == Expected, "initial slots are not acquired in order");
+	}
+	TEST_CHECK(!CpuSlots_TryAcquire(&Slots, &Index), "acquired slot when none is free");
+	TEST_CHECK(CpuSlots_GetFreeCount(&Slots) == 0, "empty pool has %u free slots", CpuSlots_GetFreeCount(&Slots));
+
+	// slots come back in same order they are recycled, many times around ring
+	static const uint32_t Order[] = { 3, 1, 4, 0, 2 };
+	for (uint32_t Round = 0; Round < 10; Round++)
+	{
+		for (uint32_t Position = 0; Position < 5; Position++)
+		{
+			CpuSlots_Recycle(&Slots, Order[(Position + Round) % 5]);
+		}
+		for (uint32_t Position = 0; Position < 5; Position++)
+		{
+			TEST_CHECK(CpuSlots_TryAcquire(&Slots, &Index) && Index == Order[(Position + Round) % 5], "round %u slots are not acquired in recycle order", Round);
+		}
+	}
+	CpuSlots_Release(&Slots);
+}
+
+static void Slots_Holder(void* Arg)
+{
+	SlotsWorker* Worker = Arg;
+	SlotsState* State = Worker->State;
+
+	// holds slot for a while, same as sample that encoder still has when Encoder_Stop starts
+	double Start = Test_Time();
+	while (Test_Time() - Start < 0.01 * (Worker->Seed + 1))
+	{
+		Test_Yield();
+	}
+	Slots_Give(State, Worker->Acquired);
+}
+
+static void Slots_TestDrain(void)
+{
+	// acquiring all slots waits until every slot held by other threads is recycled
+	static SlotsState State;
+	memset(&State, 0, sizeof(State));
+	CpuSlots_Create(&State.Slots, 4);
+
+	SlotsWorker Workers[3];
+	for (uint32_t Index = 0; Index < 3; Index++)
+	{
+		uint32_t Slot = CpuSlots_Acquire(&State.Slots);
+		Slots_Take(&State, Slot);
+		Workers[Index] = (SlotsWorker) { .State = &State, .Seed = Index, .Acquired = Slot };
+		CpuThread_Create(&Workers[Index].Thread, &Slots_Holder, &Workers[Index]);
+	}
+
+	uint32_t Seen = 0;
+	for (uint32_t Count = 0; Count < 4; Count++)
+	{
+		uint32_t Slot = CpuSlots_Acquire(&State.Slots);
+		TEST_CHECK(Slot < 4 && atomic_load(&State.Owned[Slot]) == 0, "drain acquired slot %u that is still held", Slot);
+		Seen |= 1U << Slot;
+	}
+	TEST_CHECK(Seen == 15, "drain did not get every slot, mask %x", Seen);
+
+	for (uint32_t Index = 0; Index < 3; Index++)
+	{
+		CpuThread_Join(&Workers[Index].Thread);
+	}
+	CpuSlots_Release(&State.Slots);
+}
+
+static void Slots_TestThreads(uint32_t SlotCount, uint32_t ThreadCount, bool UseMailbox)
+{
+	static SlotsState State;
+	memset(&State, 0, sizeof(State));
+	CpuSlots_Create(&State.Slots, SlotCount);
+	State.UseMailbox = UseMailbox;
+
+	SlotsWorker Workers[SLOTS_MAX_THREADS];
+	double Start = Test_Time();
+	for (uint32_t Index = 0; Index < ThreadCount; Index++)
+	{
+		Workers[Index] = (SlotsWorker) { .State = &State, .Seed = 12345 + Index * 777 };
+		CpuThread_Create(&Workers[Index].Thread, &Slots_Worker, &Workers[Index]);
+	}
+
+	uint32_t Acquired = 0;
+	for (uint32_t Index = 0; Index < ThreadCount; Index++)
+	{
+		CpuThread_Join(&Workers[Index].Thread);
+		Acquired += Workers[Index].Acquired;
+	}
+	double Elapsed = Test_Time() - Start;
+
+	uint32_t Last = atomic_load(&State.Mailbox);
+	if (Last != 0)
+	{
+		Slots_Give(&State, Last - 1);
+	}
+
+	TEST_CHECK(atomic_load(&State.Duplicates) == 0 && atomic_load(&State.BadIndex) == 0, "%u slots, %u threads: %u slots handed out twice, %u bad indices", SlotCount, ThreadCount, atomic_load(&State.Duplicates), atomic_load(&State.BadIndex));
+
+	// every slot must be back & acquirable exactly once
+	TEST_CHECK(CpuSlots_GetFreeCount(&State.Slots) == SlotCount, "%u slots, %u threads: %u free after all are recycled", SlotCount, ThreadCount, CpuSlots_GetFreeCount(&State.Slots));
+	uint32_t Seen = 0;
+	uint32_t Index;
+	for (uint32_t Count = 0; Count < SlotCount; Count++)
+	{
+		if (CpuSlots_TryAcquire(&State.Slots, &Index) && Index < SlotCount)
+		{
+			Seen |= 1U << Index;
+		}
+	}
+	TEST_CHECK(Seen == (SlotCount == 32 ? ~0U : (1U << SlotCount) - 1), "%u slots, %u threads: not every slot returned, mask %08x", SlotCount, ThreadCount, Seen);
+	TEST_CHECK(!CpuSlots_TryAcquire(&State.Slots, &Index), "%u slots, %u threads: more slots than created", SlotCount, ThreadCount);
+
+	printf("  %2u slots %u threads%s: %7.3f us per acquire & recycle\n", SlotCount, ThreadCount, UseMailbox ? " with mailbox" : "             ", Elapsed * 1e6 / (Acquired ? Acquired : 1));
+	CpuSlots_Release(&State.Slots);
+}
+
+int main(void)
+{
+	Slots_TestOrder();
+	Slots_TestDrain();
+
+	static const uint32_t SlotCounts[] = { 1, 2, 3, 4, 8, 32 };
+	static const uint32_t ThreadCounts[] = { 1, 2, 4, 8 };
+	for (uint32_t SlotIndex = 0; SlotIndex < sizeof(SlotCounts) / sizeof(*SlotCounts); SlotIndex++)
+	{
+		for (uint32_t ThreadIndex = 0; ThreadIndex < sizeof(ThreadCounts) / sizeof(*ThreadCounts); ThreadIndex++)
+		{
+			uint32_t SlotCount = SlotCounts[SlotIndex];
+			Slots_TestThreads(SlotCount, ThreadCounts[ThreadIndex], false);
+			if (SlotCount >= 2)
+			{
+				// mailbox holds one slot, so threads blocked in Acquire always have other slot to wait for
+				Slots_TestThreads(SlotCount, ThreadCounts[ThreadIndex], true);
+			}
+		}
+	}
+
+	return Test_Finish("test_cpu_slots");
+}
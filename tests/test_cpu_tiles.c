@@ -0,0 +1,320 @@
+// checks dirty block bookkeeping of CpuHash_DirtyBlocks, and compares converting only dirty tiles on top of
+// previous output against full frame conversion for typing, scrolling & video playback workloads
+
+#include "test.h"
+#include "wcap_cpu_hash.h"
+#include "wcap_cpu_convert.h"
+
+// bookkeeping
+
+static uint32_t Tiles_Dirty(uint32_t BlockCountX, uint32_t BlockCountY, const uint32_t* Changed, uint32_t ChangedCount, uint32_t* Blocks)
+{
+	// previous hashes are zero, current ones are non-zero only for Changed blocks
+	size_t Size = 2 * BlockCountX * BlockCountY * sizeof(uint32_t);
+	uint32_t* Previous = Cpu_Alloc(Size);
+	uint32_t* Current = Cpu_Alloc(Size);
+	memset(Previous, 0, Size);
+	memset(Current, 0, Size);
+
+	for (uint32_t Index = 0; Index < ChangedCount; Index++)
+	{
+		uint32_t X = Changed[Index] & 0xffff;
+		uint32_t Y = Changed[Index] >> 16;
+		Current[2 * (Y * BlockCountX + X) + (Index & 1)] = 1;
+	}
+
+	uint32_t Count = CpuHash_DirtyBlocks(Previous, Current, BlockCountX, BlockCountY, Blocks);
+
+	Cpu_Free(Current);
+	Cpu_Free(Previous);
+	return Count;
+}
+
+static void Tiles_TestNeighbors(void)
+{
+	// single changed block makes it & its neighbors dirty, clipped at grid borders
+	const uint32_t CountX = 7;
+	const uint32_t CountY = 5;
+
+	uint32_t Blocks[7 * 5];
+	for (uint32_t Y = 0; Y < CountY; Y++)
+	{
+		for (uint32_t X = 0; X < CountX; X++)
+		{
+			uint32_t Changed = Y << 16 | X;
+			uint32_t Count = Tiles_Dirty(CountX, CountY, &Changed, 1, Blocks);
+
+			uint32_t Expected = 0;
+			uint32_t Errors = 0;
+			for (uint32_t Row = Y > 0 ? Y - 1 : 0; Row <= Y + 1 && Row < CountY; Row++)
+			{
+				for (uint32_t Column = X > 0 ? X - 1 : 0; Column <= X + 1 && Column < CountX; Column++)
+				{
+					// blocks are listed in row order
+					Errors += Expected >= Count || Blocks[Expected] != (Row << 16 | Column);
+					Expected++;
+				}
+			}
+			TEST_CHECK(Count == Expected && Errors == 0, "changed block %u,%u: %u dirty blocks, expected %u, %u wrong", X, Y, Count, Expected, Errors);
+		}
+	}
+
+	// two changes with overlapping neighborhoods list shared blocks once
+	uint32_t Changed[] = { 1 << 16 | 1, 1 << 16 | 3 };
+	uint32_t Count = Tiles_Dirty(CountX, CountY, Changed, 2, Blocks);
+	TEST_CHECK(Count == 15, "two changed blocks: %u dirty blocks, expected 15", Count);
+}
+
+static void Tiles_TestPacking(void)
+{
+	// positions are Y << 16 | X, grid of largest capture has more than 256 blocks in both directions
+	const uint32_t CountX = 2048;
+	const uint32_t CountY = 300;
+
+	uint32_t Changed = 299 << 16 | 2047;
+	uint32_t* Blocks = Cpu_Alloc(CountX * CountY * sizeof(uint32_t));
+	uint32_t Count = Tiles_Dirty(CountX, CountY, &Changed, 1, Blocks);
+
+	TEST_CHECK(Count == 4, "corner block of %ux%u grid: %u dirty blocks, expected 4", CountX, CountY, Count);
+	TEST_CHECK(Blocks[0] == (298u << 16 | 2046) && Blocks[3] == (299u << 16 | 2047), "corner block of %ux%u grid: first 0x%08x, last 0x%08x", CountX, CountY, Blocks[0], Blocks[3]);
+
+	for (uint32_t Index = 0; Index < Count; Index++)
+	{
+		uint32_t X = Blocks[Index] & 0xffff;
+		uint32_t Y = Blocks[Index] >> 16;
+		TEST_CHECK(X >= 2046 && X < CountX && Y >= 298 && Y < CountY, "dirty block %u unpacks to %u,%u", Index, X, Y);
+	}
+
+	Cpu_Free(Blocks);
+}
+
+static void Tiles_TestFirstFrame(void)
+{
+	// without previous frame every block is dirty, also when hashes happen to be zero
+	const uint32_t CountX = 60;
+	const uint32_t CountY = 34;
+
+	uint32_t* Current = Cpu_Alloc(2 * CountX * CountY * sizeof(uint32_t));
+	uint32_t* Blocks = Cpu_Alloc(CountX * CountY * sizeof(uint32_t));
+	memset(Current, 0, 2 * CountX * CountY * sizeof(uint32_t));
+
+	uint32_t Count = CpuHash_DirtyBlocks(NULL, Current, CountX, CountY, Blocks);
+
+	uint32_t Errors = 0;
+	for (uint32_t Index = 0; Index < Count; Index++)
+	{
+		Errors += Blocks[Index] != ((Index / CountX) << 16 | (Index % CountX));
+	}
+	TEST_CHECK(Count == CountX * CountY && Errors == 0, "first frame: %u of %u blocks dirty, %u wrong positions", Count, CountX * CountY, Errors);
+
+	Cpu_Free(Blocks);
+	Cpu_Free(Current);
+}
+
+// workloads
+
+#define TILES_WIDTH 1920
+#define TILES_HEIGHT 1080
+#define TILES_FRAMES 120
+#define TILES_SIZE CPU_HASH_BLOCK_SIZE
+#define TILES_LEFT 16
+
+// more dirty blocks than this converts whole frame, same as Encoder__UseTiles
+#define TILES_MAX_PERCENT 50
+
+typedef enum
+{
+	TilesWorkload_Typing,    // one 8x16 glyph per frame along text lines, with blinking caret
+	TilesWorkload_Scrolling, // whole page moves up by 16 rows every frame
+	TilesWorkload_Video,     // 640x360 region of new pixels every frame
+	TilesWorkload_Count,
+}
+TilesWorkload;
+
+static const char* TilesWorkloadNames[] = { "typing", "scrolling", "video" };
+
+static void Tiles_Noise(uint8_t* Image, uint32_t X, uint32_t Y, uint32_t Width, uint32_t Height, uint32_t* State)
+{
+	for (uint32_t Row = Y; Row < Y + Height; Row++)
+	{
+		for (uint32_t Column = X; Column < X + Width; Column++)
+		{
+			uint32_t Noise = Test_Random(State);
+			memcpy(Image + ((size_t)Row * TILES_WIDTH + Column) * 4, &Noise, 4);
+		}
+	}
+}
+
+static void Tiles_Draw(uint8_t* Image, const uint8_t* Page, TilesWorkload Workload, uint32_t Frame, uint32_t* State)
+{
+	size_t Pitch = TILES_WIDTH * 4;
+	switch (Workload)
+	{
+	case TilesWorkload_Typing:
+	{
+		// glyphs stay, so image is updated in place
+		uint32_t Column = 100 + Frame % 100 * 8;
+		uint32_t Line = 200 + Frame / 100 * 20;
+		Tiles_Noise(Image, Column, Line, 8, 16, State);
+		for (uint32_t Row = Line; Row < Line + 16; Row++)
+		{
+			memset(Image + Row * Pitch + (Column + 8) * 4, Frame / 8 % 2 ? 0 : 0xff, 2 * 4);
+		}
+		break;
+	}
+	case TilesWorkload_Scrolling:
+	{
+		// Page is twice as tall as screen
+		uint32_t Offset = Frame * 16 % TILES_HEIGHT;
+		memcpy(Image, Page + Offset * Pitch, TILES_HEIGHT * Pitch);
+		break;
+	}
+	case TilesWorkload_Video:
+		Tiles_Noise(Image, 640, 360, 640, 360, State);
+		break;
+	default:
+		break;
+	}
+}
+
+typedef struct
+{
+	CpuConvert Convert;
+	CpuConvert Tile[2];   // for full height tiles & ones in last row of blocks
+	uint8_t* TileY;
+	uint8_t* TileUV;
+	size_t TilePitch;
+}
+TilesConverter;
+
+static void Tiles_ConvertTile(TilesConverter* Converter, const uint8_t* Input, uint8_t* OutputY, uint8_t* OutputUV, uint32_t BlockX, uint32_t BlockY)
+{
+	// extra columns on left give first chroma sample same left neighbor as in full conversion, and keep
+	// columns at same offset within SIMD step, so kernel tail is never used for them
+	uint32_t X = BlockX * TILES_SIZE;
+	uint32_t Y = BlockY * TILES_SIZE;
+	uint32_t Left = X == 0 ? 0 : TILES_LEFT;
+	uint32_t Height = TILES_HEIGHT - Y < TILES_SIZE ? TILES_HEIGHT - Y : TILES_SIZE;
+
+	CpuConvert* Convert = &Converter->Tile[Height == TILES_SIZE ? 0 : 1];
+	size_t InputPitch = TILES_WIDTH * 4;
+	CpuConvert_Run(Convert, Input + Y * InputPitch + (X - Left) * 4, InputPitch, Converter->TileY, Converter->TilePitch, Converter->TileUV, Converter->TilePitch);
+
+	for (uint32_t Row = 0; Row < Height; Row++)
+	{
+		memcpy(OutputY + (Y + Row) * TILES_WIDTH + X, Converter->TileY + Row * Converter->TilePitch + Left, TILES_SIZE);
+	}
+	for (uint32_t Row = 0; Row < Height / 2; Row++)
+	{
+		memcpy(OutputUV + (Y / 2 + Row) * TILES_WIDTH + X, Converter->TileUV + Row * Converter->TilePitch + Left, TILES_SIZE);
+	}
+}
+
+static void Tiles_TestWorkloads(void)
+{
+	size_t Pitch = TILES_WIDTH * 4;
+	size_t SizeY = TILES_WIDTH * TILES_HEIGHT;
+	size_t SizeUV = SizeY / 2;
+
+	uint8_t* Page = Cpu_Alloc(2 * TILES_HEIGHT * Pitch);
+	uint8_t* Image = Cpu_Alloc(TILES_HEIGHT * Pitch);
+	uint8_t* RefY = Cpu_Alloc(SizeY);
+	uint8_t* RefUV = Cpu_Alloc(SizeUV);
+	uint8_t* OutputY[2] = { Cpu_Alloc(SizeY), Cpu_Alloc(SizeY) };
+	uint8_t* OutputUV[2] = { Cpu_Alloc(SizeUV), Cpu_Alloc(SizeUV) };
+
+	TilesConverter Converter;
+	CpuConvert_Create(&Converter.Convert, TILES_WIDTH, TILES_HEIGHT, YuvColorSpace_BT709, CpuConvertFormat_NV12, false, false, CpuKernel_Auto);
+	CpuConvert_Create(&Converter.Tile[0], TILES_SIZE + TILES_LEFT, TILES_SIZE, YuvColorSpace_BT709, CpuConvertFormat_NV12, false, false, CpuKernel_Auto);
+	CpuConvert_Create(&Converter.Tile[1], TILES_SIZE + TILES_LEFT, TILES_HEIGHT % TILES_SIZE, YuvColorSpace_BT709, CpuConvertFormat_NV12, false, false, CpuKernel_Auto);
+	Converter.TilePitch = TILES_SIZE + TILES_LEFT;
+	Converter.TileY = Cpu_Alloc(Converter.TilePitch * TILES_SIZE);
+	Converter.TileUV = Cpu_Alloc(Converter.TilePitch * TILES_SIZE / 2);
+
+	CpuHash Hash;
+	CpuHash_Create(&Hash, TILES_WIDTH, TILES_HEIGHT, CpuKernel_Auto);
+	uint32_t BlockCount = Hash.BlockCountX * Hash.BlockCountY;
+	uint32_t* Hashes[2] = { Cpu_Alloc(2 * BlockCount * sizeof(uint32_t)), Cpu_Alloc(2 * BlockCount * sizeof(uint32_t)) };
+	uint32_t* Blocks = Cpu_Alloc(BlockCount * sizeof(uint32_t));
+
+	printf("%ux%u NV12 conversion of %u frames, ms per frame\n", TILES_WIDTH, TILES_HEIGHT, TILES_FRAMES);
+	for (TilesWorkload Workload = 0; Workload < TilesWorkload_Count; Workload++)
+	{
+		uint32_t State = 1;
+		Tiles_Noise(Page, 0, 0, TILES_WIDTH, 2 * TILES_HEIGHT, &State);
+		memcpy(Image, Page, TILES_HEIGHT * Pitch);
+
+		double FullTime = 0;
+		double TilesTime = 0;
+		uint32_t DirtyTotal = 0;
+		uint32_t FullFrames = 0;
+		uint32_t Mismatches = 0;
+
+		for (uint32_t Frame = 0; Frame < TILES_FRAMES; Frame++)
+		{
+			Tiles_Draw(Image, Page, Workload, Frame, &State);
+
+			double Start = Test_Time();
+			CpuConvert_Run(&Converter.Convert, Image, Pitch, RefY, TILES_WIDTH, RefUV, TILES_WIDTH);
+			FullTime += Test_Time() - Start;
+
+			// hashing & dirty blocks are part of incremental cost, previous output is copied same as on GPU
+			uint8_t* CurrentY = OutputY[Frame % 2];
+			uint8_t* CurrentUV = OutputUV[Frame % 2];
+			uint32_t* CurrentHashes = Hashes[Frame % 2];
+			uint32_t* PreviousHashes = Hashes[(Frame + 1) % 2];
+
+			Start = Test_Time();
+			CpuHash_Run(&Hash, Image, Pitch, CurrentHashes);
+			uint32_t Count = CpuHash_DirtyBlocks(Frame == 0 ? NULL : PreviousHashes, CurrentHashes, Hash.BlockCountX, Hash.BlockCountY, Blocks);
+			if (Count * 100 > BlockCount * TILES_MAX_PERCENT)
+			{
+				CpuConvert_Run(&Converter.Convert, Image, Pitch, CurrentY, TILES_WIDTH, CurrentUV, TILES_WIDTH);
+				FullFrames++;
+			}
+			else
+			{
+				memcpy(CurrentY, OutputY[(Frame + 1) % 2], SizeY);
+				memcpy(CurrentUV, OutputUV[(Frame + 1) % 2], SizeUV);
+				for (uint32_t Index = 0; Index < Count; Index++)
+				{
+					Tiles_ConvertTile(&Converter, Image, CurrentY, CurrentUV, Blocks[Index] & 0xffff, Blocks[Index] >> 16);
+				}
+			}
+			TilesTime += Test_Time() - Start;
+			DirtyTotal += Count;
+
+			Mismatches += memcmp(RefY, CurrentY, SizeY) != 0 || memcmp(RefUV, CurrentUV, SizeUV) != 0;
+		}
+
+		TEST_CHECK(Mismatches == 0, "%s: %u frames of incremental conversion differ from full conversion", TilesWorkloadNames[Workload], Mismatches);
+		printf("  %-9s full %6.2f, incremental %6.2f, %5.1f%% of blocks dirty, %u of %u frames fully converted\n", TilesWorkloadNames[Workload], FullTime * 1000.0 / TILES_FRAMES, TilesTime * 1000.0 / TILES_FRAMES, DirtyTotal * 100.0 / (BlockCount * TILES_FRAMES), FullFrames, TILES_FRAMES);
+	}
+
+	Cpu_Free(Blocks);
+	Cpu_Free(Hashes[0]);
+	Cpu_Free(Hashes[1]);
+	Cpu_Free(Converter.TileY);
+	Cpu_Free(Converter.TileUV);
+	CpuConvert_Release(&Converter.Tile[0]);
+	CpuConvert_Release(&Converter.Tile[1]);
+	CpuConvert_Release(&Converter.Convert);
+	Cpu_Free(OutputY[0]);
+	Cpu_Free(OutputY[1]);
+	Cpu_Free(OutputUV[0]);
+	Cpu_Free(OutputUV[1]);
+	Cpu_Free(RefY);
+	Cpu_Free(RefUV);
+	Cpu_Free(Image);
+	Cpu_Free(Page);
+}
+
+int main(void)
+{
+	Tiles_TestNeighbors();
+	Tiles_TestPacking();
+	Tiles_TestFirstFrame();
+	Tiles_TestWorkloads();
+
+	return Test_Finish("test_cpu_tiles");
+}
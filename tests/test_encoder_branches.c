@@ -0,0 +1,288 @@
+// pipeline of Encoder with lower resolution branches, GPU work done with CPU kernels & sink writers replaced by mock encoders
+// every captured frame is cropped once to shared buffer slot, each output converts it to own NV12 buffer of same slot
+// slot is recycled only after encoders of all outputs have returned it, same as Encoder__VideoInvoke
+
+#include "test.h"
+#include "wcap_cpu_convert.h"
+#include "wcap_cpu_queue.h"
+#include "wcap_cpu_slots.h"
+
+#define BRANCHES_BUFFER_COUNT 8 // same as ENCODER_VIDEO_BUFFER_COUNT
+#define BRANCHES_MAX 2          // same as ENCODER_MAX_BRANCHES
+#define BRANCHES_OUTPUTS (1 + BRANCHES_MAX)
+#define BRANCHES_MAX_FRAMES 1024
+
+#define BRANCHES_CAPTURE_WIDTH 1300
+#define BRANCHES_CAPTURE_HEIGHT 740
+#define BRANCHES_CROP_X 10
+#define BRANCHES_CROP_Y 8
+#define BRANCHES_WIDTH 1280
+#define BRANCHES_HEIGHT 720
+
+// branch sizes, same as Encoder__GetOutputSize gives for 1280x720 input
+static const uint32_t BranchesSizes[BRANCHES_MAX][2] = { { 640, 360 }, { 426, 240 } };
+
+typedef struct
+{
+	uint32_t Slot;
+	uint32_t Frame;
+	uint64_t Checksum;
+}
+BranchesSample;
+
+typedef struct
+{
+	CpuResize Resize;    // only for branches
+	CpuConvert Convert;
+	CpuQueue Encoder;    // mock encoder, returns samples on its own thread like Media Foundation work queue
+	uint32_t Width;
+	uint32_t Height;
+	uint8_t* Y[BRANCHES_BUFFER_COUNT];
+	uint8_t* UV[BRANCHES_BUFFER_COUNT];
+	double Delay;        // seconds encoder holds every sample
+
+	// accessed only on encoder thread while running
+	uint32_t Frames[BRANCHES_MAX_FRAMES];
+	uint32_t FrameCount;
+	uint32_t ChecksumErrors;
+}
+BranchesOutput;
+
+typedef struct
+{
+	CpuSlots Available;  // slot users are outputs that have not returned sample yet
+	uint8_t* Input[BRANCHES_BUFFER_COUNT];
+	BranchesOutput Outputs[BRANCHES_OUTPUTS];
+	uint32_t OutputCount;
+	_Atomic(uint32_t) Owned[BRANCHES_BUFFER_COUNT]; // set from acquire until last output returns slot
+	_Atomic(uint32_t) Reused;
+	_Atomic(uint32_t) Recycled;
+}
+BranchesPipeline;
+
+static uint64_t Branches_Checksum(const BranchesOutput* Output, uint32_t Slot)
+{
+	uint64_t Sum = 0;
+	const uint8_t* Y = Output->Y[Slot];
+	for (size_t Index = 0; Index < (size_t)Output->Width * Output->Height; Index++)
+	{
+		Sum = Sum * 31 + Y[Index];
+	}
+	const uint8_t* UV = Output->UV[Slot];
+	for (size_t Index = 0; Index < (size_t)Output->Width * Output->Height / 2; Index++)
+	{
+		Sum = Sum * 31 + UV[Index];
+	}
+	return Sum;
+}
+
+static BranchesPipeline BranchesPipe;
+
+static void Branches_Return(BranchesPipeline* Pipeline, uint32_t Slot)
+{
+	// last output to return sample frees slot for next frame
+	if (CpuSlots_Done(&Pipeline->Available, Slot))
+	{
+		atomic_store(&Pipeline->Owned[Slot], 0);
+		atomic_fetch_add(&Pipeline->Recycled, 1);
+		CpuSlots_Recycle(&Pipeline->Available, Slot);
+	}
+}
+
+static void Branches_OnEncode(void* Context, void* Item)
+{
+	BranchesOutput* Output = Context;
+	BranchesSample* Sample = Item;
+
+	double Start = Test_Time();
+	while (Test_Time() - Start < Output->Delay)
+	{
+		Test_Yield();
+	}
+
+	// if slot would be reused before this encoder returned it, buffer would have newer frame
+	if (Branches_Checksum(Output, Sample->Slot) != Sample->Checksum)
+	{
+		Output->ChecksumErrors++;
+	}
+	if (Output->FrameCount < BRANCHES_MAX_FRAMES)
+	{
+		Output->Frames[Output->FrameCount++] = Sample->Frame;
+	}
+
+	Branches_Return(&BranchesPipe, Sample->Slot);
+}
+
+static void Branches_Capture(uint8_t* Capture, const uint8_t* Noise, uint32_t Frame)
+{
+	// every frame has different content, so checksum of each converted frame is different
+	uint8_t Add = (uint8_t)(Frame * 7);
+	for (size_t Index = 0; Index < (size_t)BRANCHES_CAPTURE_WIDTH * BRANCHES_CAPTURE_HEIGHT * 4; Index++)
+	{
+		Capture[Index] = Noise[Index] + Add;
+	}
+}
+
+static void Branches_Test(uint32_t BranchCount, double MainDelay, double BranchDelay, uint32_t FrameCount, double Period)
+{
+	BranchesPipeline* Pipeline = &BranchesPipe;
+	memset(Pipeline, 0, sizeof(*Pipeline));
+	Pipeline->OutputCount = 1 + BranchCount;
+
+	CpuSlots_Create(&Pipeline->Available, BRANCHES_BUFFER_COUNT);
+	for (uint32_t Slot = 0; Slot < BRANCHES_BUFFER_COUNT; Slot++)
+	{
+		Pipeline->Input[Slot] = Cpu_Alloc(BRANCHES_WIDTH * BRANCHES_HEIGHT * 4);
+	}
+
+	for (uint32_t OutputIndex = 0; OutputIndex < Pipeline->OutputCount; OutputIndex++)
+	{
+		BranchesOutput* Output = &Pipeline->Outputs[OutputIndex];
+		Output->Width = OutputIndex == 0 ? BRANCHES_WIDTH : BranchesSizes[OutputIndex - 1][0];
+		Output->Height = OutputIndex == 0 ? BRANCHES_HEIGHT : BranchesSizes[OutputIndex - 1][1];
+		Output->Delay = OutputIndex == 0 ? MainDelay : BranchDelay;
+
+		// main output is HD so BT.709, branches are smaller and use BT.601, same as Encoder__IsHD
+		YuvColorSpace ColorSpace = OutputIndex == 0 ? YuvColorSpace_BT709 : YuvColorSpace_BT601;
+		CpuConvert_Create(&Output->Convert, Output->Width, Output->Height, ColorSpace, CpuConvertFormat_NV12, false, false, CpuKernel_Auto);
+		if (OutputIndex != 0)
+		{
+			CpuResize_Create(&Output->Resize, BRANCHES_WIDTH, BRANCHES_HEIGHT, Output->Width, Output->Height, ResizeFilter_CatmullRom, false, CpuKernel_Auto, NULL);
+		}
+		for (uint32_t Slot = 0; Slot < BRANCHES_BUFFER_COUNT; Slot++)
+		{
+			Output->Y[Slot] = Cpu_Alloc((size_t)Output->Width * Output->Height);
+			Output->UV[Slot] = Cpu_Alloc((size_t)Output->Width * Output->Height / 2);
+		}
+		CpuQueue_Create(&Output->Encoder, BRANCHES_BUFFER_COUNT, sizeof(BranchesSample), &Branches_OnEncode, NULL, Output);
+	}
+
+	uint8_t* Noise = Cpu_Alloc(BRANCHES_CAPTURE_WIDTH * BRANCHES_CAPTURE_HEIGHT * 4);
+	uint8_t* Capture = Cpu_Alloc(BRANCHES_CAPTURE_WIDTH * BRANCHES_CAPTURE_HEIGHT * 4);
+	uint32_t Seed = 42;
+	for (size_t Index = 0; Index < (size_t)BRANCHES_CAPTURE_WIDTH * BRANCHES_CAPTURE_HEIGHT * 4; Index++)
+	{
+		Noise[Index] = (uint8_t)Test_Random(&Seed);
+	}
+
+	uint32_t Submitted[BRANCHES_MAX_FRAMES];
+	uint32_t SubmitCount = 0;
+	uint32_t Dropped = 0;
+	uint32_t PushFailed = 0;
+
+	double Next = Test_Time();
+	for (uint32_t Frame = 0; Frame < FrameCount; Frame++)
+	{
+		while (Test_Time() < Next)
+		{
+			Test_Yield();
+		}
+		Next += Period;
+
+		Branches_Capture(Capture, Noise, Frame);
+
+		// same as Encoder__AcquireVideoSample, frame is dropped when all buffers are in use by some encoder
+		uint32_t Slot;
+		if (!CpuSlots_TryAcquire(&Pipeline->Available, &Slot))
+		{
+			Dropped++;
+			continue;
+		}
+		if (atomic_exchange(&Pipeline->Owned[Slot], 1) != 0)
+		{
+			atomic_fetch_add(&Pipeline->Reused, 1);
+		}
+
+		// crop copy happens once for all outputs
+		uint8_t* Input = Pipeline->Input[Slot];
+		for (uint32_t Y = 0; Y < BRANCHES_HEIGHT; Y++)
+		{
+			memcpy(Input + (size_t)Y * BRANCHES_WIDTH * 4, Capture + ((size_t)(Y + BRANCHES_CROP_Y) * BRANCHES_CAPTURE_WIDTH + BRANCHES_CROP_X) * 4, BRANCHES_WIDTH * 4);
+		}
+
+		BranchesSample Samples[BRANCHES_OUTPUTS];
+		for (uint32_t OutputIndex = 0; OutputIndex < Pipeline->OutputCount; OutputIndex++)
+		{
+			BranchesOutput* Output = &Pipeline->Outputs[OutputIndex];
+			if (OutputIndex == 0)
+			{
+				CpuConvert_Run(&Output->Convert, Input, BRANCHES_WIDTH * 4, Output->Y[Slot], Output->Width, Output->UV[Slot], Output->Width);
+			}
+			else
+			{
+				CpuConvert_RunResize(&Output->Convert, &Output->Resize, Input, BRANCHES_WIDTH * 4, Output->Y[Slot], Output->Width, Output->UV[Slot], Output->Width);
+			}
+			Samples[OutputIndex] = (BranchesSample) { .Slot = Slot, .Frame = Frame, .Checksum = Branches_Checksum(Output, Slot) };
+		}
+
+		// must be set before first sample can be returned
+		CpuSlots_SetUsers(&Pipeline->Available, Slot, Pipeline->OutputCount);
+		for (uint32_t OutputIndex = 0; OutputIndex < Pipeline->OutputCount; OutputIndex++)
+		{
+			// encoder has at most one sample from every slot, so its queue cannot be full
+			PushFailed += !CpuQueue_Push(&Pipeline->Outputs[OutputIndex].Encoder, &Samples[OutputIndex]);
+		}
+		Submitted[SubmitCount++] = Frame;
+	}
+
+	// same as Encoder_Stop, all slots are acquired only after every encoder has returned its samples
+	for (uint32_t Slot = 0; Slot < BRANCHES_BUFFER_COUNT; Slot++)
+	{
+		CpuSlots_Acquire(&Pipeline->Available);
+	}
+
+	const char* Name = BranchCount == 0 ? "no branches" : BranchCount == 1 ? "1 branch" : "2 branches";
+	TEST_CHECK(PushFailed == 0, "%s: %u samples not accepted by mock encoder", Name, PushFailed);
+	TEST_CHECK(SubmitCount + Dropped == FrameCount, "%s: %u submitted + %u dropped of %u frames", Name, SubmitCount, Dropped, FrameCount);
+	TEST_CHECK(atomic_load(&Pipeline->Reused) == 0, "%s: %u slots acquired while some output still used them", Name, atomic_load(&Pipeline->Reused));
+	TEST_CHECK(atomic_load(&Pipeline->Recycled) == SubmitCount, "%s: %u slots recycled for %u submitted frames", Name, atomic_load(&Pipeline->Recycled), SubmitCount);
+
+	for (uint32_t OutputIndex = 0; OutputIndex < Pipeline->OutputCount; OutputIndex++)
+	{
+		BranchesOutput* Output = &Pipeline->Outputs[OutputIndex];
+		CpuQueue_Release(&Output->Encoder);
+
+		// every output gets exactly same frames, also when one of encoders is slower & frames are dropped
+		TEST_CHECK(Output->FrameCount == SubmitCount && memcmp(Output->Frames, Submitted, SubmitCount * sizeof(*Submitted)) == 0, "%s: output %u got %u frames, not same %u that were submitted", Name, OutputIndex, Output->FrameCount, SubmitCount);
+		TEST_CHECK(Output->ChecksumErrors == 0, "%s: output %u had %u samples overwritten before encoder returned them", Name, OutputIndex, Output->ChecksumErrors);
+
+		for (uint32_t Slot = 0; Slot < BRANCHES_BUFFER_COUNT; Slot++)
+		{
+			Cpu_Free(Output->Y[Slot]);
+			Cpu_Free(Output->UV[Slot]);
+		}
+		if (OutputIndex != 0)
+		{
+			CpuResize_Release(&Output->Resize);
+		}
+		CpuConvert_Release(&Output->Convert);
+	}
+
+	printf("  %-11s main encoder %4.1f ms, branch encoders %4.1f ms: %3u frames submitted, %3u dropped\n", Name, MainDelay * 1e3, BranchDelay * 1e3, SubmitCount, Dropped);
+
+	Cpu_Free(Capture);
+	Cpu_Free(Noise);
+	for (uint32_t Slot = 0; Slot < BRANCHES_BUFFER_COUNT; Slot++)
+	{
+		Cpu_Free(Pipeline->Input[Slot]);
+	}
+	CpuSlots_Release(&Pipeline->Available);
+}
+
+int main(void)
+{
+	for (uint32_t BranchCount = 0; BranchCount <= BRANCHES_MAX; BranchCount++)
+	{
+		// encoders keep up with capture
+		Branches_Test(BranchCount, 0.002, 0.001, 200, 0.008);
+		// main encoder is too slow, branches must drop same frames
+		Branches_Test(BranchCount, 0.030, 0.001, 200, 0.008);
+		// one of branch encoders is the slow one
+		if (BranchCount != 0)
+		{
+			Branches_Test(BranchCount, 0.001, 0.030, 200, 0.008);
+		}
+	}
+
+	return Test_Finish("test_encoder_branches");
+}
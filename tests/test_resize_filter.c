@@ -0,0 +1,763 @@
+// checks ResizeTable taps & weights of every filter against double precision reference, and compares resize with
+// precomputed tables against evaluating filter for every tap of every output pixel, same as ResizePass shader did before
+// then compares quality & speed of large downscales with integer reduction stage against single stage filter,
+// speed of both filter pass orders for typical capture shapes against order chosen by ResizePlan_Create,
+// and PSNR/SSIM of every filter against double precision Lanczos3 together with its throughput at 4K input
+
+#include "test.h"
+#include "wcap_cpu_resize.h"
+
+#include <math.h>
+
+// table uses float tap positions, at 8K input they are off by ~1e-4 of output pixel from double reference
+#define FILTER_WEIGHT_TOLERANCE 2.5e-4
+
+static const char* FilterNames[] = { "Bilinear", "Area", "CatmullRom", "Mitchell", "Lanczos3" };
+#define FILTER_COUNT (sizeof(FilterNames) / sizeof(*FilterNames))
+
+static void Filter_Fill(uint8_t* Image, uint32_t Width, uint32_t Height, uint32_t Seed)
+{
+	// noise on top of gradient, so both smooth areas & sharp edges are covered
+	uint32_t State = Seed;
+	for (uint32_t Y = 0; Y < Height; Y++)
+	{
+		for (uint32_t X = 0; X < Width; X++)
+		{
+			uint8_t* Pixel = Image + ((size_t)Y * Width + X) * 4;
+			uint32_t Noise = Test_Random(&State);
+			Pixel[0] = (uint8_t)(X * 255 / Width) ^ (uint8_t)(Noise & 0x1f);
+			Pixel[1] = (uint8_t)(Y * 255 / Height);
+			Pixel[2] = (uint8_t)(Noise >> 8);
+			Pixel[3] = (uint8_t)(Noise >> 16);
+		}
+	}
+}
+
+// reference
+
+static double Filter_Cubic(double X, double B, double C)
+{
+	X = fabs(X);
+	if (X < 1)
+	{
+		return ((12 - 9 * B - 6 * C) * X * X * X + (-18 + 12 * B + 6 * C) * X * X + (6 - 2 * B)) / 6;
+	}
+	else if (X < 2)
+	{
+		return ((-B - 6 * C) * X * X * X + (6 * B + 30 * C) * X * X + (-12 * B - 48 * C) * X + (8 * B + 24 * C)) / 6;
+	}
+	return 0;
+}
+
+static double Filter_Reference(ResizeFilter Filter, double X, double Scale)
+{
+	// X is distance in output pixels, Scale is size of input pixel in output pixels
+	const double Pi = 3.14159265358979323846;
+	switch (Filter)
+	{
+	case ResizeFilter_Bilinear:   return fabs(X) < 1 ? 1 - fabs(X) : 0;
+	case ResizeFilter_Area:       return fmax(0, fmin(X + 0.5 * Scale, 0.5) - fmax(X - 0.5 * Scale, -0.5));
+	case ResizeFilter_CatmullRom: return Filter_Cubic(X, 0, 0.5);
+	case ResizeFilter_Mitchell:   return Filter_Cubic(X, 1.0 / 3, 1.0 / 3);
+	case ResizeFilter_Lanczos3:   return X == 0 ? 1 : fabs(X) < 3 ? 3 * sin(Pi * X) * sin(Pi * X / 3) / (Pi * Pi * X * X) : 0;
+	default:                      return 0;
+	}
+}
+
+static void Filter_TestTable(uint32_t InputSize, uint32_t OutputSize, ResizeFilter Filter)
+{
+	// weight of every input pixel for every output pixel, taps outside of table must have zero reference weight
+	// only downscales are checked, for upscale filters are not stretched & window can miss input pixels
+	ResizeTable Table;
+	ResizeTable_Create(&Table, InputSize, OutputSize, Filter);
+
+	double* Reference = Cpu_Alloc(InputSize * sizeof(double));
+	double Scale = (double)OutputSize / InputSize;
+
+	double MaxError = 0;
+	uint32_t BadTaps = 0;
+	uint32_t BadSums = 0;
+	for (uint32_t Index = 0; Index < OutputSize; Index++)
+	{
+		double Center = Index + 0.5;
+		double Sum = 0;
+		for (uint32_t Pos = 0; Pos < InputSize; Pos++)
+		{
+			Reference[Pos] = Filter_Reference(Filter, Center - (Pos + 0.5) * Scale, Scale);
+			Sum += Reference[Pos];
+		}
+
+		uint32_t Start = Table.Start[Index];
+		const float* Weights = Table.Weights + Index * Table.TapCount;
+		BadTaps += Start + Table.TapCount > InputSize;
+
+		double WeightSum = 0;
+		for (uint32_t Pos = 0; Pos < InputSize; Pos++)
+		{
+			double Expected = Sum == 0 ? 0 : Reference[Pos] / Sum;
+			double Weight = Pos >= Start && Pos < Start + Table.TapCount ? Weights[Pos - Start] : 0;
+			double Error = fabs(Expected - Weight);
+			MaxError = Error > MaxError ? Error : MaxError;
+			WeightSum += Weight;
+		}
+		BadSums += fabs(WeightSum - 1) > FILTER_WEIGHT_TOLERANCE;
+	}
+
+	TEST_CHECK(MaxError <= FILTER_WEIGHT_TOLERANCE, "%u -> %u %s max weight error %g", InputSize, OutputSize, FilterNames[Filter], MaxError);
+	TEST_CHECK(BadTaps == 0 && BadSums == 0, "%u -> %u %s %u outputs with taps outside of input, %u with weights not adding up to 1", InputSize, OutputSize, FilterNames[Filter], BadTaps, BadSums);
+
+	Cpu_Free(Reference);
+	ResizeTable_Release(&Table);
+}
+
+static void Filter_TestTables(void)
+{
+	static const uint32_t Sizes[][2] =
+	{
+		{ 1920, 1280 },
+		{ 3840, 1920 },
+		{ 7680, 2560 },
+		{ 7680,  640 }, // large ratio, many taps
+		{ 1000,  999 }, // almost same size
+		{  333,  102 }, // odd sizes
+		{   64,    2 },
+		{    5,    1 },
+	};
+
+	for (uint32_t SizeIndex = 0; SizeIndex < sizeof(Sizes) / sizeof(*Sizes); SizeIndex++)
+	{
+		for (uint32_t Filter = 0; Filter < FILTER_COUNT; Filter++)
+		{
+			Filter_TestTable(Sizes[SizeIndex][0], Sizes[SizeIndex][1], (ResizeFilter)Filter);
+		}
+	}
+}
+
+// filter evaluated for every tap, same loops as ResizePass shader without precomputed tables
+
+static float Filter_Evaluate(ResizeFilter Filter, float X, float Scale)
+{
+	switch (Filter)
+	{
+	case ResizeFilter_Bilinear:   return ResizeFilter__Bilinear(X, Scale);
+	case ResizeFilter_Area:       return ResizeFilter__Area(X, Scale);
+	case ResizeFilter_CatmullRom: return ResizeFilter__CatmullRom(X, Scale);
+	case ResizeFilter_Mitchell:   return ResizeFilter__Mitchell(X, Scale);
+	case ResizeFilter_Lanczos3:   return ResizeFilter__Lanczos3(X, Scale);
+	default:                      return 0;
+	}
+}
+
+static void Filter_PixelPerTap(ResizeFilter Filter, const uint8_t* Src, size_t TapStep, uint32_t InputSize, uint8_t* Out, uint32_t Index, float Scale, float Size)
+{
+	// window & weights are calculated for every output pixel, same as shader did
+	float Center = Index + 0.5f;
+
+	uint32_t Start, End;
+	ResizeFilter__Window(Center / Scale, Size, InputSize, &Start, &End);
+
+	const uint8_t* Pixel = Src + Start * TapStep;
+
+	float Sum[3] = { 0, 0, 0 };
+	float WeightSum = 0;
+	for (uint32_t Pos = Start; Pos < End; Pos++, Pixel += TapStep)
+	{
+		float Weight = Filter_Evaluate(Filter, Center - (Pos + 0.5f) * Scale, Scale);
+		Sum[0] += Weight * Pixel[0];
+		Sum[1] += Weight * Pixel[1];
+		Sum[2] += Weight * Pixel[2];
+		WeightSum += Weight;
+	}
+
+	for (int Channel = 0; Channel < 3; Channel++)
+	{
+		float Value = WeightSum == 0 ? 0 : Sum[Channel] / WeightSum;
+		Value = Value > 0.f ? Value : 0.f;
+		Value = Value < 255.f ? Value : 255.f;
+		Out[Channel] = (uint8_t)(Value + 0.5f);
+	}
+	Out[3] = 0;
+}
+
+static void Filter_PassPerTap(ResizeFilter Filter, const uint8_t* Src, size_t SrcPitch, uint32_t InputSize, uint8_t* Dst, size_t DstPitch, uint32_t OutputSize, uint32_t Count, bool Vertical)
+{
+	// Count is number of rows for horizontal pass, or columns for vertical pass, both passes go over rows in memory order
+	float Scale = (float)OutputSize / InputSize;
+	float Size = ResizeFilter__Support(Filter, Scale) / Scale;
+
+	if (Vertical)
+	{
+		for (uint32_t Y = 0; Y < OutputSize; Y++)
+		{
+			for (uint32_t X = 0; X < Count; X++)
+			{
+				Filter_PixelPerTap(Filter, Src + X * 4, SrcPitch, InputSize, Dst + Y * DstPitch + X * 4, Y, Scale, Size);
+			}
+		}
+	}
+	else
+	{
+		for (uint32_t Y = 0; Y < Count; Y++)
+		{
+			for (uint32_t X = 0; X < OutputSize; X++)
+			{
+				Filter_PixelPerTap(Filter, Src + Y * SrcPitch, 4, InputSize, Dst + Y * DstPitch + X * 4, X, Scale, Size);
+			}
+		}
+	}
+}
+
+static void Filter_ResizePerTap(const ResizePlan* Plan, const uint8_t* Input, uint8_t* Middle, uint8_t* Output)
+{
+	// no integer reduction, same pass order as plan
+	uint32_t InputWidth = Plan->InputWidth;
+	uint32_t InputHeight = Plan->InputHeight;
+	uint32_t OutputWidth = Plan->OutputWidth;
+	uint32_t OutputHeight = Plan->OutputHeight;
+
+	if (Plan->VerticalFirst)
+	{
+		Filter_PassPerTap(Plan->Filter, Input, InputWidth * 4, InputHeight, Middle, InputWidth * 4, OutputHeight, InputWidth, true);
+		Filter_PassPerTap(Plan->Filter, Middle, InputWidth * 4, InputWidth, Output, OutputWidth * 4, OutputWidth, OutputHeight, false);
+	}
+	else
+	{
+		Filter_PassPerTap(Plan->Filter, Input, InputWidth * 4, InputWidth, Middle, OutputWidth * 4, OutputWidth, InputHeight, false);
+		Filter_PassPerTap(Plan->Filter, Middle, OutputWidth * 4, InputHeight, Output, OutputWidth * 4, OutputHeight, OutputWidth, true);
+	}
+}
+
+static void Filter_BenchmarkTables(void)
+{
+	static const uint32_t Sizes[][4] =
+	{
+		{ 3840, 2160, 1920, 1080 },
+		{ 7680, 4320, 2560, 1440 },
+	};
+
+	printf("Mitchell resize on one thread with scalar kernel, ms per frame\n");
+	printf("  %-22s %10s %10s %10s %10s\n", "size", "per tap", "tables", "speedup", "create");
+	for (uint32_t SizeIndex = 0; SizeIndex < sizeof(Sizes) / sizeof(*Sizes); SizeIndex++)
+	{
+		uint32_t InputWidth = Sizes[SizeIndex][0];
+		uint32_t InputHeight = Sizes[SizeIndex][1];
+		uint32_t OutputWidth = Sizes[SizeIndex][2];
+		uint32_t OutputHeight = Sizes[SizeIndex][3];
+
+		uint8_t* Input = Cpu_Alloc((size_t)InputWidth * InputHeight * 4);
+		uint8_t* Middle = Cpu_Alloc((size_t)InputWidth * InputHeight * 4);
+		uint8_t* Output = Cpu_Alloc((size_t)OutputWidth * OutputHeight * 4);
+		uint8_t* Ref = Cpu_Alloc((size_t)OutputWidth * OutputHeight * 4);
+		Filter_Fill(Input, InputWidth, InputHeight, 1);
+
+		// tables are created once for whole recording
+		uint32_t CreateCount = 0;
+		double Start = Test_Time();
+		double CreateTime;
+		do
+		{
+			CpuResize Resize;
+			CpuResize_Create(&Resize, InputWidth, InputHeight, OutputWidth, OutputHeight, ResizeFilter_Mitchell, false, CpuKernel_Scalar, NULL);
+			CpuResize_Release(&Resize);
+			CreateCount++;
+			CreateTime = Test_Time() - Start;
+		}
+		while (CreateTime < 0.1);
+
+		CpuResize Resize;
+		CpuResize_Create(&Resize, InputWidth, InputHeight, OutputWidth, OutputHeight, ResizeFilter_Mitchell, false, CpuKernel_Scalar, NULL);
+		TEST_CHECK(Resize.Plan.ReduceX == 1 && Resize.Plan.ReduceY == 1, "%ux%u -> %ux%u must not use integer reduction", InputWidth, InputHeight, OutputWidth, OutputHeight);
+
+		uint32_t TapCount = 0;
+		Start = Test_Time();
+		double TapTime;
+		do
+		{
+			Filter_ResizePerTap(&Resize.Plan, Input, Middle, Ref);
+			TapCount++;
+			TapTime = Test_Time() - Start;
+		}
+		while (TapTime < 0.1);
+
+		uint32_t TableCount = 0;
+		Start = Test_Time();
+		double TableTime;
+		do
+		{
+			CpuResize_Run(&Resize, Input, InputWidth * 4, Output, OutputWidth * 4);
+			TableCount++;
+			TableTime = Test_Time() - Start;
+		}
+		while (TableTime < 0.1);
+
+		// same weights & rounding of middle image, only order of summation differs
+		uint32_t MaxDiff = 0;
+		for (size_t Index = 0; Index < (size_t)OutputWidth * OutputHeight * 4; Index++)
+		{
+			uint32_t Diff = (uint32_t)abs((int)Ref[Index] - (int)Output[Index]);
+			MaxDiff = Diff > MaxDiff ? Diff : MaxDiff;
+		}
+		TEST_CHECK(MaxDiff <= 1, "%ux%u -> %ux%u tables differ from per tap filter by %u", InputWidth, InputHeight, OutputWidth, OutputHeight, MaxDiff);
+
+		char Name[64];
+		snprintf(Name, sizeof(Name), "%ux%u -> %ux%u", InputWidth, InputHeight, OutputWidth, OutputHeight);
+		printf("  %-22s %10.2f %10.2f %9.2fx %10.3f\n", Name, TapTime * 1000.0 / TapCount, TableTime * 1000.0 / TableCount, (TapTime / TapCount) / (TableTime / TableCount), CreateTime * 1000.0 / CreateCount);
+
+		CpuResize_Release(&Resize);
+		Cpu_Free(Input);
+		Cpu_Free(Middle);
+		Cpu_Free(Output);
+		Cpu_Free(Ref);
+	}
+}
+
+// multi-stage downscale
+
+static double Filter_Psnr(const uint8_t* Ref, const uint8_t* Out, uint32_t Width, uint32_t Height)
+{
+	// over BGR channels, alpha is 0 in both
+	double Sum = 0;
+	for (size_t Index = 0; Index < (size_t)Width * Height; Index++)
+	{
+		for (uint32_t Channel = 0; Channel < 3; Channel++)
+		{
+			double Diff = (double)Ref[Index * 4 + Channel] - Out[Index * 4 + Channel];
+			Sum += Diff * Diff;
+		}
+	}
+	double Mse = Sum / ((double)Width * Height * 3);
+	return Mse == 0 ? 99.0 : 10.0 * log10(255.0 * 255.0 / Mse);
+}
+
+static double Filter_Time(CpuResize* Resize, const uint8_t* Input, uint8_t* Output)
+{
+	// ms per frame
+	uint32_t Count = 0;
+	double Start = Test_Time();
+	double Elapsed;
+	do
+	{
+		CpuResize_Run(Resize, Input, Resize->InputWidth * 4, Output, Resize->OutputWidth * 4);
+		Count++;
+		Elapsed = Test_Time() - Start;
+	}
+	while (Elapsed < 0.1);
+
+	return Elapsed * 1000.0 / Count;
+}
+
+static void Filter_TestReduce(void)
+{
+	// integer box reduction followed by filter with few taps, against filter over whole input with many taps
+	static const uint32_t Sizes[][4] =
+	{
+		{ 7680, 4320,  640,  360 },
+		{ 3840, 2160,  320,  180 },
+		{ 5120, 1440, 1280,  360 },
+		{ 2560, 1600,  400,  250 },
+	};
+
+	// noise in input aliases differently with box reduction, smooth content must be almost same
+	static const double MinPsnr[] = { 38.0, 50.0 };
+
+	printf("Mitchell downscale with integer reduction against single stage, ms per frame on one thread\n");
+	printf("  %-22s %7s %9s %9s %9s %9s %8s\n", "size", "reduce", "taps", "single", "multi", "PSNR", "smooth");
+	for (uint32_t SizeIndex = 0; SizeIndex < sizeof(Sizes) / sizeof(*Sizes); SizeIndex++)
+	{
+		uint32_t InputWidth = Sizes[SizeIndex][0];
+		uint32_t InputHeight = Sizes[SizeIndex][1];
+		uint32_t OutputWidth = Sizes[SizeIndex][2];
+		uint32_t OutputHeight = Sizes[SizeIndex][3];
+
+		uint8_t* Input = Cpu_Alloc((size_t)InputWidth * InputHeight * 4);
+		uint8_t* Single = Cpu_Alloc((size_t)OutputWidth * OutputHeight * 4);
+		uint8_t* Multi = Cpu_Alloc((size_t)OutputWidth * OutputHeight * 4);
+
+		ResizePlan Plan, SinglePlan, Vertical;
+		ResizePlan_Create(&Plan, InputWidth, InputHeight, OutputWidth, OutputHeight, ResizeFilter_Mitchell);
+		ResizePlan_CreateFixed(&SinglePlan, InputWidth, InputHeight, OutputWidth, OutputHeight, ResizeFilter_Mitchell, 1, 1, false);
+		ResizePlan_CreateFixed(&Vertical, InputWidth, InputHeight, OutputWidth, OutputHeight, ResizeFilter_Mitchell, 1, 1, true);
+		if (Vertical.Cost < SinglePlan.Cost)
+		{
+			SinglePlan = Vertical;
+		}
+		TEST_CHECK(Plan.ReduceX > 1 && Plan.ReduceY > 1, "%ux%u -> %ux%u must use integer reduction", InputWidth, InputHeight, OutputWidth, OutputHeight);
+
+		CpuResize SingleResize, MultiResize;
+		CpuResize_CreatePlan(&SingleResize, &SinglePlan, false, CpuKernel_Auto, NULL);
+		CpuResize_CreatePlan(&MultiResize, &Plan, false, CpuKernel_Auto, NULL);
+
+		double Psnr[2];
+		for (uint32_t Smooth = 0; Smooth < 2; Smooth++)
+		{
+			Filter_Fill(Input, InputWidth, InputHeight, 1);
+			if (Smooth)
+			{
+				// only gradients
+				for (size_t Index = 0; Index < (size_t)InputWidth * InputHeight; Index++)
+				{
+					Input[Index * 4 + 0] = Input[Index * 4 + 1] ^ 0x55;
+					Input[Index * 4 + 2] = Input[Index * 4 + 1];
+				}
+			}
+
+			CpuResize_Run(&SingleResize, Input, InputWidth * 4, Single, OutputWidth * 4);
+			CpuResize_Run(&MultiResize, Input, InputWidth * 4, Multi, OutputWidth * 4);
+			Psnr[Smooth] = Filter_Psnr(Single, Multi, OutputWidth, OutputHeight);
+			TEST_CHECK(Psnr[Smooth] >= MinPsnr[Smooth], "%ux%u -> %ux%u %s PSNR of multi-stage against single stage %.2f dB", InputWidth, InputHeight, OutputWidth, OutputHeight, Smooth ? "smooth" : "noise", Psnr[Smooth]);
+		}
+
+		double SingleTime = Filter_Time(&SingleResize, Input, Single);
+		double MultiTime = Filter_Time(&MultiResize, Input, Multi);
+
+		char Name[64], Reduce[16], Taps[16];
+		snprintf(Name, sizeof(Name), "%ux%u -> %ux%u", InputWidth, InputHeight, OutputWidth, OutputHeight);
+		snprintf(Reduce, sizeof(Reduce), "%ux%u", Plan.ReduceX, Plan.ReduceY);
+		snprintf(Taps, sizeof(Taps), "%u -> %u", SinglePlan.TapCountH + SinglePlan.TapCountV, Plan.TapCountH + Plan.TapCountV);
+		printf("  %-22s %7s %9s %9.2f %9.2f %9.2f %8.2f\n", Name, Reduce, Taps, SingleTime, MultiTime, Psnr[0], Psnr[1]);
+
+		CpuResize_Release(&SingleResize);
+		CpuResize_Release(&MultiResize);
+		Cpu_Free(Input);
+		Cpu_Free(Single);
+		Cpu_Free(Multi);
+	}
+}
+
+// pass order
+
+static void Filter_BenchmarkOrder(void)
+{
+	// typical monitor, window & region captures, some with very different scale factors in two directions
+	static const struct { const char* Name; uint32_t Size[4]; } Shapes[] =
+	{
+		{ "1080p monitor",   { 1920, 1080, 1280,  720 } },
+		{ "1440p monitor",   { 2560, 1440, 1920, 1080 } },
+		{ "4K monitor",      { 3840, 2160, 1920, 1080 } },
+		{ "portrait",        { 1080, 1920,  720, 1280 } },
+		{ "ultrawide",       { 5120, 1440, 2560, 1080 } },
+		{ "window",          { 1283,  971,  640,  480 } },
+		{ "tall region",     {  600, 2000,  580,  400 } },
+		{ "wide region",     { 3000,  400, 1000,  390 } },
+	};
+
+	printf("Lanczos3 filter passes in both orders, ms per frame on one thread, saved time is against horizontal pass first\n");
+	printf("  %-14s %-22s %9s %9s %7s %11s %8s\n", "shape", "size", "H first", "V first", "chosen", "middle", "saved");
+	for (uint32_t ShapeIndex = 0; ShapeIndex < sizeof(Shapes) / sizeof(*Shapes); ShapeIndex++)
+	{
+		const uint32_t* Size = Shapes[ShapeIndex].Size;
+
+		ResizePlan Plan, Plans[2];
+		ResizePlan_Create(&Plan, Size[0], Size[1], Size[2], Size[3], ResizeFilter_Lanczos3);
+		ResizePlan_CreateFixed(&Plans[0], Size[0], Size[1], Size[2], Size[3], ResizeFilter_Lanczos3, Plan.ReduceX, Plan.ReduceY, false);
+		ResizePlan_CreateFixed(&Plans[1], Size[0], Size[1], Size[2], Size[3], ResizeFilter_Lanczos3, Plan.ReduceX, Plan.ReduceY, true);
+
+		const ResizePlan* Cheaper = &Plans[Plans[1].Cost <= Plans[0].Cost];
+		TEST_CHECK(Plan.VerticalFirst == Cheaper->VerticalFirst && Plan.Cost == Cheaper->Cost, "%s: plan is not cheaper of two orders", Shapes[ShapeIndex].Name);
+
+		uint8_t* Input = Cpu_Alloc((size_t)Size[0] * Size[1] * 4);
+		uint8_t* Output[2] = { Cpu_Alloc((size_t)Size[2] * Size[3] * 4), Cpu_Alloc((size_t)Size[2] * Size[3] * 4) };
+		Filter_Fill(Input, Size[0], Size[1], 1);
+
+		CpuResize Resize[2];
+		CpuResize_CreatePlan(&Resize[0], &Plans[0], false, CpuKernel_Auto, NULL);
+		CpuResize_CreatePlan(&Resize[1], &Plans[1], false, CpuKernel_Auto, NULL);
+
+		// orders take turns & best time is kept, so other load on machine affects both same way
+		double Time[2] = { 1e9, 1e9 };
+		for (uint32_t Round = 0; Round < 3; Round++)
+		{
+			for (uint32_t Order = 0; Order < 2; Order++)
+			{
+				double OrderTime = Filter_Time(&Resize[Order], Input, Output[Order]);
+				Time[Order] = OrderTime < Time[Order] ? OrderTime : Time[Order];
+			}
+		}
+
+		CpuResize_Release(&Resize[0]);
+		CpuResize_Release(&Resize[1]);
+
+		// only rounding of middle image differs
+		double Psnr = Filter_Psnr(Output[0], Output[1], Size[2], Size[3]);
+		TEST_CHECK(Psnr >= 45.0, "%s: PSNR between pass orders %.2f dB", Shapes[ShapeIndex].Name, Psnr);
+
+		char Name[64], Middle[16];
+		snprintf(Name, sizeof(Name), "%ux%u -> %ux%u", Size[0], Size[1], Size[2], Size[3]);
+		snprintf(Middle, sizeof(Middle), "%ux%u", Plan.MiddleWidth, Plan.MiddleHeight);
+		printf("  %-14s %-22s %9.2f %9.2f %7s %11s %7.1f%%\n", Shapes[ShapeIndex].Name, Name, Time[0], Time[1], Plan.VerticalFirst ? "V" : "H", Middle, (Time[0] - Time[Plan.VerticalFirst]) * 100.0 / Time[0]);
+
+		Cpu_Free(Input);
+		Cpu_Free(Output[0]);
+		Cpu_Free(Output[1]);
+	}
+}
+
+// kernel quality
+
+static void Filter_FillScreen(uint8_t* Image, uint32_t Width, uint32_t Height, uint32_t Seed)
+{
+	// typical desktop, text in left third, gradient in middle & photo-like noise in right third
+	uint32_t State = Seed;
+	for (uint32_t Y = 0; Y < Height; Y++)
+	{
+		for (uint32_t X = 0; X < Width; X++)
+		{
+			uint8_t* Pixel = Image + ((size_t)Y * Width + X) * 4;
+			uint32_t Noise = Test_Random(&State);
+			if (X < Width / 3)
+			{
+				// 6x12 glyph cells with random 1 pixel strokes, dark on light
+				uint32_t CellX = X % 6;
+				uint32_t CellY = Y % 12;
+				bool Ink = CellX < 5 && CellY >= 2 && CellY < 10 && (Noise & 3) == 0;
+				Pixel[0] = Pixel[1] = Pixel[2] = Ink ? 0x20 : 0xf0;
+			}
+			else if (X < Width * 2 / 3)
+			{
+				Pixel[0] = (uint8_t)(X * 255 / Width);
+				Pixel[1] = (uint8_t)(Y * 255 / Height);
+				Pixel[2] = (uint8_t)((X + Y) * 255 / (Width + Height));
+			}
+			else
+			{
+				// small noise over smooth color, like camera image
+				Pixel[0] = (uint8_t)(0x40 + (Y * 128 / Height) + (Noise & 0xf));
+				Pixel[1] = (uint8_t)(0x60 + (X * 64 / Width) + ((Noise >> 4) & 0xf));
+				Pixel[2] = (uint8_t)(0x80 + ((Noise >> 8) & 0x1f));
+			}
+			Pixel[3] = 0;
+		}
+	}
+}
+
+static void Filter_ResizeReference(ResizeFilter Filter, const uint8_t* Input, uint32_t InputWidth, uint32_t InputHeight, double* Output, uint32_t OutputWidth, uint32_t OutputHeight)
+{
+	// separable resize in double precision without rounding between passes, Output has 3 values per pixel
+	// every output pixel sums whole filter support, weights are normalized same way as in table
+	uint32_t InputSize[] = { InputWidth, InputHeight };
+	uint32_t OutputSize[] = { OutputWidth, OutputHeight };
+
+	uint32_t* Start[2];
+	uint32_t* Count[2];
+	double* Weights[2];
+	uint32_t MaxCount[2];
+	for (uint32_t Pass = 0; Pass < 2; Pass++)
+	{
+		double Scale = (double)OutputSize[Pass] / InputSize[Pass];
+		double Size = ResizeFilter__Support(Filter, (float)Scale) / Scale + 1;
+
+		MaxCount[Pass] = (uint32_t)(2 * Size) + 2;
+		Start[Pass] = Cpu_Alloc(OutputSize[Pass] * sizeof(uint32_t));
+		Count[Pass] = Cpu_Alloc(OutputSize[Pass] * sizeof(uint32_t));
+		Weights[Pass] = Cpu_Alloc((size_t)OutputSize[Pass] * MaxCount[Pass] * sizeof(double));
+
+		for (uint32_t Index = 0; Index < OutputSize[Pass]; Index++)
+		{
+			double Center = (Index + 0.5) / Scale - 0.5;
+			int32_t First = (int32_t)floor(Center - Size);
+			int32_t Last = (int32_t)ceil(Center + Size);
+			First = First < 0 ? 0 : First;
+			Last = Last > (int32_t)InputSize[Pass] - 1 ? (int32_t)InputSize[Pass] - 1 : Last;
+
+			double* Weight = Weights[Pass] + (size_t)Index * MaxCount[Pass];
+			double Sum = 0;
+			for (int32_t Pos = First; Pos <= Last; Pos++)
+			{
+				Weight[Pos - First] = Filter_Reference(Filter, Index + 0.5 - (Pos + 0.5) * Scale, Scale);
+				Sum += Weight[Pos - First];
+			}
+			for (int32_t Pos = First; Pos <= Last; Pos++)
+			{
+				Weight[Pos - First] /= Sum;
+			}
+			Start[Pass][Index] = (uint32_t)First;
+			Count[Pass][Index] = (uint32_t)(Last - First + 1);
+		}
+	}
+
+	// one channel at a time, so middle image is not too large
+	double* Middle = Cpu_Alloc((size_t)OutputWidth * InputHeight * sizeof(double));
+	for (uint32_t Channel = 0; Channel < 3; Channel++)
+	{
+		for (uint32_t Y = 0; Y < InputHeight; Y++)
+		{
+			const uint8_t* Row = Input + (size_t)Y * InputWidth * 4 + Channel;
+			for (uint32_t X = 0; X < OutputWidth; X++)
+			{
+				const uint8_t* Src = Row + (size_t)Start[0][X] * 4;
+				const double* Weight = Weights[0] + (size_t)X * MaxCount[0];
+				double Sum = 0;
+				for (uint32_t Tap = 0; Tap < Count[0][X]; Tap++)
+				{
+					Sum += Src[Tap * 4] * Weight[Tap];
+				}
+				Middle[(size_t)Y * OutputWidth + X] = Sum;
+			}
+		}
+
+		for (uint32_t Y = 0; Y < OutputHeight; Y++)
+		{
+			const double* Src = Middle + (size_t)Start[1][Y] * OutputWidth;
+			const double* Weight = Weights[1] + (size_t)Y * MaxCount[1];
+			for (uint32_t X = 0; X < OutputWidth; X++)
+			{
+				double Sum = 0;
+				for (uint32_t Tap = 0; Tap < Count[1][Y]; Tap++)
+				{
+					Sum += Src[(size_t)Tap * OutputWidth + X] * Weight[Tap];
+				}
+				Output[((size_t)Y * OutputWidth + X) * 3 + Channel] = Sum;
+			}
+		}
+	}
+	Cpu_Free(Middle);
+
+	for (uint32_t Pass = 0; Pass < 2; Pass++)
+	{
+		Cpu_Free(Start[Pass]);
+		Cpu_Free(Count[Pass]);
+		Cpu_Free(Weights[Pass]);
+	}
+}
+
+static double Filter_PsnrReference(const double* Ref, const uint8_t* Out, uint32_t Width, uint32_t Height)
+{
+	// over BGR channels, reference is clamped to 8-bit range but not rounded
+	double Sum = 0;
+	for (size_t Index = 0; Index < (size_t)Width * Height; Index++)
+	{
+		for (uint32_t Channel = 0; Channel < 3; Channel++)
+		{
+			double Value = fmin(fmax(Ref[Index * 3 + Channel], 0), 255);
+			double Diff = Value - Out[Index * 4 + Channel];
+			Sum += Diff * Diff;
+		}
+	}
+	double Mse = Sum / ((double)Width * Height * 3);
+	return Mse == 0 ? 99.0 : 10.0 * log10(255.0 * 255.0 / Mse);
+}
+
+static double Filter_SsimReference(const double* Ref, const uint8_t* Out, uint32_t Width, uint32_t Height)
+{
+	// mean SSIM of luma over 8x8 windows placed every 4 pixels, without gaussian weighting
+	const double C1 = (0.01 * 255) * (0.01 * 255);
+	const double C2 = (0.03 * 255) * (0.03 * 255);
+
+	double Total = 0;
+	uint32_t WindowCount = 0;
+	for (uint32_t WindowY = 0; WindowY + 8 <= Height; WindowY += 4)
+	{
+		for (uint32_t WindowX = 0; WindowX + 8 <= Width; WindowX += 4)
+		{
+			double SumA = 0, SumB = 0, SumAA = 0, SumBB = 0, SumAB = 0;
+			for (uint32_t Y = WindowY; Y < WindowY + 8; Y++)
+			{
+				for (uint32_t X = WindowX; X < WindowX + 8; X++)
+				{
+					size_t Index = (size_t)Y * Width + X;
+					const double* A = Ref + Index * 3;
+					const uint8_t* B = Out + Index * 4;
+
+					// BT.709 luma of BGR pixel
+					double LumaA = 0.0722 * fmin(fmax(A[0], 0), 255) + 0.7152 * fmin(fmax(A[1], 0), 255) + 0.2126 * fmin(fmax(A[2], 0), 255);
+					double LumaB = 0.0722 * B[0] + 0.7152 * B[1] + 0.2126 * B[2];
+					SumA += LumaA;
+					SumB += LumaB;
+					SumAA += LumaA * LumaA;
+					SumBB += LumaB * LumaB;
+					SumAB += LumaA * LumaB;
+				}
+			}
+
+			double MeanA = SumA / 64;
+			double MeanB = SumB / 64;
+			double VarA = SumAA / 64 - MeanA * MeanA;
+			double VarB = SumBB / 64 - MeanB * MeanB;
+			double Covar = SumAB / 64 - MeanA * MeanB;
+			Total += (2 * MeanA * MeanB + C1) * (2 * Covar + C2) / ((MeanA * MeanA + MeanB * MeanB + C1) * (VarA + VarB + C2));
+			WindowCount++;
+		}
+	}
+	return Total / WindowCount;
+}
+
+static void Filter_BenchmarkQuality(void)
+{
+	// quality of every filter against double precision Lanczos3 of same input, with throughput of CpuResize
+	// so cheapest filter that is good enough for recording 4K monitor at 60 fps can be picked
+	// own column is PSNR against double precision reference of same filter, that is precision of tables & 8-bit middle image
+	static const uint32_t Sizes[][4] =
+	{
+		{ 3840, 2160, 1920, 1080 },
+		{ 3840, 2160, 2560, 1440 },
+	};
+
+	// blurrier filters move further away from Lanczos3, but structure of text & edges must stay same
+	static const double MinPsnr[FILTER_COUNT] = { 26.0, 26.0, 30.0, 30.0, 48.0 };
+	static const double MinSsim = 0.95;
+	static const double MinOwnPsnr = 48.0;
+
+	CpuPool Pool;
+	CpuPool_Create(&Pool, 0);
+
+	printf("filters against double precision Lanczos3 on desktop content, ms per frame on one thread & fps on pool with %u threads\n", Cpu_GetProcessorCount());
+	printf("  %-22s %-10s %9s %9s %9s %8s %9s\n", "size", "filter", "single", "fps", "PSNR", "SSIM", "own");
+	for (uint32_t SizeIndex = 0; SizeIndex < sizeof(Sizes) / sizeof(*Sizes); SizeIndex++)
+	{
+		uint32_t InputWidth = Sizes[SizeIndex][0];
+		uint32_t InputHeight = Sizes[SizeIndex][1];
+		uint32_t OutputWidth = Sizes[SizeIndex][2];
+		uint32_t OutputHeight = Sizes[SizeIndex][3];
+
+		uint8_t* Input = Cpu_Alloc((size_t)InputWidth * InputHeight * 4);
+		uint8_t* Output = Cpu_Alloc((size_t)OutputWidth * OutputHeight * 4);
+		double* Ref = Cpu_Alloc((size_t)OutputWidth * OutputHeight * 3 * sizeof(double));
+		double* Own = Cpu_Alloc((size_t)OutputWidth * OutputHeight * 3 * sizeof(double));
+		Filter_FillScreen(Input, InputWidth, InputHeight, 1);
+		Filter_ResizeReference(ResizeFilter_Lanczos3, Input, InputWidth, InputHeight, Ref, OutputWidth, OutputHeight);
+
+		char Name[64];
+		snprintf(Name, sizeof(Name), "%ux%u -> %ux%u", InputWidth, InputHeight, OutputWidth, OutputHeight);
+		for (uint32_t Filter = 0; Filter < FILTER_COUNT; Filter++)
+		{
+			CpuResize Resize, PoolResize;
+			CpuResize_Create(&Resize, InputWidth, InputHeight, OutputWidth, OutputHeight, (ResizeFilter)Filter, false, CpuKernel_Auto, NULL);
+			CpuResize_Create(&PoolResize, InputWidth, InputHeight, OutputWidth, OutputHeight, (ResizeFilter)Filter, false, CpuKernel_Auto, &Pool);
+
+			CpuResize_Run(&Resize, Input, InputWidth * 4, Output, OutputWidth * 4);
+			double Psnr = Filter_PsnrReference(Ref, Output, OutputWidth, OutputHeight);
+			double Ssim = Filter_SsimReference(Ref, Output, OutputWidth, OutputHeight);
+
+			Filter_ResizeReference((ResizeFilter)Filter, Input, InputWidth, InputHeight, Own, OutputWidth, OutputHeight);
+			double OwnPsnr = Filter_PsnrReference(Own, Output, OutputWidth, OutputHeight);
+
+			TEST_CHECK(Psnr >= MinPsnr[Filter] && Ssim >= MinSsim, "%s %s PSNR %.2f dB, SSIM %.4f against Lanczos3 reference", Name, FilterNames[Filter], Psnr, Ssim);
+			TEST_CHECK(OwnPsnr >= MinOwnPsnr, "%s %s PSNR %.2f dB against own reference", Name, FilterNames[Filter], OwnPsnr);
+
+			double SingleTime = Filter_Time(&Resize, Input, Output);
+			double PoolTime = Filter_Time(&PoolResize, Input, Output);
+			printf("  %-22s %-10s %9.2f %9.1f %9.2f %8.4f %9.2f\n", Name, FilterNames[Filter], SingleTime, 1000.0 / PoolTime, Psnr, Ssim, OwnPsnr);
+
+			CpuResize_Release(&Resize);
+			CpuResize_Release(&PoolResize);
+		}
+
+		Cpu_Free(Input);
+		Cpu_Free(Output);
+		Cpu_Free(Ref);
+		Cpu_Free(Own);
+	}
+
+	CpuPool_Release(&Pool);
+}
+
+int main(void)
+{
+	Filter_TestTables();
+	Filter_BenchmarkTables();
+	Filter_TestReduce();
+	Filter_BenchmarkOrder();
+	Filter_BenchmarkQuality();
+
+	return Test_Finish("test_resize_filter");
+}
@@ -0,0 +1,447 @@
+// recording session lifecycle & scheduling from wcap.c with synthetic capture sources and null encoder sink
+// every session has its own CpuLimit & encode CpuQueue, same as RecordingSession
+// capture callbacks, timers & window messages of all sessions run on main thread, same as DispatcherQueue of gCapture
+
+#include "test.h"
+#include "wcap_cpu_limit.h"
+#include "wcap_cpu_queue.h"
+#include "wcap_cpu_hash.h"
+
+#define SESSIONS_MAX 8          // same as WCAP_MAX_SESSIONS
+#define SESSIONS_QUEUE_SIZE 8   // same as WCAP_ENCODE_QUEUE_SIZE
+#define SESSIONS_FREQ 10000000ULL
+#define SESSIONS_WIDTH 1280
+#define SESSIONS_HEIGHT 720
+#define SESSIONS_MAX_MESSAGES 1024
+#define SESSIONS_TIMER_FRAMES 16 // frame callbacks between timer messages
+#define SESSIONS_ENCODE_UPDATE 1 // same as WCAP_ENCODE_UPDATE
+
+typedef struct
+{
+	uint32_t Index;
+	uint32_t Generation;
+	uint64_t Time;
+}
+SessionCommand;
+
+typedef struct
+{
+	bool Recording;
+	uint32_t Index;
+	uint32_t Generation;       // incremented on every start, stale stop messages are ignored
+	CpuLimit Limit;
+	CpuQueue Queue;
+	_Atomic(uint32_t) QueuedFrames;
+	_Atomic(uint32_t) DroppedFrames;
+
+	// source settings
+	uint32_t Rate;
+	uint32_t MaxFramerate;
+	uint32_t FrameCount;       // source frames until window "closes"
+	uint64_t LastFrameTime;    // encode thread asks to stop after this frame, same as length limit
+	bool WaitWhenFull;         // for benchmark, main thread waits instead of dropping frame
+
+	// accessed only on main thread while recording
+	uint32_t Captured;
+	uint32_t Accepted;
+	uint64_t NextTime;
+
+	// accessed only on encode thread while recording
+	uint32_t Encoded;
+	uint32_t Updates;
+	uint32_t WrongSession;
+	uint32_t OrderErrors;
+	uint64_t LastTime;
+	uint32_t* Hashes;
+}
+SimSession;
+
+typedef struct
+{
+	_Atomic(uint32_t) Ready;
+	uint32_t Index;
+	uint32_t Generation;
+}
+SessionMessage;
+
+static SimSession Sessions[SESSIONS_MAX];
+static CpuHash SessionsHash;
+static uint8_t* SessionsImage;
+static uint64_t SessionsTime; // time of last frame callback on main thread
+static uint32_t SessionsUpdates; // timer updates handled by encode threads of stopped recordings
+
+// stop messages from main & encode threads to main thread, same as WM_WCAP_STOP_CAPTURE
+static SessionMessage SessionsMessages[SESSIONS_MAX_MESSAGES];
+static _Atomic(uint32_t) SessionsMessageWrite;
+static uint32_t SessionsMessageRead;
+
+static void Sessions_PostStop(SimSession* Session)
+{
+	uint32_t Write = atomic_fetch_add(&SessionsMessageWrite, 1);
+	Assert(Write < SESSIONS_MAX_MESSAGES);
+
+	SessionMessage* Message = &SessionsMessages[Write];
+	Message->Index = Session->Index;
+	Message->Generation = Session->Generation;
+	atomic_store_explicit(&Message->Ready, 1, memory_order_release);
+}
+
+// null sink, hashing of frame is about same memory traffic as converting it for encoder
+static void Sessions_OnEncodeFrame(void* Context, void* Item)
+{
+	SimSession* Session = Context;
+	SessionCommand* Command = Item;
+
+	atomic_fetch_sub(&Session->QueuedFrames, 1);
+	if (Command->Index != Session->Index || Command->Generation != Session->Generation)
+	{
+		Session->WrongSession++;
+	}
+	if (Command->Time <= Session->LastTime)
+	{
+		Session->OrderErrors++;
+	}
+	Session->LastTime = Command->Time;
+
+	CpuHash_Run(&SessionsHash, SessionsImage, SESSIONS_WIDTH * 4, Session->Hashes);
+	Session->Encoded++;
+
+	// last frame reaches length limit, main thread also asks to stop when window closes after it
+	if (Command->Time == Session->LastFrameTime)
+	{
+		Sessions_PostStop(Session);
+	}
+}
+
+static void Sessions_OnEncodeFlags(void* Context, uint32_t Flags)
+{
+	SimSession* Session = Context;
+	if (Flags & SESSIONS_ENCODE_UPDATE)
+	{
+		Session->Updates++;
+	}
+}
+
+// same as OnCaptureFrame, returns false when window is closed & capture has ended
+static bool Sessions_OnCaptureFrame(SimSession* Session)
+{
+	if (Session->Captured == Session->FrameCount)
+	{
+		// OnCaptureFrame with NULL frame
+		Sessions_PostStop(Session);
+		return false;
+	}
+
+	uint64_t Time = Session->NextTime;
+	Session->NextTime += SESSIONS_FREQ / Session->Rate;
+	Session->Captured++;
+	SessionsTime = Time;
+
+	if (CpuLimit_Accept(&Session->Limit, Time))
+	{
+		Session->Accepted++;
+
+		SessionCommand Command = { .Index = Session->Index, .Generation = Session->Generation, .Time = Time };
+		atomic_fetch_add(&Session->QueuedFrames, 1);
+		while (!CpuQueue_Push(&Session->Queue, &Command))
+		{
+			if (!Session->WaitWhenFull)
+			{
+				atomic_fetch_sub(&Session->QueuedFrames, 1);
+				Session->DroppedFrames++;
+				break;
+			}
+			Test_Yield();
+		}
+	}
+	return true;
+}
+
+static void Sessions_Start(SimSession* Session, uint32_t Rate, uint32_t MaxFramerate, uint32_t FrameCount, bool WaitWhenFull)
+{
+	Assert(!Session->Recording);
+
+	uint64_t Period = SESSIONS_FREQ / Rate;
+
+	Session->Generation++;
+	Session->Rate = Rate;
+	Session->MaxFramerate = MaxFramerate;
+	Session->FrameCount = FrameCount;
+	Session->WaitWhenFull = WaitWhenFull;
+	Session->Captured = 0;
+	Session->Accepted = 0;
+	Session->NextTime = SessionsTime + Period + Session->Index * Period / SESSIONS_MAX;
+	Session->LastFrameTime = Session->NextTime + (FrameCount - 1) * Period;
+	Session->Encoded = 0;
+	Session->Updates = 0;
+	Session->WrongSession = 0;
+	Session->OrderErrors = 0;
+	Session->LastTime = 0;
+	atomic_store(&Session->QueuedFrames, 0);
+	atomic_store(&Session->DroppedFrames, 0);
+
+	CpuLimit_Create(&Session->Limit, MaxFramerate, Rate, 1, SESSIONS_FREQ);
+	CpuQueue_Create(&Session->Queue, SESSIONS_QUEUE_SIZE, sizeof(SessionCommand), &Sessions_OnEncodeFrame, &Sessions_OnEncodeFlags, Session);
+	Session->Recording = true;
+}
+
+static void Sessions_Stop(SimSession* Session)
+{
+	Session->Recording = false;
+
+	// capture callbacks run on this thread, so nothing is pushed while encode thread finishes queued frames
+	CpuQueue_Release(&Session->Queue);
+	SessionsUpdates += Session->Updates;
+
+	uint32_t Dropped = atomic_load(&Session->DroppedFrames);
+	TEST_CHECK(Session->Encoded + Dropped == Session->Accepted, "session %u generation %u: %u encoded + %u dropped of %u accepted", Session->Index, Session->Generation, Session->Encoded, Dropped, Session->Accepted);
+	TEST_CHECK(atomic_load(&Session->QueuedFrames) == 0, "session %u generation %u: %u frames still counted as queued", Session->Index, Session->Generation, atomic_load(&Session->QueuedFrames));
+	TEST_CHECK(Session->WrongSession == 0 && Session->OrderErrors == 0, "session %u generation %u: %u frames from other session, %u out of order", Session->Index, Session->Generation, Session->WrongSession, Session->OrderErrors);
+}
+
+// delivers next frame callback of all sessions in time order, same as dispatcher queue of main thread
+// returns false when no session is capturing
+static bool Sessions_Dispatch(void)
+{
+	SimSession* Next = NULL;
+	for (uint32_t Index = 0; Index < SESSIONS_MAX; Index++)
+	{
+		SimSession* Session = &Sessions[Index];
+		if (Session->Recording && Session->Captured <= Session->FrameCount && (Next == NULL || Session->NextTime < Next->NextTime))
+		{
+			Next = Session;
+		}
+	}
+	if (Next == NULL)
+	{
+		return false;
+	}
+
+	if (!Sessions_OnCaptureFrame(Next))
+	{
+		// no more callbacks after capture has ended, recording is stopped by message
+		Next->Captured++;
+	}
+
+	static uint32_t Callbacks;
+	if (++Callbacks % SESSIONS_TIMER_FRAMES == 0)
+	{
+		// WM_TIMER only signals encode threads, never takes space of frames in queue
+		for (uint32_t Index = 0; Index < SESSIONS_MAX; Index++)
+		{
+			if (Sessions[Index].Recording)
+			{
+				CpuQueue_Signal(&Sessions[Index].Queue, SESSIONS_ENCODE_UPDATE);
+			}
+		}
+	}
+	return true;
+}
+
+// handles up to Max stop messages on main thread, returns number of stopped sessions
+// Stale counts ignored messages, Reused counts ones of them that arrived when slot was recording again
+static uint32_t Sessions_ProcessMessages(uint32_t Max, uint32_t* Stale, uint32_t* Reused)
+{
+	uint32_t Stopped = 0;
+	for (uint32_t Count = 0; Count < Max && SessionsMessageRead < atomic_load(&SessionsMessageWrite); Count++)
+	{
+		SessionMessage* Message = &SessionsMessages[SessionsMessageRead];
+		if (!atomic_load_explicit(&Message->Ready, memory_order_acquire))
+		{
+			break;
+		}
+		SessionsMessageRead++;
+
+		// slot can be already reused by newer recording when message arrives
+		SimSession* Session = &Sessions[Message->Index];
+		if (Session->Recording && Session->Generation == Message->Generation)
+		{
+			Sessions_Stop(Session);
+			Stopped++;
+		}
+		else
+		{
+			*Stale += 1;
+			*Reused += Session->Recording;
+		}
+	}
+	return Stopped;
+}
+
+static void Sessions_ResetMessages(void)
+{
+	memset(SessionsMessages, 0, sizeof(SessionsMessages));
+	atomic_store(&SessionsMessageWrite, 0);
+	SessionsMessageRead = 0;
+}
+
+static void Sessions_TestLifecycle(void)
+{
+	// every slot records several times with different compositor rates & limits, slots are restarted
+	// right after they stop, so second stop message of previous recording can arrive when slot is reused
+	static const uint32_t Rates[][2] = { { 60, 0 }, { 60, 30 }, { 144, 60 }, { 75, 60 }, { 240, 50 }, { 165, 24 }, { 120, 0 }, { 144, 30 } };
+	const uint32_t Rounds = 4;
+
+	Sessions_ResetMessages();
+	SessionsUpdates = 0;
+
+	uint32_t Seed = 1234;
+	uint32_t Starts = 0;
+	for (uint32_t Index = 0; Index < SESSIONS_MAX; Index++)
+	{
+		Sessions_Start(&Sessions[Index], Rates[Index][0], Rates[Index][1], 100 + Test_Random(&Seed) % 400, false);
+		Starts++;
+	}
+
+	uint32_t Stale = 0;
+	uint32_t Reused = 0;
+	uint32_t Stops = 0;
+	double Start = Test_Time();
+	while (Stops < Starts && Test_Time() - Start < 30.0)
+	{
+		// frame callbacks & window messages are interleaved on main thread, one message at a time
+		// same as window procedure, so slots get reused between two messages
+		for (uint32_t Index = 0; Index < SESSIONS_MAX; Index++)
+		{
+			Sessions_Dispatch();
+		}
+
+		Stops += Sessions_ProcessMessages(1, &Stale, &Reused);
+
+		for (uint32_t Index = 0; Index < SESSIONS_MAX; Index++)
+		{
+			SimSession* Session = &Sessions[Index];
+			if (!Session->Recording && Starts < Rounds * SESSIONS_MAX)
+			{
+				uint32_t Rate = Rates[(Index + Starts) % SESSIONS_MAX][0];
+				uint32_t MaxFramerate = Rates[(Index + Starts) % SESSIONS_MAX][1];
+				Sessions_Start(Session, Rate, MaxFramerate, 100 + Test_Random(&Seed) % 400, false);
+				Starts++;
+			}
+		}
+	}
+
+	TEST_CHECK(Stops == Rounds * SESSIONS_MAX, "lifecycle: %u of %u recordings stopped", Stops, Rounds * SESSIONS_MAX);
+	for (uint32_t Index = 0; Index < SESSIONS_MAX; Index++)
+	{
+		if (Sessions[Index].Recording)
+		{
+			Sessions_Stop(&Sessions[Index]);
+		}
+	}
+	Sessions_ProcessMessages(SESSIONS_MAX_MESSAGES, &Stale, &Reused);
+
+	// every recording got stop message from main thread when window closed, and from encode thread when last frame
+	// was not dropped, only first one stops it, also when slot is already recording again
+	uint32_t Posted = atomic_load(&SessionsMessageWrite);
+	TEST_CHECK(Stale == Posted - Stops, "lifecycle: %u stale stop messages ignored, expected %u", Stale, Posted - Stops);
+	TEST_CHECK(SessionsUpdates > 0, "lifecycle: timer signals never reached encode threads");
+	printf("  lifecycle: %u recordings, %u stale stop messages ignored, %u of them for reused slot, %u timer updates\n", Stops, Stale, Reused, SessionsUpdates);
+}
+
+static void Sessions_TestStaleStop(void)
+{
+	// length limit is reached on last frame right before window closes, so both stop messages are posted
+	// before main thread handles first one, second one arrives when slot is already recording again
+	Sessions_ResetMessages();
+
+	SimSession* Session = &Sessions[0];
+	Sessions_Start(Session, 60, 0, 10, true);
+	uint32_t Generation = Session->Generation;
+
+	while (Sessions_Dispatch())
+	{
+	}
+	while (atomic_load(&SessionsMessageWrite) < 2)
+	{
+		Test_Yield();
+	}
+
+	uint32_t Stale = 0;
+	uint32_t Reused = 0;
+	uint32_t Stops = Sessions_ProcessMessages(1, &Stale, &Reused);
+	TEST_CHECK(Stops == 1 && !Session->Recording, "stale stop: first message did not stop recording");
+
+	Sessions_Start(Session, 60, 0, 10, true);
+	Stops = Sessions_ProcessMessages(1, &Stale, &Reused);
+	TEST_CHECK(Stops == 0 && Stale == 1 && Reused == 1, "stale stop: second message of generation %u stopped %u, ignored %u", Generation, Stops, Stale);
+	TEST_CHECK(Session->Recording && Session->Generation == Generation + 1, "stale stop: new recording in reused slot was stopped");
+
+	Sessions_Stop(Session);
+}
+
+static void Sessions_TestScaling(void)
+{
+	// all sessions capture same amount of frames at 144 Hz limited to 60 fps, main thread waits when encode thread is behind
+	// so elapsed time shows how well encode threads of parallel sessions scale with single producer
+	const uint32_t FrameCount = 1440;
+
+	double Single = 0;
+	for (uint32_t Count = 1; Count <= SESSIONS_MAX; Count++)
+	{
+		Sessions_ResetMessages();
+
+		double Start = Test_Time();
+		for (uint32_t Index = 0; Index < Count; Index++)
+		{
+			Sessions_Start(&Sessions[Index], 144, 60, FrameCount, true);
+		}
+
+		uint32_t Stale = 0;
+		uint32_t Reused = 0;
+		uint32_t Stops = 0;
+		while (Stops < Count)
+		{
+			if (!Sessions_Dispatch())
+			{
+				Test_Yield();
+			}
+			Stops += Sessions_ProcessMessages(1, &Stale, &Reused);
+		}
+		double Elapsed = Test_Time() - Start;
+
+		uint32_t Encoded = 0;
+		for (uint32_t Index = 0; Index < Count; Index++)
+		{
+			Encoded += Sessions[Index].Encoded;
+			TEST_CHECK(atomic_load(&Sessions[Index].DroppedFrames) == 0, "scaling %u: session %u dropped frames", Count, Index);
+		}
+
+		double Rate = Encoded / Elapsed;
+		if (Count == 1)
+		{
+			Single = Rate;
+		}
+		printf("  %u sessions: %8.1f frames/s per session, %8.1f total, %.2fx of one session\n", Count, Rate / Count, Rate, Rate / Single);
+	}
+}
+
+int main(void)
+{
+	CpuHash_Create(&SessionsHash, SESSIONS_WIDTH, SESSIONS_HEIGHT, CpuKernel_Auto);
+	SessionsImage = Cpu_Alloc(SESSIONS_WIDTH * SESSIONS_HEIGHT * 4);
+
+	uint32_t Seed = 1;
+	for (uint32_t Index = 0; Index < SESSIONS_WIDTH * SESSIONS_HEIGHT * 4; Index++)
+	{
+		SessionsImage[Index] = (uint8_t)Test_Random(&Seed);
+	}
+
+	for (uint32_t Index = 0; Index < SESSIONS_MAX; Index++)
+	{
+		Sessions[Index].Index = Index;
+		Sessions[Index].Hashes = Cpu_Alloc(2 * SessionsHash.BlockCountX * SessionsHash.BlockCountY * sizeof(uint32_t));
+	}
+
+	Sessions_TestLifecycle();
+	Sessions_TestStaleStop();
+	Sessions_TestScaling();
+
+	for (uint32_t Index = 0; Index < SESSIONS_MAX; Index++)
+	{
+		Cpu_Free(Sessions[Index].Hashes);
+	}
+	Cpu_Free(SessionsImage);
+
+	return Test_Finish("test_sessions");
+}
@@ -1,8 +1,13 @@
+// one frame for compositor to render into while others wait in encode queue or are being encoded
+#define SCREEN_CAPTURE_BUFFER_COUNT 3
+
 #include "wcap.h"
 #include "wcap_config.h"
 #include "wcap_audio_capture.h"
 #include "wcap_screen_capture.h"
 #include "wcap_encoder.h"
+#include "wcap_cpu_queue.h"
+#include "wcap_cpu_limit.h"
 
 #include <dxgi1_6.h>
 #include <d3d11.h>
@@ -53,6 +58,20 @@ __declspec(dllexport) DWORD NvOptimusEnablement = 1;
 #define WCAP_VIDEO_UPDATE_TIMER     2
 #define WCAP_VIDEO_UPDATE_INTERVAL  100 // msec
 
+#define WCAP_CURSOR_UPDATE_TIMER    3
+#define WCAP_CURSOR_UPDATE_INTERVAL 16 // msec
+
+// timer work is signaled to encode thread as flags, so it never takes space of captured frames in queue
+#define WCAP_ENCODE_UPDATE (1 << 0)
+#define WCAP_ENCODE_CURSOR (1 << 1)
+#define WCAP_ENCODE_AUDIO  (1 << 2)
+
+// power of 2, captured frames in queue are also limited by SCREEN_CAPTURE_BUFFER_COUNT
+#define WCAP_ENCODE_QUEUE_SIZE 8
+
+// max recordings at same time, when multiple recordings are enabled
+#define WCAP_MAX_SESSIONS 8
+
 #define CMD_WCAP     1
 #define CMD_QUIT     2
 #define CMD_SETTINGS 3
@@ -91,14 +110,11 @@ static HFONT gFontBold;
 
 // recording state
 static BOOL gRecordingStarted;
-static BOOL gRecording;
-static DWORD gRecordingLimitFramerate;
-static DWORD gRecordingDroppedFrames;
-static UINT64 gRecordingLastFrame;
-static UINT64 gRecordingNextEncode;
-static UINT64 gRecordingNextTooltip;
+static DWORD gRecordingCount;          // active recording sessions
+static DWORD gCursorOverlayCount;      // active recording sessions that draw cursor overlay
+static ID3D11Device* gRecordingDevice; // shared by all active sessions, only they hold references to it
 static EXECUTION_STATE gRecordingState;
-static WCHAR gRecordingPath[MAX_PATH];
+static WCHAR gRecordingPath[MAX_PATH]; // last started recording
 
 // when selecting rectangle to record
 static HMONITOR gRectMonitor;
@@ -115,12 +131,33 @@ static int gRectResize;
 static int gRectSetSize[2];
 static BOOL gRectSetSizeClick;
 
+typedef struct
+{
+	BOOL Recording;
+	BOOL Region;                  // gWindow shows border around recorded region
+	DWORD Generation;             // incremented on every start, so messages posted for previous recording in same slot are ignored
+	ScreenCapture Capture;
+	AudioCapture Audio;
+	Encoder Encoder;
+	CpuQueue Queue;               // captured frames, all encoder calls during recording happen on its thread
+	CpuLimit Limit;
+	_Atomic(DWORD) DroppedFrames;
+	_Atomic(DWORD) QueuedFrames;  // frames pushed to encode thread, but not yet passed to encoder
+	_Atomic(UINT64) StatsSize;    // stats for tray title, published by encode thread because only it uses encoder
+	_Atomic(DWORD) StatsBitrate;
+	_Atomic(DWORD) StatsLength;
+	_Atomic(DWORD) StatsSkipped;
+	UINT64 NextTooltip;
+	WCHAR Path[MAX_PATH];
+	WCHAR CopyPath[MAX_PATH];     // lower resolution copy, when it is enabled
+}
+RecordingSession;
+
 // globals
 static HWND gWindow;
 static Config gConfig;
-static AudioCapture gAudio;
-static ScreenCapture gCapture;
-static Encoder gEncoder;
+static ScreenCapture gCapture; // sessions share its factories & dispatcher queue, there can be only one queue per thread
+static RecordingSession gSessions[WCAP_MAX_SESSIONS];
 
 static void ShowNotification(LPCWSTR Message, LPCWSTR Title, DWORD Flags)
 {
@@ -196,8 +233,164 @@ static void ShowFileInFolder(LPCWSTR Filename)
 	}
 }
 
-static void StartRecording(ID3D11Device* Device, HWND Window)
+// HDR capture is used only for 10-bit video, PQ encoding needs more than 8 bits
+static bool UseHdrCapture(void)
+{
+	return gConfig.HdrCapture && gConfig.VideoProfile == CONFIG_VIDEO_MAIN_10;
+}
+
+static void EncodeCapturedAudio(RecordingSession* Session)
+{
+	Encoder* Encoder = &Session->Encoder;
+	AudioCapture* Audio = &Session->Audio;
+
+	if (Encoder->StartTime == 0)
+	{
+		// we don't know when first video frame starts yet
+		return;
+	}
+
+	AudioCaptureData Data;
+	while (AudioCapture_GetData(Audio, &Data, Encoder->StartTime))
+	{
+		UINT32 FramesToEncode = (UINT32)Data.Count;
+		if (Data.Time < Encoder->StartTime)
+		{
+			const UINT32 SampleRate = Audio->Format->nSamplesPerSec;
+			const UINT32 BytesPerFrame = Audio->Format->nBlockAlign;
+
+			// figure out how much time (100nsec units) and frame count to skip from current buffer
+			UINT64 TimeToSkip = Encoder->StartTime - Data.Time;
+			UINT32 FramesToSkip = (UINT32)((TimeToSkip * SampleRate - 1) / MF_UNITS_PER_SECOND + 1);
+			if (FramesToSkip < FramesToEncode)
+			{
+				// need to skip part of captured data
+				Data.Time += FramesToSkip * MF_UNITS_PER_SECOND / SampleRate;
+				FramesToEncode -= FramesToSkip;
+				if (Data.Samples)
+				{
+					Data.Samples = (BYTE*)Data.Samples + FramesToSkip * BytesPerFrame;
+				}
+			}
+			else
+			{
+				// need to skip all of captured data
+				FramesToEncode = 0;
+			}
+		}
+		if (FramesToEncode != 0)
+		{
+			Assert(Data.Time >= Encoder->StartTime);
+			Encoder_NewSamples(Encoder, Data.Samples, FramesToEncode, Data.Time, gTickFreq.QuadPart);
+		}
+		AudioCapture_ReleaseData(Audio, &Data);
+	}
+}
+
+// encoding can wait for GPU & encoder, so it is done on encode thread to not delay capture callbacks
+// encode thread does not initialize COM, it is implicitly in MTA that Media Foundation work queue threads keep alive
+static void OnEncodeFrame(void* Context, void* Item)
 {
+	RecordingSession* Session = Context;
+	Encoder* Encoder = &Session->Encoder;
+	ScreenCaptureFrame* Frame = Item;
+
+	DWORD Queued = atomic_fetch_sub(&Session->QueuedFrames, 1) - 1;
+	if (!Encoder_NewFrame(Encoder, Frame->Texture, Frame->Rect, Queued, Frame->Time, gTickFreq.QuadPart))
+	{
+		// count is shown in tray icon title, next to other stats
+		Session->DroppedFrames++;
+	}
+	ScreenCapture_ReleaseFrameRef(Frame);
+
+	if (gConfig.EnableLimitLength || gConfig.EnableLimitSize)
+	{
+		BOOL Stop = FALSE;
+
+		if (gConfig.EnableLimitLength)
+		{
+			if (Frame->Time - Encoder->StartTime >= (UINT64)(gConfig.LimitLength * gTickFreq.QuadPart))
+			{
+				Stop = TRUE;
+			}
+		}
+		if (gConfig.EnableLimitSize && !Stop)
+		{
+			UINT64 FileSize;
+			DWORD Bitrate, LengthMsec;
+			Encoder_GetStats(Encoder, &Bitrate, &LengthMsec, &FileSize);
+
+			// reserve 0.5% for mp4 format overhead (probably an overestimate)
+			if (1000 * FileSize >= (995ULL * gConfig.LimitSize) << 20)
+			{
+				Stop = TRUE;
+			}
+		}
+
+		if (Stop)
+		{
+			PostMessageW(gWindow, WM_WCAP_STOP_CAPTURE, (WPARAM)(Session - gSessions), (LPARAM)Session->Generation);
+			return;
+		}
+	}
+
+	// update tray title with stats once every second
+	if (Session->NextTooltip == 0)
+	{
+		Session->NextTooltip = Frame->Time + gTickFreq.QuadPart;
+	}
+	else if (Frame->Time >= Session->NextTooltip)
+	{
+		Session->NextTooltip += gTickFreq.QuadPart;
+
+		UINT64 FileSize;
+		DWORD Bitrate, LengthMsec;
+		Encoder_GetStats(Encoder, &Bitrate, &LengthMsec, &FileSize);
+
+		atomic_store(&Session->StatsSize, FileSize);
+		atomic_store(&Session->StatsBitrate, Bitrate);
+		atomic_store(&Session->StatsLength, LengthMsec);
+		atomic_store(&Session->StatsSkipped, Encoder->VideoDuplicateCount + Encoder->VideoStaticCount);
+
+		// do the update on main thread, which owns tray icon
+		PostMessageW(gWindow, WM_WCAP_TRAY_TITLE, 0, 0);
+	}
+}
+
+// timers of main thread only set flags, same timer signaled again before encode thread gets to it runs once
+static void OnEncodeFlags(void* Context, uint32_t Flags)
+{
+	RecordingSession* Session = Context;
+	Encoder* Encoder = &Session->Encoder;
+
+	LARGE_INTEGER Time;
+	QueryPerformanceCounter(&Time);
+
+	if (Flags & WCAP_ENCODE_AUDIO)
+	{
+		EncodeCapturedAudio(Session);
+	}
+
+	// flags are handled before frames waiting in queue, those were captured earlier & draw current cursor anyway
+	if (atomic_load(&Session->QueuedFrames) != 0)
+	{
+		return;
+	}
+	if (Flags & WCAP_ENCODE_UPDATE)
+	{
+		Encoder_Update(Encoder, Time.QuadPart, gTickFreq.QuadPart);
+	}
+	if (Flags & WCAP_ENCODE_CURSOR)
+	{
+		Encoder_UpdateCursor(Encoder, ScreenCapture_GetOrigin(&Session->Capture), Time.QuadPart, gTickFreq.QuadPart);
+	}
+}
+
+static BOOL StartRecording(RecordingSession* Session, ID3D11Device* Device, HWND Window)
+{
+	ScreenCapture* Capture = &Session->Capture;
+	Encoder* Encoder = &Session->Encoder;
+
 	SYSTEMTIME Time;
 	GetLocalTime(&Time);
 
@@ -205,157 +398,223 @@ static void StartRecording(ID3D11Device* Device, HWND Window)
 	if (Error != ERROR_SUCCESS && Error != ERROR_FILE_EXISTS && Error != ERROR_ALREADY_EXISTS)
 	{
 		ShowNotification(L"Cannot create output folder!", L"Cannot Start Recording", NIIF_WARNING);
-		ScreenCapture_Stop(&gCapture);
+		ScreenCapture_Stop(Capture);
 		ID3D11Device_Release(Device);
-		return;
+		return FALSE;
 	}
 
 	WCHAR Filename[256];
 	StrFormat(Filename, L"%04u%02u%02u_%02u%02u%02u.mp4", Time.wYear, Time.wMonth, Time.wDay, Time.wHour, Time.wMinute, Time.wSecond);
 
-	StrCpyW(gRecordingPath, gConfig.OutputFolder);
-	PathAppendW(gRecordingPath, Filename);
+	StrCpyW(Session->Path, gConfig.OutputFolder);
+	PathAppendW(Session->Path, Filename);
+
+	// other recording started in same second already created this file
+	for (DWORD Index = 2; PathFileExistsW(Session->Path); Index++)
+	{
+		StrFormat(Filename, L"%04u%02u%02u_%02u%02u%02u_%u.mp4", Time.wYear, Time.wMonth, Time.wDay, Time.wHour, Time.wMinute, Time.wSecond, Index);
+
+		StrCpyW(Session->Path, gConfig.OutputFolder);
+		PathAppendW(Session->Path, Filename);
+	}
+
+	// copy is next to main file with its max height in name
+	if (gConfig.VideoCopyMaxHeight != 0)
+	{
+		WCHAR Suffix[32];
+		StrFormat(Suffix, L"_%up.mp4", gConfig.VideoCopyMaxHeight);
+
+		StrCpyW(Session->CopyPath, Session->Path);
+		PathRemoveExtensionW(Session->CopyPath);
+		StrCatW(Session->CopyPath, Suffix);
+	}
 
 	DWM_TIMING_INFO Info = { .cbSize = sizeof(Info) };
 	HR(DwmGetCompositionTimingInfo(NULL, &Info));
 
 	DWORD FramerateNum = Info.rateCompose.uiNumerator;
 	DWORD FramerateDen = Info.rateCompose.uiDenominator;
-	if (gConfig.VideoMaxFramerate > 0 && gConfig.VideoMaxFramerate * FramerateDen < FramerateNum)
+	if (CpuLimit_Create(&Session->Limit, gConfig.VideoMaxFramerate, FramerateNum, FramerateDen, gTickFreq.QuadPart))
 	{
-		// limit rate only if max framerate is specified and it is lower than compositor framerate
-		gRecordingLimitFramerate = gConfig.VideoMaxFramerate;
 		FramerateNum = gConfig.VideoMaxFramerate;
 		FramerateDen = 1;
 	}
-	else
-	{
-		gRecordingLimitFramerate = 0;
-	}
 
 	EncoderConfig EncConfig =
 	{
-		.Width = gCapture.Rect.right - gCapture.Rect.left,
-		.Height = gCapture.Rect.bottom - gCapture.Rect.top,
+		.Width = Capture->Rect.right - Capture->Rect.left,
+		.Height = Capture->Rect.bottom - Capture->Rect.top,
 		.FramerateNum = FramerateNum,
 		.FramerateDen = FramerateDen,
+		.HdrInput = Capture->Format == SCREEN_CAPTURE_HDR_BUFFER_FORMAT,
+		.CursorOverlay = gConfig.MouseCursor && gConfig.MouseCursorOverlay && ScreenCapture_CanHideMouseCursor(),
 		.Config = &gConfig,
 	};
 
+	if (gConfig.VideoCopyMaxHeight != 0)
+	{
+		// encoded from same captured frames, so it costs only extra resize & encode
+		EncConfig.Branches[0] = (EncoderBranchConfig)
+		{
+			.FileName = Session->CopyPath,
+			.MaxHeight = gConfig.VideoCopyMaxHeight,
+			.Bitrate = gConfig.VideoCopyBitrate,
+		};
+		EncConfig.BranchCount = 1;
+	}
+
 	if (gConfig.CaptureAudio)
 	{
 		HWND ApplicationWindow = gConfig.ApplicationLocalAudio && AudioCapture_CanCaptureApplicationLocal() ? Window : NULL;
-		if (!AudioCapture_Start(&gAudio, ApplicationWindow))
+		if (!AudioCapture_Start(&Session->Audio, ApplicationWindow))
 		{
 			ShowNotification(L"Cannot capture audio!", L"Cannot Start Recording", NIIF_WARNING);
-			ScreenCapture_Stop(&gCapture);
+			ScreenCapture_Stop(Capture);
 			ID3D11Device_Release(Device);
-			return;
+			return FALSE;
 		}
-		EncConfig.AudioFormat = gAudio.Format;
+		EncConfig.AudioFormat = Session->Audio.Format;
 	}
 
-	if (!Encoder_Start(&gEncoder, Device, gRecordingPath, &EncConfig))
+	if (!Encoder_Start(Encoder, Device, Session->Path, &EncConfig))
 	{
 		if (gConfig.CaptureAudio)
 		{
-			AudioCapture_Stop(&gAudio);
+			AudioCapture_Stop(&Session->Audio);
 		}
-		ScreenCapture_Stop(&gCapture);
+		ScreenCapture_Stop(Capture);
 		ID3D11Device_Release(Device);
-		return;
+		return FALSE;
 	}
 
-	gRecordingNextTooltip = 0;
-	gRecordingNextEncode = 0;
-	gRecordingLastFrame = 0;
-	gRecordingDroppedFrames = 0;
-	ScreenCapture_Start(&gCapture, gConfig.MouseCursor, gConfig.ShowRecordingBorder, gConfig.IncludeSecondaryWindows);
+	Session->Generation++;
+	Session->NextTooltip = 0;
+	Session->DroppedFrames = 0;
+	Session->QueuedFrames = 0;
+	Session->StatsSize = 0;
+	Session->StatsBitrate = 0;
+	Session->StatsLength = 0;
+	Session->StatsSkipped = 0;
+	CpuQueue_Create(&Session->Queue, WCAP_ENCODE_QUEUE_SIZE, sizeof(ScreenCaptureFrame), &OnEncodeFrame, &OnEncodeFlags, Session);
+	// when encoder draws cursor, captured frames change only when something else on screen changes
+	ScreenCapture_Start(Capture, gConfig.MouseCursor && !Encoder->CursorOverlay, gConfig.ShowRecordingBorder, gConfig.IncludeSecondaryWindows);
 
-	if (gConfig.CaptureAudio)
+	// settings cannot change during recording, so all sessions need same timers
+	if (gRecordingCount++ == 0)
 	{
-		SetTimer(gWindow, WCAP_AUDIO_CAPTURE_TIMER, WCAP_AUDIO_CAPTURE_INTERVAL, NULL);
+		if (gConfig.CaptureAudio)
+		{
+			SetTimer(gWindow, WCAP_AUDIO_CAPTURE_TIMER, WCAP_AUDIO_CAPTURE_INTERVAL, NULL);
+		}
+		SetTimer(gWindow, WCAP_VIDEO_UPDATE_TIMER, WCAP_VIDEO_UPDATE_INTERVAL, NULL);
+
+		UpdateTrayIcon(gIcon2);
+		gRecordingState = SetThreadExecutionState(ES_CONTINUOUS | ES_DISPLAY_REQUIRED);
+		gRecordingDevice = Device;
 	}
-	SetTimer(gWindow, WCAP_VIDEO_UPDATE_TIMER, WCAP_VIDEO_UPDATE_INTERVAL, NULL);
 
-	UpdateTrayIcon(gIcon2);
-	gRecordingState = SetThreadExecutionState(ES_CONTINUOUS | ES_DISPLAY_REQUIRED);
-	gRecording = TRUE;
+	// overlay depends also on capture format & copy output, so sessions can differ in it
+	if (Encoder->CursorOverlay && gCursorOverlayCount++ == 0)
+	{
+		SetTimer(gWindow, WCAP_CURSOR_UPDATE_TIMER, WCAP_CURSOR_UPDATE_INTERVAL, NULL);
+	}
+	StrCpyW(gRecordingPath, Session->Path);
+	Session->Recording = TRUE;
 
 	ID3D11Device_Release(Device);
+	return TRUE;
 }
 
-static void EncodeCapturedAudio(void)
+static void StopRecording(RecordingSession* Session)
 {
-	if (gEncoder.StartTime == 0)
-	{
-		// we don't know when first video frame starts yet
-		return;
-	}
+	Session->Recording = FALSE;
 
-	AudioCaptureData Data;
-	while (AudioCapture_GetData(&gAudio, &Data, gEncoder.StartTime))
+	if (--gRecordingCount == 0)
 	{
-		UINT32 FramesToEncode = (UINT32)Data.Count;
-		if (Data.Time < gEncoder.StartTime)
-		{
-			const UINT32 SampleRate = gAudio.Format->nSamplesPerSec;
-			const UINT32 BytesPerFrame = gAudio.Format->nBlockAlign;
+		SetThreadExecutionState(gRecordingState);
+		gRecordingDevice = NULL;
 
-			// figure out how much time (100nsec units) and frame count to skip from current buffer
-			UINT64 TimeToSkip = gEncoder.StartTime - Data.Time;
-			UINT32 FramesToSkip = (UINT32)((TimeToSkip * SampleRate - 1) / MF_UNITS_PER_SECOND + 1);
-			if (FramesToSkip < FramesToEncode)
-			{
-				// need to skip part of captured data
-				Data.Time += FramesToSkip * MF_UNITS_PER_SECOND / SampleRate;
-				FramesToEncode -= FramesToSkip;
-				if (Data.Samples)
-				{
-					Data.Samples = (BYTE*)Data.Samples + FramesToSkip * BytesPerFrame;
-				}
-			}
-			else
-			{
-				// need to skip all of captured data
-				FramesToEncode = 0;
-			}
-		}
-		if (FramesToEncode != 0)
+		if (gConfig.CaptureAudio)
 		{
-			Assert(Data.Time >= gEncoder.StartTime);
-			Encoder_NewSamples(&gEncoder, Data.Samples, FramesToEncode, Data.Time, gTickFreq.QuadPart);
+			KillTimer(gWindow, WCAP_AUDIO_CAPTURE_TIMER);
 		}
-		AudioCapture_ReleaseData(&gAudio, &Data);
+		KillTimer(gWindow, WCAP_VIDEO_UPDATE_TIMER);
+	}
+	if (Session->Encoder.CursorOverlay && --gCursorOverlayCount == 0)
+	{
+		KillTimer(gWindow, WCAP_CURSOR_UPDATE_TIMER);
 	}
-}
 
-static void StopRecording(void)
-{
-	gRecording = FALSE;
-	SetThreadExecutionState(gRecordingState);
+	// encode thread finishes queued frames, afterwards encoder is used only on this thread
+	// capture callbacks also run on this thread, so nothing is pushed to queue meanwhile
+	CpuQueue_Release(&Session->Queue);
+	ScreenCapture_Stop(&Session->Capture);
 
 	if (gConfig.CaptureAudio)
 	{
-		KillTimer(gWindow, WCAP_AUDIO_CAPTURE_TIMER);
-		AudioCapture_Flush(&gAudio);
-		EncodeCapturedAudio();
-		AudioCapture_Stop(&gAudio);
+		AudioCapture_Flush(&Session->Audio);
+		EncodeCapturedAudio(Session);
+		AudioCapture_Stop(&Session->Audio);
 	}
-	KillTimer(gWindow, WCAP_VIDEO_UPDATE_TIMER);
-
-	ScreenCapture_Stop(&gCapture);
-	Encoder_Stop(&gEncoder);
+	Encoder_Stop(&Session->Encoder);
 	if (gConfig.OpenFolder)
 	{
-		ShowFileInFolder(gRecordingPath);
+		ShowFileInFolder(Session->Path);
 	}
 
-	SetWindowPos(gWindow, HWND_NOTOPMOST, 0, 0, 0, 0, SWP_HIDEWINDOW | SWP_NOMOVE | SWP_NOSIZE);
-	SetWindowLongW(gWindow, GWL_EXSTYLE, 0);
+	if (Session->Region)
+	{
+		SetWindowPos(gWindow, HWND_NOTOPMOST, 0, 0, 0, 0, SWP_HIDEWINDOW | SWP_NOMOVE | SWP_NOSIZE);
+		SetWindowLongW(gWindow, GWL_EXSTYLE, 0);
+		Session->Region = FALSE;
+	}
 
-	UpdateTrayIcon(gIcon1);
-	UpdateTrayTitle(WCAP_TITLE);
+	if (gRecordingCount == 0)
+	{
+		UpdateTrayIcon(gIcon1);
+		UpdateTrayTitle(WCAP_TITLE);
+	}
+}
+
+static void StopAllRecordings(void)
+{
+	for (DWORD Index = 0; Index < WCAP_MAX_SESSIONS; Index++)
+	{
+		if (gSessions[Index].Recording)
+		{
+			StopRecording(&gSessions[Index]);
+		}
+	}
+}
+
+// returns active recording of same window, monitor or region
+static RecordingSession* FindRecording(HWND Window, HMONITOR Monitor, BOOL Region)
+{
+	for (DWORD Index = 0; Index < WCAP_MAX_SESSIONS; Index++)
+	{
+		RecordingSession* Session = &gSessions[Index];
+		if (Session->Recording)
+		{
+			if (Region ? Session->Region : !Session->Region && Session->Capture.Window == Window && (Window || Session->Capture.Monitor == Monitor))
+			{
+				return Session;
+			}
+		}
+	}
+	return NULL;
+}
+
+static RecordingSession* NewRecording(void)
+{
+	for (DWORD Index = 0; Index < WCAP_MAX_SESSIONS; Index++)
+	{
+		if (!gSessions[Index].Recording)
+		{
+			return &gSessions[Index];
+		}
+	}
+	ShowNotification(L"Too many recordings!", L"Cannot Start Recording", NIIF_WARNING);
+	return NULL;
 }
 
 static ID3D11Device* CreateDevice(void)
@@ -414,6 +673,17 @@ static ID3D11Device* CreateDevice(void)
 	return Device;
 }
 
+// all recordings use same device, so they share its context & video memory
+static ID3D11Device* AcquireDevice(void)
+{
+	if (gRecordingDevice)
+	{
+		ID3D11Device_AddRef(gRecordingDevice);
+		return gRecordingDevice;
+	}
+	return CreateDevice();
+}
+
 static void CaptureWindow(void)
 {
 	HWND Window = GetForegroundWindow();
@@ -448,20 +718,34 @@ static void CaptureWindow(void)
 		return;
 	}
 
-	ID3D11Device* Device = CreateDevice();
+	RecordingSession* Session = FindRecording(Window, NULL, FALSE);
+	if (Session)
+	{
+		// with multiple recordings shortcut stops recording of same window
+		StopRecording(Session);
+		return;
+	}
+
+	Session = NewRecording();
+	if (!Session)
+	{
+		return;
+	}
+
+	ID3D11Device* Device = AcquireDevice();
 	if (!Device)
 	{
 		return;
 	}
 
-	if (!ScreenCapture_CreateForWindow(&gCapture, Device, Window, gConfig.OnlyClientArea, !gConfig.KeepRoundedWindowCorners))
+	if (!ScreenCapture_CreateForWindow(&Session->Capture, Device, Window, gConfig.OnlyClientArea, !gConfig.KeepRoundedWindowCorners, UseHdrCapture()))
 	{
 		ID3D11Device_Release(Device);
 		ShowNotification(L"Cannot record selected window!", L"Error", NIIF_WARNING);
 		return;
 	}
 
-	StartRecording(Device, Window);
+	StartRecording(Session, Device, Window);
 }
 
 static void CaptureMonitor(void)
@@ -476,23 +760,50 @@ static void CaptureMonitor(void)
 		return;
 	}
 
-	ID3D11Device* Device = CreateDevice();
+	RecordingSession* Session = FindRecording(NULL, Monitor, FALSE);
+	if (Session)
+	{
+		// with multiple recordings shortcut stops recording of same monitor
+		StopRecording(Session);
+		return;
+	}
+
+	Session = NewRecording();
+	if (!Session)
+	{
+		return;
+	}
+
+	ID3D11Device* Device = AcquireDevice();
 	if (!Device)
 	{
 		return;
 	}
 
-	if (!ScreenCapture_CreateForMonitor(&gCapture, Device, Monitor, NULL))
+	if (!ScreenCapture_CreateForMonitor(&Session->Capture, Device, Monitor, NULL, UseHdrCapture()))
 	{
 		ShowNotification(L"Cannot record selected monitor!", L"Error", NIIF_WARNING);
 		return;
 	}
 
-	StartRecording(Device, NULL);
+	StartRecording(Session, Device, NULL);
 }
 
 static void CaptureRegionInit(void)
 {
+	RecordingSession* Session = FindRecording(NULL, NULL, TRUE);
+	if (Session)
+	{
+		// window is used for border of recorded region, so only one region can be recorded
+		StopRecording(Session);
+		return;
+	}
+
+	if (!NewRecording())
+	{
+		return;
+	}
+
 	POINT Mouse;
 	GetCursorPos(&Mouse);
 
@@ -599,6 +910,12 @@ static void CaptureRegion(void)
 {
 	CaptureRegionDone();
 
+	RecordingSession* Session = NewRecording();
+	if (!Session)
+	{
+		return;
+	}
+
 	MONITORINFO Info = { .cbSize = sizeof(Info) };
 	GetMonitorInfoW(gRectMonitor, &Info);
 
@@ -614,24 +931,24 @@ static void CaptureRegion(void)
 	SetWindowLongW(gWindow, GWL_EXSTYLE, ExStyle);
 	SetLayeredWindowAttributes(gWindow, RGB(255, 0, 255), 0, LWA_COLORKEY);
 
-	ID3D11Device* Device = CreateDevice();
+	ID3D11Device* Device = AcquireDevice();
 	if (!Device)
 	{
 		CaptureRegionRelease();
 		return;
 	}
 
-	if (!ScreenCapture_CreateForMonitor(&gCapture, Device, gRectMonitor, &Rect))
+	if (!ScreenCapture_CreateForMonitor(&Session->Capture, Device, gRectMonitor, &Rect, UseHdrCapture()))
 	{
 		ShowNotification(L"Cannot record monitor!", L"Error", NIIF_WARNING);
 		CaptureRegionRelease();
 		return;
 	}
 
-	StartRecording(Device, NULL);
-
-	if (gRecording)
+	if (StartRecording(Session, Device, NULL))
 	{
+		Session->Region = TRUE;
+
 		int X = Info.rcMonitor.left + Rect.left - (WCAP_RECT_BORDER + 1);
 		int Y = Info.rcMonitor.top + Rect.top - (WCAP_RECT_BORDER + 1);
 		int W = Rect.right - Rect.left + 2 * (WCAP_RECT_BORDER + 1);
@@ -733,10 +1050,7 @@ static LRESULT CALLBACK WindowProc(HWND Window, UINT Message, WPARAM WParam, LPA
 	}
 	else if (Message == WM_DESTROY)
 	{
-		if (gRecording)
-		{
-			StopRecording();
-		}
+		StopAllRecordings();
 		RemoveTrayIcon(Window);
 		PostQuitMessage(0);
 		return 0;
@@ -942,27 +1256,38 @@ static LRESULT CALLBACK WindowProc(HWND Window, UINT Message, WPARAM WParam, LPA
 	}
 	else if (Message == WM_TIMER)
 	{
-		if (gRecording)
+		if (WParam == WCAP_AUDIO_CAPTURE_TIMER || WParam == WCAP_VIDEO_UPDATE_TIMER || WParam == WCAP_CURSOR_UPDATE_TIMER)
 		{
-			if (WParam == WCAP_AUDIO_CAPTURE_TIMER)
-			{
-				EncodeCapturedAudio();
-				return 0;
-			}
-			else if (WParam == WCAP_VIDEO_UPDATE_TIMER)
+			for (DWORD Index = 0; Index < WCAP_MAX_SESSIONS; Index++)
 			{
-				LARGE_INTEGER Time;
-				QueryPerformanceCounter(&Time);
-				Encoder_Update(&gEncoder, Time.QuadPart, gTickFreq.QuadPart);
-				return 0;
+				RecordingSession* Session = &gSessions[Index];
+				if (!Session->Recording)
+				{
+					continue;
+				}
+
+				// encode thread does the work when it gets to it, time & cursor position are taken there
+				if (WParam == WCAP_AUDIO_CAPTURE_TIMER)
+				{
+					CpuQueue_Signal(&Session->Queue, WCAP_ENCODE_AUDIO);
+				}
+				else if (WParam == WCAP_VIDEO_UPDATE_TIMER)
+				{
+					CpuQueue_Signal(&Session->Queue, WCAP_ENCODE_UPDATE);
+				}
+				else if (WParam == WCAP_CURSOR_UPDATE_TIMER && Session->Encoder.CursorOverlay)
+				{
+					CpuQueue_Signal(&Session->Queue, WCAP_ENCODE_CURSOR);
+				}
 			}
+			return 0;
 		}
 	}
 	else if (Message == WM_POWERBROADCAST)
 	{
 		if (WParam == PBT_APMQUERYSUSPEND)
 		{
-			if (gRecording)
+			if (gRecordingCount != 0)
 			{
 				if (LParam & 1)
 				{
@@ -972,7 +1297,7 @@ static LRESULT CALLBACK WindowProc(HWND Window, UINT Message, WPARAM WParam, LPA
 				else
 				{
 					// if cannot prevent suspend, need to stop recording
-					StopRecording();
+					StopAllRecordings();
 				}
 			}
 			else
@@ -991,7 +1316,7 @@ static LRESULT CALLBACK WindowProc(HWND Window, UINT Message, WPARAM WParam, LPA
 
 			AppendMenuW(Menu, MF_STRING, CMD_WCAP, WCAP_TITLE);
 			AppendMenuW(Menu, MF_SEPARATOR, 0, NULL);
-			AppendMenuW(Menu, MF_STRING | (gRecording ? MF_DISABLED : 0), CMD_SETTINGS, L"Settings");
+			AppendMenuW(Menu, MF_STRING | (gRecordingCount != 0 ? MF_DISABLED : 0), CMD_SETTINGS, L"Settings");
 			AppendMenuW(Menu, MF_STRING, CMD_QUIT, L"Exit");
 
 			POINT Mouse;
@@ -1021,7 +1346,7 @@ static LRESULT CALLBACK WindowProc(HWND Window, UINT Message, WPARAM WParam, LPA
 		}
 		else if (LOWORD(LParam) == WM_LBUTTONDBLCLK)
 		{
-			if (!gRecording)
+			if (gRecordingCount == 0)
 			{
 				if (Config_ShowDialog(&gConfig))
 				{
@@ -1040,9 +1365,9 @@ static LRESULT CALLBACK WindowProc(HWND Window, UINT Message, WPARAM WParam, LPA
 	}
 	else if (Message == WM_HOTKEY)
 	{
-		if (gRecording)
+		if (gRecordingCount != 0 && !gConfig.MultipleRecordings)
 		{
-			StopRecording();
+			StopAllRecordings();
 		}
 		else if (!gRecordingStarted)
 		{
@@ -1072,26 +1397,58 @@ static LRESULT CALLBACK WindowProc(HWND Window, UINT Message, WPARAM WParam, LPA
 	}
 	else if (Message == WM_WCAP_TRAY_TITLE)
 	{
-		if (gRecording)
+		// tray title fits stats of only one recording, for multiple recordings it shows totals
+		UINT64 TotalSize = 0;
+		DWORD TotalDropped = 0;
+		DWORD TotalSkipped = 0;
+		RecordingSession* Last = NULL;
+
+		for (DWORD Index = 0; Index < WCAP_MAX_SESSIONS; Index++)
 		{
-			UINT64 FileSize;
-			DWORD Bitrate, LengthMsec;
-			Encoder_GetStats(&gEncoder, &Bitrate, &LengthMsec, &FileSize);
+			RecordingSession* Session = &gSessions[Index];
+			if (Session->Recording)
+			{
+				TotalSize += atomic_load(&Session->StatsSize);
+				TotalDropped += atomic_load(&Session->DroppedFrames);
+				TotalSkipped += atomic_load(&Session->StatsSkipped);
+				Last = Session;
+			}
+		}
+
+		if (gRecordingCount == 1)
+		{
+			// only sizes & framerate are read from encoder, they do not change during recording
+			Encoder* Encoder = &Last->Encoder;
 
 			WCHAR LengthText[128];
-			StrFromTimeIntervalW(LengthText, _countof(LengthText), LengthMsec, 6);
+			StrFromTimeIntervalW(LengthText, _countof(LengthText), atomic_load(&Last->StatsLength), 6);
 
 			WCHAR SizeText[128];
-			StrFormatByteSizeW(FileSize, SizeText, _countof(SizeText));
+			StrFormatByteSizeW(atomic_load(&Last->StatsSize), SizeText, _countof(SizeText));
 
 			WCHAR Text[1024];
-			StrFormat(Text, L"Recording: %dx%d @ %.2f\nLength: %ls\nBitrate: %u kbit/s\nSize: %ls\nFramedrop: %u",
-				gEncoder.OutputWidth, gEncoder.OutputHeight,
-				(float)gEncoder.FramerateNum / (float)gEncoder.FramerateDen,
+			StrFormat(Text, L"Recording: %dx%d @ %.2f\nLength: %ls\nBitrate: %u kbit/s\nSize: %ls\nFramedrop: %u\nSkipped: %u",
+				Encoder->OutputWidth, Encoder->OutputHeight,
+				(float)Encoder->FramerateNum / (float)Encoder->FramerateDen,
 				LengthText,
-				Bitrate,
+				atomic_load(&Last->StatsBitrate),
 				SizeText,
-				gRecordingDroppedFrames);
+				TotalDropped,
+				TotalSkipped);
+
+			UpdateTrayTitle(Text);
+		}
+		else if (gRecordingCount > 1)
+		{
+			WCHAR SizeText[128];
+			StrFormatByteSizeW(TotalSize, SizeText, _countof(SizeText));
+
+			WCHAR Text[1024];
+			StrFormat(Text, L"Recordings: %u\nSize: %ls\nFramedrop: %u\nSkipped: %u",
+				gRecordingCount,
+				SizeText,
+				TotalDropped,
+				TotalSkipped);
 
 			UpdateTrayTitle(Text);
 		}
@@ -1099,9 +1456,11 @@ static LRESULT CALLBACK WindowProc(HWND Window, UINT Message, WPARAM WParam, LPA
 	}
 	else if (Message == WM_WCAP_STOP_CAPTURE)
 	{
-		if (gRecording)
+		// slot can be already reused by newer recording when message arrives
+		RecordingSession* Session = &gSessions[WParam];
+		if (Session->Recording && Session->Generation == (DWORD)LParam)
 		{
-			StopRecording();
+			StopRecording(Session);
 		}
 		return 0;
 	}
@@ -1285,88 +1644,26 @@ static LRESULT CALLBACK WindowProc(HWND Window, UINT Message, WPARAM WParam, LPA
 
 static bool OnCaptureFrame(ScreenCapture* Capture, ScreenCaptureFrame* Frame)
 {
+	RecordingSession* Session = CONTAINING_RECORD(Capture, RecordingSession, Capture);
+
 	if (Frame == NULL)
 	{
-		PostMessageW(gWindow, WM_WCAP_STOP_CAPTURE, 0, 0);
+		PostMessageW(gWindow, WM_WCAP_STOP_CAPTURE, (WPARAM)(Session - gSessions), (LPARAM)Session->Generation);
 		return true;
 	}
 
-	BOOL DoEncode = TRUE;
-	DWORD LimitFramerate = gRecordingLimitFramerate;
-	if (LimitFramerate != 0)
+	if (CpuLimit_Accept(&Session->Limit, Frame->Time))
 	{
-		if (Frame->Time * LimitFramerate < gRecordingNextEncode)
+		ScreenCaptureFrame Command = *Frame;
+		ScreenCapture_AddFrameRef(&Command);
+		atomic_fetch_add(&Session->QueuedFrames, 1);
+		if (!CpuQueue_Push(&Session->Queue, &Command))
 		{
-			DoEncode = FALSE;
+			// encode thread is too far behind, next frame will be shown longer
+			atomic_fetch_sub(&Session->QueuedFrames, 1);
+			ScreenCapture_ReleaseFrameRef(&Command);
+			Session->DroppedFrames++;
 		}
-		else
-		{
-			if (gRecordingNextEncode == 0)
-			{
-				gRecordingNextEncode = Frame->Time * LimitFramerate;
-			}
-			gRecordingNextEncode += gTickFreq.QuadPart;
-		}
-	}
-
-	// ignore frames if it comes from the past
-	if (Frame->Time <= gRecordingLastFrame)
-	{
-		DoEncode = FALSE;
-	}
-	gRecordingLastFrame = Frame->Time;
-
-	if (DoEncode)
-	{
-		if (!Encoder_NewFrame(&gEncoder, Frame->Texture, Frame->Rect, Frame->Time, gTickFreq.QuadPart))
-		{
-			// TODO: maybe highlight tray icon when droppped frames are increasing too much?
-			gRecordingDroppedFrames++;
-		}
-	}
-
-	if (gConfig.EnableLimitLength || gConfig.EnableLimitSize)
-	{
-		BOOL Stop = FALSE;
-
-		if (gConfig.EnableLimitLength)
-		{
-			if (Frame->Time - gEncoder.StartTime >= (UINT64)(gConfig.LimitLength * gTickFreq.QuadPart))
-			{
-				Stop = TRUE;
-			}
-		}
-		if (gConfig.EnableLimitSize && !Stop)
-		{
-			UINT64 FileSize;
-			DWORD Bitrate, LengthMsec;
-			Encoder_GetStats(&gEncoder, &Bitrate, &LengthMsec, &FileSize);
-
-			// reserve 0.5% for mp4 format overhead (probably an overestimate)
-			if (1000 * FileSize >= (995ULL * gConfig.LimitSize) << 20)
-			{
-				Stop = TRUE;
-			}
-		}
-
-		if (Stop)
-		{
-			PostMessageW(gWindow, WM_WCAP_STOP_CAPTURE, 0, 0);
-			return true;
-		}
-	}
-
-	// update tray title with stats once every second
-	if (gRecordingNextTooltip == 0)
-	{
-		gRecordingNextTooltip = Frame->Time + gTickFreq.QuadPart;
-	}
-	else if (Frame->Time >= gRecordingNextTooltip)
-	{
-		gRecordingNextTooltip += gTickFreq.QuadPart;
-
-		// do the update, but not from frame callback to minimize time when texture is used
-		PostMessageW(gWindow, WM_WCAP_TRAY_TITLE, 0, 0);
 	}
 
 	return true;
@@ -1407,7 +1704,11 @@ void WinMainCRTStartup()
 	Config_Defaults(&gConfig);
 	Config_Load(&gConfig, gConfigPath);
 	ScreenCapture_Create(&gCapture, &OnCaptureFrame, false);
-	Encoder_Init(&gEncoder);
+	for (DWORD Index = 0; Index < WCAP_MAX_SESSIONS; Index++)
+	{
+		gSessions[Index].Capture = gCapture;
+		Encoder_Init(&gSessions[Index].Encoder);
+	}
 
 	QueryPerformanceFrequency(&gTickFreq);
 
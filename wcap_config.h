@@ -15,6 +15,19 @@
 #define CONFIG_VIDEO_HIGH    2
 #define CONFIG_VIDEO_MAIN_10 3
 
+#define CONFIG_RESIZE_BILINEAR    0
+#define CONFIG_RESIZE_AREA        1
+#define CONFIG_RESIZE_CATMULL_ROM 2
+#define CONFIG_RESIZE_MITCHELL    3
+#define CONFIG_RESIZE_LANCZOS3    4
+
+// same values as CpuDropPolicy
+#define CONFIG_DROP_NEWEST       0
+#define CONFIG_DROP_OLDEST       1
+#define CONFIG_DROP_HALF_RATE    2
+#define CONFIG_DROP_SKIP_EXTRAS  3
+#define CONFIG_DROP_AUTO         4
+
 #define CONFIG_AUDIO_AAC  0
 #define CONFIG_AUDIO_FLAC 1
 
@@ -22,6 +35,7 @@ typedef struct
 {
 	// capture
 	BOOL MouseCursor;
+	BOOL MouseCursorOverlay;
 	BOOL OnlyClientArea;
 	BOOL ShowRecordingBorder;
 	BOOL KeepRoundedWindowCorners;
@@ -32,19 +46,28 @@ typedef struct
 	WCHAR OutputFolder[MAX_PATH];
 	BOOL OpenFolder;
 	BOOL FragmentedOutput;
+	BOOL MultipleRecordings;
 	BOOL EnableLimitLength;
 	BOOL EnableLimitSize;
 	DWORD LimitLength;
 	DWORD LimitSize;
 	// video
 	BOOL GammaCorrectResize;
+	DWORD ResizeFilter;
 	BOOL ImprovedColorConversion;
+	BOOL HdrCapture;
+	BOOL SkipDuplicateFrames;
+	BOOL AdaptiveFramerate;
+	BOOL SceneKeyframes;
 	DWORD VideoCodec;
 	DWORD VideoProfile;
 	DWORD VideoMaxWidth;
 	DWORD VideoMaxHeight;
 	DWORD VideoMaxFramerate;
 	DWORD VideoBitrate;
+	DWORD VideoCopyMaxHeight; // 0 when no lower resolution copy is recorded
+	DWORD VideoCopyBitrate;
+	DWORD DropPolicy;
 	// audio
 	BOOL CaptureAudio;
 	BOOL ApplicationLocalAudio;
@@ -88,6 +111,7 @@ static BOOL Config_ShowDialog(Config* C);
 #define ID_DEFAULTS                3
 
 #define ID_MOUSE_CURSOR              20
+#define ID_MOUSE_CURSOR_OVERLAY      25
 #define ID_ONLY_CLIENT_AREA          30
 #define ID_SHOW_RECORDING_BORDER     40
 #define ID_ROUNDED_CORNERS           50
@@ -97,17 +121,26 @@ static BOOL Config_ShowDialog(Config* C);
 #define ID_OUTPUT_FOLDER           100
 #define ID_OPEN_FOLDER             110
 #define ID_FRAGMENTED_MP4          120
+#define ID_MULTIPLE_RECORDINGS     125
 #define ID_LIMIT_LENGTH            130
 #define ID_LIMIT_SIZE              140
 
 #define ID_VIDEO_GAMMA_RESIZE      200
+#define ID_VIDEO_RESIZE_FILTER     205
 #define ID_VIDEO_IMPROVED_CONVERT  210
+#define ID_VIDEO_HDR               215
+#define ID_VIDEO_SKIP_DUPLICATES   217
+#define ID_VIDEO_ADAPTIVE_RATE     218
+#define ID_VIDEO_SCENE_KEYFRAMES   219
 #define ID_VIDEO_CODEC             220
 #define ID_VIDEO_PROFILE           230
 #define ID_VIDEO_MAX_WIDTH         240
 #define ID_VIDEO_MAX_HEIGHT        250
 #define ID_VIDEO_MAX_FRAMERATE     260
 #define ID_VIDEO_BITRATE           270
+#define ID_VIDEO_COPY_MAX_HEIGHT   273
+#define ID_VIDEO_COPY_BITRATE      276
+#define ID_VIDEO_DROP_POLICY       280
 
 #define ID_AUDIO_CAPTURE           300
 #define ID_AUDIO_APPLICATION_LOCAL 310
@@ -138,11 +171,11 @@ static BOOL Config_ShowDialog(Config* C);
 
 // group box width/height
 #define COL00W 120
-#define COL01W 154
-#define COL10W 144
+#define COL01W 174
+#define COL10W 164
 #define COL11W 130
-#define ROW0H 98
-#define ROW1H 124
+#define ROW0H 112
+#define ROW1H 236
 #define ROW2H 56
 
 #define PADDING 4             // padding for dialog and group boxes
@@ -154,6 +187,8 @@ static BOOL Config_ShowDialog(Config* C);
 static const DWORD gAudioBitrates[] = { 96, 128, 160, 192, 0 };
 static const DWORD gAudioSamplerates[] = { 44100, 48000, 0 };
 
+static const LPCWSTR gResizeFilters[] = { L"Bilinear", L"Area", L"CatmullRom", L"Mitchell", L"Lanczos3", NULL };
+static const LPCWSTR gDropPolicies[] = { L"DropNewest", L"ReplaceOldest", L"HalveFramerate", L"SkipExtras", L"Auto", NULL };
 static const LPCWSTR gVideoCodecs[] = { L"H264", L"H265", L"AV1", NULL};
 static const LPCWSTR gVideoProfiles[] = { L"Base", L"Main", L"High", L"Main10", NULL };
 static const LPCWSTR gAudioCodecs[] = { L"AAC", L"FLAC", NULL };
@@ -324,6 +359,7 @@ static void Config__SetDialogValues(HWND Window, Config* C)
 
 	// capture
 	CheckDlgButton(Window, ID_MOUSE_CURSOR,              C->MouseCursor);
+	CheckDlgButton(Window, ID_MOUSE_CURSOR_OVERLAY,      C->MouseCursorOverlay);
 	CheckDlgButton(Window, ID_ONLY_CLIENT_AREA,          C->OnlyClientArea);
 	CheckDlgButton(Window, ID_SHOW_RECORDING_BORDER,     C->ShowRecordingBorder);
 	CheckDlgButton(Window, ID_ROUNDED_CORNERS,           C->KeepRoundedWindowCorners);
@@ -332,23 +368,32 @@ static void Config__SetDialogValues(HWND Window, Config* C)
 	SendDlgItemMessageW(Window, ID_GPU_ENCODER + 1, CB_SETCURSEL, C->HardwarePreferIntegrated ? 0 : 1, 0);
 
 	// output
-	SetDlgItemTextW(Window, ID_OUTPUT_FOLDER,  C->OutputFolder);
-	CheckDlgButton(Window, ID_OPEN_FOLDER,     C->OpenFolder);
-	CheckDlgButton(Window, ID_FRAGMENTED_MP4,  C->FragmentedOutput);
-	CheckDlgButton(Window, ID_LIMIT_LENGTH,    C->EnableLimitLength);
-	CheckDlgButton(Window, ID_LIMIT_SIZE,      C->EnableLimitSize);
+	SetDlgItemTextW(Window, ID_OUTPUT_FOLDER,       C->OutputFolder);
+	CheckDlgButton(Window, ID_OPEN_FOLDER,          C->OpenFolder);
+	CheckDlgButton(Window, ID_FRAGMENTED_MP4,       C->FragmentedOutput);
+	CheckDlgButton(Window, ID_MULTIPLE_RECORDINGS,  C->MultipleRecordings);
+	CheckDlgButton(Window, ID_LIMIT_LENGTH,         C->EnableLimitLength);
+	CheckDlgButton(Window, ID_LIMIT_SIZE,           C->EnableLimitSize);
 	SetDlgItemInt(Window, ID_LIMIT_LENGTH + 1, C->LimitLength, FALSE);
 	SetDlgItemInt(Window, ID_LIMIT_SIZE + 1,   C->LimitSize,   FALSE);
 
 	// video
 	CheckDlgButton(Window, ID_VIDEO_GAMMA_RESIZE,     C->GammaCorrectResize);
+	SendDlgItemMessageW(Window, ID_VIDEO_RESIZE_FILTER, CB_SETCURSEL, C->ResizeFilter, 0);
 	CheckDlgButton(Window, ID_VIDEO_IMPROVED_CONVERT, C->ImprovedColorConversion);
+	CheckDlgButton(Window, ID_VIDEO_HDR,              C->HdrCapture);
+	CheckDlgButton(Window, ID_VIDEO_SKIP_DUPLICATES,  C->SkipDuplicateFrames);
+	CheckDlgButton(Window, ID_VIDEO_ADAPTIVE_RATE,    C->AdaptiveFramerate);
+	CheckDlgButton(Window, ID_VIDEO_SCENE_KEYFRAMES,  C->SceneKeyframes);
 	SendDlgItemMessageW(Window, ID_VIDEO_CODEC, CB_SETCURSEL, C->VideoCodec, 0);
 	Config__SelectVideoProfile(Window, C->VideoCodec, C->VideoProfile);
 	SetDlgItemInt(Window, ID_VIDEO_MAX_WIDTH,     C->VideoMaxWidth,     FALSE);
 	SetDlgItemInt(Window, ID_VIDEO_MAX_HEIGHT,    C->VideoMaxHeight,    FALSE);
 	SetDlgItemInt(Window, ID_VIDEO_MAX_FRAMERATE, C->VideoMaxFramerate, FALSE);
 	SetDlgItemInt(Window, ID_VIDEO_BITRATE,       C->VideoBitrate,      FALSE);
+	SetDlgItemInt(Window, ID_VIDEO_COPY_MAX_HEIGHT, C->VideoCopyMaxHeight, FALSE);
+	SetDlgItemInt(Window, ID_VIDEO_COPY_BITRATE,    C->VideoCopyBitrate,   FALSE);
+	SendDlgItemMessageW(Window, ID_VIDEO_DROP_POLICY, CB_SETCURSEL, C->DropPolicy, 0);
 
 	// audio
 	CheckDlgButton(Window, ID_AUDIO_CAPTURE, C->CaptureAudio);
@@ -383,8 +428,10 @@ static void Config__SetDialogValues(HWND Window, Config* C)
 	EnableWindow(GetDlgItem(Window, ID_GPU_ENCODER + 1),  C->HardwareEncoder);
 	EnableWindow(GetDlgItem(Window, ID_LIMIT_LENGTH + 1), C->EnableLimitLength);
 	EnableWindow(GetDlgItem(Window, ID_LIMIT_SIZE + 1),   C->EnableLimitSize);
+	EnableWindow(GetDlgItem(Window, ID_VIDEO_ADAPTIVE_RATE), C->SkipDuplicateFrames);
 
 	EnableWindow(GetDlgItem(Window, ID_MOUSE_CURSOR),              ScreenCapture_CanHideMouseCursor());
+	EnableWindow(GetDlgItem(Window, ID_MOUSE_CURSOR_OVERLAY),      ScreenCapture_CanHideMouseCursor() && C->MouseCursor);
 	EnableWindow(GetDlgItem(Window, ID_SHOW_RECORDING_BORDER),     ScreenCapture_CanHideRecordingBorder());
 	EnableWindow(GetDlgItem(Window, ID_ROUNDED_CORNERS),           ScreenCapture_CanDisableRoundedCorners());
 	EnableWindow(GetDlgItem(Window, ID_INCLUDE_SECONDARY_WINDOWS), ScreenCapture_CanIncludeSecondaryWindows());
@@ -457,10 +504,22 @@ static LRESULT CALLBACK Config__DialogProc(HWND Window, UINT Message, WPARAM WPa
 		Config* C = (Config*)LParam;
 		SetWindowLongPtrW(Window, GWLP_USERDATA, (LONG_PTR)C);
 
+		SendDlgItemMessageW(Window, ID_VIDEO_RESIZE_FILTER, CB_ADDSTRING, 0, (LPARAM)L"Bilinear");
+		SendDlgItemMessageW(Window, ID_VIDEO_RESIZE_FILTER, CB_ADDSTRING, 0, (LPARAM)L"Area");
+		SendDlgItemMessageW(Window, ID_VIDEO_RESIZE_FILTER, CB_ADDSTRING, 0, (LPARAM)L"Catmull-Rom");
+		SendDlgItemMessageW(Window, ID_VIDEO_RESIZE_FILTER, CB_ADDSTRING, 0, (LPARAM)L"Mitchell");
+		SendDlgItemMessageW(Window, ID_VIDEO_RESIZE_FILTER, CB_ADDSTRING, 0, (LPARAM)L"Lanczos-3");
+
 		SendDlgItemMessageW(Window, ID_VIDEO_CODEC, CB_ADDSTRING, 0, (LPARAM)L"H264 / AVC");
 		SendDlgItemMessageW(Window, ID_VIDEO_CODEC, CB_ADDSTRING, 0, (LPARAM)L"H265 / HEVC");
 		SendDlgItemMessageW(Window, ID_VIDEO_CODEC, CB_ADDSTRING, 0, (LPARAM)L"AV1");
 
+		SendDlgItemMessageW(Window, ID_VIDEO_DROP_POLICY, CB_ADDSTRING, 0, (LPARAM)L"Drop New");
+		SendDlgItemMessageW(Window, ID_VIDEO_DROP_POLICY, CB_ADDSTRING, 0, (LPARAM)L"Drop Old");
+		SendDlgItemMessageW(Window, ID_VIDEO_DROP_POLICY, CB_ADDSTRING, 0, (LPARAM)L"Half Rate");
+		SendDlgItemMessageW(Window, ID_VIDEO_DROP_POLICY, CB_ADDSTRING, 0, (LPARAM)L"No Extras");
+		SendDlgItemMessageW(Window, ID_VIDEO_DROP_POLICY, CB_ADDSTRING, 0, (LPARAM)L"Auto");
+
 		SendDlgItemMessageW(Window, ID_AUDIO_CODEC, CB_ADDSTRING, 0, (LPARAM)L"AAC");
 		SendDlgItemMessageW(Window, ID_AUDIO_CODEC, CB_ADDSTRING, 0, (LPARAM)L"FLAC");
 
@@ -492,6 +551,7 @@ static LRESULT CALLBACK Config__DialogProc(HWND Window, UINT Message, WPARAM WPa
 		{
 			// capture
 			C->MouseCursor              = IsDlgButtonChecked(Window, ID_MOUSE_CURSOR);
+			C->MouseCursorOverlay       = IsDlgButtonChecked(Window, ID_MOUSE_CURSOR_OVERLAY);
 			C->OnlyClientArea           = IsDlgButtonChecked(Window, ID_ONLY_CLIENT_AREA);
 			C->ShowRecordingBorder      = IsDlgButtonChecked(Window, ID_SHOW_RECORDING_BORDER);
 			C->KeepRoundedWindowCorners = IsDlgButtonChecked(Window, ID_ROUNDED_CORNERS);
@@ -501,21 +561,30 @@ static LRESULT CALLBACK Config__DialogProc(HWND Window, UINT Message, WPARAM WPa
 
 			// output
 			GetDlgItemTextW(Window, ID_OUTPUT_FOLDER, C->OutputFolder, _countof(C->OutputFolder));
-			C->OpenFolder        = IsDlgButtonChecked(Window, ID_OPEN_FOLDER);
-			C->FragmentedOutput  = IsDlgButtonChecked(Window, ID_FRAGMENTED_MP4);
-			C->EnableLimitLength = IsDlgButtonChecked(Window, ID_LIMIT_LENGTH);
-			C->EnableLimitSize   = IsDlgButtonChecked(Window, ID_LIMIT_SIZE);
+			C->OpenFolder         = IsDlgButtonChecked(Window, ID_OPEN_FOLDER);
+			C->FragmentedOutput   = IsDlgButtonChecked(Window, ID_FRAGMENTED_MP4);
+			C->MultipleRecordings = IsDlgButtonChecked(Window, ID_MULTIPLE_RECORDINGS);
+			C->EnableLimitLength  = IsDlgButtonChecked(Window, ID_LIMIT_LENGTH);
+			C->EnableLimitSize    = IsDlgButtonChecked(Window, ID_LIMIT_SIZE);
 			C->LimitLength       = GetDlgItemInt(Window,      ID_LIMIT_LENGTH + 1, NULL, FALSE);
 			C->LimitSize         = GetDlgItemInt(Window,      ID_LIMIT_SIZE + 1,   NULL, FALSE);
 			// video
 			C->GammaCorrectResize      = IsDlgButtonChecked(Window, ID_VIDEO_GAMMA_RESIZE);
+			C->ResizeFilter            = (DWORD)SendDlgItemMessageW(Window, ID_VIDEO_RESIZE_FILTER, CB_GETCURSEL, 0, 0);
 			C->ImprovedColorConversion = IsDlgButtonChecked(Window, ID_VIDEO_IMPROVED_CONVERT);
+			C->HdrCapture              = IsDlgButtonChecked(Window, ID_VIDEO_HDR);
+			C->SkipDuplicateFrames     = IsDlgButtonChecked(Window, ID_VIDEO_SKIP_DUPLICATES);
+			C->AdaptiveFramerate       = IsDlgButtonChecked(Window, ID_VIDEO_ADAPTIVE_RATE);
+			C->SceneKeyframes          = IsDlgButtonChecked(Window, ID_VIDEO_SCENE_KEYFRAMES);
 			C->VideoCodec              = (DWORD)SendDlgItemMessageW(Window, ID_VIDEO_CODEC,   CB_GETCURSEL, 0, 0);
 			C->VideoProfile            = Config__GetSelectedVideoProfile(Window);
 			C->VideoMaxWidth           = GetDlgItemInt(Window, ID_VIDEO_MAX_WIDTH,     NULL, FALSE);
 			C->VideoMaxHeight          = GetDlgItemInt(Window, ID_VIDEO_MAX_HEIGHT,    NULL, FALSE);
 			C->VideoMaxFramerate       = GetDlgItemInt(Window, ID_VIDEO_MAX_FRAMERATE, NULL, FALSE);
 			C->VideoBitrate            = GetDlgItemInt(Window, ID_VIDEO_BITRATE,       NULL, FALSE);
+			C->VideoCopyMaxHeight      = GetDlgItemInt(Window, ID_VIDEO_COPY_MAX_HEIGHT, NULL, FALSE);
+			C->VideoCopyBitrate        = GetDlgItemInt(Window, ID_VIDEO_COPY_BITRATE,    NULL, FALSE);
+			C->DropPolicy              = (DWORD)SendDlgItemMessageW(Window, ID_VIDEO_DROP_POLICY, CB_GETCURSEL, 0, 0);
 			// audio
 			C->CaptureAudio          = IsDlgButtonChecked(Window, ID_AUDIO_CAPTURE);
 			C->ApplicationLocalAudio = IsDlgButtonChecked(Window, ID_AUDIO_APPLICATION_LOCAL);
@@ -564,6 +633,12 @@ static LRESULT CALLBACK Config__DialogProc(HWND Window, UINT Message, WPARAM WPa
 			Config__UpdateAudioBitrate(Window, (DWORD)Index, C->AudioBitrate);
 			return TRUE;
 		}
+		else if (Control == ID_MOUSE_CURSOR && HIWORD(WParam) == BN_CLICKED)
+		{
+			// overlay draws cursor that is not captured
+			EnableWindow(GetDlgItem(Window, ID_MOUSE_CURSOR_OVERLAY), (BOOL)SendDlgItemMessageW(Window, ID_MOUSE_CURSOR, BM_GETCHECK, 0, 0));
+			return TRUE;
+		}
 		else if (Control == ID_GPU_ENCODER && HIWORD(WParam) == BN_CLICKED)
 		{
 			EnableWindow(GetDlgItem(Window, ID_GPU_ENCODER + 1), (BOOL)SendDlgItemMessageW(Window, ID_GPU_ENCODER, BM_GETCHECK, 0, 0));
@@ -579,6 +654,12 @@ static LRESULT CALLBACK Config__DialogProc(HWND Window, UINT Message, WPARAM WPa
 			EnableWindow(GetDlgItem(Window, ID_LIMIT_SIZE + 1), (BOOL)SendDlgItemMessageW(Window, ID_LIMIT_SIZE, BM_GETCHECK, 0, 0));
 			return TRUE;
 		}
+		else if (Control == ID_VIDEO_SKIP_DUPLICATES && HIWORD(WParam) == BN_CLICKED)
+		{
+			// adaptive framerate uses same frame hashes as skipping duplicates
+			EnableWindow(GetDlgItem(Window, ID_VIDEO_ADAPTIVE_RATE), (BOOL)SendDlgItemMessageW(Window, ID_VIDEO_SKIP_DUPLICATES, BM_GETCHECK, 0, 0));
+			return TRUE;
+		}
 		else if (Control == ID_OUTPUT_FOLDER + 1)
 		{
 			// this expects caller has called CoInitializeEx with single or apartment-threaded model
@@ -850,6 +931,7 @@ void Config_Defaults(Config* C)
 	{
 		// capture
 		.MouseCursor = TRUE,
+		.MouseCursorOverlay = FALSE,
 		.OnlyClientArea = TRUE,
 		.ShowRecordingBorder = TRUE,
 		.KeepRoundedWindowCorners = TRUE,
@@ -859,19 +941,28 @@ void Config_Defaults(Config* C)
 		// output
 		.OpenFolder = TRUE,
 		.FragmentedOutput = FALSE,
+		.MultipleRecordings = FALSE,
 		.EnableLimitLength = FALSE,
 		.EnableLimitSize = FALSE,
 		.LimitLength = 60,
 		.LimitSize = 25,
 		// video
 		.GammaCorrectResize = FALSE,
+		.ResizeFilter = CONFIG_RESIZE_MITCHELL,
 		.ImprovedColorConversion = FALSE,
+		.HdrCapture = FALSE,
+		.SkipDuplicateFrames = FALSE,
+		.AdaptiveFramerate = FALSE,
+		.SceneKeyframes = FALSE,
 		.VideoCodec = CONFIG_VIDEO_H264,
 		.VideoProfile = CONFIG_VIDEO_HIGH,
 		.VideoMaxWidth = 1920,
 		.VideoMaxHeight = 1080,
 		.VideoMaxFramerate = 60,
 		.VideoBitrate = 8000,
+		.VideoCopyMaxHeight = 0,
+		.VideoCopyBitrate = 2500,
+		.DropPolicy = CONFIG_DROP_NEWEST,
 		// audio
 		.CaptureAudio = TRUE,
 		.ApplicationLocalAudio = TRUE,
@@ -958,6 +1049,7 @@ void Config_Load(Config* C, LPCWSTR FileName)
 {
 	// capture
 	Config__GetBool(FileName, L"MouseCursor",              &C->MouseCursor);
+	Config__GetBool(FileName, L"MouseCursorOverlay",       &C->MouseCursorOverlay);
 	Config__GetBool(FileName, L"OnlyClientArea",           &C->OnlyClientArea);
 	Config__GetBool(FileName, L"ShowRecordingBorder",      &C->ShowRecordingBorder);
 	Config__GetBool(FileName, L"KeepRoundedWindowCorners", &C->KeepRoundedWindowCorners);
@@ -968,21 +1060,30 @@ void Config_Load(Config* C, LPCWSTR FileName)
 	WCHAR OutputFolder[MAX_PATH];
 	GetPrivateProfileStringW(INI_SECTION, L"OutputFolder", L"", OutputFolder, _countof(OutputFolder), FileName);
 	if (OutputFolder[0]) StrCpyW(C->OutputFolder, OutputFolder);
-	Config__GetBool(FileName, L"OpenFolder",        &C->OpenFolder);
-	Config__GetBool(FileName, L"FragmentedOutput",  &C->FragmentedOutput);
-	Config__GetBool(FileName, L"EnableLimitLength", &C->EnableLimitLength);
-	Config__GetBool(FileName, L"EnableLimitSize",   &C->EnableLimitSize);
-	Config__GetInt(FileName,  L"LimitLength",       &C->LimitLength, NULL);
-	Config__GetInt(FileName,  L"LimitSize",         &C->LimitSize,   NULL);
+	Config__GetBool(FileName, L"OpenFolder",         &C->OpenFolder);
+	Config__GetBool(FileName, L"FragmentedOutput",   &C->FragmentedOutput);
+	Config__GetBool(FileName, L"MultipleRecordings", &C->MultipleRecordings);
+	Config__GetBool(FileName, L"EnableLimitLength",  &C->EnableLimitLength);
+	Config__GetBool(FileName, L"EnableLimitSize",    &C->EnableLimitSize);
+	Config__GetInt(FileName,  L"LimitLength",        &C->LimitLength, NULL);
+	Config__GetInt(FileName,  L"LimitSize",          &C->LimitSize,   NULL);
 	// video
 	Config__GetBool(FileName, L"GammaCorrectResize",      &C->GammaCorrectResize);
+	Config__GetStr(FileName, L"ResizeFilter",             &C->ResizeFilter,      gResizeFilters);
 	Config__GetBool(FileName, L"ImprovedColorConversion", &C->ImprovedColorConversion);
+	Config__GetBool(FileName, L"HdrCapture",              &C->HdrCapture);
+	Config__GetBool(FileName, L"SkipDuplicateFrames",     &C->SkipDuplicateFrames);
+	Config__GetBool(FileName, L"AdaptiveFramerate",       &C->AdaptiveFramerate);
+	Config__GetBool(FileName, L"SceneKeyframes",          &C->SceneKeyframes);
 	Config__GetStr(FileName, L"VideoCodec",               &C->VideoCodec,        gVideoCodecs);
 	Config__GetStr(FileName, L"VideoProfile",             &C->VideoProfile,      gVideoProfiles);
 	Config__GetInt(FileName, L"VideoMaxWidth",            &C->VideoMaxWidth,     NULL);
 	Config__GetInt(FileName, L"VideoMaxHeight",           &C->VideoMaxHeight,    NULL);
 	Config__GetInt(FileName, L"VideoMaxFramerate",        &C->VideoMaxFramerate, NULL);
 	Config__GetInt(FileName, L"VideoBitrate",             &C->VideoBitrate,      NULL);
+	Config__GetInt(FileName, L"VideoCopyMaxHeight",       &C->VideoCopyMaxHeight, NULL);
+	Config__GetInt(FileName, L"VideoCopyBitrate",         &C->VideoCopyBitrate,   NULL);
+	Config__GetStr(FileName, L"DropPolicy",               &C->DropPolicy,        gDropPolicies);
 	// audio
 	Config__GetBool(FileName, L"CaptureAudio",          &C->CaptureAudio);
 	Config__GetBool(FileName, L"ApplicationLocalAudio", &C->ApplicationLocalAudio);
@@ -1009,6 +1110,7 @@ void Config_Save(Config* C, LPCWSTR FileName)
 {
 	// capture
 	WritePrivateProfileStringW(INI_SECTION, L"MouseCursor",              C->MouseCursor              ? L"1" : L"0", FileName);
+	WritePrivateProfileStringW(INI_SECTION, L"MouseCursorOverlay",       C->MouseCursorOverlay       ? L"1" : L"0", FileName);
 	WritePrivateProfileStringW(INI_SECTION, L"OnlyClientArea",           C->OnlyClientArea           ? L"1" : L"0", FileName);
 	WritePrivateProfileStringW(INI_SECTION, L"ShowRecordingBorder",      C->ShowRecordingBorder      ? L"1" : L"0", FileName);
 	WritePrivateProfileStringW(INI_SECTION, L"KeepRoundedWindowCorners", C->KeepRoundedWindowCorners ? L"1" : L"0", FileName);
@@ -1016,22 +1118,31 @@ void Config_Save(Config* C, LPCWSTR FileName)
 	WritePrivateProfileStringW(INI_SECTION, L"HardwareEncoder",          C->HardwareEncoder          ? L"1" : L"0", FileName);
 	WritePrivateProfileStringW(INI_SECTION, L"HardwarePreferIntegrated", C->HardwarePreferIntegrated ? L"1" : L"0", FileName);
 	// output
-	WritePrivateProfileStringW(INI_SECTION, L"OutputFolder",      C->OutputFolder, FileName);
-	WritePrivateProfileStringW(INI_SECTION, L"OpenFolder",        C->OpenFolder        ? L"1" : L"0", FileName);
-	WritePrivateProfileStringW(INI_SECTION, L"FragmentedOutput",  C->FragmentedOutput  ? L"1" : L"0", FileName);
-	WritePrivateProfileStringW(INI_SECTION, L"EnableLimitLength", C->EnableLimitLength ? L"1" : L"0", FileName);
-	WritePrivateProfileStringW(INI_SECTION, L"EnableLimitSize",   C->EnableLimitSize   ? L"1" : L"0", FileName);
+	WritePrivateProfileStringW(INI_SECTION, L"OutputFolder",       C->OutputFolder, FileName);
+	WritePrivateProfileStringW(INI_SECTION, L"OpenFolder",         C->OpenFolder         ? L"1" : L"0", FileName);
+	WritePrivateProfileStringW(INI_SECTION, L"FragmentedOutput",   C->FragmentedOutput   ? L"1" : L"0", FileName);
+	WritePrivateProfileStringW(INI_SECTION, L"MultipleRecordings", C->MultipleRecordings ? L"1" : L"0", FileName);
+	WritePrivateProfileStringW(INI_SECTION, L"EnableLimitLength",  C->EnableLimitLength  ? L"1" : L"0", FileName);
+	WritePrivateProfileStringW(INI_SECTION, L"EnableLimitSize",    C->EnableLimitSize    ? L"1" : L"0", FileName);
 	Config__WriteInt(FileName, L"LimitLength", C->LimitLength);
 	Config__WriteInt(FileName, L"LimitSize", C->LimitSize);
 	// video
 	WritePrivateProfileStringW(INI_SECTION, L"GammaCorrectResize",      C->GammaCorrectResize      ? L"1" : L"0", FileName);
+	WritePrivateProfileStringW(INI_SECTION, L"ResizeFilter", gResizeFilters[C->ResizeFilter], FileName);
 	WritePrivateProfileStringW(INI_SECTION, L"ImprovedColorConversion", C->ImprovedColorConversion ? L"1" : L"0", FileName);
+	WritePrivateProfileStringW(INI_SECTION, L"HdrCapture",              C->HdrCapture              ? L"1" : L"0", FileName);
+	WritePrivateProfileStringW(INI_SECTION, L"SkipDuplicateFrames",     C->SkipDuplicateFrames     ? L"1" : L"0", FileName);
+	WritePrivateProfileStringW(INI_SECTION, L"AdaptiveFramerate",       C->AdaptiveFramerate       ? L"1" : L"0", FileName);
+	WritePrivateProfileStringW(INI_SECTION, L"SceneKeyframes",          C->SceneKeyframes          ? L"1" : L"0", FileName);
 	WritePrivateProfileStringW(INI_SECTION, L"VideoCodec",   gVideoCodecs[C->VideoCodec],     FileName);
 	WritePrivateProfileStringW(INI_SECTION, L"VideoProfile", gVideoProfiles[C->VideoProfile], FileName);
 	Config__WriteInt(FileName, L"VideoMaxWidth",     C->VideoMaxWidth);
 	Config__WriteInt(FileName, L"VideoMaxHeight",    C->VideoMaxHeight);
 	Config__WriteInt(FileName, L"VideoMaxFramerate", C->VideoMaxFramerate);
 	Config__WriteInt(FileName, L"VideoBitrate",      C->VideoBitrate);
+	Config__WriteInt(FileName, L"VideoCopyMaxHeight", C->VideoCopyMaxHeight);
+	Config__WriteInt(FileName, L"VideoCopyBitrate",  C->VideoCopyBitrate);
+	WritePrivateProfileStringW(INI_SECTION, L"DropPolicy", gDropPolicies[C->DropPolicy], FileName);
 	// audio
 	WritePrivateProfileStringW(INI_SECTION, L"CaptureAudio",          C->CaptureAudio          ? L"1" : L"0", FileName);
 	WritePrivateProfileStringW(INI_SECTION, L"ApplicationLocalAudio", C->ApplicationLocalAudio ? L"1" : L"0", FileName);
@@ -1066,6 +1177,7 @@ BOOL Config_ShowDialog(Config* C)
 				.Items = (Config__DialogItem[])
 				{
 					{ "&Mouse Cursor",                ID_MOUSE_CURSOR,              ITEM_CHECKBOX                     },
+					{ "Draw Cursor in E&xtra Pass",   ID_MOUSE_CURSOR_OVERLAY,      ITEM_CHECKBOX                     },
 					{ "Only &Client Area",            ID_ONLY_CLIENT_AREA,          ITEM_CHECKBOX                     },
 					{ "Show Recording &Border",       ID_SHOW_RECORDING_BORDER,     ITEM_CHECKBOX                     },
 					{ "Keep &Rounded Window Corners", ID_ROUNDED_CORNERS,           ITEM_CHECKBOX                     },
@@ -1079,11 +1191,12 @@ BOOL Config_ShowDialog(Config* C)
 				.Rect = { COL00W + PADDING, 0, COL01W, ROW0H },
 				.Items = (Config__DialogItem[])
 				{
-					{ "",                            ID_OUTPUT_FOLDER,  ITEM_FOLDER                     },
-					{ "O&pen When Finished",         ID_OPEN_FOLDER,    ITEM_CHECKBOX                   },
-					{ "Fragmented MP&4 (H264 only)", ID_FRAGMENTED_MP4, ITEM_CHECKBOX                   },
-					{ "Limit &Length (seconds)",     ID_LIMIT_LENGTH,   ITEM_CHECKBOX | ITEM_NUMBER, 80 },
-					{ "Limit &Size (MB)",            ID_LIMIT_SIZE,     ITEM_CHECKBOX | ITEM_NUMBER, 80 },
+					{ "",                               ID_OUTPUT_FOLDER,       ITEM_FOLDER                     },
+					{ "O&pen When Finished",            ID_OPEN_FOLDER,         ITEM_CHECKBOX                   },
+					{ "Fragmented MP&4 (H264 only)",    ID_FRAGMENTED_MP4,      ITEM_CHECKBOX                   },
+					{ "Multiple Recordings (Up to &8)", ID_MULTIPLE_RECORDINGS, ITEM_CHECKBOX                   },
+					{ "Limit &Length (seconds)",        ID_LIMIT_LENGTH,        ITEM_CHECKBOX | ITEM_NUMBER, 80 },
+					{ "Limit &Size (MB)",               ID_LIMIT_SIZE,          ITEM_CHECKBOX | ITEM_NUMBER, 80 },
 					{ NULL },
 				},
 			},
@@ -1092,14 +1205,22 @@ BOOL Config_ShowDialog(Config* C)
 				.Rect = { 0, ROW0H, COL10W, ROW1H },
 				.Items = (Config__DialogItem[])
 				{
-					{ "&Gamma Correct Resize",      ID_VIDEO_GAMMA_RESIZE ,    ITEM_CHECKBOX     },
-					{ "&Improved Color Conversion", ID_VIDEO_IMPROVED_CONVERT, ITEM_CHECKBOX     },
-					{ "Codec",                      ID_VIDEO_CODEC,            ITEM_COMBOBOX, 64 },
-					{ "Profile",                    ID_VIDEO_PROFILE,          ITEM_COMBOBOX, 64 },
-					{ "Max &Width",                 ID_VIDEO_MAX_WIDTH,        ITEM_NUMBER,   64 },
-					{ "Max &Height",                ID_VIDEO_MAX_HEIGHT,       ITEM_NUMBER,   64 },
-					{ "Max &Framerate",             ID_VIDEO_MAX_FRAMERATE,    ITEM_NUMBER,   64 },
-					{ "Bitrate (kbit/s)",           ID_VIDEO_BITRATE,          ITEM_NUMBER,   64 },
+					{ "&Gamma Correct Resize",        ID_VIDEO_GAMMA_RESIZE ,    ITEM_CHECKBOX     },
+					{ "Resi&ze Filter",               ID_VIDEO_RESIZE_FILTER,    ITEM_COMBOBOX, 84 },
+					{ "&Improved Color Conversion",   ID_VIDEO_IMPROVED_CONVERT, ITEM_CHECKBOX     },
+					{ "HDR Capture (&10-bit only)",   ID_VIDEO_HDR,              ITEM_CHECKBOX     },
+					{ "Skip D&uplicate Frames",       ID_VIDEO_SKIP_DUPLICATES,  ITEM_CHECKBOX     },
+					{ "Ad&just Framerate to Changes", ID_VIDEO_ADAPTIVE_RATE,    ITEM_CHECKBOX     },
+					{ "&Keyframes on Scene Change",   ID_VIDEO_SCENE_KEYFRAMES,  ITEM_CHECKBOX     },
+					{ "Codec",                        ID_VIDEO_CODEC,            ITEM_COMBOBOX, 84 },
+					{ "Profile",                      ID_VIDEO_PROFILE,          ITEM_COMBOBOX, 84 },
+					{ "Max &Width",                   ID_VIDEO_MAX_WIDTH,        ITEM_NUMBER,   84 },
+					{ "Max &Height",                  ID_VIDEO_MAX_HEIGHT,       ITEM_NUMBER,   84 },
+					{ "Max &Framerate",               ID_VIDEO_MAX_FRAMERATE,    ITEM_NUMBER,   84 },
+					{ "Bitrate (kbit/s)",             ID_VIDEO_BITRATE,          ITEM_NUMBER,   84 },
+					{ "Copy Max Height",              ID_VIDEO_COPY_MAX_HEIGHT,  ITEM_NUMBER,   84 },
+					{ "Copy Bitrate (kbit/s)",        ID_VIDEO_COPY_BITRATE,     ITEM_NUMBER,   84 },
+					{ "When &Queue Is Full",          ID_VIDEO_DROP_POLICY,      ITEM_COMBOBOX, 84 },
 					{ NULL },
 				},
 			},
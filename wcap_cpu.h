@@ -0,0 +1,274 @@
+#pragma once
+
+// CPU side helpers that do not depend on D3D11 or Media Foundation
+// code using only this header can be compiled & tested on other platforms too
+
+#if !defined(_WIN32) && !defined(_GNU_SOURCE)
+#	define _GNU_SOURCE // for sysconf & syscall, so this header must be included before system headers
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+
+#if defined(_WIN32)
+#	include <windows.h>
+#else
+#	include <stdlib.h>
+#	include <unistd.h>
+#	include <sched.h>
+#	include <pthread.h>
+#	if defined(__linux__)
+#		include <linux/futex.h>
+#		include <sys/syscall.h>
+#	endif
+#endif
+
+#if defined(_M_AMD64) || defined(__x86_64__)
+#	define CPU_X64 1
+#	include <immintrin.h>
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#	define CPU_ARM64 1
+#	include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#	include <intrin.h>
+#	define CPU_TARGET(Target)
+#	define CPU_INLINE static __forceinline
+#else
+#	define CPU_TARGET(Target) __attribute__((target(Target)))
+#	define CPU_INLINE static inline __attribute__((always_inline))
+#endif
+
+#ifndef Assert
+#	if defined(NDEBUG)
+#		define Assert(Cond) (void)(Cond)
+#	else
+#		include <assert.h>
+#		define Assert(Cond) assert(Cond)
+#	endif
+#endif
+
+//
+// interface
+//
+
+#define CPU_CACHE_LINE 64
+
+typedef enum
+{
+	CpuKernel_Auto,   // best one available on current CPU
+	CpuKernel_Scalar, // reference implementation
+	CpuKernel_SSE41,
+	CpuKernel_AVX2,   // AVX2 + FMA
+	CpuKernel_NEON,
+}
+CpuKernel;
+
+// returns Kernel if current CPU supports it, otherwise best supported one
+static CpuKernel Cpu_SelectKernel(CpuKernel Kernel);
+
+// allocated memory is zeroed & aligned at least to CPU_CACHE_LINE
+static void* Cpu_Alloc(size_t Size);
+static void Cpu_Free(void* Memory);
+
+// logical processors available to process
+static uint32_t Cpu_GetProcessorCount(void);
+
+// blocks while *Address is equal to Value, can return spuriously so always check value again
+static void Cpu_Wait(_Atomic(uint32_t)* Address, uint32_t Value);
+static void Cpu_WakeAll(_Atomic(uint32_t)* Address);
+
+typedef void CpuThread_Func(void* Arg);
+
+typedef struct
+{
+#if defined(_WIN32)
+	HANDLE Handle;
+#else
+	pthread_t Handle;
+#endif
+	CpuThread_Func* Func;
+	void* Arg;
+}
+CpuThread;
+
+// Thread must stay in same place in memory until it is joined
+static void CpuThread_Create(CpuThread* Thread, CpuThread_Func* Func, void* Arg);
+static void CpuThread_Join(CpuThread* Thread);
+
+//
+// implementation
+//
+
+static bool Cpu__IsSupported(CpuKernel Kernel)
+{
+	switch (Kernel)
+	{
+	case CpuKernel_Scalar:
+		return true;
+
+#if defined(CPU_X64)
+#if defined(_MSC_VER) && !defined(__clang__)
+	case CpuKernel_SSE41:
+	{
+		int Info[4];
+		__cpuid(Info, 1);
+		return (Info[2] & (1 << 19)) != 0;
+	}
+	case CpuKernel_AVX2:
+	{
+		int Info[4];
+		__cpuid(Info, 1);
+		bool HasFma = (Info[2] & (1 << 12)) != 0;
+		bool HasOsxsave = (Info[2] & (1 << 27)) != 0;
+		bool HasAvx = (Info[2] & (1 << 28)) != 0;
+		if (!HasFma || !HasOsxsave || !HasAvx || (_xgetbv(0) & 6) != 6)
+		{
+			return false;
+		}
+		__cpuidex(Info, 7, 0);
+		return (Info[1] & (1 << 5)) != 0;
+	}
+#else
+	case CpuKernel_SSE41:
+		return __builtin_cpu_supports("sse4.1");
+	case CpuKernel_AVX2:
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+#endif
+
+#if defined(CPU_ARM64)
+	case CpuKernel_NEON:
+		return true;
+#endif
+
+	default:
+		return false;
+	}
+}
+
+CpuKernel Cpu_SelectKernel(CpuKernel Kernel)
+{
+	if (Kernel != CpuKernel_Auto && Cpu__IsSupported(Kernel))
+	{
+		return Kernel;
+	}
+
+	static const CpuKernel Preferred[] = { CpuKernel_AVX2, CpuKernel_SSE41, CpuKernel_NEON };
+	for (size_t Index = 0; Index < sizeof(Preferred) / sizeof(*Preferred); Index++)
+	{
+		if (Cpu__IsSupported(Preferred[Index]))
+		{
+			return Preferred[Index];
+		}
+	}
+	return CpuKernel_Scalar;
+}
+
+void* Cpu_Alloc(size_t Size)
+{
+#if defined(_WIN32)
+	// page aligned & zeroed, this does not require CRT to be initialized
+	void* Memory = VirtualAlloc(NULL, Size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+	size_t AlignedSize = (Size + CPU_CACHE_LINE - 1) & ~(size_t)(CPU_CACHE_LINE - 1);
+	void* Memory = aligned_alloc(CPU_CACHE_LINE, AlignedSize);
+	if (Memory)
+	{
+		memset(Memory, 0, AlignedSize);
+	}
+#endif
+	Assert(Memory);
+	return Memory;
+}
+
+void Cpu_Free(void* Memory)
+{
+	if (Memory)
+	{
+#if defined(_WIN32)
+		VirtualFree(Memory, 0, MEM_RELEASE);
+#else
+		free(Memory);
+#endif
+	}
+}
+
+uint32_t Cpu_GetProcessorCount(void)
+{
+#if defined(_WIN32)
+	DWORD Count = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+#else
+	long Count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	return Count > 0 ? (uint32_t)Count : 1;
+}
+
+void Cpu_Wait(_Atomic(uint32_t)* Address, uint32_t Value)
+{
+#if defined(_WIN32)
+	WaitOnAddress((volatile void*)Address, &Value, sizeof(Value), INFINITE);
+#elif defined(__linux__)
+	syscall(SYS_futex, (uint32_t*)Address, FUTEX_WAIT_PRIVATE, Value, NULL, NULL, 0);
+#else
+	if (atomic_load(Address) == Value)
+	{
+		sched_yield();
+	}
+#endif
+}
+
+void Cpu_WakeAll(_Atomic(uint32_t)* Address)
+{
+#if defined(_WIN32)
+	WakeByAddressAll((void*)Address);
+#elif defined(__linux__)
+	syscall(SYS_futex, (uint32_t*)Address, FUTEX_WAKE_PRIVATE, INT32_MAX, NULL, NULL, 0);
+#else
+	(void)Address;
+#endif
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI CpuThread__Entry(LPVOID Arg)
+{
+	CpuThread* Thread = Arg;
+	Thread->Func(Thread->Arg);
+	return 0;
+}
+#else
+static void* CpuThread__Entry(void* Arg)
+{
+	CpuThread* Thread = Arg;
+	Thread->Func(Thread->Arg);
+	return NULL;
+}
+#endif
+
+void CpuThread_Create(CpuThread* Thread, CpuThread_Func* Func, void* Arg)
+{
+	Thread->Func = Func;
+	Thread->Arg = Arg;
+#if defined(_WIN32)
+	Thread->Handle = CreateThread(NULL, 0, &CpuThread__Entry, Thread, 0, NULL);
+	Assert(Thread->Handle);
+#else
+	int Error = pthread_create(&Thread->Handle, NULL, &CpuThread__Entry, Thread);
+	Assert(Error == 0);
+#endif
+}
+
+void CpuThread_Join(CpuThread* Thread)
+{
+#if defined(_WIN32)
+	WaitForSingleObject(Thread->Handle, INFINITE);
+	CloseHandle(Thread->Handle);
+#else
+	pthread_join(Thread->Handle, NULL);
+#endif
+}
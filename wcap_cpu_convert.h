@@ -0,0 +1,1249 @@
+#pragma once
+
+#include "wcap_cpu_resize.h"
+#include "wcap_yuv_matrix.h"
+
+//
+// interface
+//
+
+typedef enum
+{
+	CpuConvertFormat_NV12, // 8-bit values
+	CpuConvertFormat_P010, // 16-bit values, same as GPU writes to R16_UNORM & R16G16_UNORM views
+	CpuConvertFormat_P010_HDR, // same as P010 but input is R16G16B16A16_FLOAT scRGB, output is PQ encoded BT.2020
+}
+CpuConvertFormat;
+
+typedef struct CpuConvert CpuConvert;
+
+// converts two input rows to two rows of Y & one row of UV values, Y rows can be NULL to calculate only UV values
+typedef void CpuConvert_RowFunc(const CpuConvert* Convert, const uint8_t* Row0, const uint8_t* Row1, uint8_t* RowY0, uint8_t* RowY1, uint8_t* RowUV);
+
+// improved conversion of one input row to Y values, chroma is interpolated vertically from two UV rows with Weight0 & 1-Weight0
+typedef void CpuConvert_RowYFunc(const CpuConvert* Convert, const uint8_t* Input, const uint8_t* RowUV0, const uint8_t* RowUV1, float Weight0, uint8_t* RowY);
+
+typedef struct CpuConvert
+{
+	const float (*Matrix)[4];
+	CpuConvertFormat Format;
+	CpuConvert_RowFunc* Row;
+	CpuConvert_RowYFunc* RowY; // only for improved conversion
+	CpuKernel Kernel;
+	float ScaleY[3];     // SIMD kernels use matrix premultiplied with range & output scale, for RGB bytes
+	float ScaleU[3];     // for sum of 8 RGB bytes
+	float ScaleV[3];
+	float OffsetY;       // including +0.5 for rounding
+	float OffsetUV;
+	float LumaScale[3];  // improved conversion, luma weights for squared RGB bytes
+	float ScaleKU[3];    // K = U * ScaleKU + V * ScaleKV + OffsetK, where U & V are chroma values as stored in output
+	float ScaleKV[3];
+	float OffsetK[3];
+	float RangeY;
+	int16_t FixedY[3];    // fixed point coefficients with CPU_CONVERT_FIXED_BITS fraction bits, for RGB bytes
+	int16_t FixedU[3];    // for sum of 8 RGB bytes
+	int16_t FixedV[3];
+	int32_t FixedOffsetY; // including rounding
+	int32_t FixedOffsetUV;
+	uint8_t* Strip;      // few rows of resized image for CpuConvert_RunResize
+	size_t StripPitch;
+	uint32_t Width;
+	uint32_t Height;
+}
+CpuConvert;
+
+// CPU version of ConvertSinglePass shader, or ConvertImprovedNV12/P010 shaders with ImprovedConversion
+// input is 8-bit BGRA, output is Y & UV planes of NV12 or P010 image
+// scalar kernel uses same float math as shader, SIMD kernels can be off by 1 from it because of different rounding
+// improved P010 luma is solved from those chroma values, so it can be off by few 16-bit steps, still below one 10-bit step
+// FixedPoint uses integer math for RGB to YUV conversion instead, which gives exactly same output on every kernel
+// it supports only NV12, and with ImprovedConversion only chroma is calculated in fixed point
+// P010_HDR needs BT2020 ColorSpace, it is scalar reference only & without improved conversion or resize
+static void CpuConvert_Create(CpuConvert* Convert, uint32_t Width, uint32_t Height, YuvColorSpace ColorSpace, CpuConvertFormat Format, bool ImprovedConversion, bool FixedPoint, CpuKernel Kernel);
+static void CpuConvert_Release(CpuConvert* Convert);
+
+static void CpuConvert_Run(CpuConvert* Convert, const uint8_t* Input, size_t InputPitch, uint8_t* OutputY, size_t PitchY, uint8_t* OutputUV, size_t PitchUV);
+
+// model of ConvertImprovedNV12/P010 shader dispatch, needs ImprovedConversion
+// every 16x16 tile of chroma values is calculated together with one row above & below and one column to the right of it
+// then Y is solved only from these tile-local values, same as from group shared memory in shader
+// it uses float math of scalar kernel, so output is exactly same as CpuConvert_Run with float scalar kernel
+static void CpuConvert_RunTiles(CpuConvert* Convert, const uint8_t* Input, size_t InputPitch, uint8_t* OutputY, size_t PitchY, uint8_t* OutputUV, size_t PitchUV);
+
+// CPU version of ResizeConvertPassH/V shaders, output is exactly same as CpuResize_Run followed by CpuConvert_Run
+// but resized image is produced only few rows at a time, so it stays in cache instead of going to memory & back
+static void CpuConvert_RunResize(CpuConvert* Convert, CpuResize* Resize, const uint8_t* Input, size_t InputPitch, uint8_t* OutputY, size_t PitchY, uint8_t* OutputUV, size_t PitchUV);
+
+//
+// implementation
+//
+
+// must be even, so every strip has whole rows of chroma values
+#define CPU_CONVERT_STRIP_ROWS 16
+
+// same as numthreads of ConvertImprovedNV12/P010 shaders
+#define CPU_CONVERT_TILE_SIZE 16
+
+// same as RANGE_* and OFFSET_* constants in shaders
+#define CPU_CONVERT_RANGE_Y   (219.f / 255.f)
+#define CPU_CONVERT_RANGE_UV  (224.f / 255.f)
+#define CPU_CONVERT_OFFSET_Y  (16.f / 255.f)
+#define CPU_CONVERT_OFFSET_UV (0.5f / 255.f + 0.5f)
+
+// fixed point coefficients fit in 16 bits, and dot products with sum of 8 pixels fit in 32 bits
+#define CPU_CONVERT_FIXED_BITS 13
+
+// same as LumaWeights in shaders
+static const float CpuConvert__LumaWeights[3] = { 0.2126f, 0.7152f, 0.0722f };
+
+static void CpuConvert__Load(const uint8_t* Pixel, float* Color)
+{
+	// BGRA bytes to RGB
+	Color[0] = Pixel[2] / 255.f;
+	Color[1] = Pixel[1] / 255.f;
+	Color[2] = Pixel[0] / 255.f;
+}
+
+static uint32_t CpuConvert__Quantize(float Value, float MaxValue)
+{
+	// same as storing to UNORM texture view
+	Value = Value > 0.f ? Value : 0.f;
+	Value = Value < 1.f ? Value : 1.f;
+	return (uint32_t)(Value * MaxValue + 0.5f);
+}
+
+static void CpuConvert__Store(const CpuConvert* Convert, uint8_t* Output, size_t Index, float Value)
+{
+	if (Convert->Format == CpuConvertFormat_NV12)
+	{
+		Output[Index] = (uint8_t)CpuConvert__Quantize(Value, 255.f);
+	}
+	else
+	{
+		((uint16_t*)Output)[Index] = (uint16_t)CpuConvert__Quantize(Value, 65535.f);
+	}
+}
+
+static float CpuConvert__Dot(const float* Row, const float* Color)
+{
+	return Row[0] * Color[0] + Row[1] * Color[1] + Row[2] * Color[2];
+}
+
+static float CpuConvert__LoadValue(const CpuConvert* Convert, const uint8_t* Row, size_t Index)
+{
+	// value from UV plane, same as loading from UNORM texture view
+	if (Convert->Format == CpuConvertFormat_NV12)
+	{
+		return Row[Index] / 255.f;
+	}
+	else
+	{
+		return ((const uint16_t*)Row)[Index] / 65535.f;
+	}
+}
+
+// scalar reference
+
+static void CpuConvert__ChromaColor(const uint8_t* Row0, const uint8_t* Row1, uint32_t X, float* Color)
+{
+	// horizontally co-sited & vertically centered chroma for 2x2 pixels starting at column X, same weights as bilinear sampling in shader
+	uint32_t Left = X == 0 ? 0 : X - 1;
+
+	float Color00[3], Color01[3], Color10[3], Color11[3], ColorLeft0[3], ColorLeft1[3];
+	CpuConvert__Load(Row0 + X * 4, Color00);
+	CpuConvert__Load(Row0 + X * 4 + 4, Color01);
+	CpuConvert__Load(Row1 + X * 4, Color10);
+	CpuConvert__Load(Row1 + X * 4 + 4, Color11);
+	CpuConvert__Load(Row0 + Left * 4, ColorLeft0);
+	CpuConvert__Load(Row1 + Left * 4, ColorLeft1);
+
+	for (int Channel = 0; Channel < 3; Channel++)
+	{
+		Color[Channel] = (ColorLeft0[Channel] + ColorLeft1[Channel] + 2 * (Color00[Channel] + Color10[Channel]) + Color01[Channel] + Color11[Channel]) / 8;
+	}
+}
+
+static void CpuConvert__Block_Scalar(const CpuConvert* Convert, const uint8_t* Row0, const uint8_t* Row1, uint8_t* RowY0, uint8_t* RowY1, uint8_t* RowUV, uint32_t X)
+{
+	// 2x2 pixels starting at column X
+	const float (*Matrix)[4] = Convert->Matrix;
+
+	float Color[3];
+	CpuConvert__ChromaColor(Row0, Row1, X, Color);
+
+	CpuConvert__Store(Convert, RowUV, X + 0, CpuConvert__Dot(Matrix[1], Color) * CPU_CONVERT_RANGE_UV + CPU_CONVERT_OFFSET_UV);
+	CpuConvert__Store(Convert, RowUV, X + 1, CpuConvert__Dot(Matrix[2], Color) * CPU_CONVERT_RANGE_UV + CPU_CONVERT_OFFSET_UV);
+
+	if (RowY0 == NULL)
+	{
+		return;
+	}
+
+	float Color00[3], Color01[3], Color10[3], Color11[3];
+	CpuConvert__Load(Row0 + X * 4, Color00);
+	CpuConvert__Load(Row0 + X * 4 + 4, Color01);
+	CpuConvert__Load(Row1 + X * 4, Color10);
+	CpuConvert__Load(Row1 + X * 4 + 4, Color11);
+
+	CpuConvert__Store(Convert, RowY0, X + 0, CpuConvert__Dot(Matrix[0], Color00) * CPU_CONVERT_RANGE_Y + CPU_CONVERT_OFFSET_Y);
+	CpuConvert__Store(Convert, RowY0, X + 1, CpuConvert__Dot(Matrix[0], Color01) * CPU_CONVERT_RANGE_Y + CPU_CONVERT_OFFSET_Y);
+	CpuConvert__Store(Convert, RowY1, X + 0, CpuConvert__Dot(Matrix[0], Color10) * CPU_CONVERT_RANGE_Y + CPU_CONVERT_OFFSET_Y);
+	CpuConvert__Store(Convert, RowY1, X + 1, CpuConvert__Dot(Matrix[0], Color11) * CPU_CONVERT_RANGE_Y + CPU_CONVERT_OFFSET_Y);
+}
+
+static void CpuConvert__Row_Scalar(const CpuConvert* Convert, const uint8_t* Row0, const uint8_t* Row1, uint8_t* RowY0, uint8_t* RowY1, uint8_t* RowUV)
+{
+	for (uint32_t X = 0; X < Convert->Width; X += 2)
+	{
+		CpuConvert__Block_Scalar(Convert, Row0, Row1, RowY0, RowY1, RowUV, X);
+	}
+}
+
+static void CpuConvert__SolveY(const CpuConvert* Convert, const uint8_t* Input, const float* UV, uint8_t* RowY, uint32_t X)
+{
+	float Color[3];
+	CpuConvert__Load(Input + X * 4, Color);
+
+	// same as ConvertImprovedY in shader, solves Y for quadratic equation that keeps relative luminance of pixel
+	const float (*Matrix)[4] = Convert->Matrix;
+	const float* W = CpuConvert__LumaWeights;
+	float T[3] = { 0, UV[0] * (1.f / CPU_CONVERT_RANGE_UV) - (CPU_CONVERT_OFFSET_UV / CPU_CONVERT_RANGE_UV), UV[1] * (1.f / CPU_CONVERT_RANGE_UV) - (CPU_CONVERT_OFFSET_UV / CPU_CONVERT_RANGE_UV) };
+	float K[3] = { CpuConvert__Dot(Matrix[3], T), CpuConvert__Dot(Matrix[4], T), CpuConvert__Dot(Matrix[5], T) };
+	float KK[3] = { K[0] * K[0], K[1] * K[1], K[2] * K[2] };
+	float Color2[3] = { Color[0] * Color[0], Color[1] * Color[1], Color[2] * Color[2] };
+	float L = CpuConvert__Dot(W, Color2);
+	float A = CpuConvert__Dot(W, K);
+	float B = CpuConvert__Dot(W, KK);
+	float C = A * A - B + L;
+	float Y = sqrtf(C) - A;
+
+	// saturate, NaN from negative C becomes 0 same as on GPU
+	Y = Y > 0.f ? Y : 0.f;
+	Y = Y < 1.f ? Y : 1.f;
+	CpuConvert__Store(Convert, RowY, X, Y * CPU_CONVERT_RANGE_Y + CPU_CONVERT_OFFSET_Y);
+}
+
+static void CpuConvert__PixelY_Scalar(const CpuConvert* Convert, const uint8_t* Input, const uint8_t* RowUV0, const uint8_t* RowUV1, float Weight0, uint8_t* RowY, uint32_t X)
+{
+	// chroma values that decoder is expected to calculate with bilinear interpolation
+	// even pixels are co-sited with chroma samples, odd pixels are in middle between two of them
+	uint32_t Index = X / 2;
+	uint32_t Right = X % 2 == 0 ? Index : Index + 1 < Convert->Width / 2 ? Index + 1 : Index;
+
+	float UV[2];
+	for (int Channel = 0; Channel < 2; Channel++)
+	{
+		float Value0 = CpuConvert__LoadValue(Convert, RowUV0, Index * 2 + Channel) * Weight0 + CpuConvert__LoadValue(Convert, RowUV1, Index * 2 + Channel) * (1.f - Weight0);
+		float Value1 = CpuConvert__LoadValue(Convert, RowUV0, Right * 2 + Channel) * Weight0 + CpuConvert__LoadValue(Convert, RowUV1, Right * 2 + Channel) * (1.f - Weight0);
+		UV[Channel] = (Value0 + Value1) * 0.5f;
+	}
+
+	CpuConvert__SolveY(Convert, Input, UV, RowY, X);
+}
+
+static void CpuConvert__RowY_Scalar(const CpuConvert* Convert, const uint8_t* Input, const uint8_t* RowUV0, const uint8_t* RowUV1, float Weight0, uint8_t* RowY)
+{
+	for (uint32_t X = 0; X < Convert->Width; X++)
+	{
+		CpuConvert__PixelY_Scalar(Convert, Input, RowUV0, RowUV1, Weight0, RowY, X);
+	}
+}
+
+// fixed point - all sums are positive & below 256 after shift, so no kernel needs to clamp or round negative values
+
+static uint8_t CpuConvert__Fixed(const int16_t* Coefficient, int32_t Offset, int Shift, int32_t R, int32_t G, int32_t B)
+{
+	return (uint8_t)((Coefficient[0] * R + Coefficient[1] * G + Coefficient[2] * B + Offset) >> Shift);
+}
+
+static void CpuConvert__Block_Fixed(const CpuConvert* Convert, const uint8_t* Row0, const uint8_t* Row1, uint8_t* RowY0, uint8_t* RowY1, uint8_t* RowUV, uint32_t X)
+{
+	// 2x2 pixels starting at column X, same chroma weights as float version
+	uint32_t Left = X == 0 ? 0 : X - 1;
+
+	int32_t Sum[3];
+	for (int Channel = 0; Channel < 3; Channel++)
+	{
+		// BGRA bytes to RGB
+		uint32_t Byte = 2 - Channel;
+		Sum[Channel] = Row0[Left * 4 + Byte] + Row1[Left * 4 + Byte] + 2 * (Row0[X * 4 + Byte] + Row1[X * 4 + Byte]) + Row0[X * 4 + 4 + Byte] + Row1[X * 4 + 4 + Byte];
+	}
+
+	RowUV[X + 0] = CpuConvert__Fixed(Convert->FixedU, Convert->FixedOffsetUV, CPU_CONVERT_FIXED_BITS + 3, Sum[0], Sum[1], Sum[2]);
+	RowUV[X + 1] = CpuConvert__Fixed(Convert->FixedV, Convert->FixedOffsetUV, CPU_CONVERT_FIXED_BITS + 3, Sum[0], Sum[1], Sum[2]);
+
+	if (RowY0 == NULL)
+	{
+		return;
+	}
+
+	const uint8_t* Pixels[] = { Row0 + X * 4, Row0 + X * 4 + 4, Row1 + X * 4, Row1 + X * 4 + 4 };
+	uint8_t* Outputs[] = { RowY0 + X, RowY0 + X + 1, RowY1 + X, RowY1 + X + 1 };
+	for (int Index = 0; Index < 4; Index++)
+	{
+		const uint8_t* Pixel = Pixels[Index];
+		*Outputs[Index] = CpuConvert__Fixed(Convert->FixedY, Convert->FixedOffsetY, CPU_CONVERT_FIXED_BITS, Pixel[2], Pixel[1], Pixel[0]);
+	}
+}
+
+static void CpuConvert__Row_Fixed_Scalar(const CpuConvert* Convert, const uint8_t* Row0, const uint8_t* Row1, uint8_t* RowY0, uint8_t* RowY1, uint8_t* RowUV)
+{
+	for (uint32_t X = 0; X < Convert->Width; X += 2)
+	{
+		CpuConvert__Block_Fixed(Convert, Row0, Row1, RowY0, RowY1, RowUV, X);
+	}
+}
+
+// HDR - same as ConvertHdr shader, every pixel is converted to PQ encoded BT.2020 color before chroma is averaged
+
+// https://en.wikipedia.org/wiki/Perceptual_quantizer
+#define CPU_CONVERT_PQ_M1 (2610.f / 16384.f)
+#define CPU_CONVERT_PQ_M2 (2523.f / 4096.f * 128.f)
+#define CPU_CONVERT_PQ_C1 (3424.f / 4096.f)
+#define CPU_CONVERT_PQ_C2 (2413.f / 4096.f * 32.f)
+#define CPU_CONVERT_PQ_C3 (2392.f / 4096.f * 32.f)
+
+// scRGB has 1.0 for 80 nits, PQ has 1.0 for 10000 nits
+#define CPU_CONVERT_SCRGB_TO_PQ (80.f / 10000.f)
+
+// 10-bit limited range, HDR output uses exact values instead of 8-bit range scaled to 16 bits
+#define CPU_CONVERT_HDR_RANGE_Y   876.f
+#define CPU_CONVERT_HDR_RANGE_UV  896.f
+#define CPU_CONVERT_HDR_OFFSET_Y  64.f
+#define CPU_CONVERT_HDR_OFFSET_UV 512.f
+
+// linear BT.709 to BT.2020 primaries, same as in shader
+static const float CpuConvert__Bt709ToBt2020[3][3] =
+{
+	{ 0.627404f, 0.329283f, 0.043313f },
+	{ 0.069097f, 0.919540f, 0.011362f },
+	{ 0.016391f, 0.088013f, 0.895595f },
+};
+
+static float CpuConvert__HalfToFloat(uint16_t Half)
+{
+	// infinity & NaN are not expected in captured frames, they become large values that PQ clamps to 1
+	uint32_t Exponent = (Half >> 10) & 31;
+	uint32_t Mantissa = Half & 1023;
+	float Value = Exponent == 0 ? ldexpf((float)Mantissa, -24) : ldexpf((float)(Mantissa | 1024), (int)Exponent - 25);
+	return Half >> 15 ? -Value : Value;
+}
+
+static float CpuConvert__LinearToPQ(float Value)
+{
+	Value = Value > 0.f ? Value : 0.f;
+	Value = Value < 1.f ? Value : 1.f;
+	float P = powf(Value, CPU_CONVERT_PQ_M1);
+	return powf((CPU_CONVERT_PQ_C1 + CPU_CONVERT_PQ_C2 * P) / (1.f + CPU_CONVERT_PQ_C3 * P), CPU_CONVERT_PQ_M2);
+}
+
+static void CpuConvert__LoadHdr(const uint8_t* Pixel, float* Color)
+{
+	// RGBA half floats to PQ encoded RGB
+	const uint16_t* Half = (const uint16_t*)Pixel;
+	float Linear[3] = { CpuConvert__HalfToFloat(Half[0]), CpuConvert__HalfToFloat(Half[1]), CpuConvert__HalfToFloat(Half[2]) };
+	for (int Channel = 0; Channel < 3; Channel++)
+	{
+		Color[Channel] = CpuConvert__LinearToPQ(CpuConvert__Dot(CpuConvert__Bt709ToBt2020[Channel], Linear) * CPU_CONVERT_SCRGB_TO_PQ);
+	}
+}
+
+static void CpuConvert__StoreHdr(uint8_t* Output, size_t Index, float Value)
+{
+	// 10-bit value in high bits of 16-bit P010 value
+	Value = Value > 0.f ? Value : 0.f;
+	Value = Value < 1023.f ? Value : 1023.f;
+	((uint16_t*)Output)[Index] = (uint16_t)((uint32_t)(Value + 0.5f) << 6);
+}
+
+static void CpuConvert__Row_Hdr(const CpuConvert* Convert, const uint8_t* Row0, const uint8_t* Row1, uint8_t* RowY0, uint8_t* RowY1, uint8_t* RowUV)
+{
+	const float (*Matrix)[4] = Convert->Matrix;
+
+	// PQ colors of column to the left of current 2x2 pixels, first column uses itself same as clamped load
+	float Left0[3], Left1[3];
+
+	for (uint32_t X = 0; X < Convert->Width; X += 2)
+	{
+		float Color00[3], Color01[3], Color10[3], Color11[3];
+		CpuConvert__LoadHdr(Row0 + X * 8, Color00);
+		CpuConvert__LoadHdr(Row0 + X * 8 + 8, Color01);
+		CpuConvert__LoadHdr(Row1 + X * 8, Color10);
+		CpuConvert__LoadHdr(Row1 + X * 8 + 8, Color11);
+		if (X == 0)
+		{
+			memcpy(Left0, Color00, sizeof(Left0));
+			memcpy(Left1, Color10, sizeof(Left1));
+		}
+
+		float Color[3];
+		for (int Channel = 0; Channel < 3; Channel++)
+		{
+			Color[Channel] = (Left0[Channel] + Left1[Channel] + 2 * (Color00[Channel] + Color10[Channel]) + Color01[Channel] + Color11[Channel]) / 8;
+		}
+
+		CpuConvert__StoreHdr(RowUV, X + 0, CpuConvert__Dot(Matrix[1], Color) * CPU_CONVERT_HDR_RANGE_UV + CPU_CONVERT_HDR_OFFSET_UV);
+		CpuConvert__StoreHdr(RowUV, X + 1, CpuConvert__Dot(Matrix[2], Color) * CPU_CONVERT_HDR_RANGE_UV + CPU_CONVERT_HDR_OFFSET_UV);
+
+		if (RowY0)
+		{
+			CpuConvert__StoreHdr(RowY0, X + 0, CpuConvert__Dot(Matrix[0], Color00) * CPU_CONVERT_HDR_RANGE_Y + CPU_CONVERT_HDR_OFFSET_Y);
+			CpuConvert__StoreHdr(RowY0, X + 1, CpuConvert__Dot(Matrix[0], Color01) * CPU_CONVERT_HDR_RANGE_Y + CPU_CONVERT_HDR_OFFSET_Y);
+			CpuConvert__StoreHdr(RowY1, X + 0, CpuConvert__Dot(Matrix[0], Color10) * CPU_CONVERT_HDR_RANGE_Y + CPU_CONVERT_HDR_OFFSET_Y);
+			CpuConvert__StoreHdr(RowY1, X + 1, CpuConvert__Dot(Matrix[0], Color11) * CPU_CONVERT_HDR_RANGE_Y + CPU_CONVERT_HDR_OFFSET_Y);
+		}
+
+		// right column of this block is left column of next one
+		memcpy(Left0, Color01, sizeof(Left0));
+		memcpy(Left1, Color11, sizeof(Left1));
+	}
+}
+
+#if defined(CPU_X64)
+
+// SSE4.1 fixed point - pixels are expanded to 16-bit BGRA values, pmaddwd + phaddd does dot product with coefficients
+
+CPU_INLINE CPU_TARGET("sse4.1") __m128i CpuConvert__FixedCoefficients_SSE41(const int16_t* Coefficient)
+{
+	return _mm_setr_epi16(Coefficient[2], Coefficient[1], Coefficient[0], 0, Coefficient[2], Coefficient[1], Coefficient[0], 0);
+}
+
+CPU_INLINE CPU_TARGET("sse4.1") __m128i CpuConvert__FixedY_SSE41(__m128i Pixels, __m128i Coefficients, __m128i Offset)
+{
+	// 4 pixels to 4 Y values in 32-bit lanes
+	__m128i Zero = _mm_setzero_si128();
+	__m128i Low = _mm_madd_epi16(_mm_unpacklo_epi8(Pixels, Zero), Coefficients);
+	__m128i High = _mm_madd_epi16(_mm_unpackhi_epi8(Pixels, Zero), Coefficients);
+	return _mm_srli_epi32(_mm_add_epi32(_mm_hadd_epi32(Low, High), Offset), CPU_CONVERT_FIXED_BITS);
+}
+
+CPU_INLINE CPU_TARGET("sse4.1") __m128i CpuConvert__FixedUV_SSE41(__m128i Left0, __m128i Left1, __m128i Pixels0, __m128i Pixels1, __m128i CoefficientsU, __m128i CoefficientsV, __m128i Offset)
+{
+	// Left + Pixels from both rows, pair of neighbor pixels in it gives left + 2 * center + right for one 2x2 block
+	__m128i Zero = _mm_setzero_si128();
+	__m128i Low = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(Left0, Zero), _mm_unpacklo_epi8(Pixels0, Zero)), _mm_add_epi16(_mm_unpacklo_epi8(Left1, Zero), _mm_unpacklo_epi8(Pixels1, Zero)));
+	__m128i High = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(Left0, Zero), _mm_unpackhi_epi8(Pixels0, Zero)), _mm_add_epi16(_mm_unpackhi_epi8(Left1, Zero), _mm_unpackhi_epi8(Pixels1, Zero)));
+
+	__m128i U = _mm_hadd_epi32(_mm_madd_epi16(Low, CoefficientsU), _mm_madd_epi16(High, CoefficientsU));
+	__m128i V = _mm_hadd_epi32(_mm_madd_epi16(Low, CoefficientsV), _mm_madd_epi16(High, CoefficientsV));
+
+	// U0 U1 V0 V1 -> U0 V0 U1 V1
+	__m128i UV = _mm_srli_epi32(_mm_add_epi32(_mm_hadd_epi32(U, V), Offset), CPU_CONVERT_FIXED_BITS + 3);
+	return _mm_shuffle_epi32(UV, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+static CPU_TARGET("sse4.1") void CpuConvert__Row_Fixed_SSE41(const CpuConvert* Convert, const uint8_t* Row0, const uint8_t* Row1, uint8_t* RowY0, uint8_t* RowY1, uint8_t* RowUV)
+{
+	__m128i CoefficientsY = CpuConvert__FixedCoefficients_SSE41(Convert->FixedY);
+	__m128i CoefficientsU = CpuConvert__FixedCoefficients_SSE41(Convert->FixedU);
+	__m128i CoefficientsV = CpuConvert__FixedCoefficients_SSE41(Convert->FixedV);
+	__m128i OffsetY = _mm_set1_epi32(Convert->FixedOffsetY);
+	__m128i OffsetUV = _mm_set1_epi32(Convert->FixedOffsetUV);
+
+	// 8 pixels from each row per iteration, as two halves of 4 pixels
+	uint32_t X = 0;
+	for (; X + 8 <= Convert->Width; X += 8)
+	{
+		__m128i Y0[2], Y1[2], UV[2];
+		for (int Half = 0; Half < 2; Half++)
+		{
+			uint32_t Index = X + Half * 4;
+			__m128i Pixels0 = _mm_loadu_si128((const __m128i*)(Row0 + Index * 4));
+			__m128i Pixels1 = _mm_loadu_si128((const __m128i*)(Row1 + Index * 4));
+
+			// pixels shifted by one to the right, left of first pixel in row is clamped to itself
+			__m128i Left0, Left1;
+			if (Index == 0)
+			{
+				Left0 = _mm_shuffle_epi32(Pixels0, _MM_SHUFFLE(2, 1, 0, 0));
+				Left1 = _mm_shuffle_epi32(Pixels1, _MM_SHUFFLE(2, 1, 0, 0));
+			}
+			else
+			{
+				Left0 = _mm_loadu_si128((const __m128i*)(Row0 + Index * 4 - 4));
+				Left1 = _mm_loadu_si128((const __m128i*)(Row1 + Index * 4 - 4));
+			}
+
+			Y0[Half] = CpuConvert__FixedY_SSE41(Pixels0, CoefficientsY, OffsetY);
+			Y1[Half] = CpuConvert__FixedY_SSE41(Pixels1, CoefficientsY, OffsetY);
+			UV[Half] = CpuConvert__FixedUV_SSE41(Left0, Left1, Pixels0, Pixels1, CoefficientsU, CoefficientsV, OffsetUV);
+		}
+
+		if (RowY0)
+		{
+			__m128i Y = _mm_packus_epi16(_mm_packus_epi32(Y0[0], Y0[1]), _mm_packus_epi32(Y1[0], Y1[1]));
+			_mm_storel_epi64((__m128i*)(RowY0 + X), Y);
+			_mm_storel_epi64((__m128i*)(RowY1 + X), _mm_unpackhi_epi64(Y, Y));
+		}
+
+		__m128i UV16 = _mm_packus_epi32(UV[0], UV[1]);
+		_mm_storel_epi64((__m128i*)(RowUV + X), _mm_packus_epi16(UV16, UV16));
+	}
+
+	for (; X < Convert->Width; X += 2)
+	{
+		CpuConvert__Block_Fixed(Convert, Row0, Row1, RowY0, RowY1, RowUV, X);
+	}
+}
+
+// AVX2 - 8 pixels from each row per iteration, one channel of each pixel in 32-bit lane
+
+CPU_INLINE CPU_TARGET("avx2,fma") __m256i CpuConvert__Channel_AVX2(__m256i Pixels, int Shift)
+{
+	return _mm256_and_si256(_mm256_srli_epi32(Pixels, Shift), _mm256_set1_epi32(0xff));
+}
+
+CPU_INLINE CPU_TARGET("avx2,fma") __m256i CpuConvert__Y_AVX2(const CpuConvert* Convert, __m256i Pixels)
+{
+	__m256 Value = _mm256_set1_ps(Convert->OffsetY);
+	Value = _mm256_fmadd_ps(_mm256_cvtepi32_ps(CpuConvert__Channel_AVX2(Pixels, 16)), _mm256_set1_ps(Convert->ScaleY[0]), Value);
+	Value = _mm256_fmadd_ps(_mm256_cvtepi32_ps(CpuConvert__Channel_AVX2(Pixels,  8)), _mm256_set1_ps(Convert->ScaleY[1]), Value);
+	Value = _mm256_fmadd_ps(_mm256_cvtepi32_ps(CpuConvert__Channel_AVX2(Pixels,  0)), _mm256_set1_ps(Convert->ScaleY[2]), Value);
+	return _mm256_cvttps_epi32(Value);
+}
+
+CPU_INLINE CPU_TARGET("avx2,fma") __m256 CpuConvert__Sum_AVX2(__m256i Left0, __m256i Left1, __m256i Pixels0, __m256i Pixels1, int Shift)
+{
+	// left + 2 * center + right pixel from both rows, valid only in even lanes
+	__m256i Left = _mm256_add_epi32(CpuConvert__Channel_AVX2(Left0, Shift), CpuConvert__Channel_AVX2(Left1, Shift));
+	__m256i Center = _mm256_add_epi32(CpuConvert__Channel_AVX2(Pixels0, Shift), CpuConvert__Channel_AVX2(Pixels1, Shift));
+	__m256i Right = _mm256_srli_epi64(Center, 32);
+	return _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_add_epi32(Left, Right), _mm256_add_epi32(Center, Center)));
+}
+
+CPU_INLINE CPU_TARGET("avx2,fma") __m256i CpuConvert__UV_AVX2(const float* Scale, float Offset, __m256 R, __m256 G, __m256 B)
+{
+	__m256 Value = _mm256_set1_ps(Offset);
+	Value = _mm256_fmadd_ps(R, _mm256_set1_ps(Scale[0]), Value);
+	Value = _mm256_fmadd_ps(G, _mm256_set1_ps(Scale[1]), Value);
+	Value = _mm256_fmadd_ps(B, _mm256_set1_ps(Scale[2]), Value);
+	return _mm256_cvttps_epi32(Value);
+}
+
+CPU_INLINE CPU_TARGET("avx2,fma") void CpuConvert__Store_AVX2(const CpuConvert* Convert, uint8_t* Output, uint32_t Index, __m256i Value)
+{
+	// saturating packs clamp to output range, negative values were truncated towards 0
+	__m128i Value16 = _mm_packus_epi32(_mm256_castsi256_si128(Value), _mm256_extracti128_si256(Value, 1));
+	if (Convert->Format == CpuConvertFormat_NV12)
+	{
+		_mm_storel_epi64((__m128i*)(Output + Index), _mm_packus_epi16(Value16, Value16));
+	}
+	else
+	{
+		_mm_storeu_si128((__m128i*)((uint16_t*)Output + Index), Value16);
+	}
+}
+
+static CPU_TARGET("avx2,fma") void CpuConvert__Row_AVX2(const CpuConvert* Convert, const uint8_t* Row0, const uint8_t* Row1, uint8_t* RowY0, uint8_t* RowY1, uint8_t* RowUV)
+{
+	uint32_t X = 0;
+	for (; X + 8 <= Convert->Width; X += 8)
+	{
+		__m256i Pixels0 = _mm256_loadu_si256((const __m256i*)(Row0 + X * 4));
+		__m256i Pixels1 = _mm256_loadu_si256((const __m256i*)(Row1 + X * 4));
+
+		// pixels shifted by one to the right, left of first pixel in row is clamped to itself
+		__m256i Left0, Left1;
+		if (X == 0)
+		{
+			__m256i Index = _mm256_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6);
+			Left0 = _mm256_permutevar8x32_epi32(Pixels0, Index);
+			Left1 = _mm256_permutevar8x32_epi32(Pixels1, Index);
+		}
+		else
+		{
+			Left0 = _mm256_loadu_si256((const __m256i*)(Row0 + X * 4 - 4));
+			Left1 = _mm256_loadu_si256((const __m256i*)(Row1 + X * 4 - 4));
+		}
+
+		if (RowY0)
+		{
+			CpuConvert__Store_AVX2(Convert, RowY0, X, CpuConvert__Y_AVX2(Convert, Pixels0));
+			CpuConvert__Store_AVX2(Convert, RowY1, X, CpuConvert__Y_AVX2(Convert, Pixels1));
+		}
+
+		__m256 R = CpuConvert__Sum_AVX2(Left0, Left1, Pixels0, Pixels1, 16);
+		__m256 G = CpuConvert__Sum_AVX2(Left0, Left1, Pixels0, Pixels1, 8);
+		__m256 B = CpuConvert__Sum_AVX2(Left0, Left1, Pixels0, Pixels1, 0);
+
+		// U stays in even lanes, V moves to odd lanes, so they are interleaved same as in UV plane
+		__m256i U = CpuConvert__UV_AVX2(Convert->ScaleU, Convert->OffsetUV, R, G, B);
+		__m256i V = CpuConvert__UV_AVX2(Convert->ScaleV, Convert->OffsetUV, R, G, B);
+		CpuConvert__Store_AVX2(Convert, RowUV, X, _mm256_blend_epi32(U, _mm256_slli_epi64(V, 32), 0xaa));
+	}
+
+	for (; X < Convert->Width; X += 2)
+	{
+		CpuConvert__Block_Scalar(Convert, Row0, Row1, RowY0, RowY1, RowUV, X);
+	}
+}
+
+CPU_INLINE CPU_TARGET("avx2,fma") __m256 CpuConvert__LoadUV_AVX2(const CpuConvert* Convert, const uint8_t* Row0, const uint8_t* Row1, __m256 Weight0, __m256 Weight1, uint32_t Index)
+{
+	// 8 values from UV planes starting at Index, interpolated vertically
+	__m256i Value0, Value1;
+	if (Convert->Format == CpuConvertFormat_NV12)
+	{
+		Value0 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(Row0 + Index)));
+		Value1 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(Row1 + Index)));
+	}
+	else
+	{
+		Value0 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)((const uint16_t*)Row0 + Index)));
+		Value1 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)((const uint16_t*)Row1 + Index)));
+	}
+	return _mm256_fmadd_ps(_mm256_cvtepi32_ps(Value0), Weight0, _mm256_mul_ps(_mm256_cvtepi32_ps(Value1), Weight1));
+}
+
+static CPU_TARGET("avx2,fma") void CpuConvert__RowY_AVX2(const CpuConvert* Convert, const uint8_t* Input, const uint8_t* RowUV0, const uint8_t* RowUV1, float Weight0, uint8_t* RowY)
+{
+	const float* W = CpuConvert__LumaWeights;
+	__m256 Weight0x8 = _mm256_set1_ps(Weight0);
+	__m256 Weight1x8 = _mm256_set1_ps(1.f - Weight0);
+	__m256 Zero = _mm256_setzero_ps();
+	__m256 One = _mm256_set1_ps(1.f);
+
+	// last pixels in row are left for scalar loop, which clamps the right chroma sample
+	uint32_t X = 0;
+	for (; X + 8 < Convert->Width; X += 8)
+	{
+		// chroma samples X/2 .. X/2+3 and one to the right of each
+		__m256 Chroma = CpuConvert__LoadUV_AVX2(Convert, RowUV0, RowUV1, Weight0x8, Weight1x8, X);
+		__m256 Right = CpuConvert__LoadUV_AVX2(Convert, RowUV0, RowUV1, Weight0x8, Weight1x8, X + 2);
+		__m256 Middle = _mm256_mul_ps(_mm256_add_ps(Chroma, Right), _mm256_set1_ps(0.5f));
+
+		// even pixels are co-sited with chroma samples, odd pixels are in middle between two of them
+		__m256 U = _mm256_blend_ps(Chroma, _mm256_moveldup_ps(Middle), 0xaa);
+		__m256 V = _mm256_blend_ps(_mm256_movehdup_ps(Chroma), Middle, 0xaa);
+
+		__m256 K[3];
+		for (int Channel = 0; Channel < 3; Channel++)
+		{
+			K[Channel] = _mm256_fmadd_ps(U, _mm256_set1_ps(Convert->ScaleKU[Channel]), _mm256_fmadd_ps(V, _mm256_set1_ps(Convert->ScaleKV[Channel]), _mm256_set1_ps(Convert->OffsetK[Channel])));
+		}
+
+		__m256 A = _mm256_mul_ps(K[0], _mm256_set1_ps(W[0]));
+		A = _mm256_fmadd_ps(K[1], _mm256_set1_ps(W[1]), A);
+		A = _mm256_fmadd_ps(K[2], _mm256_set1_ps(W[2]), A);
+
+		__m256 B = _mm256_mul_ps(_mm256_mul_ps(K[0], K[0]), _mm256_set1_ps(W[0]));
+		B = _mm256_fmadd_ps(_mm256_mul_ps(K[1], K[1]), _mm256_set1_ps(W[1]), B);
+		B = _mm256_fmadd_ps(_mm256_mul_ps(K[2], K[2]), _mm256_set1_ps(W[2]), B);
+
+		__m256i Pixels = _mm256_loadu_si256((const __m256i*)(Input + X * 4));
+		__m256 Red = _mm256_cvtepi32_ps(CpuConvert__Channel_AVX2(Pixels, 16));
+		__m256 Green = _mm256_cvtepi32_ps(CpuConvert__Channel_AVX2(Pixels, 8));
+		__m256 Blue = _mm256_cvtepi32_ps(CpuConvert__Channel_AVX2(Pixels, 0));
+
+		__m256 L = _mm256_mul_ps(_mm256_mul_ps(Red, Red), _mm256_set1_ps(Convert->LumaScale[0]));
+		L = _mm256_fmadd_ps(_mm256_mul_ps(Green, Green), _mm256_set1_ps(Convert->LumaScale[1]), L);
+		L = _mm256_fmadd_ps(_mm256_mul_ps(Blue, Blue), _mm256_set1_ps(Convert->LumaScale[2]), L);
+
+		__m256 C = _mm256_fmadd_ps(A, A, _mm256_sub_ps(L, B));
+
+		// sqrt(C) = C * rsqrt(C), one Newton-Raphson step refines 12-bit approximation to almost full precision
+		__m256 Rsqrt = _mm256_rsqrt_ps(C);
+		Rsqrt = _mm256_mul_ps(Rsqrt, _mm256_fnmadd_ps(_mm256_mul_ps(_mm256_mul_ps(C, _mm256_set1_ps(0.5f)), Rsqrt), Rsqrt, _mm256_set1_ps(1.5f)));
+
+		// C = 0 gives 0 * inf, negative C stays NaN same as sqrt on GPU
+		__m256 Sqrt = _mm256_and_ps(_mm256_mul_ps(C, Rsqrt), _mm256_cmp_ps(C, Zero, _CMP_NEQ_OQ));
+
+		// saturate, max returns second operand for NaN so it becomes 0 same as on GPU
+		__m256 Value = _mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(Sqrt, A), Zero), One);
+		Value = _mm256_fmadd_ps(Value, _mm256_set1_ps(Convert->RangeY), _mm256_set1_ps(Convert->OffsetY));
+		CpuConvert__Store_AVX2(Convert, RowY, X, _mm256_cvttps_epi32(Value));
+	}
+
+	for (; X < Convert->Width; X++)
+	{
+		CpuConvert__PixelY_Scalar(Convert, Input, RowUV0, RowUV1, Weight0, RowY, X);
+	}
+}
+
+// AVX2 fixed point - same as SSE4.1 version, with each 128-bit lane doing 4 pixels
+
+CPU_INLINE CPU_TARGET("avx2,fma") __m256i CpuConvert__FixedY_AVX2(__m256i Pixels, __m256i Coefficients, __m256i Offset)
+{
+	__m256i Zero = _mm256_setzero_si256();
+	__m256i Low = _mm256_madd_epi16(_mm256_unpacklo_epi8(Pixels, Zero), Coefficients);
+	__m256i High = _mm256_madd_epi16(_mm256_unpackhi_epi8(Pixels, Zero), Coefficients);
+	return _mm256_srli_epi32(_mm256_add_epi32(_mm256_hadd_epi32(Low, High), Offset), CPU_CONVERT_FIXED_BITS);
+}
+
+CPU_INLINE CPU_TARGET("avx2,fma") __m256i CpuConvert__FixedUV_AVX2(__m256i Left0, __m256i Left1, __m256i Pixels0, __m256i Pixels1, __m256i CoefficientsU, __m256i CoefficientsV, __m256i Offset)
+{
+	__m256i Zero = _mm256_setzero_si256();
+	__m256i Low = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpacklo_epi8(Left0, Zero), _mm256_unpacklo_epi8(Pixels0, Zero)), _mm256_add_epi16(_mm256_unpacklo_epi8(Left1, Zero), _mm256_unpacklo_epi8(Pixels1, Zero)));
+	__m256i High = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpackhi_epi8(Left0, Zero), _mm256_unpackhi_epi8(Pixels0, Zero)), _mm256_add_epi16(_mm256_unpackhi_epi8(Left1, Zero), _mm256_unpackhi_epi8(Pixels1, Zero)));
+
+	__m256i U = _mm256_hadd_epi32(_mm256_madd_epi16(Low, CoefficientsU), _mm256_madd_epi16(High, CoefficientsU));
+	__m256i V = _mm256_hadd_epi32(_mm256_madd_epi16(Low, CoefficientsV), _mm256_madd_epi16(High, CoefficientsV));
+
+	__m256i UV = _mm256_srli_epi32(_mm256_add_epi32(_mm256_hadd_epi32(U, V), Offset), CPU_CONVERT_FIXED_BITS + 3);
+	return _mm256_shuffle_epi32(UV, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+static CPU_TARGET("avx2,fma") void CpuConvert__Row_Fixed_AVX2(const CpuConvert* Convert, const uint8_t* Row0, const uint8_t* Row1, uint8_t* RowY0, uint8_t* RowY1, uint8_t* RowUV)
+{
+	__m256i CoefficientsY = _mm256_broadcastsi128_si256(CpuConvert__FixedCoefficients_SSE41(Convert->FixedY));
+	__m256i CoefficientsU = _mm256_broadcastsi128_si256(CpuConvert__FixedCoefficients_SSE41(Convert->FixedU));
+	__m256i CoefficientsV = _mm256_broadcastsi128_si256(CpuConvert__FixedCoefficients_SSE41(Convert->FixedV));
+	__m256i OffsetY = _mm256_set1_epi32(Convert->FixedOffsetY);
+	__m256i OffsetUV = _mm256_set1_epi32(Convert->FixedOffsetUV);
+
+	uint32_t X = 0;
+	for (; X + 8 <= Convert->Width; X += 8)
+	{
+		__m256i Pixels0 = _mm256_loadu_si256((const __m256i*)(Row0 + X * 4));
+		__m256i Pixels1 = _mm256_loadu_si256((const __m256i*)(Row1 + X * 4));
+
+		// pixels shifted by one to the right, left of first pixel in row is clamped to itself
+		__m256i Left0, Left1;
+		if (X == 0)
+		{
+			__m256i Index = _mm256_setr_epi32(0, 0, 1, 2, 3, 4, 5, 6);
+			Left0 = _mm256_permutevar8x32_epi32(Pixels0, Index);
+			Left1 = _mm256_permutevar8x32_epi32(Pixels1, Index);
+		}
+		else
+		{
+			Left0 = _mm256_loadu_si256((const __m256i*)(Row0 + X * 4 - 4));
+			Left1 = _mm256_loadu_si256((const __m256i*)(Row1 + X * 4 - 4));
+		}
+
+		__m256i Y0 = CpuConvert__FixedY_AVX2(Pixels0, CoefficientsY, OffsetY);
+		__m256i Y1 = CpuConvert__FixedY_AVX2(Pixels1, CoefficientsY, OffsetY);
+		__m256i UV = CpuConvert__FixedUV_AVX2(Left0, Left1, Pixels0, Pixels1, CoefficientsU, CoefficientsV, OffsetUV);
+
+		// each 128-bit lane has 4 bytes of Y0, Y1, UV, UV - gather them to 8 bytes of Y0, Y1, UV
+		__m256i Bytes = _mm256_packus_epi16(_mm256_packus_epi32(Y0, Y1), _mm256_packus_epi32(UV, UV));
+		Bytes = _mm256_permutevar8x32_epi32(Bytes, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+
+		__m128i Y = _mm256_castsi256_si128(Bytes);
+		if (RowY0)
+		{
+			_mm_storel_epi64((__m128i*)(RowY0 + X), Y);
+			_mm_storel_epi64((__m128i*)(RowY1 + X), _mm_unpackhi_epi64(Y, Y));
+		}
+		_mm_storel_epi64((__m128i*)(RowUV + X), _mm256_extracti128_si256(Bytes, 1));
+	}
+
+	for (; X < Convert->Width; X += 2)
+	{
+		CpuConvert__Block_Fixed(Convert, Row0, Row1, RowY0, RowY1, RowUV, X);
+	}
+}
+
+#endif // defined(CPU_X64)
+
+#if defined(CPU_ARM64)
+
+// NEON - 8 pixels from each row per iteration, deinterleaved to 8-bit channels on load
+
+CPU_INLINE float32x4_t CpuConvert__Dot_NEON(const float* Scale, float Offset, uint32x4_t R, uint32x4_t G, uint32x4_t B)
+{
+	float32x4_t Value = vdupq_n_f32(Offset);
+	Value = vfmaq_n_f32(Value, vcvtq_f32_u32(R), Scale[0]);
+	Value = vfmaq_n_f32(Value, vcvtq_f32_u32(G), Scale[1]);
+	Value = vfmaq_n_f32(Value, vcvtq_f32_u32(B), Scale[2]);
+	return Value;
+}
+
+CPU_INLINE uint16x8_t CpuConvert__Y_NEON(const CpuConvert* Convert, uint8x8x4_t Pixels)
+{
+	uint16x8_t B = vmovl_u8(Pixels.val[0]);
+	uint16x8_t G = vmovl_u8(Pixels.val[1]);
+	uint16x8_t R = vmovl_u8(Pixels.val[2]);
+
+	// conversion to unsigned truncates & clamps negative values to 0
+	float32x4_t Low = CpuConvert__Dot_NEON(Convert->ScaleY, Convert->OffsetY, vmovl_u16(vget_low_u16(R)), vmovl_u16(vget_low_u16(G)), vmovl_u16(vget_low_u16(B)));
+	float32x4_t High = CpuConvert__Dot_NEON(Convert->ScaleY, Convert->OffsetY, vmovl_high_u16(R), vmovl_high_u16(G), vmovl_high_u16(B));
+	return vcombine_u16(vqmovn_u32(vcvtq_u32_f32(Low)), vqmovn_u32(vcvtq_u32_f32(High)));
+}
+
+CPU_INLINE uint16x4_t CpuConvert__Sum_NEON(uint8x8_t Left0, uint8x8_t Left1, uint8x8_t Pixels0, uint8x8_t Pixels1)
+{
+	// left + 2 * center + right pixel from both rows for even pixels
+	uint16x8_t Left = vaddl_u8(Left0, Left1);
+	uint16x8_t Center = vaddl_u8(Pixels0, Pixels1);
+	uint16x8_t Right = vextq_u16(Center, Center, 1);
+	uint16x8_t Sum = vaddq_u16(vaddq_u16(Left, Right), vaddq_u16(Center, Center));
+	return vget_low_u16(vuzp1q_u16(Sum, Sum));
+}
+
+CPU_INLINE void CpuConvert__Store_NEON(const CpuConvert* Convert, uint8_t* Output, uint32_t Index, uint16x8_t Value)
+{
+	if (Convert->Format == CpuConvertFormat_NV12)
+	{
+		vst1_u8(Output + Index, vqmovn_u16(Value));
+	}
+	else
+	{
+		vst1q_u16((uint16_t*)Output + Index, Value);
+	}
+}
+
+static void CpuConvert__Row_NEON(const CpuConvert* Convert, const uint8_t* Row0, const uint8_t* Row1, uint8_t* RowY0, uint8_t* RowY1, uint8_t* RowUV)
+{
+	uint32_t X = 0;
+	for (; X + 8 <= Convert->Width; X += 8)
+	{
+		uint8x8x4_t Pixels0 = vld4_u8(Row0 + X * 4);
+		uint8x8x4_t Pixels1 = vld4_u8(Row1 + X * 4);
+
+		// pixels shifted by one to the right, left of first pixel in row is clamped to itself
+		uint8x8x4_t Left0, Left1;
+		if (X == 0)
+		{
+			for (int Channel = 0; Channel < 3; Channel++)
+			{
+				Left0.val[Channel] = vext_u8(vdup_lane_u8(Pixels0.val[Channel], 0), Pixels0.val[Channel], 7);
+				Left1.val[Channel] = vext_u8(vdup_lane_u8(Pixels1.val[Channel], 0), Pixels1.val[Channel], 7);
+			}
+		}
+		else
+		{
+			Left0 = vld4_u8(Row0 + X * 4 - 4);
+			Left1 = vld4_u8(Row1 + X * 4 - 4);
+		}
+
+		if (RowY0)
+		{
+			CpuConvert__Store_NEON(Convert, RowY0, X, CpuConvert__Y_NEON(Convert, Pixels0));
+			CpuConvert__Store_NEON(Convert, RowY1, X, CpuConvert__Y_NEON(Convert, Pixels1));
+		}
+
+		uint32x4_t B = vmovl_u16(CpuConvert__Sum_NEON(Left0.val[0], Left1.val[0], Pixels0.val[0], Pixels1.val[0]));
+		uint32x4_t G = vmovl_u16(CpuConvert__Sum_NEON(Left0.val[1], Left1.val[1], Pixels0.val[1], Pixels1.val[1]));
+		uint32x4_t R = vmovl_u16(CpuConvert__Sum_NEON(Left0.val[2], Left1.val[2], Pixels0.val[2], Pixels1.val[2]));
+
+		uint16x4_t U = vqmovn_u32(vcvtq_u32_f32(CpuConvert__Dot_NEON(Convert->ScaleU, Convert->OffsetUV, R, G, B)));
+		uint16x4_t V = vqmovn_u32(vcvtq_u32_f32(CpuConvert__Dot_NEON(Convert->ScaleV, Convert->OffsetUV, R, G, B)));
+		CpuConvert__Store_NEON(Convert, RowUV, X, vzip1q_u16(vcombine_u16(U, U), vcombine_u16(V, V)));
+	}
+
+	for (; X < Convert->Width; X += 2)
+	{
+		CpuConvert__Block_Scalar(Convert, Row0, Row1, RowY0, RowY1, RowUV, X);
+	}
+}
+
+CPU_INLINE void CpuConvert__LoadUV_NEON(const CpuConvert* Convert, const uint8_t* Row0, const uint8_t* Row1, float Weight0, uint32_t Index, float32x4_t* Result)
+{
+	// 8 values from UV planes starting at Index, interpolated vertically
+	uint16x8_t Value0, Value1;
+	if (Convert->Format == CpuConvertFormat_NV12)
+	{
+		Value0 = vmovl_u8(vld1_u8(Row0 + Index));
+		Value1 = vmovl_u8(vld1_u8(Row1 + Index));
+	}
+	else
+	{
+		Value0 = vld1q_u16((const uint16_t*)Row0 + Index);
+		Value1 = vld1q_u16((const uint16_t*)Row1 + Index);
+	}
+	Result[0] = vfmaq_n_f32(vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(Value1))), 1.f - Weight0), vcvtq_f32_u32(vmovl_u16(vget_low_u16(Value0))), Weight0);
+	Result[1] = vfmaq_n_f32(vmulq_n_f32(vcvtq_f32_u32(vmovl_high_u16(Value1)), 1.f - Weight0), vcvtq_f32_u32(vmovl_high_u16(Value0)), Weight0);
+}
+
+CPU_INLINE uint16x4_t CpuConvert__ImprovedY_NEON(const CpuConvert* Convert, float32x4_t U, float32x4_t V, uint32x4_t Red, uint32x4_t Green, uint32x4_t Blue)
+{
+	const float* W = CpuConvert__LumaWeights;
+
+	float32x4_t K[3];
+	for (int Channel = 0; Channel < 3; Channel++)
+	{
+		K[Channel] = vfmaq_n_f32(vfmaq_n_f32(vdupq_n_f32(Convert->OffsetK[Channel]), U, Convert->ScaleKU[Channel]), V, Convert->ScaleKV[Channel]);
+	}
+
+	float32x4_t A = vmulq_n_f32(K[0], W[0]);
+	A = vfmaq_n_f32(A, K[1], W[1]);
+	A = vfmaq_n_f32(A, K[2], W[2]);
+
+	float32x4_t B = vmulq_n_f32(vmulq_f32(K[0], K[0]), W[0]);
+	B = vfmaq_n_f32(B, vmulq_f32(K[1], K[1]), W[1]);
+	B = vfmaq_n_f32(B, vmulq_f32(K[2], K[2]), W[2]);
+
+	// squares of bytes are exact in integers
+	float32x4_t L = vmulq_n_f32(vcvtq_f32_u32(vmulq_u32(Red, Red)), Convert->LumaScale[0]);
+	L = vfmaq_n_f32(L, vcvtq_f32_u32(vmulq_u32(Green, Green)), Convert->LumaScale[1]);
+	L = vfmaq_n_f32(L, vcvtq_f32_u32(vmulq_u32(Blue, Blue)), Convert->LumaScale[2]);
+
+	float32x4_t C = vfmaq_f32(vsubq_f32(L, B), A, A);
+
+	// sqrt(C) = C * rsqrt(C), estimate has only 8 bits so it needs two Newton-Raphson steps
+	float32x4_t Rsqrt = vrsqrteq_f32(C);
+	Rsqrt = vmulq_f32(Rsqrt, vrsqrtsq_f32(vmulq_f32(C, Rsqrt), Rsqrt));
+	Rsqrt = vmulq_f32(Rsqrt, vrsqrtsq_f32(vmulq_f32(C, Rsqrt), Rsqrt));
+
+	// C = 0 gives 0 * inf, negative C stays NaN same as sqrt on GPU
+	float32x4_t Sqrt = vreinterpretq_f32_u32(vbicq_u32(vreinterpretq_u32_f32(vmulq_f32(C, Rsqrt)), vceqzq_f32(C)));
+
+	// saturate, maxnm returns the number for NaN so it becomes 0 same as on GPU
+	float32x4_t Value = vminq_f32(vmaxnmq_f32(vsubq_f32(Sqrt, A), vdupq_n_f32(0.f)), vdupq_n_f32(1.f));
+	Value = vfmaq_n_f32(vdupq_n_f32(Convert->OffsetY), Value, Convert->RangeY);
+	return vqmovn_u32(vcvtq_u32_f32(Value));
+}
+
+static void CpuConvert__RowY_NEON(const CpuConvert* Convert, const uint8_t* Input, const uint8_t* RowUV0, const uint8_t* RowUV1, float Weight0, uint8_t* RowY)
+{
+	// last pixels in row are left for scalar loop, which clamps the right chroma sample
+	uint32_t X = 0;
+	for (; X + 8 < Convert->Width; X += 8)
+	{
+		// chroma samples X/2 .. X/2+3 and one to the right of each
+		float32x4_t Chroma[2], Right[2];
+		CpuConvert__LoadUV_NEON(Convert, RowUV0, RowUV1, Weight0, X, Chroma);
+		CpuConvert__LoadUV_NEON(Convert, RowUV0, RowUV1, Weight0, X + 2, Right);
+
+		uint8x8x4_t Pixels = vld4_u8(Input + X * 4);
+		uint16x8_t B = vmovl_u8(Pixels.val[0]);
+		uint16x8_t G = vmovl_u8(Pixels.val[1]);
+		uint16x8_t R = vmovl_u8(Pixels.val[2]);
+
+		// even pixels are co-sited with chroma samples, odd pixels are in middle between two of them
+		float32x4_t Middle0 = vmulq_n_f32(vaddq_f32(Chroma[0], Right[0]), 0.5f);
+		float32x4_t Middle1 = vmulq_n_f32(vaddq_f32(Chroma[1], Right[1]), 0.5f);
+
+		uint16x4_t Y0 = CpuConvert__ImprovedY_NEON(Convert, vtrn1q_f32(Chroma[0], Middle0), vtrn2q_f32(Chroma[0], Middle0), vmovl_u16(vget_low_u16(R)), vmovl_u16(vget_low_u16(G)), vmovl_u16(vget_low_u16(B)));
+		uint16x4_t Y1 = CpuConvert__ImprovedY_NEON(Convert, vtrn1q_f32(Chroma[1], Middle1), vtrn2q_f32(Chroma[1], Middle1), vmovl_high_u16(R), vmovl_high_u16(G), vmovl_high_u16(B));
+		CpuConvert__Store_NEON(Convert, RowY, X, vcombine_u16(Y0, Y1));
+	}
+
+	for (; X < Convert->Width; X++)
+	{
+		CpuConvert__PixelY_Scalar(Convert, Input, RowUV0, RowUV1, Weight0, RowY, X);
+	}
+}
+
+// NEON fixed point - widening multiply accumulate on deinterleaved channels
+
+CPU_INLINE int32x4_t CpuConvert__FixedDot_NEON(const int16_t* Coefficient, int32_t Offset, int16x4_t R, int16x4_t G, int16x4_t B)
+{
+	int32x4_t Value = vdupq_n_s32(Offset);
+	Value = vmlal_n_s16(Value, R, Coefficient[0]);
+	Value = vmlal_n_s16(Value, G, Coefficient[1]);
+	Value = vmlal_n_s16(Value, B, Coefficient[2]);
+	return Value;
+}
+
+CPU_INLINE uint8x8_t CpuConvert__FixedY_NEON(const CpuConvert* Convert, uint8x8x4_t Pixels)
+{
+	int16x8_t B = vreinterpretq_s16_u16(vmovl_u8(Pixels.val[0]));
+	int16x8_t G = vreinterpretq_s16_u16(vmovl_u8(Pixels.val[1]));
+	int16x8_t R = vreinterpretq_s16_u16(vmovl_u8(Pixels.val[2]));
+
+	int32x4_t Low = CpuConvert__FixedDot_NEON(Convert->FixedY, Convert->FixedOffsetY, vget_low_s16(R), vget_low_s16(G), vget_low_s16(B));
+	int32x4_t High = CpuConvert__FixedDot_NEON(Convert->FixedY, Convert->FixedOffsetY, vget_high_s16(R), vget_high_s16(G), vget_high_s16(B));
+	return vqmovn_u16(vcombine_u16(vqshrun_n_s32(Low, CPU_CONVERT_FIXED_BITS), vqshrun_n_s32(High, CPU_CONVERT_FIXED_BITS)));
+}
+
+static void CpuConvert__Row_Fixed_NEON(const CpuConvert* Convert, const uint8_t* Row0, const uint8_t* Row1, uint8_t* RowY0, uint8_t* RowY1, uint8_t* RowUV)
+{
+	uint32_t X = 0;
+	for (; X + 8 <= Convert->Width; X += 8)
+	{
+		uint8x8x4_t Pixels0 = vld4_u8(Row0 + X * 4);
+		uint8x8x4_t Pixels1 = vld4_u8(Row1 + X * 4);
+
+		// pixels shifted by one to the right, left of first pixel in row is clamped to itself
+		uint8x8x4_t Left0, Left1;
+		if (X == 0)
+		{
+			for (int Channel = 0; Channel < 3; Channel++)
+			{
+				Left0.val[Channel] = vext_u8(vdup_lane_u8(Pixels0.val[Channel], 0), Pixels0.val[Channel], 7);
+				Left1.val[Channel] = vext_u8(vdup_lane_u8(Pixels1.val[Channel], 0), Pixels1.val[Channel], 7);
+			}
+		}
+		else
+		{
+			Left0 = vld4_u8(Row0 + X * 4 - 4);
+			Left1 = vld4_u8(Row1 + X * 4 - 4);
+		}
+
+		if (RowY0)
+		{
+			vst1_u8(RowY0 + X, CpuConvert__FixedY_NEON(Convert, Pixels0));
+			vst1_u8(RowY1 + X, CpuConvert__FixedY_NEON(Convert, Pixels1));
+		}
+
+		int16x4_t B = vreinterpret_s16_u16(CpuConvert__Sum_NEON(Left0.val[0], Left1.val[0], Pixels0.val[0], Pixels1.val[0]));
+		int16x4_t G = vreinterpret_s16_u16(CpuConvert__Sum_NEON(Left0.val[1], Left1.val[1], Pixels0.val[1], Pixels1.val[1]));
+		int16x4_t R = vreinterpret_s16_u16(CpuConvert__Sum_NEON(Left0.val[2], Left1.val[2], Pixels0.val[2], Pixels1.val[2]));
+
+		uint16x4_t U = vqshrun_n_s32(CpuConvert__FixedDot_NEON(Convert->FixedU, Convert->FixedOffsetUV, R, G, B), CPU_CONVERT_FIXED_BITS + 3);
+		uint16x4_t V = vqshrun_n_s32(CpuConvert__FixedDot_NEON(Convert->FixedV, Convert->FixedOffsetUV, R, G, B), CPU_CONVERT_FIXED_BITS + 3);
+		vst1_u8(RowUV + X, vqmovn_u16(vzip1q_u16(vcombine_u16(U, U), vcombine_u16(V, V))));
+	}
+
+	for (; X < Convert->Width; X += 2)
+	{
+		CpuConvert__Block_Fixed(Convert, Row0, Row1, RowY0, RowY1, RowUV, X);
+	}
+}
+
+#endif // defined(CPU_ARM64)
+
+static void CpuConvert__Rows(const CpuConvert* Convert, const uint8_t* Input, size_t InputPitch, uint8_t* OutputY, size_t PitchY, uint8_t* OutputUV, size_t PitchUV, uint32_t RowCount)
+{
+	// converts RowCount input rows, Output pointers are at rows matching first input row
+	for (uint32_t Y = 0; Y < RowCount; Y += 2)
+	{
+		const uint8_t* Row0 = Input + Y * InputPitch;
+		uint8_t* RowY0 = OutputY + Y * PitchY;
+		Convert->Row(Convert, Row0, Row0 + InputPitch, RowY0, RowY0 + PitchY, OutputUV + Y / 2 * PitchUV);
+	}
+}
+
+static void CpuConvert__ImprovedRows(const CpuConvert* Convert, const uint8_t* Input, size_t InputPitch, uint8_t* OutputY, size_t PitchY, uint8_t* OutputUV, size_t PitchUV, uint32_t First, uint32_t Last)
+{
+	// converts rows [First, Last), Input points to row First & must have two more rows after Last (if image has them)
+	// Output pointers are at row 0, because Y needs chroma row above from previous call
+
+	// chroma & Y are done for one row pair at a time, first chroma row below it is calculated
+	// then Y is solved with it and two chroma rows calculated just before, so they are still in cache
+	uint32_t ChromaHeight = Convert->Height / 2;
+	if (First == 0)
+	{
+		Convert->Row(Convert, Input, Input + InputPitch, NULL, NULL, OutputUV);
+	}
+
+	for (uint32_t Y = First; Y < Last; Y += 2)
+	{
+		uint32_t Chroma = Y / 2;
+		uint32_t Above = Chroma == 0 ? 0 : Chroma - 1;
+		uint32_t Below = Chroma + 1 < ChromaHeight ? Chroma + 1 : Chroma;
+
+		const uint8_t* Row = Input + (Y - First) * InputPitch;
+		if (Below != Chroma)
+		{
+			Convert->Row(Convert, Row + 2 * InputPitch, Row + 3 * InputPitch, NULL, NULL, OutputUV + Below * PitchUV);
+		}
+
+		// vertically chroma is at 1/4 between rows of pixel pair
+		Convert->RowY(Convert, Row, OutputUV + Above * PitchUV, OutputUV + Chroma * PitchUV, 0.25f, OutputY + Y * PitchY);
+		Convert->RowY(Convert, Row + InputPitch, OutputUV + Chroma * PitchUV, OutputUV + Below * PitchUV, 0.75f, OutputY + (Y + 1) * PitchY);
+	}
+}
+
+static int16_t CpuConvert__FixedRound(float Value)
+{
+	return (int16_t)(Value < 0 ? Value - 0.5f : Value + 0.5f);
+}
+
+void CpuConvert_Create(CpuConvert* Convert, uint32_t Width, uint32_t Height, YuvColorSpace ColorSpace, CpuConvertFormat Format, bool ImprovedConversion, bool FixedPoint, CpuKernel Kernel)
+{
+	Assert(Width % 2 == 0 && Height % 2 == 0);
+	Assert(!FixedPoint || Format == CpuConvertFormat_NV12);
+	Assert(Format != CpuConvertFormat_P010_HDR || (ColorSpace == YuvColorSpace_BT2020 && !ImprovedConversion));
+	Assert(ColorSpace < sizeof(YuvMatrix) / sizeof(*YuvMatrix));
+
+	*Convert = (CpuConvert)
+	{
+		.Matrix = YuvMatrix[ColorSpace],
+		.Format = Format,
+		.Kernel = Cpu_SelectKernel(Kernel),
+		.StripPitch = Width * 4,
+		.Width = Width,
+		.Height = Height,
+	};
+	Convert->Strip = Cpu_Alloc(Convert->StripPitch * (CPU_CONVERT_STRIP_ROWS + 2));
+
+	float MaxValue = Format == CpuConvertFormat_NV12 ? 255.f : 65535.f;
+	for (int Channel = 0; Channel < 3; Channel++)
+	{
+		Convert->ScaleY[Channel] = Convert->Matrix[0][Channel] * CPU_CONVERT_RANGE_Y * MaxValue / 255.f;
+		Convert->ScaleU[Channel] = Convert->Matrix[1][Channel] * CPU_CONVERT_RANGE_UV * MaxValue / (8 * 255.f);
+		Convert->ScaleV[Channel] = Convert->Matrix[2][Channel] * CPU_CONVERT_RANGE_UV * MaxValue / (8 * 255.f);
+	}
+	Convert->OffsetY = CPU_CONVERT_OFFSET_Y * MaxValue + 0.5f;
+	Convert->OffsetUV = CPU_CONVERT_OFFSET_UV * MaxValue + 0.5f;
+
+	// K = mul(YUV_To_RGB, float3(0, UV * (1.0 / RANGE_UV) - (OFFSET_UV / RANGE_UV))) from ConvertImprovedY shader
+	for (int Channel = 0; Channel < 3; Channel++)
+	{
+		const float* Row = Convert->Matrix[3 + Channel];
+		Convert->LumaScale[Channel] = CpuConvert__LumaWeights[Channel] / (255.f * 255.f);
+		Convert->ScaleKU[Channel] = Row[1] / (CPU_CONVERT_RANGE_UV * MaxValue);
+		Convert->ScaleKV[Channel] = Row[2] / (CPU_CONVERT_RANGE_UV * MaxValue);
+		Convert->OffsetK[Channel] = -(Row[1] + Row[2]) * (CPU_CONVERT_OFFSET_UV / CPU_CONVERT_RANGE_UV);
+	}
+	Convert->RangeY = CPU_CONVERT_RANGE_Y * MaxValue;
+
+	// green coefficient is adjusted so rounded coefficients have same sum as exact ones
+	// then white & black map to exact Y values, and gray has exactly zero chroma
+	int16_t* Fixed[] = { Convert->FixedY, Convert->FixedU, Convert->FixedV };
+	float Range[] = { CPU_CONVERT_RANGE_Y, CPU_CONVERT_RANGE_UV, CPU_CONVERT_RANGE_UV };
+	for (int Row = 0; Row < 3; Row++)
+	{
+		const float* Matrix = Convert->Matrix[Row];
+		float Scale = Range[Row] * (1 << CPU_CONVERT_FIXED_BITS);
+		Fixed[Row][0] = CpuConvert__FixedRound(Matrix[0] * Scale);
+		Fixed[Row][2] = CpuConvert__FixedRound(Matrix[2] * Scale);
+		Fixed[Row][1] = CpuConvert__FixedRound((Matrix[0] + Matrix[1] + Matrix[2]) * Scale) - Fixed[Row][0] - Fixed[Row][2];
+	}
+	Convert->FixedOffsetY = (int32_t)(CPU_CONVERT_OFFSET_Y * 255.f + 0.5f) << CPU_CONVERT_FIXED_BITS | 1 << (CPU_CONVERT_FIXED_BITS - 1);
+	Convert->FixedOffsetUV = (int32_t)(CPU_CONVERT_OFFSET_UV * 255.f + 0.5f) << (CPU_CONVERT_FIXED_BITS + 3) | 1 << (CPU_CONVERT_FIXED_BITS + 2);
+
+	switch (Convert->Kernel)
+	{
+#if defined(CPU_X64)
+	case CpuKernel_SSE41:
+		// only fixed point has SSE4.1 kernel, float one would be half the width of AVX2 & need to emulate variable permutes
+		Convert->Row = FixedPoint ? &CpuConvert__Row_Fixed_SSE41 : &CpuConvert__Row_Scalar;
+		Convert->RowY = &CpuConvert__RowY_Scalar;
+		break;
+	case CpuKernel_AVX2:
+		Convert->Row = FixedPoint ? &CpuConvert__Row_Fixed_AVX2 : &CpuConvert__Row_AVX2;
+		Convert->RowY = &CpuConvert__RowY_AVX2;
+		break;
+#endif
+#if defined(CPU_ARM64)
+	case CpuKernel_NEON:
+		Convert->Row = FixedPoint ? &CpuConvert__Row_Fixed_NEON : &CpuConvert__Row_NEON;
+		Convert->RowY = &CpuConvert__RowY_NEON;
+		break;
+#endif
+	default:
+		Convert->Row = FixedPoint ? &CpuConvert__Row_Fixed_Scalar : &CpuConvert__Row_Scalar;
+		Convert->RowY = &CpuConvert__RowY_Scalar;
+		break;
+	}
+
+	if (Format == CpuConvertFormat_P010_HDR)
+	{
+		Convert->Row = &CpuConvert__Row_Hdr;
+	}
+
+	if (!ImprovedConversion)
+	{
+		Convert->RowY = NULL;
+	}
+}
+
+void CpuConvert_Release(CpuConvert* Convert)
+{
+	Cpu_Free(Convert->Strip);
+}
+
+void CpuConvert_Run(CpuConvert* Convert, const uint8_t* Input, size_t InputPitch, uint8_t* OutputY, size_t PitchY, uint8_t* OutputUV, size_t PitchUV)
+{
+	if (Convert->RowY)
+	{
+		CpuConvert__ImprovedRows(Convert, Input, InputPitch, OutputY, PitchY, OutputUV, PitchUV, 0, Convert->Height);
+	}
+	else
+	{
+		CpuConvert__Rows(Convert, Input, InputPitch, OutputY, PitchY, OutputUV, PitchUV, Convert->Height);
+	}
+}
+
+void CpuConvert_RunTiles(CpuConvert* Convert, const uint8_t* Input, size_t InputPitch, uint8_t* OutputY, size_t PitchY, uint8_t* OutputUV, size_t PitchUV)
+{
+	Assert(Convert->RowY && Convert->Format != CpuConvertFormat_P010_HDR);
+
+	uint32_t ChromaWidth = Convert->Width / 2;
+	uint32_t ChromaHeight = Convert->Height / 2;
+	float MaxValue = Convert->Format == CpuConvertFormat_NV12 ? 255.f : 65535.f;
+
+	// same layout as ConvertImprovedUV group shared array, row 0 is above tile & column 16 is to the right of it
+	float Shared[CPU_CONVERT_TILE_SIZE + 2][CPU_CONVERT_TILE_SIZE + 1][2];
+
+	for (uint32_t TileY = 0; TileY < ChromaHeight; TileY += CPU_CONVERT_TILE_SIZE)
+	{
+		for (uint32_t TileX = 0; TileX < ChromaWidth; TileX += CPU_CONVERT_TILE_SIZE)
+		{
+			for (uint32_t LocalY = 0; LocalY < CPU_CONVERT_TILE_SIZE + 2; LocalY++)
+			{
+				for (uint32_t LocalX = 0; LocalX < CPU_CONVERT_TILE_SIZE + 1; LocalX++)
+				{
+					// position is clamped same way as sampler clamps texture coordinates
+					int32_t ChromaX = (int32_t)(TileX + LocalX);
+					int32_t ChromaY = (int32_t)(TileY + LocalY) - 1;
+					ChromaX = ChromaX < (int32_t)ChromaWidth ? ChromaX : (int32_t)ChromaWidth - 1;
+					ChromaY = ChromaY < 0 ? 0 : ChromaY < (int32_t)ChromaHeight ? ChromaY : (int32_t)ChromaHeight - 1;
+
+					const uint8_t* Row0 = Input + ChromaY * 2 * InputPitch;
+					float Color[3];
+					CpuConvert__ChromaColor(Row0, Row0 + InputPitch, ChromaX * 2, Color);
+
+					// rounded same as storing to output
+					Shared[LocalY][LocalX][0] = CpuConvert__Quantize(CpuConvert__Dot(Convert->Matrix[1], Color) * CPU_CONVERT_RANGE_UV + CPU_CONVERT_OFFSET_UV, MaxValue) / MaxValue;
+					Shared[LocalY][LocalX][1] = CpuConvert__Quantize(CpuConvert__Dot(Convert->Matrix[2], Color) * CPU_CONVERT_RANGE_UV + CPU_CONVERT_OFFSET_UV, MaxValue) / MaxValue;
+				}
+			}
+
+			for (uint32_t LocalY = 0; LocalY < CPU_CONVERT_TILE_SIZE && TileY + LocalY < ChromaHeight; LocalY++)
+			{
+				uint32_t Y = TileY + LocalY;
+				const uint8_t* Row0 = Input + Y * 2 * InputPitch;
+				uint8_t* RowY0 = OutputY + Y * 2 * PitchY;
+
+				for (uint32_t LocalX = 0; LocalX < CPU_CONVERT_TILE_SIZE && TileX + LocalX < ChromaWidth; LocalX++)
+				{
+					uint32_t X = TileX + LocalX;
+					const float* Center = Shared[LocalY + 1][LocalX];
+					CpuConvert__Store(Convert, OutputUV + Y * PitchUV, X * 2 + 0, Center[0]);
+					CpuConvert__Store(Convert, OutputUV + Y * PitchUV, X * 2 + 1, Center[1]);
+
+					// vertically chroma is at 1/4 between rows of pixel pair, odd pixels are in middle of two chroma values
+					// interpolated with same float operations as CpuConvert__PixelY_Scalar
+					for (uint32_t Row = 0; Row < 2; Row++)
+					{
+						const float (*Chroma0)[2] = Shared[LocalY + Row];
+						const float (*Chroma1)[2] = Shared[LocalY + Row + 1];
+						float Weight0 = Row == 0 ? 0.25f : 0.75f;
+
+						for (uint32_t Pixel = 0; Pixel < 2; Pixel++)
+						{
+							uint32_t Right = LocalX + Pixel;
+
+							float UV[2];
+							for (int Channel = 0; Channel < 2; Channel++)
+							{
+								float Value0 = Chroma0[LocalX][Channel] * Weight0 + Chroma1[LocalX][Channel] * (1.f - Weight0);
+								float Value1 = Chroma0[Right][Channel] * Weight0 + Chroma1[Right][Channel] * (1.f - Weight0);
+								UV[Channel] = (Value0 + Value1) * 0.5f;
+							}
+							CpuConvert__SolveY(Convert, Row0 + Row * InputPitch, UV, RowY0 + Row * PitchY, X * 2 + Pixel);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+void CpuConvert_RunResize(CpuConvert* Convert, CpuResize* Resize, const uint8_t* Input, size_t InputPitch, uint8_t* OutputY, size_t PitchY, uint8_t* OutputUV, size_t PitchUV)
+{
+	Assert(Resize->OutputWidth == Convert->Width && Resize->OutputHeight == Convert->Height);
+	Assert(Convert->Format != CpuConvertFormat_P010_HDR);
+
+	if (Resize->Middle == NULL)
+	{
+		// nothing to resize
+		CpuConvert_Run(Convert, Input, InputPitch, OutputY, PitchY, OutputUV, PitchUV);
+		return;
+	}
+
+	CpuResize_RunMiddle(Resize, Input, InputPitch);
+
+	for (uint32_t First = 0; First < Convert->Height; First += CPU_CONVERT_STRIP_ROWS)
+	{
+		uint32_t Last = First + CPU_CONVERT_STRIP_ROWS < Convert->Height ? First + CPU_CONVERT_STRIP_ROWS : Convert->Height;
+
+		if (Convert->RowY)
+		{
+			// improved conversion needs two more rows for chroma below the strip, they are resized again for next strip
+			uint32_t End = Last + 2 < Convert->Height ? Last + 2 : Convert->Height;
+			CpuResize_RunRows(Resize, Convert->Strip, Convert->StripPitch, First, End);
+			CpuConvert__ImprovedRows(Convert, Convert->Strip, Convert->StripPitch, OutputY, PitchY, OutputUV, PitchUV, First, Last);
+		}
+		else
+		{
+			CpuResize_RunRows(Resize, Convert->Strip, Convert->StripPitch, First, Last);
+			CpuConvert__Rows(Convert, Convert->Strip, Convert->StripPitch, OutputY + First * PitchY, PitchY, OutputUV + First / 2 * PitchUV, PitchUV, Last - First);
+		}
+	}
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "wcap_cpu.h"
+
+//
+// interface
+//
+
+// cursor pixels are 8-bit premultiplied BGRA, except pixels with zero alpha are drawn as difference with background
+// this way one format represents alpha blended, transparent and inverted pixels of all Windows cursor types:
+//   transparent = (0,0,0,0), inverted = (255,255,255,0), opaque = (C,255), translucent = (C*A,A)
+
+// converts cursor bitmap to Width x Height cursor pixels in Output, rows of output are not padded
+// Color is 32-bit BGRA bitmap, or NULL for monochrome cursor
+// Mask is 1 bit per pixel with most significant bit first, for monochrome cursor it has AND mask followed by XOR mask
+// color cursor with non-zero alpha anywhere ignores Mask, without alpha Mask selects opaque or XOR pixels
+static void CpuCursor_Convert(uint8_t* Output, const uint8_t* Color, size_t ColorPitch, const uint8_t* Mask, size_t MaskPitch, uint32_t Width, uint32_t Height);
+
+// draws Width x Height cursor pixels over BGRA Frame with top-left corner at X,Y, cursor is clipped to frame
+// same calculation as CursorBlend shader, which can differ by 1 because of float rounding
+static void CpuCursor_Blend(uint8_t* Frame, size_t FramePitch, uint32_t FrameWidth, uint32_t FrameHeight, const uint8_t* Cursor, uint32_t Width, uint32_t Height, int32_t X, int32_t Y);
+
+//
+// implementation
+//
+
+static uint32_t CpuCursor__MaskBit(const uint8_t* Mask, size_t MaskPitch, uint32_t X, uint32_t Y)
+{
+	return (Mask[Y * MaskPitch + X / 8] >> (7 - X % 8)) & 1;
+}
+
+void CpuCursor_Convert(uint8_t* Output, const uint8_t* Color, size_t ColorPitch, const uint8_t* Mask, size_t MaskPitch, uint32_t Width, uint32_t Height)
+{
+	bool HasAlpha = false;
+	if (Color)
+	{
+		for (uint32_t Y = 0; Y < Height && !HasAlpha; Y++)
+		{
+			for (uint32_t X = 0; X < Width; X++)
+			{
+				if (Color[Y * ColorPitch + X * 4 + 3] != 0)
+				{
+					HasAlpha = true;
+					break;
+				}
+			}
+		}
+	}
+
+	for (uint32_t Y = 0; Y < Height; Y++)
+	{
+		for (uint32_t X = 0; X < Width; X++)
+		{
+			uint8_t* Pixel = Output + (Y * Width + X) * 4;
+
+			if (Color == NULL)
+			{
+				// AND=0 XOR=0 is black, AND=0 XOR=1 is white, AND=1 XOR=0 is transparent, AND=1 XOR=1 inverts
+				uint32_t And = CpuCursor__MaskBit(Mask, MaskPitch, X, Y);
+				uint32_t Xor = CpuCursor__MaskBit(Mask, MaskPitch, X, Y + Height);
+				uint8_t Value = Xor ? 255 : 0;
+				Pixel[0] = Pixel[1] = Pixel[2] = Value;
+				Pixel[3] = And ? 0 : 255;
+			}
+			else
+			{
+				const uint8_t* Input = Color + Y * ColorPitch + X * 4;
+				uint32_t Alpha;
+				if (HasAlpha)
+				{
+					Alpha = Input[3];
+				}
+				else
+				{
+					// XOR with color is approximated as difference, which is exact for black & white
+					Alpha = CpuCursor__MaskBit(Mask, MaskPitch, X, Y) ? 0 : 255;
+				}
+
+				for (uint32_t Channel = 0; Channel < 3; Channel++)
+				{
+					Pixel[Channel] = HasAlpha ? (uint8_t)((Input[Channel] * Alpha + 127) / 255) : Input[Channel];
+				}
+				Pixel[3] = (uint8_t)Alpha;
+			}
+		}
+	}
+}
+
+void CpuCursor_Blend(uint8_t* Frame, size_t FramePitch, uint32_t FrameWidth, uint32_t FrameHeight, const uint8_t* Cursor, uint32_t Width, uint32_t Height, int32_t X, int32_t Y)
+{
+	int32_t StartX = X < 0 ? -X : 0;
+	int32_t StartY = Y < 0 ? -Y : 0;
+	int32_t EndX = (int32_t)Width < (int32_t)FrameWidth - X ? (int32_t)Width : (int32_t)FrameWidth - X;
+	int32_t EndY = (int32_t)Height < (int32_t)FrameHeight - Y ? (int32_t)Height : (int32_t)FrameHeight - Y;
+
+	for (int32_t CursorY = StartY; CursorY < EndY; CursorY++)
+	{
+		for (int32_t CursorX = StartX; CursorX < EndX; CursorX++)
+		{
+			const uint8_t* Pixel = Cursor + (CursorY * Width + CursorX) * 4;
+			uint8_t* Output = Frame + (size_t)(Y + CursorY) * FramePitch + (size_t)(X + CursorX) * 4;
+
+			uint32_t Alpha = Pixel[3];
+			for (uint32_t Channel = 0; Channel < 3; Channel++)
+			{
+				uint32_t Value;
+				if (Alpha == 0)
+				{
+					Value = Pixel[Channel] > Output[Channel] ? Pixel[Channel] - Output[Channel] : Output[Channel] - Pixel[Channel];
+				}
+				else
+				{
+					Value = Pixel[Channel] + (Output[Channel] * (255 - Alpha) + 127) / 255;
+				}
+				Output[Channel] = (uint8_t)(Value < 255 ? Value : 255);
+			}
+		}
+	}
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "wcap_cpu.h"
+
+//
+// interface
+//
+
+typedef enum
+{
+	CpuDropPolicy_DropNewest,     // frame is dropped only when no encoder buffer is free
+	CpuDropPolicy_ReplaceOldest,  // frame is dropped when newer one is already waiting, so free buffers go to newest frames
+	CpuDropPolicy_HalveFramerate, // every other frame is dropped while overloaded
+	CpuDropPolicy_SkipExtras,     // frames are encoded without optional work while overloaded
+	CpuDropPolicy_Auto,           // skips extras first, then also replaces oldest & halves framerate when that is not enough
+}
+CpuDropPolicy;
+
+typedef enum
+{
+	CpuDropAction_Encode,
+	CpuDropAction_EncodeCheap, // encode without optional work, like duplicate & scene change detection
+	CpuDropAction_Drop,
+}
+CpuDropAction;
+
+typedef struct
+{
+	CpuDropPolicy Policy;
+	uint32_t BufferCount;
+	uint64_t Latency;       // average encode latency in 1/8 ticks
+	uint64_t OverloadStart; // time when overloaded state started
+	uint64_t OverloadEnd;   // time until policy keeps acting as overloaded
+	uint64_t SevereEnd;     // same for Auto policy dropping frames
+	uint32_t DropCounter;   // for halving framerate
+	bool Overloaded;
+	bool Severe;
+}
+CpuDrop;
+
+// decides what to do with every new video frame based on encoder buffer use, encode queue depth & latency
+// BufferCount is number of encoder buffers, all times are in same units, for example QPC ticks
+static void CpuDrop_Create(CpuDrop* Drop, CpuDropPolicy Policy, uint32_t BufferCount);
+
+// Latency is time from submitting frame to encoder until its buffer is free again
+static void CpuDrop_AddLatency(CpuDrop* Drop, uint64_t Latency);
+
+// Queued is count of newer frames already waiting after this one, Free is count of free encoder buffers
+// FramePeriod is time between output frames, action is Drop whenever Free is 0
+static CpuDropAction CpuDrop_Decide(CpuDrop* Drop, uint32_t Queued, uint32_t Free, uint64_t Time, uint64_t FramePeriod);
+
+//
+// implementation
+//
+
+// how many frames policy stays in overloaded state after last sign of it
+#define CPU_DROP_HOLD_FRAMES 30
+
+// Auto policy starts dropping only after this many overloaded frames, so cheaper encoding has
+// time to free buffers & bring down latency average that were built up by frames before it
+#define CPU_DROP_SETTLE_FRAMES 16
+
+void CpuDrop_Create(CpuDrop* Drop, CpuDropPolicy Policy, uint32_t BufferCount)
+{
+	*Drop = (CpuDrop)
+	{
+		.Policy = Policy,
+		.BufferCount = BufferCount,
+	};
+}
+
+void CpuDrop_AddLatency(CpuDrop* Drop, uint64_t Latency)
+{
+	// exponential moving average with 1/8 weight for new value
+	Drop->Latency = Drop->Latency - Drop->Latency / 8 + Latency;
+}
+
+CpuDropAction CpuDrop_Decide(CpuDrop* Drop, uint32_t Queued, uint32_t Free, uint64_t Time, uint64_t FramePeriod)
+{
+	// by Little's law encoder needs Latency / FramePeriod buffers in flight to keep up with framerate
+	uint64_t Demand = Drop->Latency / 8 / (FramePeriod ? FramePeriod : 1);
+
+	// newer frame waiting in queue means frames arrive faster than they are submitted
+	bool Pressure = Queued != 0 || Free <= 1 || Demand + 1 >= Drop->BufferCount;
+	bool Severe = Queued >= 2 || Free == 0 || Demand >= Drop->BufferCount;
+
+	uint64_t Hold = CPU_DROP_HOLD_FRAMES * FramePeriod;
+	if (Pressure)
+	{
+		if (!Drop->Overloaded)
+		{
+			Drop->OverloadStart = Time;
+		}
+		Drop->OverloadEnd = Time + Hold;
+		Drop->Overloaded = true;
+	}
+	else if (Drop->Overloaded && (int64_t)(Time - Drop->OverloadEnd) >= 0)
+	{
+		Drop->Overloaded = false;
+	}
+	if (Drop->Policy == CpuDropPolicy_Auto && Time - Drop->OverloadStart < CPU_DROP_SETTLE_FRAMES * FramePeriod)
+	{
+		Severe = false;
+	}
+	if (Severe)
+	{
+		Drop->SevereEnd = Time + Hold;
+		Drop->Severe = true;
+	}
+	else if (Drop->Severe && (int64_t)(Time - Drop->SevereEnd) >= 0)
+	{
+		Drop->Severe = false;
+	}
+
+	if (Free == 0)
+	{
+		return CpuDropAction_Drop;
+	}
+
+	bool Halve = false;
+	if (Drop->Policy == CpuDropPolicy_HalveFramerate ? Drop->Overloaded : Drop->Severe)
+	{
+		Halve = (Drop->DropCounter++ & 1) != 0;
+	}
+	else
+	{
+		Drop->DropCounter = 0;
+	}
+
+	switch (Drop->Policy)
+	{
+	case CpuDropPolicy_ReplaceOldest:
+		return Queued != 0 ? CpuDropAction_Drop : CpuDropAction_Encode;
+
+	case CpuDropPolicy_HalveFramerate:
+		return Halve ? CpuDropAction_Drop : CpuDropAction_Encode;
+
+	case CpuDropPolicy_SkipExtras:
+		return Drop->Overloaded ? CpuDropAction_EncodeCheap : CpuDropAction_Encode;
+
+	case CpuDropPolicy_Auto:
+		if (Drop->Severe && (Queued != 0 || Halve))
+		{
+			return CpuDropAction_Drop;
+		}
+		return Drop->Overloaded ? CpuDropAction_EncodeCheap : CpuDropAction_Encode;
+
+	default:
+		return CpuDropAction_Encode;
+	}
+}
@@ -0,0 +1,351 @@
+#pragma once
+
+#include "wcap_cpu.h"
+
+//
+// interface
+//
+
+// block size in pixels, same as area of one FrameHash shader group
+#define CPU_HASH_BLOCK_SIZE 32
+
+// adds hashes of Width x Height pixels starting at Input to Output[0] & Output[1], X & Y is position of first pixel in image
+typedef void CpuHash_BlockFunc(const uint8_t* Input, size_t InputPitch, uint32_t X, uint32_t Y, uint32_t Width, uint32_t Height, uint32_t* Output);
+
+typedef struct
+{
+	CpuHash_BlockFunc* Block;
+	CpuKernel Kernel;
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t BlockCountX;
+	uint32_t BlockCountY;
+}
+CpuHash;
+
+// CPU version of FrameHash shader, input is 8-bit BGRA, alpha is ignored
+// every block of CPU_HASH_BLOCK_SIZE x CPU_HASH_BLOCK_SIZE pixels gets two 32-bit values, all kernels give exactly same output
+// it is not cryptographic hash, only meant to detect changes between frames
+static void CpuHash_Create(CpuHash* Hash, uint32_t Width, uint32_t Height, CpuKernel Kernel);
+
+// Output must have space for 2 * BlockCountX * BlockCountY values
+static void CpuHash_Run(const CpuHash* Hash, const uint8_t* Input, size_t InputPitch, uint32_t* Output);
+
+// hashes only block rows [First, Last), to split work between threads
+static void CpuHash_RunRows(const CpuHash* Hash, const uint8_t* Input, size_t InputPitch, uint32_t* Output, uint32_t First, uint32_t Last);
+
+// compares block hashes of two frames & writes positions of blocks that need to be converted again to Blocks, returns their count
+// block needs conversion when it or any of its 8 neighbors has changed, because YUV conversion reads pixels around the block
+// positions are packed as Y << 16 | X, Blocks must have space for BlockCountX * BlockCountY values
+// Previous is NULL for first frame, then every block needs conversion
+static uint32_t CpuHash_DirtyBlocks(const uint32_t* Previous, const uint32_t* Current, uint32_t BlockCountX, uint32_t BlockCountY, uint32_t* Blocks);
+
+//
+// implementation
+//
+
+// same as HASH_* constants in shaders
+#define CPU_HASH_SALT  0x9e3779b1u
+#define CPU_HASH_MUL1  0x85ebca6bu
+#define CPU_HASH_MUL2  0xc2b2ae35u
+#define CPU_HASH_COLOR 0x00ffffffu
+
+// every pixel value is salted with its position, then mixed with murmur3 finalizer
+// block hash is sum & xor of mixed values, so pixels can be added in any order
+static uint32_t CpuHash__Mix(uint32_t Value)
+{
+	Value ^= Value >> 16;
+	Value *= CPU_HASH_MUL1;
+	Value ^= Value >> 13;
+	Value *= CPU_HASH_MUL2;
+	Value ^= Value >> 16;
+	return Value;
+}
+
+static uint32_t CpuHash__Salt(uint32_t X, uint32_t Y)
+{
+	return ((Y << 16) | X) * CPU_HASH_SALT;
+}
+
+// scalar reference
+
+static void CpuHash__Pixels_Scalar(const uint8_t* Row, uint32_t X, uint32_t Y, uint32_t Count, uint32_t* Sum, uint32_t* Xor)
+{
+	for (uint32_t Index = 0; Index < Count; Index++)
+	{
+		uint32_t Pixel;
+		memcpy(&Pixel, Row + Index * 4, sizeof(Pixel));
+
+		uint32_t Value = CpuHash__Mix((Pixel & CPU_HASH_COLOR) ^ CpuHash__Salt(X + Index, Y));
+		*Sum += Value;
+		*Xor ^= Value;
+	}
+}
+
+static void CpuHash__Block_Scalar(const uint8_t* Input, size_t InputPitch, uint32_t X, uint32_t Y, uint32_t Width, uint32_t Height, uint32_t* Output)
+{
+	uint32_t Sum = 0;
+	uint32_t Xor = 0;
+	for (uint32_t Row = 0; Row < Height; Row++)
+	{
+		CpuHash__Pixels_Scalar(Input + Row * InputPitch, X, Y + Row, Width, &Sum, &Xor);
+	}
+	Output[0] += Sum;
+	Output[1] ^= Xor;
+}
+
+#if defined(CPU_X64)
+
+// SSE4.1 is needed for 32-bit multiply
+
+CPU_INLINE CPU_TARGET("sse4.1") __m128i CpuHash__Mix_SSE41(__m128i Value)
+{
+	Value = _mm_xor_si128(Value, _mm_srli_epi32(Value, 16));
+	Value = _mm_mullo_epi32(Value, _mm_set1_epi32((int)CPU_HASH_MUL1));
+	Value = _mm_xor_si128(Value, _mm_srli_epi32(Value, 13));
+	Value = _mm_mullo_epi32(Value, _mm_set1_epi32((int)CPU_HASH_MUL2));
+	Value = _mm_xor_si128(Value, _mm_srli_epi32(Value, 16));
+	return Value;
+}
+
+static CPU_TARGET("sse4.1") void CpuHash__Block_SSE41(const uint8_t* Input, size_t InputPitch, uint32_t X, uint32_t Y, uint32_t Width, uint32_t Height, uint32_t* Output)
+{
+	const __m128i Color = _mm_set1_epi32((int)CPU_HASH_COLOR);
+	const __m128i SaltStep = _mm_set1_epi32((int)CpuHash__Salt(4, 0));
+	const __m128i SaltColumn = _mm_setr_epi32((int)CpuHash__Salt(X + 0, 0), (int)CpuHash__Salt(X + 1, 0), (int)CpuHash__Salt(X + 2, 0), (int)CpuHash__Salt(X + 3, 0));
+
+	uint32_t Count = Width & ~3;
+
+	__m128i Sum = _mm_setzero_si128();
+	__m128i Xor = _mm_setzero_si128();
+	uint32_t TailSum = 0;
+	uint32_t TailXor = 0;
+
+	for (uint32_t Row = 0; Row < Height; Row++)
+	{
+		const uint8_t* Pixels = Input + Row * InputPitch;
+
+		// salt of row is added to salt of column, because X never overflows into Y bits
+		__m128i Salt = _mm_add_epi32(SaltColumn, _mm_set1_epi32((int)CpuHash__Salt(0, Y + Row)));
+		for (uint32_t Index = 0; Index < Count; Index += 4)
+		{
+			__m128i Pixel = _mm_loadu_si128((const __m128i*)(Pixels + Index * 4));
+			__m128i Value = CpuHash__Mix_SSE41(_mm_xor_si128(_mm_and_si128(Pixel, Color), Salt));
+			Sum = _mm_add_epi32(Sum, Value);
+			Xor = _mm_xor_si128(Xor, Value);
+			Salt = _mm_add_epi32(Salt, SaltStep);
+		}
+		CpuHash__Pixels_Scalar(Pixels + Count * 4, X + Count, Y + Row, Width - Count, &TailSum, &TailXor);
+	}
+
+	Sum = _mm_add_epi32(Sum, _mm_shuffle_epi32(Sum, _MM_SHUFFLE(1, 0, 3, 2)));
+	Sum = _mm_add_epi32(Sum, _mm_shuffle_epi32(Sum, _MM_SHUFFLE(2, 3, 0, 1)));
+	Xor = _mm_xor_si128(Xor, _mm_shuffle_epi32(Xor, _MM_SHUFFLE(1, 0, 3, 2)));
+	Xor = _mm_xor_si128(Xor, _mm_shuffle_epi32(Xor, _MM_SHUFFLE(2, 3, 0, 1)));
+
+	Output[0] += (uint32_t)_mm_cvtsi128_si32(Sum) + TailSum;
+	Output[1] ^= (uint32_t)_mm_cvtsi128_si32(Xor) ^ TailXor;
+}
+
+CPU_INLINE CPU_TARGET("avx2") __m256i CpuHash__Mix_AVX2(__m256i Value)
+{
+	Value = _mm256_xor_si256(Value, _mm256_srli_epi32(Value, 16));
+	Value = _mm256_mullo_epi32(Value, _mm256_set1_epi32((int)CPU_HASH_MUL1));
+	Value = _mm256_xor_si256(Value, _mm256_srli_epi32(Value, 13));
+	Value = _mm256_mullo_epi32(Value, _mm256_set1_epi32((int)CPU_HASH_MUL2));
+	Value = _mm256_xor_si256(Value, _mm256_srli_epi32(Value, 16));
+	return Value;
+}
+
+static CPU_TARGET("avx2") void CpuHash__Block_AVX2(const uint8_t* Input, size_t InputPitch, uint32_t X, uint32_t Y, uint32_t Width, uint32_t Height, uint32_t* Output)
+{
+	const __m256i Color = _mm256_set1_epi32((int)CPU_HASH_COLOR);
+	const __m256i SaltStep = _mm256_set1_epi32((int)CpuHash__Salt(8, 0));
+	const __m256i SaltColumn = _mm256_mullo_epi32(_mm256_add_epi32(_mm256_set1_epi32((int)X), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)), _mm256_set1_epi32((int)CPU_HASH_SALT));
+
+	uint32_t Count = Width & ~7;
+
+	__m256i Sum = _mm256_setzero_si256();
+	__m256i Xor = _mm256_setzero_si256();
+	uint32_t TailSum = 0;
+	uint32_t TailXor = 0;
+
+	for (uint32_t Row = 0; Row < Height; Row++)
+	{
+		const uint8_t* Pixels = Input + Row * InputPitch;
+
+		__m256i Salt = _mm256_add_epi32(SaltColumn, _mm256_set1_epi32((int)CpuHash__Salt(0, Y + Row)));
+		for (uint32_t Index = 0; Index < Count; Index += 8)
+		{
+			__m256i Pixel = _mm256_loadu_si256((const __m256i*)(Pixels + Index * 4));
+			__m256i Value = CpuHash__Mix_AVX2(_mm256_xor_si256(_mm256_and_si256(Pixel, Color), Salt));
+			Sum = _mm256_add_epi32(Sum, Value);
+			Xor = _mm256_xor_si256(Xor, Value);
+			Salt = _mm256_add_epi32(Salt, SaltStep);
+		}
+		CpuHash__Pixels_Scalar(Pixels + Count * 4, X + Count, Y + Row, Width - Count, &TailSum, &TailXor);
+	}
+
+	__m128i Sum4 = _mm_add_epi32(_mm256_castsi256_si128(Sum), _mm256_extracti128_si256(Sum, 1));
+	__m128i Xor4 = _mm_xor_si128(_mm256_castsi256_si128(Xor), _mm256_extracti128_si256(Xor, 1));
+	Sum4 = _mm_add_epi32(Sum4, _mm_shuffle_epi32(Sum4, _MM_SHUFFLE(1, 0, 3, 2)));
+	Sum4 = _mm_add_epi32(Sum4, _mm_shuffle_epi32(Sum4, _MM_SHUFFLE(2, 3, 0, 1)));
+	Xor4 = _mm_xor_si128(Xor4, _mm_shuffle_epi32(Xor4, _MM_SHUFFLE(1, 0, 3, 2)));
+	Xor4 = _mm_xor_si128(Xor4, _mm_shuffle_epi32(Xor4, _MM_SHUFFLE(2, 3, 0, 1)));
+
+	Output[0] += (uint32_t)_mm_cvtsi128_si32(Sum4) + TailSum;
+	Output[1] ^= (uint32_t)_mm_cvtsi128_si32(Xor4) ^ TailXor;
+}
+
+#endif
+
+#if defined(CPU_ARM64)
+
+CPU_INLINE uint32x4_t CpuHash__Mix_NEON(uint32x4_t Value)
+{
+	Value = veorq_u32(Value, vshrq_n_u32(Value, 16));
+	Value = vmulq_n_u32(Value, CPU_HASH_MUL1);
+	Value = veorq_u32(Value, vshrq_n_u32(Value, 13));
+	Value = vmulq_n_u32(Value, CPU_HASH_MUL2);
+	Value = veorq_u32(Value, vshrq_n_u32(Value, 16));
+	return Value;
+}
+
+static void CpuHash__Block_NEON(const uint8_t* Input, size_t InputPitch, uint32_t X, uint32_t Y, uint32_t Width, uint32_t Height, uint32_t* Output)
+{
+	const uint32x4_t Color = vdupq_n_u32(CPU_HASH_COLOR);
+	const uint32x4_t SaltStep = vdupq_n_u32(CpuHash__Salt(4, 0));
+	const uint32_t Columns[] = { CpuHash__Salt(X + 0, 0), CpuHash__Salt(X + 1, 0), CpuHash__Salt(X + 2, 0), CpuHash__Salt(X + 3, 0) };
+	const uint32x4_t SaltColumn = vld1q_u32(Columns);
+
+	uint32_t Count = Width & ~3;
+
+	// two accumulators to hide multiply latency
+	uint32x4_t Sum[2] = { vdupq_n_u32(0), vdupq_n_u32(0) };
+	uint32x4_t Xor[2] = { vdupq_n_u32(0), vdupq_n_u32(0) };
+	uint32_t TailSum = 0;
+	uint32_t TailXor = 0;
+
+	for (uint32_t Row = 0; Row < Height; Row++)
+	{
+		const uint8_t* Pixels = Input + Row * InputPitch;
+
+		uint32x4_t Salt = vaddq_u32(SaltColumn, vdupq_n_u32(CpuHash__Salt(0, Y + Row)));
+		for (uint32_t Index = 0; Index < Count; Index += 4)
+		{
+			uint32x4_t Pixel = vld1q_u32((const uint32_t*)(Pixels + Index * 4));
+			uint32x4_t Value = CpuHash__Mix_NEON(veorq_u32(vandq_u32(Pixel, Color), Salt));
+			uint32_t Lane = (Index / 4) & 1;
+			Sum[Lane] = vaddq_u32(Sum[Lane], Value);
+			Xor[Lane] = veorq_u32(Xor[Lane], Value);
+			Salt = vaddq_u32(Salt, SaltStep);
+		}
+		CpuHash__Pixels_Scalar(Pixels + Count * 4, X + Count, Y + Row, Width - Count, &TailSum, &TailXor);
+	}
+
+	uint32x4_t Xor4 = veorq_u32(Xor[0], Xor[1]);
+	uint32x2_t Xor2 = veor_u32(vget_low_u32(Xor4), vget_high_u32(Xor4));
+
+	Output[0] += vaddvq_u32(vaddq_u32(Sum[0], Sum[1])) + TailSum;
+	Output[1] ^= vget_lane_u32(Xor2, 0) ^ vget_lane_u32(Xor2, 1) ^ TailXor;
+}
+
+#endif
+
+void CpuHash_Create(CpuHash* Hash, uint32_t Width, uint32_t Height, CpuKernel Kernel)
+{
+	// salt packs X & Y in 16 bits each, D3D11 textures are not larger than that anyway
+	Assert(Width <= 65536 && Height <= 65536);
+
+	*Hash = (CpuHash)
+	{
+		.Kernel = Cpu_SelectKernel(Kernel),
+		.Width = Width,
+		.Height = Height,
+		.BlockCountX = (Width + CPU_HASH_BLOCK_SIZE - 1) / CPU_HASH_BLOCK_SIZE,
+		.BlockCountY = (Height + CPU_HASH_BLOCK_SIZE - 1) / CPU_HASH_BLOCK_SIZE,
+	};
+
+	switch (Hash->Kernel)
+	{
+#if defined(CPU_X64)
+	case CpuKernel_SSE41:
+		Hash->Block = &CpuHash__Block_SSE41;
+		break;
+	case CpuKernel_AVX2:
+		Hash->Block = &CpuHash__Block_AVX2;
+		break;
+#endif
+#if defined(CPU_ARM64)
+	case CpuKernel_NEON:
+		Hash->Block = &CpuHash__Block_NEON;
+		break;
+#endif
+	default:
+		Hash->Block = &CpuHash__Block_Scalar;
+		break;
+	}
+}
+
+void CpuHash_Run(const CpuHash* Hash, const uint8_t* Input, size_t InputPitch, uint32_t* Output)
+{
+	CpuHash_RunRows(Hash, Input, InputPitch, Output, 0, Hash->BlockCountY);
+}
+
+void CpuHash_RunRows(const CpuHash* Hash, const uint8_t* Input, size_t InputPitch, uint32_t* Output, uint32_t First, uint32_t Last)
+{
+	Assert(First <= Last && Last <= Hash->BlockCountY);
+
+	for (uint32_t BlockY = First; BlockY < Last; BlockY++)
+	{
+		uint32_t Y = BlockY * CPU_HASH_BLOCK_SIZE;
+		uint32_t Height = Hash->Height - Y < CPU_HASH_BLOCK_SIZE ? Hash->Height - Y : CPU_HASH_BLOCK_SIZE;
+
+		for (uint32_t BlockX = 0; BlockX < Hash->BlockCountX; BlockX++)
+		{
+			uint32_t X = BlockX * CPU_HASH_BLOCK_SIZE;
+			uint32_t Width = Hash->Width - X < CPU_HASH_BLOCK_SIZE ? Hash->Width - X : CPU_HASH_BLOCK_SIZE;
+
+			uint32_t* Block = Output + 2 * (BlockY * Hash->BlockCountX + BlockX);
+			Block[0] = 0;
+			Block[1] = 0;
+			Hash->Block(Input + Y * InputPitch + X * 4, InputPitch, X, Y, Width, Height, Block);
+		}
+	}
+}
+
+static bool CpuHash__Changed(const uint32_t* Previous, const uint32_t* Current, size_t Index)
+{
+	return Previous[2 * Index + 0] != Current[2 * Index + 0] || Previous[2 * Index + 1] != Current[2 * Index + 1];
+}
+
+uint32_t CpuHash_DirtyBlocks(const uint32_t* Previous, const uint32_t* Current, uint32_t BlockCountX, uint32_t BlockCountY, uint32_t* Blocks)
+{
+	uint32_t Count = 0;
+	for (uint32_t Y = 0; Y < BlockCountY; Y++)
+	{
+		uint32_t Top = Y > 0 ? Y - 1 : 0;
+		uint32_t Bottom = Y + 1 < BlockCountY ? Y + 1 : Y;
+
+		for (uint32_t X = 0; X < BlockCountX; X++)
+		{
+			uint32_t Left = X > 0 ? X - 1 : 0;
+			uint32_t Right = X + 1 < BlockCountX ? X + 1 : X;
+
+			bool Dirty = Previous == NULL;
+			for (uint32_t Row = Top; Row <= Bottom && !Dirty; Row++)
+			{
+				for (uint32_t Column = Left; Column <= Right && !Dirty; Column++)
+				{
+					Dirty = CpuHash__Changed(Previous, Current, (size_t)Row * BlockCountX + Column);
+				}
+			}
+
+			if (Dirty)
+			{
+				Blocks[Count++] = (Y << 16) | X;
+			}
+		}
+	}
+	return Count;
+}
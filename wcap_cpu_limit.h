@@ -0,0 +1,76 @@
+#pragma once
+
+#include "wcap_cpu.h"
+
+//
+// interface
+//
+
+typedef struct
+{
+	uint32_t Framerate; // 0 when frames are not limited
+	uint64_t TickFreq;
+	uint64_t NextTime;  // earliest time of next accepted frame, multiplied by Framerate
+	uint64_t LastTime;
+}
+CpuLimit;
+
+// limits captured frames to MaxFramerate, only if it is not 0 and is lower than compositor rate RateNum/RateDen
+// returns true if frames are limited, then output framerate is MaxFramerate, otherwise compositor rate
+static bool CpuLimit_Create(CpuLimit* Limit, uint32_t MaxFramerate, uint32_t RateNum, uint32_t RateDen, uint64_t TickFreq);
+
+// returns true if frame captured at Time should be encoded, must be called for every captured frame in order they arrive
+static bool CpuLimit_Accept(CpuLimit* Limit, uint64_t Time);
+
+//
+// implementation
+//
+
+// grid of accepted frame times restarts only when it is behind by more than this many periods
+#define CPU_LIMIT_RESTART_PERIODS 4
+
+bool CpuLimit_Create(CpuLimit* Limit, uint32_t MaxFramerate, uint32_t RateNum, uint32_t RateDen, uint64_t TickFreq)
+{
+	bool Limited = MaxFramerate != 0 && (uint64_t)MaxFramerate * RateDen < RateNum;
+
+	*Limit = (CpuLimit)
+	{
+		.Framerate = Limited ? MaxFramerate : 0,
+		.TickFreq = TickFreq,
+	};
+	return Limited;
+}
+
+bool CpuLimit_Accept(CpuLimit* Limit, uint64_t Time)
+{
+	bool Accept = true;
+
+	uint64_t Framerate = Limit->Framerate;
+	if (Framerate != 0)
+	{
+		if (Time * Framerate < Limit->NextTime)
+		{
+			Accept = false;
+		}
+		else
+		{
+			// delays keep frames on same time grid, so jitter & variable refresh do not lower average framerate
+			// but after longer gap without frames (static screen) grid restarts from this frame, otherwise
+			// all following frames would be accepted until grid catches up with time
+			if (Limit->NextTime == 0 || Time * Framerate - Limit->NextTime >= CPU_LIMIT_RESTART_PERIODS * Limit->TickFreq)
+			{
+				Limit->NextTime = Time * Framerate;
+			}
+			Limit->NextTime += Limit->TickFreq;
+		}
+	}
+
+	// ignore frames if it comes from the past
+	if (Time <= Limit->LastTime)
+	{
+		Accept = false;
+	}
+	Limit->LastTime = Time;
+
+	return Accept;
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "wcap_cpu.h"
+
+//
+// interface
+//
+
+// called for every task Index in [0, Count), Worker is index of thread running it in [0, ThreadCount)
+typedef void CpuPool_TaskFunc(void* Context, uint32_t Index, uint32_t Worker);
+
+typedef struct CpuPool CpuPool;
+
+typedef struct
+{
+	// task indices [Begin, End) packed as End << 32 | Begin, owner takes from Begin & thieves take from End
+	_Alignas(CPU_CACHE_LINE) _Atomic(uint64_t) Range;
+	CpuPool* Pool;
+	CpuThread Thread;
+	uint32_t Index;
+}
+CpuPool__Worker;
+
+typedef struct CpuPool
+{
+	CpuPool__Worker* Workers; // worker 0 is thread calling CpuPool_Run, others are background threads
+	uint32_t ThreadCount;
+	CpuPool_TaskFunc* Func;
+	void* Context;
+	_Atomic(uint32_t) Generation; // incremented for every CpuPool_Run, background threads wait on it
+	_Atomic(uint32_t) Finished;   // background threads done with current run
+	_Atomic(uint32_t) Quit;
+}
+CpuPool;
+
+// ThreadCount includes calling thread, 0 means all logical processors
+static void CpuPool_Create(CpuPool* Pool, uint32_t ThreadCount);
+static void CpuPool_Release(CpuPool* Pool);
+
+// splits tasks evenly between workers, workers that finish early steal tasks from others
+// returns when all tasks are done, must not be called from multiple threads at same time
+static void CpuPool_Run(CpuPool* Pool, CpuPool_TaskFunc* Func, void* Context, uint32_t Count);
+
+//
+// implementation
+//
+
+static uint64_t CpuPool__Range(uint32_t Begin, uint32_t End)
+{
+	return ((uint64_t)End << 32) | Begin;
+}
+
+static bool CpuPool__Pop(CpuPool__Worker* Worker, uint32_t* Index)
+{
+	uint64_t Range = atomic_load(&Worker->Range);
+	for (;;)
+	{
+		uint32_t Begin = (uint32_t)Range;
+		uint32_t End = (uint32_t)(Range >> 32);
+		if (Begin >= End)
+		{
+			return false;
+		}
+		if (atomic_compare_exchange_weak(&Worker->Range, &Range, CpuPool__Range(Begin + 1, End)))
+		{
+			*Index = Begin;
+			return true;
+		}
+	}
+}
+
+static bool CpuPool__Steal(CpuPool* Pool, uint32_t Self, uint32_t* Index)
+{
+	// tasks are expected to be coarse, so thief takes one task at a time from worker with most tasks left
+	// ranges only shrink during run, so compare exchange cannot succeed with stale value
+	for (;;)
+	{
+		CpuPool__Worker* Victim = NULL;
+		uint64_t VictimRange = 0;
+		uint32_t VictimCount = 0;
+
+		for (uint32_t Offset = 1; Offset < Pool->ThreadCount; Offset++)
+		{
+			CpuPool__Worker* Worker = &Pool->Workers[(Self + Offset) % Pool->ThreadCount];
+			uint64_t Range = atomic_load(&Worker->Range);
+			uint32_t Begin = (uint32_t)Range;
+			uint32_t End = (uint32_t)(Range >> 32);
+			if (Begin < End && End - Begin > VictimCount)
+			{
+				Victim = Worker;
+				VictimRange = Range;
+				VictimCount = End - Begin;
+			}
+		}
+
+		if (Victim == NULL)
+		{
+			return false;
+		}
+
+		uint32_t Begin = (uint32_t)VictimRange;
+		uint32_t End = (uint32_t)(VictimRange >> 32);
+		if (atomic_compare_exchange_strong(&Victim->Range, &VictimRange, CpuPool__Range(Begin, End - 1)))
+		{
+			*Index = End - 1;
+			return true;
+		}
+	}
+}
+
+static void CpuPool__Work(CpuPool* Pool, uint32_t Self)
+{
+	uint32_t Index;
+	while (CpuPool__Pop(&Pool->Workers[Self], &Index) || CpuPool__Steal(Pool, Self, &Index))
+	{
+		Pool->Func(Pool->Context, Index, Self);
+	}
+}
+
+static void CpuPool__Thread(void* Arg)
+{
+	CpuPool__Worker* Worker = Arg;
+	CpuPool* Pool = Worker->Pool;
+
+	uint32_t Generation = 0;
+	for (;;)
+	{
+		uint32_t Current;
+		while ((Current = atomic_load(&Pool->Generation)) == Generation)
+		{
+			Cpu_Wait(&Pool->Generation, Generation);
+		}
+		Generation = Current;
+
+		if (atomic_load(&Pool->Quit))
+		{
+			break;
+		}
+
+		CpuPool__Work(Pool, Worker->Index);
+
+		if (atomic_fetch_add(&Pool->Finished, 1) + 1 == Pool->ThreadCount - 1)
+		{
+			Cpu_WakeAll(&Pool->Finished);
+		}
+	}
+}
+
+void CpuPool_Create(CpuPool* Pool, uint32_t ThreadCount)
+{
+	ThreadCount = ThreadCount ? ThreadCount : Cpu_GetProcessorCount();
+
+	Pool->Workers = Cpu_Alloc(ThreadCount * sizeof(*Pool->Workers));
+	Pool->ThreadCount = ThreadCount;
+	atomic_init(&Pool->Generation, 0);
+	atomic_init(&Pool->Finished, 0);
+	atomic_init(&Pool->Quit, 0);
+
+	for (uint32_t Index = 0; Index < ThreadCount; Index++)
+	{
+		CpuPool__Worker* Worker = &Pool->Workers[Index];
+		atomic_init(&Worker->Range, 0);
+		Worker->Pool = Pool;
+		Worker->Index = Index;
+		if (Index != 0)
+		{
+			CpuThread_Create(&Worker->Thread, &CpuPool__Thread, Worker);
+		}
+	}
+}
+
+void CpuPool_Release(CpuPool* Pool)
+{
+	atomic_store(&Pool->Quit, 1);
+	atomic_fetch_add(&Pool->Generation, 1);
+	Cpu_WakeAll(&Pool->Generation);
+
+	for (uint32_t Index = 1; Index < Pool->ThreadCount; Index++)
+	{
+		CpuThread_Join(&Pool->Workers[Index].Thread);
+	}
+	Cpu_Free(Pool->Workers);
+}
+
+void CpuPool_Run(CpuPool* Pool, CpuPool_TaskFunc* Func, void* Context, uint32_t Count)
+{
+	uint32_t ThreadCount = Pool->ThreadCount;
+
+	Pool->Func = Func;
+	Pool->Context = Context;
+
+	// contiguous task ranges, so neighbor tasks usually run on same thread
+	for (uint32_t Index = 0; Index < ThreadCount; Index++)
+	{
+		uint32_t Begin = (uint32_t)((uint64_t)Count * Index / ThreadCount);
+		uint32_t End = (uint32_t)((uint64_t)Count * (Index + 1) / ThreadCount);
+		atomic_store(&Pool->Workers[Index].Range, CpuPool__Range(Begin, End));
+	}
+
+	if (ThreadCount > 1)
+	{
+		atomic_store(&Pool->Finished, 0);
+		atomic_fetch_add(&Pool->Generation, 1);
+		Cpu_WakeAll(&Pool->Generation);
+	}
+
+	CpuPool__Work(Pool, 0);
+
+	uint32_t Finished;
+	while ((Finished = atomic_load(&Pool->Finished)) != ThreadCount - 1)
+	{
+		Cpu_Wait(&Pool->Finished, Finished);
+	}
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "wcap_cpu.h"
+
+//
+// interface
+//
+
+// called on queue thread for every item, in same order as they were pushed
+typedef void CpuQueue_ItemFunc(void* Context, void* Item);
+
+// called on queue thread between items with all flags signaled after previous call
+typedef void CpuQueue_FlagsFunc(void* Context, uint32_t Flags);
+
+typedef struct
+{
+	// free running item counters, Write - Read is number of items in queue
+	_Alignas(CPU_CACHE_LINE) _Atomic(uint32_t) Write; // modified only by producer
+	_Alignas(CPU_CACHE_LINE) _Atomic(uint32_t) Read;  // modified only by queue thread, after item is processed
+	_Alignas(CPU_CACHE_LINE) _Atomic(uint32_t) Sleeping; // queue thread is about to wait or is waiting on Signal
+	_Atomic(uint32_t) Signal;
+	_Atomic(uint32_t) Quit;
+	_Atomic(uint32_t) Flags;
+	_Alignas(CPU_CACHE_LINE) uint8_t* Items;
+	uint32_t ItemSize;
+	uint32_t Count;
+	CpuQueue_ItemFunc* Func;
+	CpuQueue_FlagsFunc* FlagsFunc;
+	void* Context;
+	CpuThread Thread;
+}
+CpuQueue;
+
+// bounded single producer, single consumer queue of Count items, each ItemSize bytes
+// items are processed by Func on background thread, Count must be power of 2
+// FlagsFunc can be NULL when CpuQueue_Signal is not used
+static void CpuQueue_Create(CpuQueue* Queue, uint32_t Count, uint32_t ItemSize, CpuQueue_ItemFunc* Func, CpuQueue_FlagsFunc* FlagsFunc, void* Context);
+// processes all items still in queue, then stops background thread
+static void CpuQueue_Release(CpuQueue* Queue);
+
+// copies Item into queue and returns immediately, returns false if queue is full
+// must not be called from multiple threads at same time
+static bool CpuQueue_Push(CpuQueue* Queue, const void* Item);
+
+// sets Flags for FlagsFunc & returns immediately, never fails & does not use space of items
+// flags signaled again before queue thread gets to them are passed only once, can be called from any thread
+static void CpuQueue_Signal(CpuQueue* Queue, uint32_t Flags);
+
+//
+// implementation
+//
+
+static void CpuQueue__Wake(CpuQueue* Queue)
+{
+	atomic_fetch_add(&Queue->Signal, 1);
+	Cpu_WakeAll(&Queue->Signal);
+}
+
+static void CpuQueue__Thread(void* Arg)
+{
+	CpuQueue* Queue = Arg;
+
+	uint32_t Read = atomic_load_explicit(&Queue->Read, memory_order_relaxed);
+	for (;;)
+	{
+		// flags are checked before every item, so they are not delayed by full queue
+		uint32_t Flags = atomic_exchange(&Queue->Flags, 0);
+		if (Flags)
+		{
+			Queue->FlagsFunc(Queue->Context, Flags);
+		}
+
+		uint32_t Write = atomic_load_explicit(&Queue->Write, memory_order_acquire);
+		if (Read != Write)
+		{
+			Queue->Func(Queue->Context, Queue->Items + (size_t)(Read & (Queue->Count - 1)) * Queue->ItemSize);
+			atomic_store_explicit(&Queue->Read, ++Read, memory_order_release);
+			continue;
+		}
+
+		if (atomic_load(&Queue->Quit) && !atomic_load(&Queue->Flags))
+		{
+			break;
+		}
+
+		// after Sleeping is visible, producer either sees it & increments Signal, or this check sees new item
+		uint32_t Signal = atomic_load(&Queue->Signal);
+		atomic_store(&Queue->Sleeping, 1);
+		atomic_thread_fence(memory_order_seq_cst);
+		if (atomic_load_explicit(&Queue->Write, memory_order_relaxed) == Write && !atomic_load(&Queue->Flags) && !atomic_load(&Queue->Quit))
+		{
+			Cpu_Wait(&Queue->Signal, Signal);
+		}
+		atomic_store(&Queue->Sleeping, 0);
+	}
+}
+
+void CpuQueue_Create(CpuQueue* Queue, uint32_t Count, uint32_t ItemSize, CpuQueue_ItemFunc* Func, CpuQueue_FlagsFunc* FlagsFunc, void* Context)
+{
+	Assert(Count != 0 && (Count & (Count - 1)) == 0);
+
+	atomic_init(&Queue->Write, 0);
+	atomic_init(&Queue->Read, 0);
+	atomic_init(&Queue->Sleeping, 0);
+	atomic_init(&Queue->Signal, 0);
+	atomic_init(&Queue->Quit, 0);
+	atomic_init(&Queue->Flags, 0);
+	Queue->Items = Cpu_Alloc((size_t)Count * ItemSize);
+	Queue->ItemSize = ItemSize;
+	Queue->Count = Count;
+	Queue->Func = Func;
+	Queue->FlagsFunc = FlagsFunc;
+	Queue->Context = Context;
+
+	CpuThread_Create(&Queue->Thread, &CpuQueue__Thread, Queue);
+}
+
+void CpuQueue_Release(CpuQueue* Queue)
+{
+	atomic_store(&Queue->Quit, 1);
+	atomic_thread_fence(memory_order_seq_cst);
+	CpuQueue__Wake(Queue);
+
+	CpuThread_Join(&Queue->Thread);
+	Cpu_Free(Queue->Items);
+}
+
+bool CpuQueue_Push(CpuQueue* Queue, const void* Item)
+{
+	uint32_t Write = atomic_load_explicit(&Queue->Write, memory_order_relaxed);
+	if (Write - atomic_load_explicit(&Queue->Read, memory_order_acquire) == Queue->Count)
+	{
+		return false;
+	}
+
+	memcpy(Queue->Items + (size_t)(Write & (Queue->Count - 1)) * Queue->ItemSize, Item, Queue->ItemSize);
+	atomic_store_explicit(&Queue->Write, Write + 1, memory_order_release);
+
+	atomic_thread_fence(memory_order_seq_cst);
+	if (atomic_load_explicit(&Queue->Sleeping, memory_order_relaxed))
+	{
+		CpuQueue__Wake(Queue);
+	}
+	return true;
+}
+
+void CpuQueue_Signal(CpuQueue* Queue, uint32_t Flags)
+{
+	Assert(Queue->FlagsFunc);
+	atomic_fetch_or(&Queue->Flags, Flags);
+
+	// same as in CpuQueue_Push
+	atomic_thread_fence(memory_order_seq_cst);
+	if (atomic_load_explicit(&Queue->Sleeping, memory_order_relaxed))
+	{
+		CpuQueue__Wake(Queue);
+	}
+}
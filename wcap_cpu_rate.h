@@ -0,0 +1,55 @@
+#pragma once
+
+#include "wcap_cpu.h"
+
+//
+// interface
+//
+
+typedef struct
+{
+	uint64_t LastMotion; // time of last compared frame with larger changes
+	uint64_t NextEncode; // small changes are not encoded before this time
+}
+CpuRate;
+
+// adaptive framerate, while screen is static small changes are encoded at lower framerate & larger changes switch back to full framerate
+// all times are in same units as TickFreq, for example QPC ticks
+static void CpuRate_Create(CpuRate* Rate);
+
+// DirtyCount is count of dirty blocks out of BlockCount in last compared frame, returns true if screen is static
+// changes are compared few frames after they are captured, so full framerate resumes only when larger change is compared
+static bool CpuRate_IsStatic(CpuRate* Rate, uint32_t DirtyCount, uint32_t BlockCount, uint64_t Time, uint64_t TickFreq);
+
+// must be called for every encoded frame, small changes after it wait until NextEncode
+static void CpuRate_Encoded(CpuRate* Rate, uint64_t Time, uint64_t TickFreq);
+
+//
+// implementation
+//
+
+// frames with less than this % of dirty blocks are small changes
+#define CPU_RATE_MOTION_PERCENT   2
+// after this many msec without larger changes, small changes are encoded at STATIC_FRAMERATE
+#define CPU_RATE_MOTION_HOLD      500
+#define CPU_RATE_STATIC_FRAMERATE 5
+
+void CpuRate_Create(CpuRate* Rate)
+{
+	*Rate = (CpuRate) { 0 };
+}
+
+bool CpuRate_IsStatic(CpuRate* Rate, uint32_t DirtyCount, uint32_t BlockCount, uint64_t Time, uint64_t TickFreq)
+{
+	// any larger change switches back to full framerate as soon as it is compared, and keeps it for a while
+	if ((uint64_t)DirtyCount * 100 >= (uint64_t)BlockCount * CPU_RATE_MOTION_PERCENT)
+	{
+		Rate->LastMotion = Time;
+	}
+	return Time - Rate->LastMotion >= TickFreq * CPU_RATE_MOTION_HOLD / 1000;
+}
+
+void CpuRate_Encoded(CpuRate* Rate, uint64_t Time, uint64_t TickFreq)
+{
+	Rate->NextEncode = Time + TickFreq / CPU_RATE_STATIC_FRAMERATE;
+}
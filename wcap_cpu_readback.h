@@ -0,0 +1,153 @@
+#pragma once
+
+#include "wcap_cpu.h"
+
+//
+// interface
+//
+
+#define CPU_READBACK_MAX_COUNT 4
+
+typedef struct
+{
+	const uint8_t* PlaneY;
+	const uint8_t* PlaneUV; // interleaved U & V values, half of height
+	uint32_t PitchY;
+	uint32_t PitchUV;
+	uint32_t Width;
+	uint32_t Height;
+	uint32_t SampleSize; // 1 for NV12, 2 for P010 with 10-bit values in high bits
+	uint64_t Time;       // same as passed to CpuReadback_Submit
+	uint64_t Index;      // count of frames submitted before this one, gaps are dropped frames
+}
+CpuReadbackFrame;
+
+// receives frames in same order as they were submitted, plane data is valid only during call
+// called on thread that calls CpuReadback_Submit, Poll or Flush
+typedef void CpuReadback_SinkFunc(void* Context, const CpuReadbackFrame* Frame);
+
+// queues copy of current frame to staging buffer Slot, must not wait for it to finish
+typedef void CpuReadback_CopyFunc(void* Context, uint32_t Slot);
+// maps staging buffer Slot & sets plane fields of Frame, returns false if copy has not finished yet
+// without Wait it must return immediately, with Wait it waits for copy and always returns true
+typedef bool CpuReadback_MapFunc(void* Context, uint32_t Slot, bool Wait, CpuReadbackFrame* Frame);
+typedef void CpuReadback_UnmapFunc(void* Context, uint32_t Slot);
+
+typedef struct
+{
+	CpuReadback_CopyFunc* Copy;
+	CpuReadback_MapFunc* Map;
+	CpuReadback_UnmapFunc* Unmap;
+	void* Context;
+}
+CpuReadbackDevice;
+
+typedef struct
+{
+	CpuReadbackDevice Device;
+	CpuReadback_SinkFunc* Sink;
+	void* SinkContext;
+	uint32_t Count;     // staging buffers
+	uint32_t Lag;       // frame is mapped only after this many frames are copied after it, unless polling all
+	uint64_t Write;     // frames copied to staging buffers
+	uint64_t Read;      // frames passed to sink
+	uint64_t Submitted; // frames passed to CpuReadback_Submit
+	uint64_t Dropped;   // submitted frames not copied because every staging buffer was still waiting for map
+	uint64_t Time[CPU_READBACK_MAX_COUNT];
+	uint64_t Index[CPU_READBACK_MAX_COUNT];
+}
+CpuReadback;
+
+// ring of Count staging buffers, frame copied to one of them is mapped Count-1 frames later
+// so GPU has time to finish the copy, and mapping it never waits
+static void CpuReadback_Create(CpuReadback* Readback, uint32_t Count, const CpuReadbackDevice* Device, CpuReadback_SinkFunc* Sink, void* SinkContext);
+
+// passes finished older frames to sink & queues copy of new frame, never waits for GPU
+// returns false when frame is dropped because all staging buffers are in use
+static bool CpuReadback_Submit(CpuReadback* Readback, uint64_t Time);
+
+// passes finished frames to sink without waiting, with All even those that are not Lag frames old
+// for calling when no new frames are submitted for a while, so last frames are not delayed
+static void CpuReadback_Poll(CpuReadback* Readback, bool All);
+
+// waits for all copied frames & passes them to sink, sink is not called after this anymore
+static void CpuReadback_Flush(CpuReadback* Readback);
+
+//
+// implementation
+//
+
+void CpuReadback_Create(CpuReadback* Readback, uint32_t Count, const CpuReadbackDevice* Device, CpuReadback_SinkFunc* Sink, void* SinkContext)
+{
+	Assert(Count >= 2 && Count <= CPU_READBACK_MAX_COUNT);
+
+	*Readback = (CpuReadback)
+	{
+		.Device = *Device,
+		.Sink = Sink,
+		.SinkContext = SinkContext,
+		.Count = Count,
+		// one buffer is spare, for when GPU is late with copy
+		.Lag = Count - 1,
+	};
+}
+
+static bool CpuReadback__Deliver(CpuReadback* Readback, bool Wait)
+{
+	uint32_t Slot = (uint32_t)(Readback->Read % Readback->Count);
+
+	CpuReadbackFrame Frame;
+	if (!Readback->Device.Map(Readback->Device.Context, Slot, Wait, &Frame))
+	{
+		Assert(!Wait);
+		return false;
+	}
+
+	Frame.Time = Readback->Time[Slot];
+	Frame.Index = Readback->Index[Slot];
+	Readback->Sink(Readback->SinkContext, &Frame);
+
+	Readback->Device.Unmap(Readback->Device.Context, Slot);
+	Readback->Read++;
+	return true;
+}
+
+void CpuReadback_Poll(CpuReadback* Readback, bool All)
+{
+	// frames are delivered in order, so newer one waits while older is not finished
+	while (Readback->Read != Readback->Write && (All || Readback->Write - Readback->Read >= Readback->Lag))
+	{
+		if (!CpuReadback__Deliver(Readback, false))
+		{
+			break;
+		}
+	}
+}
+
+bool CpuReadback_Submit(CpuReadback* Readback, uint64_t Time)
+{
+	CpuReadback_Poll(Readback, false);
+
+	uint64_t Index = Readback->Submitted++;
+	if (Readback->Write - Readback->Read == Readback->Count)
+	{
+		// oldest buffer still waits for GPU, this frame is skipped instead of waiting
+		Readback->Dropped++;
+		return false;
+	}
+
+	uint32_t Slot = (uint32_t)(Readback->Write % Readback->Count);
+	Readback->Device.Copy(Readback->Device.Context, Slot);
+	Readback->Time[Slot] = Time;
+	Readback->Index[Slot] = Index;
+	Readback->Write++;
+	return true;
+}
+
+void CpuReadback_Flush(CpuReadback* Readback)
+{
+	while (Readback->Read != Readback->Write)
+	{
+		CpuReadback__Deliver(Readback, true);
+	}
+}
@@ -0,0 +1,1078 @@
+#pragma once
+
+#include "wcap_resize_filter.h"
+#include "wcap_cpu_pool.h"
+
+//
+// interface
+//
+
+typedef struct CpuResize CpuResize;
+
+// resizes Count rows (horizontal pass) or Count columns (vertical pass) for output indices [First, Last)
+// Src points to input index SrcFirst in the resize direction, Dst points to output index First
+typedef void CpuResize_PassFunc(const CpuResize* Resize, const ResizeTable* Table, const uint8_t* Src, size_t SrcPitch, uint32_t SrcFirst, uint8_t* Dst, size_t DstPitch, uint32_t First, uint32_t Last, uint32_t Count);
+
+typedef struct CpuResize
+{
+	ResizePlan Plan;
+	ResizeTable TableH;
+	ResizeTable TableV;
+	CpuResize_PassFunc* PassH;
+	CpuResize_PassFunc* PassV;
+	uint8_t* Reduced;     // ReducedWidth x ReducedHeight image after integer reduction, NULL if not needed
+	size_t ReducedPitch;
+	uint8_t* Middle;      // MiddleWidth x MiddleHeight image after first filter pass
+	size_t MiddlePitch;
+	float* Lut;           // gamma tables when LinearSpace is set, see CPU_RESIZE_DECODE_SIZE & CPU_RESIZE_ENCODE_SIZE
+	CpuPool* Pool;        // NULL if Run uses only calling thread
+	uint8_t* Scratch;     // first pass output for one tile, for each worker of Pool
+	size_t ScratchSize;   // bytes for each worker
+	size_t ScratchPitch;
+	uint32_t TileSize;    // output is split in TileSize x TileSize tiles for Pool
+	uint32_t TileCountX;
+	uint32_t TileCountY;
+	CpuKernel Kernel;
+	bool LinearSpace;
+	uint32_t InputWidth;
+	uint32_t InputHeight;
+	uint32_t OutputWidth;
+	uint32_t OutputHeight;
+}
+CpuResize;
+
+// CPU version of ResizeReduce & ResizePassH/ResizePassV shaders - same ResizePlan & filter weights
+// images are 8-bit BGRA, pitch is in bytes, alpha channel of output is set to 0 same as shaders do
+// except when input & output sizes are same, then Run just copies input
+// with Pool set, Run splits output in tiles & does both filter passes for each tile on one of Pool threads
+static void CpuResize_Create(CpuResize* Resize, uint32_t InputWidth, uint32_t InputHeight, uint32_t OutputWidth, uint32_t OutputHeight, ResizeFilter Filter, bool LinearSpace, CpuKernel Kernel, CpuPool* Pool);
+static void CpuResize_Release(CpuResize* Resize);
+
+// same as Create, but with given plan, for example from ResizePlan_CreateFixed
+static void CpuResize_CreatePlan(CpuResize* Resize, const ResizePlan* Plan, bool LinearSpace, CpuKernel Kernel, CpuPool* Pool);
+
+static void CpuResize_Run(CpuResize* Resize, const uint8_t* Input, size_t InputPitch, uint8_t* Output, size_t OutputPitch);
+
+// Run split in two steps, only when Middle is not NULL - integer reduction & first filter pass into Middle image,
+// then last filter pass for output rows [First, Last), Output points to row First
+static void CpuResize_RunMiddle(CpuResize* Resize, const uint8_t* Input, size_t InputPitch);
+static void CpuResize_RunRows(CpuResize* Resize, uint8_t* Output, size_t OutputPitch, uint32_t First, uint32_t Last);
+
+//
+// implementation
+//
+
+// Lut starts with CPU_RESIZE_DECODE_SIZE linear values for input bytes, followed by CPU_RESIZE_ENCODE_SIZE + 2
+// gamma values scaled to [0..255] for linear interpolation of output over [0..1] range, last entry is repeated
+// so interpolation at 1.0 does not need to clamp index - max error against exact curve is ~0.005 of 8-bit step
+#define CPU_RESIZE_DECODE_SIZE 256
+#define CPU_RESIZE_ENCODE_SIZE 4096
+
+static float CpuResize__GammaToLinear(float Color)
+{
+	return Color < 0.04045f ? Color / 12.92f : powf((Color + 0.055f) / 1.055f, 2.4f);
+}
+
+static float CpuResize__LinearToGamma(float Color)
+{
+	return Color < 0.0031308f ? Color * 12.92f : 1.055f * powf(Color, 1.f / 2.4f) - 0.055f;
+}
+
+// scalar reference
+
+static float CpuResize__Encode_Scalar(float Color, const float* Lut)
+{
+	const float* Encode = Lut + CPU_RESIZE_DECODE_SIZE;
+
+	Color = Color > 0.f ? Color : 0.f; // NaN goes to 0, same as saturate()
+	Color = Color < 1.f ? Color : 1.f;
+
+	float Pos = Color * CPU_RESIZE_ENCODE_SIZE;
+	uint32_t Index = (uint32_t)Pos;
+	return Encode[Index] + (Encode[Index + 1] - Encode[Index]) * (Pos - (float)Index);
+}
+
+static void CpuResize__Load_Scalar(const uint8_t* Pixel, const float* Lut, float* Color)
+{
+	if (Lut)
+	{
+		Color[0] = Lut[Pixel[0]];
+		Color[1] = Lut[Pixel[1]];
+		Color[2] = Lut[Pixel[2]];
+	}
+	else
+	{
+		// not normalizing to [0..1] range, weights are normalized already
+		Color[0] = Pixel[0];
+		Color[1] = Pixel[1];
+		Color[2] = Pixel[2];
+	}
+}
+
+static uint32_t CpuResize__Store_Scalar(const float* Color, const float* Lut)
+{
+	uint32_t Result = 0;
+	for (int Channel = 0; Channel < 3; Channel++)
+	{
+		float Value = Lut ? CpuResize__Encode_Scalar(Color[Channel], Lut) : Color[Channel];
+		Value = Value > 0.f ? Value : 0.f; // NaN goes to 0, same as saturate()
+		Value = Value < 255.f ? Value : 255.f;
+		Result |= (uint32_t)(Value + 0.5f) << (8 * Channel);
+	}
+	return Result;
+}
+
+static void CpuResize__PassH_Scalar(const CpuResize* Resize, const ResizeTable* Table, const uint8_t* Src, size_t SrcPitch, uint32_t SrcFirst, uint8_t* Dst, size_t DstPitch, uint32_t First, uint32_t Last, uint32_t Count)
+{
+	const float* Lut = Resize->Lut;
+	uint32_t TapCount = Table->TapCount;
+
+	for (uint32_t Y = 0; Y < Count; Y++)
+	{
+		const uint8_t* SrcRow = Src + Y * SrcPitch;
+		uint32_t* DstRow = (uint32_t*)(Dst + Y * DstPitch);
+
+		for (uint32_t X = First; X < Last; X++)
+		{
+			const float* Weights = Table->Weights + X * TapCount;
+			const uint8_t* Pixel = SrcRow + (Table->Start[X] - SrcFirst) * 4;
+
+			float Sum[3] = { 0, 0, 0 };
+			for (uint32_t Tap = 0; Tap < TapCount; Tap++)
+			{
+				float Color[3];
+				CpuResize__Load_Scalar(Pixel + Tap * 4, Lut, Color);
+				Sum[0] += Weights[Tap] * Color[0];
+				Sum[1] += Weights[Tap] * Color[1];
+				Sum[2] += Weights[Tap] * Color[2];
+			}
+			*DstRow++ = CpuResize__Store_Scalar(Sum, Lut);
+		}
+	}
+}
+
+static void CpuResize__PassV_Scalar(const CpuResize* Resize, const ResizeTable* Table, const uint8_t* Src, size_t SrcPitch, uint32_t SrcFirst, uint8_t* Dst, size_t DstPitch, uint32_t First, uint32_t Last, uint32_t Count)
+{
+	const float* Lut = Resize->Lut;
+	uint32_t TapCount = Table->TapCount;
+
+	for (uint32_t Y = First; Y < Last; Y++)
+	{
+		const float* Weights = Table->Weights + Y * TapCount;
+		const uint8_t* SrcRow = Src + (Table->Start[Y] - SrcFirst) * SrcPitch;
+		uint32_t* DstRow = (uint32_t*)(Dst + (Y - First) * DstPitch);
+
+		for (uint32_t X = 0; X < Count; X++)
+		{
+			const uint8_t* Pixel = SrcRow + X * 4;
+
+			float Sum[3] = { 0, 0, 0 };
+			for (uint32_t Tap = 0; Tap < TapCount; Tap++)
+			{
+				float Color[3];
+				CpuResize__Load_Scalar(Pixel + Tap * SrcPitch, Lut, Color);
+				Sum[0] += Weights[Tap] * Color[0];
+				Sum[1] += Weights[Tap] * Color[1];
+				Sum[2] += Weights[Tap] * Color[2];
+			}
+			DstRow[X] = CpuResize__Store_Scalar(Sum, Lut);
+		}
+	}
+}
+
+static void CpuResize__Reduce(const CpuResize* Resize, const uint8_t* Src, size_t SrcPitch, uint8_t* Dst, size_t DstPitch, uint32_t First, uint32_t Last)
+{
+	// box filter for reduced rows [First, Last), Src & Dst point to row 0
+	// memory bandwidth bound, so no SIMD versions of this
+	const float* Lut = Resize->Lut;
+	uint32_t ReduceX = Resize->Plan.ReduceX;
+	uint32_t ReduceY = Resize->Plan.ReduceY;
+	uint32_t Count = ReduceX * ReduceY;
+
+	for (uint32_t Y = First; Y < Last; Y++)
+	{
+		const uint8_t* SrcRow = Src + Y * ReduceY * SrcPitch;
+		uint32_t* DstRow = (uint32_t*)(Dst + Y * DstPitch);
+
+		for (uint32_t X = 0; X < Resize->Plan.ReducedWidth; X++, SrcRow += ReduceX * 4)
+		{
+			if (Lut)
+			{
+				float Sum[3] = { 0, 0, 0 };
+				for (uint32_t BoxY = 0; BoxY < ReduceY; BoxY++)
+				{
+					for (uint32_t BoxX = 0; BoxX < ReduceX; BoxX++)
+					{
+						float Color[3];
+						CpuResize__Load_Scalar(SrcRow + BoxY * SrcPitch + BoxX * 4, Lut, Color);
+						Sum[0] += Color[0];
+						Sum[1] += Color[1];
+						Sum[2] += Color[2];
+					}
+				}
+				Sum[0] /= Count;
+				Sum[1] /= Count;
+				Sum[2] /= Count;
+				DstRow[X] = CpuResize__Store_Scalar(Sum, Lut);
+			}
+			else
+			{
+				uint32_t Sum[3] = { 0, 0, 0 };
+				for (uint32_t BoxY = 0; BoxY < ReduceY; BoxY++)
+				{
+					const uint8_t* Pixel = SrcRow + BoxY * SrcPitch;
+					for (uint32_t BoxX = 0; BoxX < ReduceX; BoxX++, Pixel += 4)
+					{
+						Sum[0] += Pixel[0];
+						Sum[1] += Pixel[1];
+						Sum[2] += Pixel[2];
+					}
+				}
+				DstRow[X] = ((Sum[0] + Count / 2) / Count) << 0
+				          | ((Sum[1] + Count / 2) / Count) << 8
+				          | ((Sum[2] + Count / 2) / Count) << 16;
+			}
+		}
+	}
+}
+
+#if defined(CPU_X64)
+
+// SSE4.1 - one pixel per register for horizontal pass, four pixels per iteration for vertical pass
+
+CPU_INLINE CPU_TARGET("sse4.1") __m128 CpuResize__Load_SSE41(const uint8_t* Pixel, const float* Lut)
+{
+	if (Lut)
+	{
+		return _mm_setr_ps(Lut[Pixel[0]], Lut[Pixel[1]], Lut[Pixel[2]], 0.f);
+	}
+	else
+	{
+		int32_t Value;
+		memcpy(&Value, Pixel, sizeof(Value));
+		return _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(Value)));
+	}
+}
+
+CPU_INLINE CPU_TARGET("sse4.1") __m128i CpuResize__Quantize_SSE41(__m128 Color)
+{
+	// max first, so NaN goes to 0
+	Color = _mm_min_ps(_mm_max_ps(Color, _mm_setzero_ps()), _mm_set1_ps(255.f));
+	return _mm_cvttps_epi32(_mm_add_ps(Color, _mm_set1_ps(0.5f)));
+}
+
+CPU_INLINE CPU_TARGET("sse4.1") uint32_t CpuResize__Store_SSE41(__m128 Color, const float* Lut)
+{
+	if (Lut)
+	{
+		float Values[4];
+		_mm_storeu_ps(Values, Color);
+		return CpuResize__Store_Scalar(Values, Lut);
+	}
+	else
+	{
+		__m128i Value = CpuResize__Quantize_SSE41(Color);
+		Value = _mm_packus_epi32(Value, Value);
+		Value = _mm_packus_epi16(Value, Value);
+		return (uint32_t)_mm_cvtsi128_si32(Value) & 0xffffff;
+	}
+}
+
+CPU_INLINE CPU_TARGET("sse4.1") void CpuResize__PassH_SSE41_Impl(const ResizeTable* Table, const uint8_t* Src, size_t SrcPitch, uint32_t SrcFirst, uint8_t* Dst, size_t DstPitch, uint32_t First, uint32_t Last, uint32_t Count, const float* Lut)
+{
+	uint32_t TapCount = Table->TapCount;
+
+	for (uint32_t Y = 0; Y < Count; Y++)
+	{
+		const uint8_t* SrcRow = Src + Y * SrcPitch;
+		uint32_t* DstRow = (uint32_t*)(Dst + Y * DstPitch);
+
+		for (uint32_t X = First; X < Last; X++)
+		{
+			const float* Weights = Table->Weights + X * TapCount;
+			const uint8_t* Pixel = SrcRow + (Table->Start[X] - SrcFirst) * 4;
+
+			__m128 Sum = _mm_setzero_ps();
+			for (uint32_t Tap = 0; Tap < TapCount; Tap++)
+			{
+				__m128 Color = CpuResize__Load_SSE41(Pixel + Tap * 4, Lut);
+				Sum = _mm_add_ps(Sum, _mm_mul_ps(_mm_set1_ps(Weights[Tap]), Color));
+			}
+			*DstRow++ = CpuResize__Store_SSE41(Sum, Lut);
+		}
+	}
+}
+
+CPU_INLINE CPU_TARGET("sse4.1") void CpuResize__PassV_SSE41_Impl(const ResizeTable* Table, const uint8_t* Src, size_t SrcPitch, uint32_t SrcFirst, uint8_t* Dst, size_t DstPitch, uint32_t First, uint32_t Last, uint32_t Count, const float* Lut)
+{
+	uint32_t TapCount = Table->TapCount;
+
+	for (uint32_t Y = First; Y < Last; Y++)
+	{
+		const float* Weights = Table->Weights + Y * TapCount;
+		const uint8_t* SrcRow = Src + (Table->Start[Y] - SrcFirst) * SrcPitch;
+		uint8_t* DstRow = Dst + (Y - First) * DstPitch;
+
+		uint32_t X = 0;
+		for (; X + 4 <= Count; X += 4)
+		{
+			const uint8_t* Pixel = SrcRow + X * 4;
+
+			__m128 Sum0 = _mm_setzero_ps();
+			__m128 Sum1 = _mm_setzero_ps();
+			__m128 Sum2 = _mm_setzero_ps();
+			__m128 Sum3 = _mm_setzero_ps();
+			for (uint32_t Tap = 0; Tap < TapCount; Tap++, Pixel += SrcPitch)
+			{
+				__m128 Weight = _mm_set1_ps(Weights[Tap]);
+				__m128 Color0, Color1, Color2, Color3;
+				if (Lut)
+				{
+					Color0 = CpuResize__Load_SSE41(Pixel +  0, Lut);
+					Color1 = CpuResize__Load_SSE41(Pixel +  4, Lut);
+					Color2 = CpuResize__Load_SSE41(Pixel +  8, Lut);
+					Color3 = CpuResize__Load_SSE41(Pixel + 12, Lut);
+				}
+				else
+				{
+					__m128i Value = _mm_loadu_si128((const __m128i*)Pixel);
+					Color0 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(Value));
+					Color1 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(Value, 4)));
+					Color2 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(Value, 8)));
+					Color3 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(Value, 12)));
+				}
+				Sum0 = _mm_add_ps(Sum0, _mm_mul_ps(Weight, Color0));
+				Sum1 = _mm_add_ps(Sum1, _mm_mul_ps(Weight, Color1));
+				Sum2 = _mm_add_ps(Sum2, _mm_mul_ps(Weight, Color2));
+				Sum3 = _mm_add_ps(Sum3, _mm_mul_ps(Weight, Color3));
+			}
+
+			if (Lut)
+			{
+				uint32_t* Output = (uint32_t*)DstRow + X;
+				Output[0] = CpuResize__Store_SSE41(Sum0, Lut);
+				Output[1] = CpuResize__Store_SSE41(Sum1, Lut);
+				Output[2] = CpuResize__Store_SSE41(Sum2, Lut);
+				Output[3] = CpuResize__Store_SSE41(Sum3, Lut);
+			}
+			else
+			{
+				__m128i Value01 = _mm_packus_epi32(CpuResize__Quantize_SSE41(Sum0), CpuResize__Quantize_SSE41(Sum1));
+				__m128i Value23 = _mm_packus_epi32(CpuResize__Quantize_SSE41(Sum2), CpuResize__Quantize_SSE41(Sum3));
+				__m128i Value = _mm_and_si128(_mm_packus_epi16(Value01, Value23), _mm_set1_epi32(0xffffff));
+				_mm_storeu_si128((__m128i*)(DstRow + X * 4), Value);
+			}
+		}
+
+		for (; X < Count; X++)
+		{
+			const uint8_t* Pixel = SrcRow + X * 4;
+
+			__m128 Sum = _mm_setzero_ps();
+			for (uint32_t Tap = 0; Tap < TapCount; Tap++, Pixel += SrcPitch)
+			{
+				Sum = _mm_add_ps(Sum, _mm_mul_ps(_mm_set1_ps(Weights[Tap]), CpuResize__Load_SSE41(Pixel, Lut)));
+			}
+			((uint32_t*)DstRow)[X] = CpuResize__Store_SSE41(Sum, Lut);
+		}
+	}
+}
+
+static CPU_TARGET("sse4.1") void CpuResize__PassH_SSE41(const CpuResize* Resize, const ResizeTable* Table, const uint8_t* Src, size_t SrcPitch, uint32_t SrcFirst, uint8_t* Dst, size_t DstPitch, uint32_t First, uint32_t Last, uint32_t Count)
+{
+	// separate instances for gamma & linear space, so there are no branches in inner loops
+	if (Resize->LinearSpace)
+	{
+		CpuResize__PassH_SSE41_Impl(Table, Src, SrcPitch, SrcFirst, Dst, DstPitch, First, Last, Count, Resize->Lut);
+	}
+	else
+	{
+		CpuResize__PassH_SSE41_Impl(Table, Src, SrcPitch, SrcFirst, Dst, DstPitch, First, Last, Count, NULL);
+	}
+}
+
+static CPU_TARGET("sse4.1") void CpuResize__PassV_SSE41(const CpuResize* Resize, const ResizeTable* Table, const uint8_t* Src, size_t SrcPitch, uint32_t SrcFirst, uint8_t* Dst, size_t DstPitch, uint32_t First, uint32_t Last, uint32_t Count)
+{
+	if (Resize->LinearSpace)
+	{
+		CpuResize__PassV_SSE41_Impl(Table, Src, SrcPitch, SrcFirst, Dst, DstPitch, First, Last, Count, Resize->Lut);
+	}
+	else
+	{
+		CpuResize__PassV_SSE41_Impl(Table, Src, SrcPitch, SrcFirst, Dst, DstPitch, First, Last, Count, NULL);
+	}
+}
+
+// AVX2 - two pixels per register, one in each 128-bit lane
+
+CPU_INLINE CPU_TARGET("avx2,fma") __m256 CpuResize__Load2_AVX2(const uint8_t* Pixel0, const uint8_t* Pixel1, const float* Lut)
+{
+	if (Lut)
+	{
+		return _mm256_setr_ps(
+			Lut[Pixel0[0]], Lut[Pixel0[1]], Lut[Pixel0[2]], 0.f,
+			Lut[Pixel1[0]], Lut[Pixel1[1]], Lut[Pixel1[2]], 0.f);
+	}
+	else
+	{
+		int32_t Value0, Value1;
+		memcpy(&Value0, Pixel0, sizeof(Value0));
+		memcpy(&Value1, Pixel1, sizeof(Value1));
+		return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_setr_epi32(Value0, Value1, 0, 0)));
+	}
+}
+
+CPU_INLINE CPU_TARGET("avx2,fma") __m256 CpuResize__Load8_AVX2(__m128i Value, const float* Lut)
+{
+	// two pixels from lower 8 bytes
+	__m256i Index = _mm256_cvtepu8_epi32(Value);
+	return Lut ? _mm256_i32gather_ps(Lut, Index, sizeof(float)) : _mm256_cvtepi32_ps(Index);
+}
+
+CPU_INLINE CPU_TARGET("avx2,fma") __m256i CpuResize__Quantize_AVX2(__m256 Color)
+{
+	Color = _mm256_min_ps(_mm256_max_ps(Color, _mm256_setzero_ps()), _mm256_set1_ps(255.f));
+	return _mm256_cvttps_epi32(_mm256_add_ps(Color, _mm256_set1_ps(0.5f)));
+}
+
+CPU_INLINE CPU_TARGET("avx2,fma") __m256 CpuResize__Encode_AVX2(__m256 Color, const float* Lut)
+{
+	// same as CpuResize__Encode_Scalar, with gathers for both interpolation ends
+	const float* Encode = Lut + CPU_RESIZE_DECODE_SIZE;
+
+	Color = _mm256_min_ps(_mm256_max_ps(Color, _mm256_setzero_ps()), _mm256_set1_ps(1.f));
+
+	__m256 Pos = _mm256_mul_ps(Color, _mm256_set1_ps((float)CPU_RESIZE_ENCODE_SIZE));
+	__m256i Index = _mm256_cvttps_epi32(Pos);
+	__m256 Frac = _mm256_sub_ps(Pos, _mm256_cvtepi32_ps(Index));
+
+	__m256 Value0 = _mm256_i32gather_ps(Encode + 0, Index, sizeof(float));
+	__m256 Value1 = _mm256_i32gather_ps(Encode + 1, Index, sizeof(float));
+	return _mm256_fmadd_ps(_mm256_sub_ps(Value1, Value0), Frac, Value0);
+}
+
+CPU_INLINE CPU_TARGET("avx2,fma") void CpuResize__Store2_AVX2(uint32_t* Output, __m256 Color, const float* Lut)
+{
+	__m256i Value = CpuResize__Quantize_AVX2(Lut ? CpuResize__Encode_AVX2(Color, Lut) : Color);
+	__m128i Value01 = _mm_packus_epi32(_mm256_castsi256_si128(Value), _mm256_extracti128_si256(Value, 1));
+	Value01 = _mm_and_si128(_mm_packus_epi16(Value01, Value01), _mm_set1_epi32(0xffffff));
+	_mm_storel_epi64((__m128i*)Output, Value01);
+}
+
+CPU_INLINE CPU_TARGET("avx2,fma") void CpuResize__PassH_AVX2_Impl(const ResizeTable* Table, const uint8_t* Src, size_t SrcPitch, uint32_t SrcFirst, uint8_t* Dst, size_t DstPitch, uint32_t First, uint32_t Last, uint32_t Count, const float* Lut)
+{
+	uint32_t TapCount = Table->TapCount;
+
+	for (uint32_t Y = 0; Y < Count; Y++)
+	{
+		const uint8_t* SrcRow = Src + Y * SrcPitch;
+		uint32_t* DstRow = (uint32_t*)(Dst + Y * DstPitch);
+
+		uint32_t X = First;
+		for (; X + 2 <= Last; X += 2, DstRow += 2)
+		{
+			const float* Weights0 = Table->Weights + X * TapCount;
+			const float* Weights1 = Weights0 + TapCount;
+			const uint8_t* Pixel0 = SrcRow + (Table->Start[X + 0] - SrcFirst) * 4;
+			const uint8_t* Pixel1 = SrcRow + (Table->Start[X + 1] - SrcFirst) * 4;
+
+			__m256 Sum = _mm256_setzero_ps();
+			for (uint32_t Tap = 0; Tap < TapCount; Tap++)
+			{
+				__m256 Weight = _mm256_setr_m128(_mm_set1_ps(Weights0[Tap]), _mm_set1_ps(Weights1[Tap]));
+				__m256 Color = CpuResize__Load2_AVX2(Pixel0 + Tap * 4, Pixel1 + Tap * 4, Lut);
+				Sum = _mm256_fmadd_ps(Weight, Color, Sum);
+			}
+			CpuResize__Store2_AVX2(DstRow, Sum, Lut);
+		}
+
+		if (X < Last)
+		{
+			const float* Weights = Table->Weights + X * TapCount;
+			const uint8_t* Pixel = SrcRow + (Table->Start[X] - SrcFirst) * 4;
+
+			__m128 Sum = _mm_setzero_ps();
+			for (uint32_t Tap = 0; Tap < TapCount; Tap++)
+			{
+				Sum = _mm_fmadd_ps(_mm_set1_ps(Weights[Tap]), CpuResize__Load_SSE41(Pixel + Tap * 4, Lut), Sum);
+			}
+			*DstRow = CpuResize__Store_SSE41(Sum, Lut);
+		}
+	}
+}
+
+CPU_INLINE CPU_TARGET("avx2,fma") void CpuResize__PassV_AVX2_Impl(const ResizeTable* Table, const uint8_t* Src, size_t SrcPitch, uint32_t SrcFirst, uint8_t* Dst, size_t DstPitch, uint32_t First, uint32_t Last, uint32_t Count, const float* Lut)
+{
+	uint32_t TapCount = Table->TapCount;
+
+	for (uint32_t Y = First; Y < Last; Y++)
+	{
+		const float* Weights = Table->Weights + Y * TapCount;
+		const uint8_t* SrcRow = Src + (Table->Start[Y] - SrcFirst) * SrcPitch;
+		uint8_t* DstRow = Dst + (Y - First) * DstPitch;
+
+		uint32_t X = 0;
+		for (; X + 8 <= Count; X += 8)
+		{
+			const uint8_t* Pixel = SrcRow + X * 4;
+
+			__m256 Sum0 = _mm256_setzero_ps();
+			__m256 Sum1 = _mm256_setzero_ps();
+			__m256 Sum2 = _mm256_setzero_ps();
+			__m256 Sum3 = _mm256_setzero_ps();
+			for (uint32_t Tap = 0; Tap < TapCount; Tap++, Pixel += SrcPitch)
+			{
+				__m256 Weight = _mm256_set1_ps(Weights[Tap]);
+				__m128i Value0 = _mm_loadu_si128((const __m128i*)(Pixel + 0));
+				__m128i Value1 = _mm_loadu_si128((const __m128i*)(Pixel + 16));
+				Sum0 = _mm256_fmadd_ps(Weight, CpuResize__Load8_AVX2(Value0, Lut), Sum0);
+				Sum1 = _mm256_fmadd_ps(Weight, CpuResize__Load8_AVX2(_mm_srli_si128(Value0, 8), Lut), Sum1);
+				Sum2 = _mm256_fmadd_ps(Weight, CpuResize__Load8_AVX2(Value1, Lut), Sum2);
+				Sum3 = _mm256_fmadd_ps(Weight, CpuResize__Load8_AVX2(_mm_srli_si128(Value1, 8), Lut), Sum3);
+			}
+
+			if (Lut)
+			{
+				uint32_t* Output = (uint32_t*)DstRow + X;
+				CpuResize__Store2_AVX2(Output + 0, Sum0, Lut);
+				CpuResize__Store2_AVX2(Output + 2, Sum1, Lut);
+				CpuResize__Store2_AVX2(Output + 4, Sum2, Lut);
+				CpuResize__Store2_AVX2(Output + 6, Sum3, Lut);
+			}
+			else
+			{
+				// packs are done inside 128-bit lanes, so pixels end up in 0,2,4,6,1,3,5,7 order
+				__m256i Value01 = _mm256_packus_epi32(CpuResize__Quantize_AVX2(Sum0), CpuResize__Quantize_AVX2(Sum1));
+				__m256i Value23 = _mm256_packus_epi32(CpuResize__Quantize_AVX2(Sum2), CpuResize__Quantize_AVX2(Sum3));
+				__m256i Value = _mm256_packus_epi16(Value01, Value23);
+				Value = _mm256_permutevar8x32_epi32(Value, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+				Value = _mm256_and_si256(Value, _mm256_set1_epi32(0xffffff));
+				_mm256_storeu_si256((__m256i*)(DstRow + X * 4), Value);
+			}
+		}
+
+		for (; X < Count; X++)
+		{
+			const uint8_t* Pixel = SrcRow + X * 4;
+
+			__m128 Sum = _mm_setzero_ps();
+			for (uint32_t Tap = 0; Tap < TapCount; Tap++, Pixel += SrcPitch)
+			{
+				Sum = _mm_fmadd_ps(_mm_set1_ps(Weights[Tap]), CpuResize__Load_SSE41(Pixel, Lut), Sum);
+			}
+			((uint32_t*)DstRow)[X] = CpuResize__Store_SSE41(Sum, Lut);
+		}
+	}
+}
+
+static CPU_TARGET("avx2,fma") void CpuResize__PassH_AVX2(const CpuResize* Resize, const ResizeTable* Table, const uint8_t* Src, size_t SrcPitch, uint32_t SrcFirst, uint8_t* Dst, size_t DstPitch, uint32_t First, uint32_t Last, uint32_t Count)
+{
+	if (Resize->LinearSpace)
+	{
+		CpuResize__PassH_AVX2_Impl(Table, Src, SrcPitch, SrcFirst, Dst, DstPitch, First, Last, Count, Resize->Lut);
+	}
+	else
+	{
+		CpuResize__PassH_AVX2_Impl(Table, Src, SrcPitch, SrcFirst, Dst, DstPitch, First, Last, Count, NULL);
+	}
+}
+
+static CPU_TARGET("avx2,fma") void CpuResize__PassV_AVX2(const CpuResize* Resize, const ResizeTable* Table, const uint8_t* Src, size_t SrcPitch, uint32_t SrcFirst, uint8_t* Dst, size_t DstPitch, uint32_t First, uint32_t Last, uint32_t Count)
+{
+	if (Resize->LinearSpace)
+	{
+		CpuResize__PassV_AVX2_Impl(Table, Src, SrcPitch, SrcFirst, Dst, DstPitch, First, Last, Count, Resize->Lut);
+	}
+	else
+	{
+		CpuResize__PassV_AVX2_Impl(Table, Src, SrcPitch, SrcFirst, Dst, DstPitch, First, Last, Count, NULL);
+	}
+}
+
+#endif // defined(CPU_X64)
+
+#if defined(CPU_ARM64)
+
+// NEON - one pixel per register for horizontal pass, four pixels per iteration for vertical pass
+
+CPU_INLINE float32x4_t CpuResize__Load_NEON(const uint8_t* Pixel, const float* Lut)
+{
+	if (Lut)
+	{
+		float Values[4] = { Lut[Pixel[0]], Lut[Pixel[1]], Lut[Pixel[2]], 0.f };
+		return vld1q_f32(Values);
+	}
+	else
+	{
+		uint32_t Value;
+		memcpy(&Value, Pixel, sizeof(Value));
+		uint16x8_t Value16 = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(Value)));
+		return vcvtq_f32_u32(vmovl_u16(vget_low_u16(Value16)));
+	}
+}
+
+CPU_INLINE uint16x4_t CpuResize__Quantize_NEON(float32x4_t Color)
+{
+	Color = vminq_f32(vmaxq_f32(Color, vdupq_n_f32(0.f)), vdupq_n_f32(255.f));
+	return vmovn_u32(vcvtq_u32_f32(vaddq_f32(Color, vdupq_n_f32(0.5f))));
+}
+
+CPU_INLINE uint32_t CpuResize__Store_NEON(float32x4_t Color, const float* Lut)
+{
+	if (Lut)
+	{
+		float Values[4];
+		vst1q_f32(Values, Color);
+		return CpuResize__Store_Scalar(Values, Lut);
+	}
+	else
+	{
+		uint16x4_t Value = CpuResize__Quantize_NEON(Color);
+		uint8x8_t Value8 = vmovn_u16(vcombine_u16(Value, Value));
+		return vget_lane_u32(vreinterpret_u32_u8(Value8), 0) & 0xffffff;
+	}
+}
+
+CPU_INLINE void CpuResize__PassH_NEON_Impl(const ResizeTable* Table, const uint8_t* Src, size_t SrcPitch, uint32_t SrcFirst, uint8_t* Dst, size_t DstPitch, uint32_t First, uint32_t Last, uint32_t Count, const float* Lut)
+{
+	uint32_t TapCount = Table->TapCount;
+
+	for (uint32_t Y = 0; Y < Count; Y++)
+	{
+		const uint8_t* SrcRow = Src + Y * SrcPitch;
+		uint32_t* DstRow = (uint32_t*)(Dst + Y * DstPitch);
+
+		for (uint32_t X = First; X < Last; X++)
+		{
+			const float* Weights = Table->Weights + X * TapCount;
+			const uint8_t* Pixel = SrcRow + (Table->Start[X] - SrcFirst) * 4;
+
+			float32x4_t Sum = vdupq_n_f32(0.f);
+			for (uint32_t Tap = 0; Tap < TapCount; Tap++)
+			{
+				Sum = vfmaq_n_f32(Sum, CpuResize__Load_NEON(Pixel + Tap * 4, Lut), Weights[Tap]);
+			}
+			*DstRow++ = CpuResize__Store_NEON(Sum, Lut);
+		}
+	}
+}
+
+CPU_INLINE void CpuResize__PassV_NEON_Impl(const ResizeTable* Table, const uint8_t* Src, size_t SrcPitch, uint32_t SrcFirst, uint8_t* Dst, size_t DstPitch, uint32_t First, uint32_t Last, uint32_t Count, const float* Lut)
+{
+	uint32_t TapCount = Table->TapCount;
+
+	for (uint32_t Y = First; Y < Last; Y++)
+	{
+		const float* Weights = Table->Weights + Y * TapCount;
+		const uint8_t* SrcRow = Src + (Table->Start[Y] - SrcFirst) * SrcPitch;
+		uint8_t* DstRow = Dst + (Y - First) * DstPitch;
+
+		uint32_t X = 0;
+		for (; X + 4 <= Count; X += 4)
+		{
+			const uint8_t* Pixel = SrcRow + X * 4;
+
+			float32x4_t Sum0 = vdupq_n_f32(0.f);
+			float32x4_t Sum1 = vdupq_n_f32(0.f);
+			float32x4_t Sum2 = vdupq_n_f32(0.f);
+			float32x4_t Sum3 = vdupq_n_f32(0.f);
+			for (uint32_t Tap = 0; Tap < TapCount; Tap++, Pixel += SrcPitch)
+			{
+				float Weight = Weights[Tap];
+				float32x4_t Color0, Color1, Color2, Color3;
+				if (Lut)
+				{
+					Color0 = CpuResize__Load_NEON(Pixel +  0, Lut);
+					Color1 = CpuResize__Load_NEON(Pixel +  4, Lut);
+					Color2 = CpuResize__Load_NEON(Pixel +  8, Lut);
+					Color3 = CpuResize__Load_NEON(Pixel + 12, Lut);
+				}
+				else
+				{
+					uint8x16_t Value = vld1q_u8(Pixel);
+					uint16x8_t Value01 = vmovl_u8(vget_low_u8(Value));
+					uint16x8_t Value23 = vmovl_u8(vget_high_u8(Value));
+					Color0 = vcvtq_f32_u32(vmovl_u16(vget_low_u16(Value01)));
+					Color1 = vcvtq_f32_u32(vmovl_u16(vget_high_u16(Value01)));
+					Color2 = vcvtq_f32_u32(vmovl_u16(vget_low_u16(Value23)));
+					Color3 = vcvtq_f32_u32(vmovl_u16(vget_high_u16(Value23)));
+				}
+				Sum0 = vfmaq_n_f32(Sum0, Color0, Weight);
+				Sum1 = vfmaq_n_f32(Sum1, Color1, Weight);
+				Sum2 = vfmaq_n_f32(Sum2, Color2, Weight);
+				Sum3 = vfmaq_n_f32(Sum3, Color3, Weight);
+			}
+
+			if (Lut)
+			{
+				uint32_t* Output = (uint32_t*)DstRow + X;
+				Output[0] = CpuResize__Store_NEON(Sum0, Lut);
+				Output[1] = CpuResize__Store_NEON(Sum1, Lut);
+				Output[2] = CpuResize__Store_NEON(Sum2, Lut);
+				Output[3] = CpuResize__Store_NEON(Sum3, Lut);
+			}
+			else
+			{
+				uint16x8_t Value01 = vcombine_u16(CpuResize__Quantize_NEON(Sum0), CpuResize__Quantize_NEON(Sum1));
+				uint16x8_t Value23 = vcombine_u16(CpuResize__Quantize_NEON(Sum2), CpuResize__Quantize_NEON(Sum3));
+				uint8x16_t Value = vcombine_u8(vmovn_u16(Value01), vmovn_u16(Value23));
+				Value = vandq_u8(Value, vreinterpretq_u8_u32(vdupq_n_u32(0xffffff)));
+				vst1q_u8(DstRow + X * 4, Value);
+			}
+		}
+
+		for (; X < Count; X++)
+		{
+			const uint8_t* Pixel = SrcRow + X * 4;
+
+			float32x4_t Sum = vdupq_n_f32(0.f);
+			for (uint32_t Tap = 0; Tap < TapCount; Tap++, Pixel += SrcPitch)
+			{
+				Sum = vfmaq_n_f32(Sum, CpuResize__Load_NEON(Pixel, Lut), Weights[Tap]);
+			}
+			((uint32_t*)DstRow)[X] = CpuResize__Store_NEON(Sum, Lut);
+		}
+	}
+}
+
+static void CpuResize__PassH_NEON(const CpuResize* Resize, const ResizeTable* Table, const uint8_t* Src, size_t SrcPitch, uint32_t SrcFirst, uint8_t* Dst, size_t DstPitch, uint32_t First, uint32_t Last, uint32_t Count)
+{
+	if (Resize->LinearSpace)
+	{
+		CpuResize__PassH_NEON_Impl(Table, Src, SrcPitch, SrcFirst, Dst, DstPitch, First, Last, Count, Resize->Lut);
+	}
+	else
+	{
+		CpuResize__PassH_NEON_Impl(Table, Src, SrcPitch, SrcFirst, Dst, DstPitch, First, Last, Count, NULL);
+	}
+}
+
+static void CpuResize__PassV_NEON(const CpuResize* Resize, const ResizeTable* Table, const uint8_t* Src, size_t SrcPitch, uint32_t SrcFirst, uint8_t* Dst, size_t DstPitch, uint32_t First, uint32_t Last, uint32_t Count)
+{
+	if (Resize->LinearSpace)
+	{
+		CpuResize__PassV_NEON_Impl(Table, Src, SrcPitch, SrcFirst, Dst, DstPitch, First, Last, Count, Resize->Lut);
+	}
+	else
+	{
+		CpuResize__PassV_NEON_Impl(Table, Src, SrcPitch, SrcFirst, Dst, DstPitch, First, Last, Count, NULL);
+	}
+}
+
+#endif // defined(CPU_ARM64)
+
+// multithreaded Run
+
+// first pass output of one tile should fit in L2 cache, so second pass reads it from there instead of memory
+#define CPU_RESIZE_TILE_BYTES (256 * 1024)
+
+// reduced rows in one task of integer reduction
+#define CPU_RESIZE_REDUCE_ROWS 16
+
+typedef struct
+{
+	CpuResize* Resize;
+	const uint8_t* Input;
+	size_t InputPitch;
+	uint8_t* Output;
+	size_t OutputPitch;
+}
+CpuResize__Job;
+
+static void CpuResize__TileInput(const ResizeTable* Table, uint32_t First, uint32_t Last, uint32_t* InputFirst, uint32_t* InputLast)
+{
+	// input indices [InputFirst, InputLast) used by outputs [First, Last)
+	uint32_t Low = Table->InputSize;
+	uint32_t High = 0;
+	for (uint32_t Index = First; Index < Last; Index++)
+	{
+		uint32_t Start = Table->Start[Index];
+		Low = Start < Low ? Start : Low;
+		High = Start + Table->TapCount > High ? Start + Table->TapCount : High;
+	}
+	*InputFirst = Low;
+	*InputLast = High;
+}
+
+static uint32_t CpuResize__TileSpan(const ResizeTable* Table, uint32_t TileSize)
+{
+	// max count of input indices any tile needs
+	uint32_t Span = 0;
+	for (uint32_t First = 0; First < Table->OutputSize; First += TileSize)
+	{
+		uint32_t Last = First + TileSize < Table->OutputSize ? First + TileSize : Table->OutputSize;
+
+		uint32_t InputFirst, InputLast;
+		CpuResize__TileInput(Table, First, Last, &InputFirst, &InputLast);
+		Span = InputLast - InputFirst > Span ? InputLast - InputFirst : Span;
+	}
+	return Span;
+}
+
+static void CpuResize__ReduceTask(void* Context, uint32_t Index, uint32_t Worker)
+{
+	// reduction works directly on input & output rows, it needs no scratch memory of worker
+	(void)Worker;
+
+	CpuResize__Job* Job = Context;
+	CpuResize* Resize = Job->Resize;
+
+	uint32_t First = Index * CPU_RESIZE_REDUCE_ROWS;
+	uint32_t Last = First + CPU_RESIZE_REDUCE_ROWS < Resize->Plan.ReducedHeight ? First + CPU_RESIZE_REDUCE_ROWS : Resize->Plan.ReducedHeight;
+
+	CpuResize__Reduce(Resize, Job->Input, Job->InputPitch, Resize->Reduced, Resize->ReducedPitch, First, Last);
+}
+
+static void CpuResize__TileTask(void* Context, uint32_t Index, uint32_t Worker)
+{
+	CpuResize__Job* Job = Context;
+	CpuResize* Resize = Job->Resize;
+
+	uint32_t TileSize = Resize->TileSize;
+	uint32_t X0 = (Index % Resize->TileCountX) * TileSize;
+	uint32_t Y0 = (Index / Resize->TileCountX) * TileSize;
+	uint32_t X1 = X0 + TileSize < Resize->OutputWidth ? X0 + TileSize : Resize->OutputWidth;
+	uint32_t Y1 = Y0 + TileSize < Resize->OutputHeight ? Y0 + TileSize : Resize->OutputHeight;
+
+	uint8_t* Scratch = Resize->Scratch + Worker * Resize->ScratchSize;
+	uint8_t* Output = Job->Output + Y0 * Job->OutputPitch + X0 * 4;
+
+	// first pass calculates only part of middle image that tile needs, rows or columns next to tile are calculated again
+	// by neighbor tiles, but middle image is never written to memory in full
+	uint32_t InputFirst, InputLast;
+	if (Resize->Plan.VerticalFirst)
+	{
+		CpuResize__TileInput(&Resize->TableH, X0, X1, &InputFirst, &InputLast);
+		Resize->PassV(Resize, &Resize->TableV, Job->Input + InputFirst * 4, Job->InputPitch, 0, Scratch, Resize->ScratchPitch, Y0, Y1, InputLast - InputFirst);
+		Resize->PassH(Resize, &Resize->TableH, Scratch, Resize->ScratchPitch, InputFirst, Output, Job->OutputPitch, X0, X1, Y1 - Y0);
+	}
+	else
+	{
+		CpuResize__TileInput(&Resize->TableV, Y0, Y1, &InputFirst, &InputLast);
+		Resize->PassH(Resize, &Resize->TableH, Job->Input + InputFirst * Job->InputPitch, Job->InputPitch, 0, Scratch, Resize->ScratchPitch, X0, X1, InputLast - InputFirst);
+		Resize->PassV(Resize, &Resize->TableV, Scratch, Resize->ScratchPitch, InputFirst, Output, Job->OutputPitch, Y0, Y1, X1 - X0);
+	}
+}
+
+static void CpuResize__CreateTiles(CpuResize* Resize)
+{
+	// largest tile that fits in L2 & still gives enough tiles for work stealing to balance threads
+	uint32_t TileSize = 256;
+	uint32_t Span;
+	for (;;)
+	{
+		uint32_t TileCount = ((Resize->OutputWidth + TileSize - 1) / TileSize) * ((Resize->OutputHeight + TileSize - 1) / TileSize);
+		if (Resize->Plan.VerticalFirst)
+		{
+			Span = CpuResize__TileSpan(&Resize->TableH, TileSize);
+			Resize->ScratchPitch = Span * 4;
+			Resize->ScratchSize = Resize->ScratchPitch * (TileSize < Resize->OutputHeight ? TileSize : Resize->OutputHeight);
+		}
+		else
+		{
+			Span = CpuResize__TileSpan(&Resize->TableV, TileSize);
+			Resize->ScratchPitch = (TileSize < Resize->OutputWidth ? TileSize : Resize->OutputWidth) * 4;
+			Resize->ScratchSize = Resize->ScratchPitch * Span;
+		}
+
+		if (TileSize == 16 || (Resize->ScratchSize <= CPU_RESIZE_TILE_BYTES && TileCount >= 4 * Resize->Pool->ThreadCount))
+		{
+			break;
+		}
+		TileSize /= 2;
+	}
+
+	// separate cache lines for each worker
+	Resize->ScratchSize = (Resize->ScratchSize + CPU_CACHE_LINE - 1) & ~(size_t)(CPU_CACHE_LINE - 1);
+	Resize->Scratch = Cpu_Alloc(Resize->ScratchSize * Resize->Pool->ThreadCount);
+	Resize->TileSize = TileSize;
+	Resize->TileCountX = (Resize->OutputWidth + TileSize - 1) / TileSize;
+	Resize->TileCountY = (Resize->OutputHeight + TileSize - 1) / TileSize;
+}
+
+static void CpuResize__RunPool(CpuResize* Resize, const uint8_t* Input, size_t InputPitch, uint8_t* Output, size_t OutputPitch)
+{
+	CpuResize__Job Job =
+	{
+		.Resize = Resize,
+		.Input = Input,
+		.InputPitch = InputPitch,
+		.Output = Output,
+		.OutputPitch = OutputPitch,
+	};
+
+	if (Resize->Reduced)
+	{
+		uint32_t TaskCount = (Resize->Plan.ReducedHeight + CPU_RESIZE_REDUCE_ROWS - 1) / CPU_RESIZE_REDUCE_ROWS;
+		CpuPool_Run(Resize->Pool, &CpuResize__ReduceTask, &Job, TaskCount);
+
+		Job.Input = Resize->Reduced;
+		Job.InputPitch = Resize->ReducedPitch;
+	}
+
+	CpuPool_Run(Resize->Pool, &CpuResize__TileTask, &Job, Resize->TileCountX * Resize->TileCountY);
+}
+
+void CpuResize_Create(CpuResize* Resize, uint32_t InputWidth, uint32_t InputHeight, uint32_t OutputWidth, uint32_t OutputHeight, ResizeFilter Filter, bool LinearSpace, CpuKernel Kernel, CpuPool* Pool)
+{
+	ResizePlan Plan;
+	ResizePlan_Create(&Plan, InputWidth, InputHeight, OutputWidth, OutputHeight, Filter);
+	CpuResize_CreatePlan(Resize, &Plan, LinearSpace, Kernel, Pool);
+}
+
+void CpuResize_CreatePlan(CpuResize* Resize, const ResizePlan* Plan, bool LinearSpace, CpuKernel Kernel, CpuPool* Pool)
+{
+	uint32_t InputWidth = Plan->InputWidth;
+	uint32_t InputHeight = Plan->InputHeight;
+	uint32_t OutputWidth = Plan->OutputWidth;
+	uint32_t OutputHeight = Plan->OutputHeight;
+
+	*Resize = (CpuResize)
+	{
+		.Kernel = Cpu_SelectKernel(Kernel),
+		.LinearSpace = LinearSpace,
+		.Pool = Pool,
+		.InputWidth = InputWidth,
+		.InputHeight = InputHeight,
+		.OutputWidth = OutputWidth,
+		.OutputHeight = OutputHeight,
+	};
+
+	if (InputWidth == OutputWidth && InputHeight == OutputHeight)
+	{
+		// nothing to resize, Run will just copy
+		return;
+	}
+
+	Resize->Plan = *Plan;
+
+	if (Plan->ReduceX != 1 || Plan->ReduceY != 1)
+	{
+		Resize->ReducedPitch = Plan->ReducedWidth * 4;
+		Resize->Reduced = Cpu_Alloc(Resize->ReducedPitch * Plan->ReducedHeight);
+	}
+
+	ResizeTable_Create(&Resize->TableH, Plan->ReducedWidth, OutputWidth, Plan->Filter);
+	ResizeTable_Create(&Resize->TableV, Plan->ReducedHeight, OutputHeight, Plan->Filter);
+
+	Resize->MiddlePitch = Plan->MiddleWidth * 4;
+	Resize->Middle = Cpu_Alloc(Resize->MiddlePitch * Plan->MiddleHeight);
+
+	if (LinearSpace)
+	{
+		Resize->Lut = Cpu_Alloc((CPU_RESIZE_DECODE_SIZE + CPU_RESIZE_ENCODE_SIZE + 2) * sizeof(float));
+
+		// same as reading B8G8R8A8_UNORM_SRGB texture view
+		for (int Index = 0; Index < CPU_RESIZE_DECODE_SIZE; Index++)
+		{
+			Resize->Lut[Index] = CpuResize__GammaToLinear(Index / 255.f);
+		}
+
+		// replaces pow() for every channel of every output pixel in LinearToGamma
+		float* Encode = Resize->Lut + CPU_RESIZE_DECODE_SIZE;
+		for (int Index = 0; Index <= CPU_RESIZE_ENCODE_SIZE; Index++)
+		{
+			Encode[Index] = CpuResize__LinearToGamma((float)Index / CPU_RESIZE_ENCODE_SIZE) * 255.f;
+		}
+		Encode[CPU_RESIZE_ENCODE_SIZE + 1] = Encode[CPU_RESIZE_ENCODE_SIZE];
+	}
+
+	switch (Resize->Kernel)
+	{
+#if defined(CPU_X64)
+	case CpuKernel_SSE41:
+		Resize->PassH = &CpuResize__PassH_SSE41;
+		Resize->PassV = &CpuResize__PassV_SSE41;
+		break;
+	case CpuKernel_AVX2:
+		Resize->PassH = &CpuResize__PassH_AVX2;
+		Resize->PassV = &CpuResize__PassV_AVX2;
+		break;
+#endif
+#if defined(CPU_ARM64)
+	case CpuKernel_NEON:
+		Resize->PassH = &CpuResize__PassH_NEON;
+		Resize->PassV = &CpuResize__PassV_NEON;
+		break;
+#endif
+	default:
+		Resize->PassH = &CpuResize__PassH_Scalar;
+		Resize->PassV = &CpuResize__PassV_Scalar;
+		break;
+	}
+
+	if (Pool)
+	{
+		CpuResize__CreateTiles(Resize);
+	}
+}
+
+void CpuResize_Release(CpuResize* Resize)
+{
+	if (Resize->Middle)
+	{
+		ResizeTable_Release(&Resize->TableH);
+		ResizeTable_Release(&Resize->TableV);
+		Cpu_Free(Resize->Reduced);
+		Cpu_Free(Resize->Middle);
+		Cpu_Free(Resize->Lut);
+		Cpu_Free(Resize->Scratch);
+	}
+}
+
+void CpuResize_Run(CpuResize* Resize, const uint8_t* Input, size_t InputPitch, uint8_t* Output, size_t OutputPitch)
+{
+	if (Resize->Middle == NULL)
+	{
+		for (uint32_t Y = 0; Y < Resize->InputHeight; Y++)
+		{
+			memcpy(Output + Y * OutputPitch, Input + Y * InputPitch, Resize->InputWidth * 4);
+		}
+		return;
+	}
+
+	if (Resize->Pool)
+	{
+		CpuResize__RunPool(Resize, Input, InputPitch, Output, OutputPitch);
+		return;
+	}
+
+	CpuResize_RunMiddle(Resize, Input, InputPitch);
+	CpuResize_RunRows(Resize, Output, OutputPitch, 0, Resize->OutputHeight);
+}
+
+void CpuResize_RunMiddle(CpuResize* Resize, const uint8_t* Input, size_t InputPitch)
+{
+	Assert(Resize->Middle);
+
+	if (Resize->Reduced)
+	{
+		CpuResize__Reduce(Resize, Input, InputPitch, Resize->Reduced, Resize->ReducedPitch, 0, Resize->Plan.ReducedHeight);
+		Input = Resize->Reduced;
+		InputPitch = Resize->ReducedPitch;
+	}
+
+	if (Resize->Plan.VerticalFirst)
+	{
+		Resize->PassV(Resize, &Resize->TableV, Input, InputPitch, 0, Resize->Middle, Resize->MiddlePitch, 0, Resize->OutputHeight, Resize->Plan.ReducedWidth);
+	}
+	else
+	{
+		Resize->PassH(Resize, &Resize->TableH, Input, InputPitch, 0, Resize->Middle, Resize->MiddlePitch, 0, Resize->OutputWidth, Resize->Plan.ReducedHeight);
+	}
+}
+
+void CpuResize_RunRows(CpuResize* Resize, uint8_t* Output, size_t OutputPitch, uint32_t First, uint32_t Last)
+{
+	Assert(Resize->Middle);
+	Assert(First <= Last && Last <= Resize->OutputHeight);
+
+	if (Resize->Plan.VerticalFirst)
+	{
+		Resize->PassH(Resize, &Resize->TableH, Resize->Middle + First * Resize->MiddlePitch, Resize->MiddlePitch, 0, Output, OutputPitch, 0, Resize->OutputWidth, Last - First);
+	}
+	else
+	{
+		Resize->PassV(Resize, &Resize->TableV, Resize->Middle, Resize->MiddlePitch, 0, Output, OutputPitch, First, Last, Resize->OutputWidth);
+	}
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include "wcap_cpu.h"
+
+//
+// interface
+//
+
+// histogram bins for 8-bit luma
+#define CPU_SCENE_BINS 32
+
+// returns sum of absolute differences of Count bytes
+typedef uint32_t CpuScene_SadFunc(const uint8_t* Previous, const uint8_t* Current, size_t Count);
+
+typedef struct
+{
+	CpuScene_SadFunc* Sad;
+	CpuKernel Kernel;
+	uint8_t* Previous;
+	uint32_t Count;
+	uint32_t Histogram[CPU_SCENE_BINS];
+	uint32_t AverageSad; // recent per-pixel SAD in 8.8 fixed point
+	bool Valid;
+}
+CpuScene;
+
+// scene change detector for small luma thumbnails of frames, for example average luma of every FrameHash block
+// thumbnail is Count bytes, its layout does not matter as long as it is same for every frame
+static void CpuScene_Create(CpuScene* Scene, uint32_t Count, CpuKernel Kernel);
+static void CpuScene_Release(CpuScene* Scene);
+
+// returns true if Luma is very different from previous thumbnail, for example on window switch or slide change
+// large changes that happen every frame, like video playback or scrolling, are not reported
+static bool CpuScene_Detect(CpuScene* Scene, const uint8_t* Luma);
+
+//
+// implementation
+//
+
+// per-pixel SAD in luma levels that can be a scene change, when it is also CPU_SCENE_SAD_RATIO times larger than recent SAD
+#define CPU_SCENE_MIN_SAD   8
+#define CPU_SCENE_SAD_RATIO 4
+// then it must move at least this fraction of pixels to other histogram bin, out of 256 (~10%)
+#define CPU_SCENE_MIN_MOVED 24
+// or have SAD at least this large, when different content has similar histogram
+#define CPU_SCENE_CUT_SAD   32
+
+// scalar reference
+
+static uint32_t CpuScene__Sad_Scalar(const uint8_t* Previous, const uint8_t* Current, size_t Count)
+{
+	uint32_t Sad = 0;
+	for (size_t Index = 0; Index < Count; Index++)
+	{
+		Sad += Previous[Index] > Current[Index] ? Previous[Index] - Current[Index] : Current[Index] - Previous[Index];
+	}
+	return Sad;
+}
+
+#if defined(CPU_X64)
+
+static CPU_TARGET("sse4.1") uint32_t CpuScene__Sad_SSE41(const uint8_t* Previous, const uint8_t* Current, size_t Count)
+{
+	__m128i Sum = _mm_setzero_si128();
+
+	size_t Index = 0;
+	for (; Index + 16 <= Count; Index += 16)
+	{
+		__m128i A = _mm_loadu_si128((const __m128i*)(Previous + Index));
+		__m128i B = _mm_loadu_si128((const __m128i*)(Current + Index));
+		Sum = _mm_add_epi64(Sum, _mm_sad_epu8(A, B));
+	}
+	Sum = _mm_add_epi64(Sum, _mm_unpackhi_epi64(Sum, Sum));
+
+	return (uint32_t)_mm_cvtsi128_si32(Sum) + CpuScene__Sad_Scalar(Previous + Index, Current + Index, Count - Index);
+}
+
+static CPU_TARGET("avx2") uint32_t CpuScene__Sad_AVX2(const uint8_t* Previous, const uint8_t* Current, size_t Count)
+{
+	__m256i Sum = _mm256_setzero_si256();
+
+	size_t Index = 0;
+	for (; Index + 32 <= Count; Index += 32)
+	{
+		__m256i A = _mm256_loadu_si256((const __m256i*)(Previous + Index));
+		__m256i B = _mm256_loadu_si256((const __m256i*)(Current + Index));
+		Sum = _mm256_add_epi64(Sum, _mm256_sad_epu8(A, B));
+	}
+	__m128i Sum2 = _mm_add_epi64(_mm256_castsi256_si128(Sum), _mm256_extracti128_si256(Sum, 1));
+	Sum2 = _mm_add_epi64(Sum2, _mm_unpackhi_epi64(Sum2, Sum2));
+
+	return (uint32_t)_mm_cvtsi128_si32(Sum2) + CpuScene__Sad_Scalar(Previous + Index, Current + Index, Count - Index);
+}
+
+#endif
+
+#if defined(CPU_ARM64)
+
+static uint32_t CpuScene__Sad_NEON(const uint8_t* Previous, const uint8_t* Current, size_t Count)
+{
+	uint32x4_t Sum = vdupq_n_u32(0);
+
+	size_t Index = 0;
+	for (; Index + 16 <= Count; Index += 16)
+	{
+		uint8x16_t Diff = vabdq_u8(vld1q_u8(Previous + Index), vld1q_u8(Current + Index));
+		Sum = vpadalq_u16(Sum, vpaddlq_u8(Diff));
+	}
+
+	return vaddvq_u32(Sum) + CpuScene__Sad_Scalar(Previous + Index, Current + Index, Count - Index);
+}
+
+#endif
+
+void CpuScene_Create(CpuScene* Scene, uint32_t Count, CpuKernel Kernel)
+{
+	// 32-bit SAD
+	Assert(Count != 0 && Count <= UINT32_MAX / 255);
+
+	*Scene = (CpuScene)
+	{
+		.Kernel = Cpu_SelectKernel(Kernel),
+		.Previous = Cpu_Alloc(Count),
+		.Count = Count,
+	};
+
+	switch (Scene->Kernel)
+	{
+#if defined(CPU_X64)
+	case CpuKernel_SSE41:
+		Scene->Sad = &CpuScene__Sad_SSE41;
+		break;
+	case CpuKernel_AVX2:
+		Scene->Sad = &CpuScene__Sad_AVX2;
+		break;
+#endif
+#if defined(CPU_ARM64)
+	case CpuKernel_NEON:
+		Scene->Sad = &CpuScene__Sad_NEON;
+		break;
+#endif
+	default:
+		Scene->Sad = &CpuScene__Sad_Scalar;
+		break;
+	}
+}
+
+void CpuScene_Release(CpuScene* Scene)
+{
+	Cpu_Free(Scene->Previous);
+}
+
+bool CpuScene_Detect(CpuScene* Scene, const uint8_t* Luma)
+{
+	uint32_t Histogram[CPU_SCENE_BINS] = { 0 };
+	for (uint32_t Index = 0; Index < Scene->Count; Index++)
+	{
+		Histogram[Luma[Index] * CPU_SCENE_BINS / 256]++;
+	}
+
+	bool Cut = false;
+	if (Scene->Valid)
+	{
+		uint32_t Sad = (uint32_t)((uint64_t)Scene->Sad(Scene->Previous, Luma, Scene->Count) * 256 / Scene->Count);
+
+		// histogram changes a lot when different content appears, but not when same content moves around
+		uint32_t Moved = 0;
+		for (uint32_t Bin = 0; Bin < CPU_SCENE_BINS; Bin++)
+		{
+			Moved += Histogram[Bin] > Scene->Histogram[Bin] ? Histogram[Bin] - Scene->Histogram[Bin] : Scene->Histogram[Bin] - Histogram[Bin];
+		}
+		Moved = (uint32_t)((uint64_t)Moved * 256 / (2 * Scene->Count));
+
+		Cut = Sad >= CPU_SCENE_MIN_SAD * 256
+			&& Sad >= CPU_SCENE_SAD_RATIO * Scene->AverageSad
+			&& (Moved >= CPU_SCENE_MIN_MOVED || Sad >= CPU_SCENE_CUT_SAD * 256);
+
+		Scene->AverageSad = (Scene->AverageSad * 7 + Sad) / 8;
+	}
+
+	memcpy(Scene->Previous, Luma, Scene->Count);
+	memcpy(Scene->Histogram, Histogram, sizeof(Histogram));
+	Scene->Valid = true;
+
+	return Cut;
+}
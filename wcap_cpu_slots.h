@@ -0,0 +1,206 @@
+#pragma once
+
+#include "wcap_cpu.h"
+
+//
+// interface
+//
+
+typedef struct
+{
+	_Atomic(uint32_t) Sequence; // position this cell can be recycled to, or +1 when it holds free slot
+	uint32_t Index;
+}
+CpuSlots__Cell;
+
+typedef struct
+{
+	// free slot indices in ring of cells, acquired from Head & recycled to Tail
+	_Alignas(CPU_CACHE_LINE) _Atomic(uint32_t) Head;
+	_Alignas(CPU_CACHE_LINE) _Atomic(uint32_t) Tail;
+	_Alignas(CPU_CACHE_LINE) _Atomic(uint32_t) Waiters; // threads blocked in CpuSlots_Acquire
+	_Atomic(uint32_t) Signal;                           // incremented when slot is recycled while someone is waiting
+	_Alignas(CPU_CACHE_LINE) CpuSlots__Cell* Cells;
+	_Atomic(uint32_t)* Users; // for every slot, count of users that have not finished with it yet
+	uint32_t Mask;
+	uint32_t Count;
+}
+CpuSlots;
+
+// lock-free pool of slot indices in [0, Count), initially all slots are free
+// slots are acquired in same order they were recycled, so all buffers are used evenly
+// any number of threads can acquire & recycle at same time
+static void CpuSlots_Create(CpuSlots* Slots, uint32_t Count);
+static void CpuSlots_Release(CpuSlots* Slots);
+
+// returns false if no slot is free
+static bool CpuSlots_TryAcquire(CpuSlots* Slots, uint32_t* Index);
+// waits until slot is free
+static uint32_t CpuSlots_Acquire(CpuSlots* Slots);
+// makes acquired slot free again, it must not be recycled twice
+static void CpuSlots_Recycle(CpuSlots* Slots, uint32_t Index);
+// returns count of free slots, it can be already out of date when other threads acquire or recycle at same time
+static uint32_t CpuSlots_GetFreeCount(CpuSlots* Slots);
+
+// for slot shared by multiple users, sets how many of them must call CpuSlots_Done before it can be recycled
+// must be called after acquire, before slot is passed to any user
+static void CpuSlots_SetUsers(CpuSlots* Slots, uint32_t Index, uint32_t Users);
+// called by every user when it has finished with slot, returns true for last one, which must recycle slot
+static bool CpuSlots_Done(CpuSlots* Slots, uint32_t Index);
+
+//
+// implementation
+//
+
+void CpuSlots_Create(CpuSlots* Slots, uint32_t Count)
+{
+	Assert(Count != 0 && Count <= (1U << 31));
+
+	uint32_t Capacity = 1;
+	while (Capacity < Count)
+	{
+		Capacity *= 2;
+	}
+
+	Slots->Cells = Cpu_Alloc(Capacity * sizeof(*Slots->Cells));
+	Slots->Users = Cpu_Alloc(Count * sizeof(*Slots->Users));
+	Slots->Mask = Capacity - 1;
+	Slots->Count = Count;
+
+	for (uint32_t Index = 0; Index < Capacity; Index++)
+	{
+		CpuSlots__Cell* Cell = &Slots->Cells[Index];
+		atomic_init(&Cell->Sequence, Index < Count ? Index + 1 : Index);
+		Cell->Index = Index;
+	}
+	for (uint32_t Index = 0; Index < Count; Index++)
+	{
+		atomic_init(&Slots->Users[Index], 0);
+	}
+
+	atomic_init(&Slots->Head, 0);
+	atomic_init(&Slots->Tail, Count);
+	atomic_init(&Slots->Waiters, 0);
+	atomic_init(&Slots->Signal, 0);
+}
+
+void CpuSlots_Release(CpuSlots* Slots)
+{
+	Cpu_Free(Slots->Users);
+	Cpu_Free(Slots->Cells);
+}
+
+bool CpuSlots_TryAcquire(CpuSlots* Slots, uint32_t* Index)
+{
+	uint32_t Position = atomic_load_explicit(&Slots->Head, memory_order_relaxed);
+	for (;;)
+	{
+		CpuSlots__Cell* Cell = &Slots->Cells[Position & Slots->Mask];
+		uint32_t Sequence = atomic_load_explicit(&Cell->Sequence, memory_order_acquire);
+		int32_t Diff = (int32_t)(Sequence - (Position + 1));
+		if (Diff == 0)
+		{
+			if (atomic_compare_exchange_weak_explicit(&Slots->Head, &Position, Position + 1, memory_order_relaxed, memory_order_relaxed))
+			{
+				*Index = Cell->Index;
+				// cell can be reused when Tail wraps around to it
+				atomic_store_explicit(&Cell->Sequence, Position + Slots->Mask + 1, memory_order_release);
+				return true;
+			}
+		}
+		else if (Diff < 0)
+		{
+			// cell is not recycled yet, nothing is free
+			return false;
+		}
+		else
+		{
+			// other thread acquired this cell
+			Position = atomic_load_explicit(&Slots->Head, memory_order_relaxed);
+		}
+	}
+}
+
+uint32_t CpuSlots_Acquire(CpuSlots* Slots)
+{
+	uint32_t Index;
+	while (!CpuSlots_TryAcquire(Slots, &Index))
+	{
+		uint32_t Signal = atomic_load(&Slots->Signal);
+		atomic_fetch_add(&Slots->Waiters, 1);
+
+		// after Waiters is visible, recycling thread either sees it & increments Signal, or this try sees recycled slot
+		atomic_thread_fence(memory_order_seq_cst);
+		bool Acquired = CpuSlots_TryAcquire(Slots, &Index);
+		if (!Acquired)
+		{
+			Cpu_Wait(&Slots->Signal, Signal);
+		}
+
+		atomic_fetch_sub(&Slots->Waiters, 1);
+		if (Acquired)
+		{
+			break;
+		}
+	}
+	return Index;
+}
+
+void CpuSlots_Recycle(CpuSlots* Slots, uint32_t Index)
+{
+	Assert(Index < Slots->Count);
+
+	uint32_t Position = atomic_load_explicit(&Slots->Tail, memory_order_relaxed);
+	for (;;)
+	{
+		CpuSlots__Cell* Cell = &Slots->Cells[Position & Slots->Mask];
+		uint32_t Sequence = atomic_load_explicit(&Cell->Sequence, memory_order_acquire);
+		int32_t Diff = (int32_t)(Sequence - Position);
+		if (Diff == 0)
+		{
+			if (atomic_compare_exchange_weak_explicit(&Slots->Tail, &Position, Position + 1, memory_order_relaxed, memory_order_relaxed))
+			{
+				Cell->Index = Index;
+				atomic_store_explicit(&Cell->Sequence, Position + 1, memory_order_release);
+				break;
+			}
+		}
+		else
+		{
+			// ring has space for all slots, so cell is either recycled by other thread or still being acquired
+			Position = atomic_load_explicit(&Slots->Tail, memory_order_relaxed);
+		}
+	}
+
+	atomic_thread_fence(memory_order_seq_cst);
+	if (atomic_load_explicit(&Slots->Waiters, memory_order_relaxed) != 0)
+	{
+		atomic_fetch_add(&Slots->Signal, 1);
+		Cpu_WakeAll(&Slots->Signal);
+	}
+}
+
+uint32_t CpuSlots_GetFreeCount(CpuSlots* Slots)
+{
+	// counters are loaded separately, so difference can be briefly out of range
+	uint32_t Head = atomic_load(&Slots->Head);
+	uint32_t Tail = atomic_load(&Slots->Tail);
+	int32_t Count = (int32_t)(Tail - Head);
+	return Count < 0 ? 0 : (uint32_t)Count < Slots->Count ? (uint32_t)Count : Slots->Count;
+}
+
+void CpuSlots_SetUsers(CpuSlots* Slots, uint32_t Index, uint32_t Users)
+{
+	Assert(Index < Slots->Count && Users != 0);
+	atomic_store_explicit(&Slots->Users[Index], Users, memory_order_release);
+}
+
+bool CpuSlots_Done(CpuSlots* Slots, uint32_t Index)
+{
+	Assert(Index < Slots->Count);
+
+	// acquire & release, so last user sees everything other users did with slot
+	uint32_t Users = atomic_fetch_sub_explicit(&Slots->Users[Index], 1, memory_order_acq_rel);
+	Assert(Users != 0);
+	return Users == 1;
+}
@@ -0,0 +1,359 @@
+#pragma once
+
+#include "wcap.h"
+#include "wcap_cpu_cursor.h"
+#include "wcap_yuv_convert.h"
+#include <d3d11.h>
+
+//
+// interface
+//
+
+// larger cursors are not drawn, Windows does not create cursors larger than this
+#define CURSOR_OVERLAY_MAX_SIZE 256
+
+typedef struct
+{
+	ID3D11Texture2D* InputTexture;         // not owned
+	ID3D11ShaderResourceView* InputView;
+	ID3D11Texture2D* Texture;              // input with cursor drawn on top, only tiles around cursor are up to date
+	ID3D11ShaderResourceView* TextureView;
+	ID3D11UnorderedAccessView* TextureOut;
+	ID3D11Texture2D* Cursor;
+	ID3D11ShaderResourceView* CursorView;
+	ID3D11ComputeShader* Shader;
+	ID3D11Buffer* ConstantBuffer;
+	ID3D11Buffer* Tiles;
+	ID3D11ShaderResourceView* TilesView;
+	uint8_t* Pixels;   // current cursor shape, see CpuCursor_Convert
+	HCURSOR Handle;    // current cursor shape handle
+	POINT Hotspot;
+	POINT Position;    // top-left corner of cursor in input
+	RECT Rect;         // visible part of cursor in input, empty when cursor is hidden
+	RECT LastRect;     // visible part of cursor in last converted output
+	uint32_t Width;    // cursor size, 0 when it cannot be drawn
+	uint32_t Height;
+	uint32_t InputWidth;
+	uint32_t InputHeight;
+	bool Upload;       // Pixels must be uploaded to Cursor texture
+}
+CursorOverlay;
+
+// draws mouse cursor on top of B8G8R8A8 input texture during YUV conversion, input texture itself is not modified
+// so cursor movement needs to convert only few tiles around it, instead of whole frame
+static void CursorOverlay_Create(CursorOverlay* Overlay, ID3D11Device* Device, ID3D11Texture2D* InputTexture, uint32_t Width, uint32_t Height);
+static void CursorOverlay_Release(CursorOverlay* Overlay);
+
+// reads current cursor shape & position, Origin is screen position of top-left input pixel
+// returns true if cursor looks different in input than before
+static bool CursorOverlay_Update(CursorOverlay* Overlay, POINT Origin);
+
+// converts tiles around previous & current cursor position to Output, with cursor drawn on top of input
+// rest of Output must be already converted from same input, any cursor in it must be at LastRect
+static void CursorOverlay_Dispatch(CursorOverlay* Overlay, ID3D11DeviceContext* Context, YuvConvert* Convert, YuvConvertOutput* Output);
+
+//
+// implementation
+//
+
+#include <d3dcompiler.h>
+
+#include "shaders/CursorBlend.h"
+
+// same tile size as YuvConvert_DispatchTiles uses, converter reads up to 3 pixels around each tile
+#define CURSOR_OVERLAY_TILE   32
+#define CURSOR_OVERLAY_MARGIN 4
+
+// tiles for previous & current cursor position
+#define CURSOR_OVERLAY_MAX_TILES (2 * (CURSOR_OVERLAY_MAX_SIZE / CURSOR_OVERLAY_TILE + 2) * (CURSOR_OVERLAY_MAX_SIZE / CURSOR_OVERLAY_TILE + 2))
+
+void CursorOverlay_Create(CursorOverlay* Overlay, ID3D11Device* Device, ID3D11Texture2D* InputTexture, uint32_t Width, uint32_t Height)
+{
+	*Overlay = (CursorOverlay)
+	{
+		.InputTexture = InputTexture,
+		.Pixels = Cpu_Alloc(CURSOR_OVERLAY_MAX_SIZE * CURSOR_OVERLAY_MAX_SIZE * 4),
+		.InputWidth = Width,
+		.InputHeight = Height,
+	};
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC ViewInDesc =
+	{
+		.Format = DXGI_FORMAT_B8G8R8A8_UNORM,
+		.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D,
+		.Texture2D.MipLevels = -1,
+	};
+	ID3D11Device_CreateShaderResourceView(Device, (ID3D11Resource*)InputTexture, &ViewInDesc, &Overlay->InputView);
+
+	D3D11_TEXTURE2D_DESC TextureDesc =
+	{
+		.Width = Width,
+		.Height = Height,
+		.MipLevels = 1,
+		.ArraySize = 1,
+		.Format = DXGI_FORMAT_B8G8R8A8_TYPELESS,
+		.SampleDesc = { 1, 0 },
+		.Usage = D3D11_USAGE_DEFAULT,
+		.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS,
+	};
+	ID3D11Device_CreateTexture2D(Device, &TextureDesc, NULL, &Overlay->Texture);
+	ID3D11Device_CreateShaderResourceView(Device, (ID3D11Resource*)Overlay->Texture, &ViewInDesc, &Overlay->TextureView);
+
+	// same as in TexResize, D3D 11.0 does not support B8G8R8A8 for UAV stores
+	D3D11_UNORDERED_ACCESS_VIEW_DESC ViewOutDesc =
+	{
+		.Format = DXGI_FORMAT_R32_UINT,
+		.ViewDimension = D3D11_UAV_DIMENSION_TEXTURE2D,
+		.Texture2D.MipSlice = 0,
+	};
+	ID3D11Device_CreateUnorderedAccessView(Device, (ID3D11Resource*)Overlay->Texture, &ViewOutDesc, &Overlay->TextureOut);
+
+	D3D11_TEXTURE2D_DESC CursorDesc =
+	{
+		.Width = CURSOR_OVERLAY_MAX_SIZE,
+		.Height = CURSOR_OVERLAY_MAX_SIZE,
+		.MipLevels = 1,
+		.ArraySize = 1,
+		.Format = DXGI_FORMAT_B8G8R8A8_UNORM,
+		.SampleDesc = { 1, 0 },
+		.Usage = D3D11_USAGE_DEFAULT,
+		.BindFlags = D3D11_BIND_SHADER_RESOURCE,
+	};
+	ID3D11Device_CreateTexture2D(Device, &CursorDesc, NULL, &Overlay->Cursor);
+	ID3D11Device_CreateShaderResourceView(Device, (ID3D11Resource*)Overlay->Cursor, NULL, &Overlay->CursorView);
+
+	D3D11_BUFFER_DESC ConstantBufferDesc =
+	{
+		.ByteWidth = 4 * sizeof(uint32_t),
+		.Usage = D3D11_USAGE_DEFAULT,
+		.BindFlags = D3D11_BIND_CONSTANT_BUFFER,
+	};
+	ID3D11Device_CreateBuffer(Device, &ConstantBufferDesc, NULL, &Overlay->ConstantBuffer);
+
+	D3D11_BUFFER_DESC TilesDesc =
+	{
+		.ByteWidth = CURSOR_OVERLAY_MAX_TILES * sizeof(uint32_t),
+		.Usage = D3D11_USAGE_DEFAULT,
+		.BindFlags = D3D11_BIND_SHADER_RESOURCE,
+		.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED,
+		.StructureByteStride = sizeof(uint32_t),
+	};
+	ID3D11Device_CreateBuffer(Device, &TilesDesc, NULL, &Overlay->Tiles);
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC TilesViewDesc =
+	{
+		.Format = DXGI_FORMAT_UNKNOWN,
+		.ViewDimension = D3D11_SRV_DIMENSION_BUFFER,
+		.Buffer.NumElements = CURSOR_OVERLAY_MAX_TILES,
+	};
+	ID3D11Device_CreateShaderResourceView(Device, (ID3D11Resource*)Overlay->Tiles, &TilesViewDesc, &Overlay->TilesView);
+
+	ID3DBlob* Shader;
+	HR(D3DDecompressShaders(CursorBlendShaderBytes, sizeof(CursorBlendShaderBytes), 1, 0, NULL, 0, &Shader, NULL));
+	ID3D11Device_CreateComputeShader(Device, ID3D10Blob_GetBufferPointer(Shader), ID3D10Blob_GetBufferSize(Shader), NULL, &Overlay->Shader);
+	ID3D10Blob_Release(Shader);
+}
+
+void CursorOverlay_Release(CursorOverlay* Overlay)
+{
+	ID3D11ShaderResourceView_Release(Overlay->InputView);
+	ID3D11ShaderResourceView_Release(Overlay->TextureView);
+	ID3D11UnorderedAccessView_Release(Overlay->TextureOut);
+	ID3D11Texture2D_Release(Overlay->Texture);
+	ID3D11ShaderResourceView_Release(Overlay->CursorView);
+	ID3D11Texture2D_Release(Overlay->Cursor);
+	ID3D11ComputeShader_Release(Overlay->Shader);
+	ID3D11Buffer_Release(Overlay->ConstantBuffer);
+	ID3D11ShaderResourceView_Release(Overlay->TilesView);
+	ID3D11Buffer_Release(Overlay->Tiles);
+	Cpu_Free(Overlay->Pixels);
+}
+
+static void CursorOverlay__LoadShape(CursorOverlay* Overlay, HCURSOR Cursor)
+{
+	Overlay->Width = 0;
+	Overlay->Height = 0;
+
+	ICONINFO Info;
+	if (!GetIconInfo(Cursor, &Info))
+	{
+		return;
+	}
+
+	BITMAP Mask;
+	GetObjectW(Info.hbmMask, sizeof(Mask), &Mask);
+
+	// monochrome cursor has AND & XOR masks in one bitmap of double height
+	uint32_t Width = Mask.bmWidth;
+	uint32_t Height = Info.hbmColor ? Mask.bmHeight : Mask.bmHeight / 2;
+	size_t MaskPitch = DIV_ROUND_UP(Width, 32) * 4;
+	size_t ColorPitch = Width * 4;
+
+	if (Width <= CURSOR_OVERLAY_MAX_SIZE && Height <= CURSOR_OVERLAY_MAX_SIZE)
+	{
+		uint8_t* MaskBits = Cpu_Alloc(MaskPitch * Mask.bmHeight + ColorPitch * Height);
+		uint8_t* ColorBits = Info.hbmColor ? MaskBits + MaskPitch * Mask.bmHeight : NULL;
+
+		struct
+		{
+			BITMAPINFOHEADER Header;
+			RGBQUAD Palette[2];
+		}
+		BitmapInfo =
+		{
+			.Header =
+			{
+				.biSize = sizeof(BitmapInfo.Header),
+				.biWidth = Width,
+				.biHeight = -Mask.bmHeight, // top-down rows
+				.biPlanes = 1,
+				.biBitCount = 1,
+				.biCompression = BI_RGB,
+			},
+		};
+
+		HDC DeviceContext = GetDC(NULL);
+		bool Loaded = GetDIBits(DeviceContext, Info.hbmMask, 0, Mask.bmHeight, MaskBits, (BITMAPINFO*)&BitmapInfo, DIB_RGB_COLORS) == Mask.bmHeight;
+		if (Loaded && ColorBits)
+		{
+			BitmapInfo.Header.biHeight = -(LONG)Height;
+			BitmapInfo.Header.biBitCount = 32;
+			Loaded = GetDIBits(DeviceContext, Info.hbmColor, 0, Height, ColorBits, (BITMAPINFO*)&BitmapInfo, DIB_RGB_COLORS) == (int)Height;
+		}
+		ReleaseDC(NULL, DeviceContext);
+
+		if (Loaded)
+		{
+			CpuCursor_Convert(Overlay->Pixels, ColorBits, ColorPitch, MaskBits, MaskPitch, Width, Height);
+			Overlay->Width = Width;
+			Overlay->Height = Height;
+			Overlay->Hotspot = (POINT) { Info.xHotspot, Info.yHotspot };
+			Overlay->Upload = true;
+		}
+		Cpu_Free(MaskBits);
+	}
+
+	DeleteObject(Info.hbmMask);
+	if (Info.hbmColor)
+	{
+		DeleteObject(Info.hbmColor);
+	}
+}
+
+bool CursorOverlay_Update(CursorOverlay* Overlay, POINT Origin)
+{
+	CURSORINFO Info = { .cbSize = sizeof(Info) };
+	bool Visible = GetCursorInfo(&Info) && (Info.flags & CURSOR_SHOWING) && Info.hCursor;
+
+	// animated cursors keep same handle, only their first frame is drawn
+	bool NewShape = Visible && Info.hCursor != Overlay->Handle;
+	if (NewShape)
+	{
+		CursorOverlay__LoadShape(Overlay, Info.hCursor);
+		Overlay->Handle = Info.hCursor;
+	}
+
+	POINT Position =
+	{
+		Info.ptScreenPos.x - Overlay->Hotspot.x - Origin.x,
+		Info.ptScreenPos.y - Overlay->Hotspot.y - Origin.y,
+	};
+
+	RECT Rect = { 0 };
+	if (Visible && Overlay->Width)
+	{
+		RECT Cursor = { Position.x, Position.y, Position.x + (LONG)Overlay->Width, Position.y + (LONG)Overlay->Height };
+		RECT Input = { 0, 0, (LONG)Overlay->InputWidth, (LONG)Overlay->InputHeight };
+		IntersectRect(&Rect, &Cursor, &Input);
+	}
+
+	bool Moved = Position.x != Overlay->Position.x || Position.y != Overlay->Position.y;
+	bool Changed = !EqualRect(&Rect, &Overlay->Rect) || (!IsRectEmpty(&Rect) && (NewShape || Moved));
+
+	Overlay->Position = Position;
+	Overlay->Rect = Rect;
+	return Changed;
+}
+
+// adds tiles that read pixels of Rect to Tiles, unless they are inside Skip tile range
+static uint32_t CursorOverlay__AddTiles(CursorOverlay* Overlay, ID3D11DeviceContext* Context, const RECT* Rect, RECT* TileRect, const RECT* Skip, uint32_t* Tiles, uint32_t TileCount)
+{
+	*TileRect = (RECT) { 0 };
+	if (IsRectEmpty(Rect))
+	{
+		return TileCount;
+	}
+
+	TileRect->left = max(Rect->left - CURSOR_OVERLAY_MARGIN, 0) / CURSOR_OVERLAY_TILE;
+	TileRect->top = max(Rect->top - CURSOR_OVERLAY_MARGIN, 0) / CURSOR_OVERLAY_TILE;
+	TileRect->right = DIV_ROUND_UP(min(Rect->right + CURSOR_OVERLAY_MARGIN, (LONG)Overlay->InputWidth), CURSOR_OVERLAY_TILE);
+	TileRect->bottom = DIV_ROUND_UP(min(Rect->bottom + CURSOR_OVERLAY_MARGIN, (LONG)Overlay->InputHeight), CURSOR_OVERLAY_TILE);
+
+	// copy input pixels that converter reads for these tiles
+	D3D11_BOX Box =
+	{
+		.left = max(TileRect->left * CURSOR_OVERLAY_TILE - CURSOR_OVERLAY_MARGIN, 0),
+		.top = max(TileRect->top * CURSOR_OVERLAY_TILE - CURSOR_OVERLAY_MARGIN, 0),
+		.right = min(TileRect->right * CURSOR_OVERLAY_TILE + CURSOR_OVERLAY_MARGIN, (LONG)Overlay->InputWidth),
+		.bottom = min(TileRect->bottom * CURSOR_OVERLAY_TILE + CURSOR_OVERLAY_MARGIN, (LONG)Overlay->InputHeight),
+		.front = 0,
+		.back = 1,
+	};
+	ID3D11DeviceContext_CopySubresourceRegion(Context, (ID3D11Resource*)Overlay->Texture, 0, Box.left, Box.top, 0, (ID3D11Resource*)Overlay->InputTexture, 0, &Box);
+
+	for (LONG Y = TileRect->top; Y < TileRect->bottom; Y++)
+	{
+		for (LONG X = TileRect->left; X < TileRect->right; X++)
+		{
+			POINT Tile = { X, Y };
+			if (!PtInRect(Skip, Tile))
+			{
+				Assert(TileCount < CURSOR_OVERLAY_MAX_TILES);
+				Tiles[TileCount++] = (Y << 16) | X;
+			}
+		}
+	}
+	return TileCount;
+}
+
+void CursorOverlay_Dispatch(CursorOverlay* Overlay, ID3D11DeviceContext* Context, YuvConvert* Convert, YuvConvertOutput* Output)
+{
+	if (Overlay->Upload)
+	{
+		D3D11_BOX Box = { .right = Overlay->Width, .bottom = Overlay->Height, .back = 1 };
+		ID3D11DeviceContext_UpdateSubresource(Context, (ID3D11Resource*)Overlay->Cursor, 0, &Box, Overlay->Pixels, Overlay->Width * 4, 0);
+		Overlay->Upload = false;
+	}
+
+	// previous cursor is erased by converting its tiles from clean input
+	uint32_t Tiles[CURSOR_OVERLAY_MAX_TILES];
+	RECT LastTiles, CurrentTiles;
+	uint32_t TileCount = CursorOverlay__AddTiles(Overlay, Context, &Overlay->LastRect, &LastTiles, &(RECT) { 0 }, Tiles, 0);
+	TileCount = CursorOverlay__AddTiles(Overlay, Context, &Overlay->Rect, &CurrentTiles, &LastTiles, Tiles, TileCount);
+	Overlay->LastRect = Overlay->Rect;
+
+	if (TileCount == 0)
+	{
+		return;
+	}
+
+	if (!IsRectEmpty(&Overlay->Rect))
+	{
+		int32_t Position[4] = { Overlay->Position.x, Overlay->Position.y, (int32_t)Overlay->Width, (int32_t)Overlay->Height };
+		ID3D11DeviceContext_UpdateSubresource(Context, (ID3D11Resource*)Overlay->ConstantBuffer, 0, NULL, Position, 0, 0);
+
+		ID3D11ShaderResourceView* InputViews[] = { Overlay->CursorView, Overlay->InputView };
+
+		ID3D11DeviceContext_ClearState(Context);
+		ID3D11DeviceContext_CSSetShader(Context, Overlay->Shader, NULL, 0);
+		ID3D11DeviceContext_CSSetConstantBuffers(Context, 0, 1, &Overlay->ConstantBuffer);
+		ID3D11DeviceContext_CSSetShaderResources(Context, 0, ARRAYSIZE(InputViews), InputViews);
+		ID3D11DeviceContext_CSSetUnorderedAccessViews(Context, 0, 1, &Overlay->TextureOut, NULL);
+		ID3D11DeviceContext_Dispatch(Context, DIV_ROUND_UP(Overlay->Width, 16), DIV_ROUND_UP(Overlay->Height, 16), 1);
+	}
+
+	D3D11_BOX Box = { .right = TileCount * sizeof(uint32_t), .bottom = 1, .back = 1 };
+	ID3D11DeviceContext_UpdateSubresource(Context, (ID3D11Resource*)Overlay->Tiles, 0, &Box, Tiles, 0, 0);
+
+	YuvConvert_DispatchTiles(Convert, Context, Output, Overlay->TextureView, Overlay->TilesView, TileCount);
+}
@@ -4,6 +4,12 @@
 #include "wcap_config.h"
 #include "wcap_tex_resize.h"
 #include "wcap_yuv_convert.h"
+#include "wcap_frame_hash.h"
+#include "wcap_cpu_rate.h"
+#include "wcap_cpu_scene.h"
+#include "wcap_cpu_slots.h"
+#include "wcap_cpu_drop.h"
+#include "wcap_cursor_overlay.h"
 
 #include <d3d11_4.h>
 #include <mfidl.h>
@@ -16,6 +22,29 @@
 #define ENCODER_VIDEO_BUFFER_COUNT 8
 #define ENCODER_AUDIO_BUFFER_COUNT 16
 
+// max extra outputs encoding same frames at other size or bitrate
+#define ENCODER_MAX_BRANCHES 2
+
+// min msec between keyframes forced by scene change
+#define ENCODER_SCENE_INTERVAL     1000
+
+// extra output with its own size & file, it uses same input texture & buffer slots as main output
+typedef struct
+{
+	DWORD OutputWidth;
+	DWORD OutputHeight;
+	IMFSinkWriter* Writer;
+	int VideoStreamIndex;
+	int AudioStreamIndex;
+	ICodecAPI* VideoCodec; // only for forcing keyframes
+
+	TexResize Resize; // reads Encoder.Resize.InputTexture
+	YuvConvert Convert;
+	YuvConvertOutput ConvertOutput[ENCODER_VIDEO_BUFFER_COUNT];
+	IMFSample*       VideoSample[ENCODER_VIDEO_BUFFER_COUNT];
+}
+EncoderBranch;
+
 typedef struct
 {
 	DWORD InputWidth;   // width to what input will be cropped
@@ -28,6 +57,7 @@ typedef struct
 
 	IMFAsyncCallback VideoSampleCallback;
 	IMFAsyncCallback AudioSampleCallback;
+	_Atomic(uint32_t) SampleCallbacks; // sample callbacks running on work queue threads right now
 	ID3D11DeviceContext* Context;
 	ID3D11Multithread* Multithread;
 	IMFSinkWriter* Writer;
@@ -38,17 +68,45 @@ typedef struct
 
 	TexResize Resize;
 	YuvConvert Convert;
-
+	FrameHash Hash;
+	BOOL HashFrames; // Hash is used for skipping duplicates or scene change detection
+	BOOL SkipDuplicates;
+	BOOL AdaptiveFramerate;
+	BOOL SceneKeyframes;
+	CpuScene Scene;
+	ICodecAPI* VideoCodec; // only for forcing keyframes
+	BOOL CursorOverlay;    // mouse cursor is drawn by Cursor instead of being captured
+	CursorOverlay Cursor;
+
+	EncoderBranch Branch[ENCODER_MAX_BRANCHES];
+	DWORD BranchCount;
+
+	// buffer slot Index is used by ConvertOutput[Index] of main output and all branches at same time
 	YuvConvertOutput  ConvertOutput[ENCODER_VIDEO_BUFFER_COUNT];
 	IMFSample*        VideoSample[ENCODER_VIDEO_BUFFER_COUNT];
-	_Atomic(uint64_t) VideoSampleAvailable;
+	CpuSlots          VideoSampleAvailable;                        // slot users are outputs that have not returned sample yet
+	UINT64            VideoSubmitTime[ENCODER_VIDEO_BUFFER_COUNT]; // QPC time when sample was written to encoder, 0 if not
+	UINT64            VideoReturnTime[ENCODER_VIDEO_BUFFER_COUNT]; // QPC time when encoder returned it
+	CpuDrop           Drop;
 
 	BOOL   VideoDiscontinuity;
 	UINT64 VideoLastTime;
 
+	DWORD VideoPendingIndex;   // when skipping duplicates, sample is written when next frame arrives to know its duration
+	DWORD VideoDuplicateCount; // frames not encoded because they were same as previous one
+	DWORD VideoLastIndex;      // ConvertOutput with last converted frame, for converting only changed tiles
+	UINT64 VideoHashFrame;     // Hash.Frames when input was converted last time
+	DWORD VideoStaticCount;    // changed frames not encoded because of adaptive framerate
+	BOOL VideoSkippedChange;   // input texture has changes that are not encoded yet
+	CpuRate VideoRate;         // adaptive framerate, also time when skipped changes are encoded
+	UINT64 VideoLastKeyframe;  // time of last keyframe forced by scene change
+	BOOL VideoKeyframe;        // next encoded frame must be keyframe
+	BOOL VideoPendingKeyframe; // pending sample must be keyframe
+	BOOL VideoCursorChanged;   // cursor has changes that are not encoded yet
+
 	IMFTransform*     Resampler;
 	IMFSample*        AudioSample[ENCODER_AUDIO_BUFFER_COUNT];
-	_Atomic(uint64_t) AudioSampleAvailable;
+	CpuSlots          AudioSampleAvailable;
 
 	IMFSample*      AudioInputSample;
 	DWORD           AudioFrameSize;
@@ -56,14 +114,27 @@ typedef struct
 }
 Encoder;
 
+typedef struct
+{
+	LPCWSTR FileName;
+	DWORD MaxWidth;  // 0 to not limit
+	DWORD MaxHeight; // 0 to not limit
+	DWORD Bitrate;   // kbit/s
+}
+EncoderBranchConfig;
+
 typedef struct
 {
 	DWORD Width;
 	DWORD Height;
 	DWORD FramerateNum;
 	DWORD FramerateDen;
+	bool HdrInput; // frames are R16G16B16A16_FLOAT scRGB, encoded as BT.2020 with PQ transfer function in 10-bit
+	bool CursorOverlay; // draw mouse cursor on top of frames, check Encoder.CursorOverlay after start if it can be done
 	WAVEFORMATEX* AudioFormat;
 	Config* Config;
+	EncoderBranchConfig Branches[ENCODER_MAX_BRANCHES]; // extra outputs, not used for HDR input
+	DWORD BranchCount;
 }
 EncoderConfig;
 
@@ -71,9 +142,16 @@ static void Encoder_Init(Encoder* Encoder);
 static BOOL Encoder_Start(Encoder* Encoder, ID3D11Device* Device, LPWSTR FileName, const EncoderConfig* Config);
 static void Encoder_Stop(Encoder* Encoder);
 
-static BOOL Encoder_NewFrame(Encoder* Encoder, ID3D11Texture2D* Texture, RECT Rect, UINT64 Time, UINT64 TimePeriod);
+// Queued is count of newer frames already waiting for NewFrame call, used by drop policy
+static BOOL Encoder_NewFrame(Encoder* Encoder, ID3D11Texture2D* Texture, RECT Rect, DWORD Queued, UINT64 Time, UINT64 TimePeriod);
 static void Encoder_NewSamples(Encoder* Encoder, LPCVOID Samples, DWORD FrameCount, UINT64 Time, UINT64 TimePeriod);
 static void Encoder_Update(Encoder* Encoder, UINT64 Time, UINT64 TimePeriod);
+
+// with cursor overlay reads cursor shape & position, Origin is screen position of top-left pixel in frame Rect
+// if only cursor has changed since last frame, it encodes previous frame again with only tiles around cursor converted
+static void Encoder_UpdateCursor(Encoder* Encoder, POINT Origin, UINT64 Time, UINT64 TimePeriod);
+
+// stats are only for main output
 static void Encoder_GetStats(Encoder* Encoder, DWORD* Bitrate, DWORD* LengthMsec, UINT64* FileSize);
 
 //
@@ -123,6 +201,7 @@ static HRESULT STDMETHODCALLTYPE Encoder__GetParameters(IMFAsyncCallback* this,
 static HRESULT STDMETHODCALLTYPE Encoder__VideoInvoke(IMFAsyncCallback* this, IMFAsyncResult* Result)
 {
 	Encoder* Enc = CONTAINING_RECORD(this, Encoder, VideoSampleCallback);
+	atomic_fetch_add(&Enc->SampleCallbacks, 1);
 
 	IUnknown* Object;
 	IMFSample* Sample;
@@ -132,22 +211,36 @@ static HRESULT STDMETHODCALLTYPE Encoder__VideoInvoke(IMFAsyncCallback* this, IM
 	IUnknown_Release(Object);
 	// keep Sample object reference count incremented to reuse for new frame submission
 
-	for (size_t Index = 0; Index < ARRAYSIZE(Enc->VideoSample); Index++)
+	for (uint32_t Index = 0; Index < ARRAYSIZE(Enc->VideoSample); Index++)
 	{
-		if (Sample == Enc->VideoSample[Index])
+		BOOL Found = Sample == Enc->VideoSample[Index];
+		for (DWORD BranchIndex = 0; !Found && BranchIndex < Enc->BranchCount; BranchIndex++)
+		{
+			Found = Sample == Enc->Branch[BranchIndex].VideoSample[Index];
+		}
+
+		// slot is free only after encoders of all outputs have returned their sample
+		if (Found && CpuSlots_Done(&Enc->VideoSampleAvailable, Index))
+		{
+			LARGE_INTEGER Time;
+			QueryPerformanceCounter(&Time);
+			Enc->VideoReturnTime[Index] = Time.QuadPart;
+			CpuSlots_Recycle(&Enc->VideoSampleAvailable, Index);
+		}
+		if (Found)
 		{
-			atomic_fetch_or(&Enc->VideoSampleAvailable, 1ULL << Index);
-			WakeByAddressSingle((PVOID)&Enc->VideoSampleAvailable);
 			break;
 		}
 	}
 
+	atomic_fetch_sub(&Enc->SampleCallbacks, 1);
 	return S_OK;
 }
 
 static HRESULT STDMETHODCALLTYPE Encoder__AudioInvoke(IMFAsyncCallback* this, IMFAsyncResult* Result)
 {
 	Encoder* Enc = CONTAINING_RECORD(this, Encoder, AudioSampleCallback);
+	atomic_fetch_add(&Enc->SampleCallbacks, 1);
 
 	IUnknown* Object;
 	IMFSample* Sample;
@@ -157,16 +250,16 @@ static HRESULT STDMETHODCALLTYPE Encoder__AudioInvoke(IMFAsyncCallback* this, IM
 	IUnknown_Release(Object);
 	// keep Sample object reference count incremented to reuse for new sample submission
 
-	for (size_t Index = 0; Index < ARRAYSIZE(Enc->AudioSample); Index++)
+	for (uint32_t Index = 0; Index < ARRAYSIZE(Enc->AudioSample); Index++)
 	{
 		if (Sample == Enc->AudioSample[Index])
 		{
-			atomic_fetch_or(&Enc->AudioSampleAvailable, 1ULL << Index);
-			WakeByAddressSingle((PVOID)&Enc->AudioSampleAvailable);
+			CpuSlots_Recycle(&Enc->AudioSampleAvailable, Index);
 			break;
 		}
 	}
 
+	atomic_fetch_sub(&Enc->SampleCallbacks, 1);
 	return S_OK;
 }
 
@@ -193,16 +286,7 @@ static void Encoder__OutputAudioSamples(Encoder* Encoder)
 	for (;;)
 	{
 		// we don't want to drop any audio frames, so wait for available sample/buffer
-		uint64_t Available = atomic_load(&Encoder->AudioSampleAvailable);
-		while (Available == 0)
-		{
-			uint64_t Zero = 0;
-			WaitOnAddress((PVOID)&Encoder->AudioSampleAvailable, &Zero, sizeof(Zero), INFINITE);
-			Available = atomic_load(&Encoder->AudioSampleAvailable);
-		}
-
-		DWORD Index;
-		_BitScanForward64(&Index, Available);
+		uint32_t Index = CpuSlots_Acquire(&Encoder->AudioSampleAvailable);
 
 		IMFSample* Sample = Encoder->AudioSample[Index];
 
@@ -212,17 +296,22 @@ static void Encoder__OutputAudioSamples(Encoder* Encoder)
 		if (hr == MF_E_TRANSFORM_NEED_MORE_INPUT)
 		{
 			// no output is available
+			CpuSlots_Recycle(&Encoder->AudioSampleAvailable, Index);
 			break;
 		}
 		Assert(SUCCEEDED(hr));
 
-		atomic_fetch_and(&Encoder->AudioSampleAvailable, ~(1ULL << Index));
-
 		IMFTrackedSample* Tracked;
 		HR(IMFSample_QueryInterface(Sample, &IID_IMFTrackedSample, (LPVOID*)&Tracked));
 		HR(IMFTrackedSample_SetAllocator(Tracked, &Encoder->AudioSampleCallback, (IUnknown*)Tracked));
 
+		// same sample goes to every output, it is returned after all of them release it
 		HR(IMFSinkWriter_WriteSample(Encoder->Writer, Encoder->AudioStreamIndex, Sample));
+		for (DWORD BranchIndex = 0; BranchIndex < Encoder->BranchCount; BranchIndex++)
+		{
+			EncoderBranch* Branch = &Encoder->Branch[BranchIndex];
+			HR(IMFSinkWriter_WriteSample(Branch->Writer, Branch->AudioStreamIndex, Sample));
+		}
 
 		IMFSample_Release(Sample);
 		IMFTrackedSample_Release(Tracked);
@@ -236,22 +325,20 @@ void Encoder_Init(Encoder* Encoder)
 	Encoder->AudioSampleCallback.lpVtbl = &Encoder__AudioSampleCallbackVtbl;
 }
 
-BOOL Encoder_Start(Encoder* Encoder, ID3D11Device* Device, LPWSTR FileName, const EncoderConfig* Config)
+typedef struct
 {
-	ID3D11DeviceContext* Context;
-	ID3D11Device_GetImmediateContext(Device, &Context);
-
-	ID3D11Multithread* Multithread;
-
-	// it is very unclear if this is needed or not, it used to be that D3D11 debug runtime
-	// was complaining if this is not done, but nowadays it doesn't complain anymore? very confusing
-	HR(ID3D11DeviceContext_QueryInterface(Context, &IID_ID3D11Multithread, &Multithread));
-	ID3D11Multithread_SetMultithreadProtected(Multithread, TRUE);
+	const GUID* Container;
+	const GUID* Codec;
+	UINT32 Profile;
+	const GUID* VideoInputFormat;
+}
+Encoder__Format;
 
-	DWORD InputWidth = Config->Width;
-	DWORD InputHeight = Config->Height;
-	DWORD OutputWidth = Config->Config->VideoMaxWidth;
-	DWORD OutputHeight = Config->Config->VideoMaxHeight;
+// size of output that fits in MaxWidth & MaxHeight keeping aspect ratio, 0 means that side is not limited
+static void Encoder__GetOutputSize(DWORD InputWidth, DWORD InputHeight, DWORD MaxWidth, DWORD MaxHeight, DWORD* Width, DWORD* Height)
+{
+	DWORD OutputWidth = MaxWidth;
+	DWORD OutputHeight = MaxHeight;
 
 	if (OutputWidth != 0 && OutputHeight == 0)
 	{
@@ -315,125 +402,28 @@ BOOL Encoder_Start(Encoder* Encoder, ID3D11Device* Device, LPWSTR FileName, cons
 	}
 
 	// must be multiple of 2, round upwards
-	InputWidth = (InputWidth + 1) & ~1;
-	InputHeight = (InputHeight + 1) & ~1;
-	OutputWidth = (OutputWidth + 1) & ~1;
-	OutputHeight = (OutputHeight + 1) & ~1;
+	*Width = (OutputWidth + 1) & ~1;
+	*Height = (OutputHeight + 1) & ~1;
+}
 
-	BOOL Result = FALSE;
+// https://github.com/mpv-player/mpv/blob/release/0.38/video/csputils.c#L150-L153
+static bool Encoder__IsHD(const EncoderConfig* Config, DWORD Width, DWORD Height)
+{
+	return (Width >= 1280) || (Height > 576)
+		|| Config->Config->VideoCodec == CONFIG_VIDEO_H265
+		|| Config->Config->VideoCodec == CONFIG_VIDEO_AV1;
+}
+
+// creates mp4 file with video stream & audio stream when Config has AudioFormat, returns NULL on failure
+static IMFSinkWriter* Encoder__CreateWriter(ID3D11Device* Device, LPCWSTR FileName, const EncoderConfig* Config, const Encoder__Format* Format, DWORD Width, DWORD Height, DWORD Bitrate, int* VideoStreamIndex, int* AudioStreamIndex)
+{
 	IMFSinkWriter* Writer = NULL;
-	IMFTransform* Resampler = NULL;
 	HRESULT hr;
 
-	Encoder->VideoStreamIndex = -1;
-	Encoder->AudioStreamIndex = -1;
-
-	const GUID* Container;
-	const GUID* Codec;
-	UINT32 Profile;
-	const GUID* VideoInputFormat;
-	if (Config->Config->VideoCodec == CONFIG_VIDEO_H264)
-	{
-		VideoInputFormat = &MFVideoFormat_NV12;
-		Container = Config->Config->FragmentedOutput ? &MFTranscodeContainerType_FMPEG4 : &MFTranscodeContainerType_MPEG4;
-		Codec = &MFVideoFormat_H264;
-		Profile = ((UINT32[]) { eAVEncH264VProfile_Base, eAVEncH264VProfile_Main, eAVEncH264VProfile_High })[Config->Config->VideoProfile];
-	}
-	else if (Config->Config->VideoCodec == CONFIG_VIDEO_H265 && Config->Config->VideoProfile == CONFIG_VIDEO_MAIN)
-	{
-		VideoInputFormat = &MFVideoFormat_NV12;
-		Container = &MFTranscodeContainerType_MPEG4;
-		Codec = &MFVideoFormat_HEVC;
-		Profile = eAVEncH265VProfile_Main_420_8;
-	}
-	else if (Config->Config->VideoCodec == CONFIG_VIDEO_H265 && Config->Config->VideoProfile == CONFIG_VIDEO_MAIN_10)
-	{
-		VideoInputFormat = &MFVideoFormat_P010;
-		Container = &MFTranscodeContainerType_MPEG4;
-		Codec = &MFVideoFormat_HEVC;
-		Profile = eAVEncH265VProfile_Main_420_10;
-	}
-	else if (Config->Config->VideoCodec == CONFIG_VIDEO_AV1 && Config->Config->VideoProfile == CONFIG_VIDEO_MAIN)
-	{
-		VideoInputFormat = &MFVideoFormat_NV12;
-		Container = &MFTranscodeContainerType_MPEG4;
-		Codec = &MFVideoFormat_AV1;
-		Profile = eAVEncAV1VProfile_Main_420_8;
-	}
-	else if (Config->Config->VideoCodec == CONFIG_VIDEO_AV1 && Config->Config->VideoProfile == CONFIG_VIDEO_MAIN_10)
-	{
-		VideoInputFormat = &MFVideoFormat_P010;
-		Container = &MFTranscodeContainerType_MPEG4;
-		Codec = &MFVideoFormat_AV1;
-		Profile = eAVEncAV1VProfile_Main_420_10;
-	}
-	else
-	{
-		Assert(0);
-	}
-
-	// make sure MFT video encoder exists, some vendors wrongly allow SinkWriter to be created for invalid configuration
-	{
-		bool Ok = false;
-
-		MFT_REGISTER_TYPE_INFO InputType = { MFMediaType_Video, *VideoInputFormat };
-		MFT_REGISTER_TYPE_INFO OutputType = { MFMediaType_Video, *Codec };
-
-		IMFAttributes* EnumAttributes;
-		HR(MFCreateAttributes(&EnumAttributes, 1));
-
-		UINT32 Flags = MFT_ENUM_FLAG_SORTANDFILTER;
-
-		if (Config->Config->HardwareEncoder)
-		{
-			IDXGIDevice* DxgiDevice;
-			HR(ID3D11Device_QueryInterface(Device, &IID_IDXGIDevice, (void**)&DxgiDevice));
-
-			IDXGIAdapter* DxgiAdapter;
-			HR(IDXGIDevice_GetAdapter(DxgiDevice, &DxgiAdapter));
-			IDXGIDevice_Release(DxgiDevice);
-
-			DXGI_ADAPTER_DESC AdapterDesc;
-			IDXGIAdapter_GetDesc(DxgiAdapter, &AdapterDesc);
-			IDXGIAdapter_Release(DxgiAdapter);
-
-			HR(IMFAttributes_SetBlob(EnumAttributes, &MFT_ENUM_ADAPTER_LUID, (UINT8*)&AdapterDesc.AdapterLuid, sizeof(AdapterDesc.AdapterLuid)));
-
-			Flags |= MFT_ENUM_FLAG_ASYNCMFT | MFT_ENUM_FLAG_HARDWARE;
-		}
-		else
-		{
-			Flags |= MFT_ENUM_FLAG_SYNCMFT;
-		}
-
-		UINT32 ActivateCount = 0;
-		IMFActivate** Activate = NULL;
-		if (SUCCEEDED(MFTEnum2(MFT_CATEGORY_VIDEO_ENCODER, Flags, &InputType, &OutputType, EnumAttributes, &Activate, &ActivateCount)) && ActivateCount != 0)
-		{
-			Ok = true;
-		}
-
-		if (Activate)
-		{
-			for (size_t ActivateIndex = 0; ActivateIndex != ActivateCount; ActivateIndex++)
-			{
-				IMFActivate_Release(Activate[ActivateIndex]);
-			}
-			CoTaskMemFree(Activate);
-		}
-		IMFAttributes_Release(EnumAttributes);
-
-		if (!Ok)
-		{
-			MessageBoxW(NULL, L"Cannot find video encoder!", WCAP_TITLE, MB_ICONERROR);
-			goto bail;
-		}
-	}
+	*VideoStreamIndex = -1;
+	*AudioStreamIndex = -1;
 
-	// https://github.com/mpv-player/mpv/blob/release/0.38/video/csputils.c#L150-L153
-	bool IsHD = (OutputWidth >= 1280) || (OutputHeight > 576)
-		|| Config->Config->VideoCodec == CONFIG_VIDEO_H265
-		|| Config->Config->VideoCodec == CONFIG_VIDEO_AV1;
+	bool IsHD = Encoder__IsHD(Config, Width, Height);
 
 	// output file
 	{
@@ -452,7 +442,7 @@ BOOL Encoder_Start(Encoder* Encoder, ID3D11Device* Device, LPWSTR FileName, cons
 			IMFDXGIDeviceManager_Release(Manager);
 		}
 		HR(IMFAttributes_SetUINT32(Attributes, &MF_SINK_WRITER_DISABLE_THROTTLING, TRUE));
-		HR(IMFAttributes_SetGUID(Attributes, &MF_TRANSCODE_CONTAINERTYPE, Container));
+		HR(IMFAttributes_SetGUID(Attributes, &MF_TRANSCODE_CONTAINERTYPE, Format->Container));
 
 		hr = MFCreateSinkWriterFromURL(FileName, NULL, Attributes, &Writer);
 		IMFAttributes_Release(Attributes);
@@ -470,19 +460,19 @@ BOOL Encoder_Start(Encoder* Encoder, ID3D11Device* Device, LPWSTR FileName, cons
 		HR(MFCreateMediaType(&Type));
 
 		HR(IMFMediaType_SetGUID(Type, &MF_MT_MAJOR_TYPE, &MFMediaType_Video));
-		HR(IMFMediaType_SetGUID(Type, &MF_MT_SUBTYPE, Codec));
-		HR(IMFMediaType_SetUINT32(Type, &MF_MT_MPEG2_PROFILE, Profile));
+		HR(IMFMediaType_SetGUID(Type, &MF_MT_SUBTYPE, Format->Codec));
+		HR(IMFMediaType_SetUINT32(Type, &MF_MT_MPEG2_PROFILE, Format->Profile));
 		HR(IMFMediaType_SetUINT32(Type, &MF_MT_VIDEO_CHROMA_SITING, MFVideoChromaSubsampling_MPEG2));
 		HR(IMFMediaType_SetUINT32(Type, &MF_MT_VIDEO_NOMINAL_RANGE, MFNominalRange_Wide));
-		HR(IMFMediaType_SetUINT32(Type, &MF_MT_VIDEO_PRIMARIES, IsHD ? MFVideoPrimaries_BT709 : MFVideoPrimaries_SMPTE170M));
-		HR(IMFMediaType_SetUINT32(Type, &MF_MT_YUV_MATRIX, IsHD ? MFVideoTransferMatrix_BT709 : MFVideoTransferMatrix_BT601));
-		HR(IMFMediaType_SetUINT32(Type, &MF_MT_TRANSFER_FUNCTION, MFVideoPrimaries_BT709));
+		HR(IMFMediaType_SetUINT32(Type, &MF_MT_VIDEO_PRIMARIES, Config->HdrInput ? MFVideoPrimaries_BT2020 : IsHD ? MFVideoPrimaries_BT709 : MFVideoPrimaries_SMPTE170M));
+		HR(IMFMediaType_SetUINT32(Type, &MF_MT_YUV_MATRIX, Config->HdrInput ? MFVideoTransferMatrix_BT2020_10 : IsHD ? MFVideoTransferMatrix_BT709 : MFVideoTransferMatrix_BT601));
+		HR(IMFMediaType_SetUINT32(Type, &MF_MT_TRANSFER_FUNCTION, Config->HdrInput ? MFVideoTransFunc_2084 : MFVideoTransFunc_709));
 		HR(IMFMediaType_SetUINT32(Type, &MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive));
 		HR(IMFMediaType_SetUINT64(Type, &MF_MT_FRAME_RATE, MFT64(Config->FramerateNum, Config->FramerateDen)));
-		HR(IMFMediaType_SetUINT64(Type, &MF_MT_FRAME_SIZE, MFT64(OutputWidth, OutputHeight)));
-		HR(IMFMediaType_SetUINT32(Type, &MF_MT_AVG_BITRATE, Config->Config->VideoBitrate * 1000));
+		HR(IMFMediaType_SetUINT64(Type, &MF_MT_FRAME_SIZE, MFT64(Width, Height)));
+		HR(IMFMediaType_SetUINT32(Type, &MF_MT_AVG_BITRATE, Bitrate * 1000));
 
-		hr = IMFSinkWriter_AddStream(Writer, Type, &Encoder->VideoStreamIndex);
+		hr = IMFSinkWriter_AddStream(Writer, Type, VideoStreamIndex);
 		IMFMediaType_Release(Type);
 
 		if (FAILED(hr))
@@ -497,12 +487,20 @@ BOOL Encoder_Start(Encoder* Encoder, ID3D11Device* Device, LPWSTR FileName, cons
 		IMFMediaType* Type;
 		HR(MFCreateMediaType(&Type));
 		HR(IMFMediaType_SetGUID(Type, &MF_MT_MAJOR_TYPE, &MFMediaType_Video));
-		HR(IMFMediaType_SetGUID(Type, &MF_MT_SUBTYPE, VideoInputFormat));
+		HR(IMFMediaType_SetGUID(Type, &MF_MT_SUBTYPE, Format->VideoInputFormat));
+		if (Config->HdrInput)
+		{
+			// some encoders take color description of bitstream from input type
+			HR(IMFMediaType_SetUINT32(Type, &MF_MT_VIDEO_NOMINAL_RANGE, MFNominalRange_Wide));
+			HR(IMFMediaType_SetUINT32(Type, &MF_MT_VIDEO_PRIMARIES, MFVideoPrimaries_BT2020));
+			HR(IMFMediaType_SetUINT32(Type, &MF_MT_YUV_MATRIX, MFVideoTransferMatrix_BT2020_10));
+			HR(IMFMediaType_SetUINT32(Type, &MF_MT_TRANSFER_FUNCTION, MFVideoTransFunc_2084));
+		}
 		HR(IMFMediaType_SetUINT32(Type, &MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive));
 		HR(IMFMediaType_SetUINT64(Type, &MF_MT_FRAME_RATE, MFT64(Config->FramerateNum, Config->FramerateDen)));
-		HR(IMFMediaType_SetUINT64(Type, &MF_MT_FRAME_SIZE, MFT64(OutputWidth, OutputHeight)));
+		HR(IMFMediaType_SetUINT64(Type, &MF_MT_FRAME_SIZE, MFT64(Width, Height)));
 
-		hr = IMFSinkWriter_SetInputMediaType(Writer, Encoder->VideoStreamIndex, Type, NULL);
+		hr = IMFSinkWriter_SetInputMediaType(Writer, *VideoStreamIndex, Type, NULL);
 		IMFMediaType_Release(Type);
 
 		if (FAILED(hr))
@@ -522,8 +520,8 @@ BOOL Encoder_Start(Encoder* Encoder, ID3D11Device* Device, LPWSTR FileName, cons
 		ICodecAPI_SetValue(Codec, &CODECAPI_AVEncCommonRateControlMode, &RateControl);
 
 		// VBR bitrate to use, some MFT encoders override MF_MT_AVG_BITRATE setting with this one
-		VARIANT Bitrate = { .vt = VT_UI4, .ulVal = Config->Config->VideoBitrate * 1000 };
-		ICodecAPI_SetValue(Codec, &CODECAPI_AVEncCommonMeanBitRate, &Bitrate);
+		VARIANT MeanBitrate = { .vt = VT_UI4, .ulVal = Bitrate * 1000 };
+		ICodecAPI_SetValue(Codec, &CODECAPI_AVEncCommonMeanBitRate, &MeanBitrate);
 
 		// set GOP size to 4 seconds
 		VARIANT GopSize = { .vt = VT_UI4, .ulVal = MUL_DIV_ROUND_UP(4, Config->FramerateNum, Config->FramerateDen) };
@@ -542,38 +540,6 @@ BOOL Encoder_Start(Encoder* Encoder, ID3D11Device* Device, LPWSTR FileName, cons
 
 	if (Config->AudioFormat)
 	{
-		HR(CoCreateInstance(&CLSID_CResamplerMediaObject, NULL, CLSCTX_INPROC_SERVER, &IID_IMFTransform, (LPVOID*)&Resampler));
-
-		// audio resampler input
-		{
-			IMFMediaType* Type;
-			HR(MFCreateMediaType(&Type));
-			HR(MFInitMediaTypeFromWaveFormatEx(Type, Config->AudioFormat, sizeof(*Config->AudioFormat) + Config->AudioFormat->cbSize));
-			HR(IMFTransform_SetInputType(Resampler, 0, Type, 0));
-			IMFMediaType_Release(Type);
-		}
-
-		// audio resampler output
-		{
-			WAVEFORMATEX Format =
-			{
-				.wFormatTag = WAVE_FORMAT_PCM,
-				.nChannels = (WORD)Config->Config->AudioChannels,
-				.nSamplesPerSec = Config->Config->AudioSamplerate,
-				.wBitsPerSample = sizeof(short) * 8,
-			};
-			Format.nBlockAlign = Format.nChannels * Format.wBitsPerSample / 8;
-			Format.nAvgBytesPerSec = Format.nSamplesPerSec * Format.nBlockAlign;
-
-			IMFMediaType* Type;
-			HR(MFCreateMediaType(&Type));
-			HR(MFInitMediaTypeFromWaveFormatEx(Type, &Format, sizeof(Format)));
-			HR(IMFTransform_SetOutputType(Resampler, 0, Type, 0));
-			IMFMediaType_Release(Type);
-		}
-
-		HR(IMFTransform_ProcessMessage(Resampler, MFT_MESSAGE_NOTIFY_BEGIN_STREAMING, 0));
-
 		// audio output type
 		{
 			const GUID* Codec = &((GUID[]){ MFAudioFormat_AAC, MFAudioFormat_FLAC })[Config->Config->AudioCodec];
@@ -590,7 +556,7 @@ BOOL Encoder_Start(Encoder* Encoder, ID3D11Device* Device, LPWSTR FileName, cons
 				HR(IMFMediaType_SetUINT32(Type, &MF_MT_AUDIO_AVG_BYTES_PER_SECOND, Config->Config->AudioBitrate * 1000 / 8));
 			}
 
-			hr = IMFSinkWriter_AddStream(Writer, Type, &Encoder->AudioStreamIndex);
+			hr = IMFSinkWriter_AddStream(Writer, Type, AudioStreamIndex);
 			IMFMediaType_Release(Type);
 
 			if (FAILED(hr))
@@ -610,7 +576,7 @@ BOOL Encoder_Start(Encoder* Encoder, ID3D11Device* Device, LPWSTR FileName, cons
 			HR(IMFMediaType_SetUINT32(Type, &MF_MT_AUDIO_SAMPLES_PER_SECOND, Config->Config->AudioSamplerate));
 			HR(IMFMediaType_SetUINT32(Type, &MF_MT_AUDIO_NUM_CHANNELS, Config->Config->AudioChannels));
 
-			hr = IMFSinkWriter_SetInputMediaType(Writer, Encoder->AudioStreamIndex, Type, NULL);
+			hr = IMFSinkWriter_SetInputMediaType(Writer, *AudioStreamIndex, Type, NULL);
 			IMFMediaType_Release(Type);
 
 			if (FAILED(hr))
@@ -628,94 +594,366 @@ BOOL Encoder_Start(Encoder* Encoder, ID3D11Device* Device, LPWSTR FileName, cons
 		goto bail;
 	}
 
-	// input texture
-	{
-		TexResize_Create(&Encoder->Resize, Device, InputWidth, InputHeight, OutputWidth, OutputHeight, Config->Config->GammaCorrectResize, D3D11_BIND_RENDER_TARGET);
-
-		D3D11_RENDER_TARGET_VIEW_DESC InputViewDesc =
-		{
-			.Format = DXGI_FORMAT_B8G8R8A8_UNORM,
-			.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D,
-		};
-		ID3D11Device_CreateRenderTargetView(Device, (ID3D11Resource*)Encoder->Resize.InputTexture, &InputViewDesc, &Encoder->InputView);
+	return Writer;
 
-		FLOAT Black[] = { 0, 0, 0, 0 };
-		ID3D11DeviceContext_ClearRenderTargetView(Context, Encoder->InputView, Black);
-	}
-
-	// yuv converter
+bail:
+	if (Writer)
 	{
-		YuvColorSpace ColorSpace = IsHD ? YuvColorSpace_BT709 : YuvColorSpace_BT601;
-		YuvConvert_Create(&Encoder->Convert, Device, Encoder->Resize.OutputTexture, OutputWidth, OutputHeight, ColorSpace, Config->Config->ImprovedColorConversion);
+		IMFSinkWriter_Release(Writer);
+		DeleteFileW(FileName);
+	}
+	return NULL;
+}
 
-		DXGI_FORMAT ConvertFormat = IsEqualGUID(VideoInputFormat, &MFVideoFormat_NV12) ? DXGI_FORMAT_NV12 : DXGI_FORMAT_P010;
+// creates YUV output texture & sample that submits it to encoder
+static IMFSample* Encoder__CreateVideoSample(YuvConvertOutput* Output, ID3D11Device* Device, DWORD Width, DWORD Height, DXGI_FORMAT Format)
+{
+	YuvConvertOutput_Create(Output, Device, Width, Height, Format);
 
-		for (size_t OutputIndex = 0; OutputIndex < ENCODER_VIDEO_BUFFER_COUNT; OutputIndex++)
-		{
-			YuvConvertOutput_Create(&Encoder->ConvertOutput[OutputIndex], Device, OutputWidth, OutputHeight, ConvertFormat);
-			ID3D11Texture2D* ConvertOutputTexture = Encoder->ConvertOutput[OutputIndex].Texture;
+	IMFSample* VideoSample;
+	HR(MFCreateVideoSampleFromSurface(NULL, &VideoSample));
 
-			IMFSample* VideoSample;
-			HR(MFCreateVideoSampleFromSurface(NULL, &VideoSample));
+	IMFMediaBuffer* Buffer;
+	HR(MFCreateDXGISurfaceBuffer(&IID_ID3D11Texture2D, (IUnknown*)Output->Texture, 0, FALSE, &Buffer));
 
-			IMFMediaBuffer* Buffer;
-			HR(MFCreateDXGISurfaceBuffer(&IID_ID3D11Texture2D, (IUnknown*)ConvertOutputTexture, 0, FALSE, &Buffer));
+	UINT32 MaxLength;
+	HR(IMFMediaBuffer_GetMaxLength(Buffer, &MaxLength));
+	HR(IMFMediaBuffer_SetCurrentLength(Buffer, MaxLength));
 
-			UINT32 MaxLength;
-			HR(IMFMediaBuffer_GetMaxLength(Buffer, &MaxLength));
-			HR(IMFMediaBuffer_SetCurrentLength(Buffer, MaxLength));
+	HR(IMFSample_AddBuffer(VideoSample, Buffer));
+	IMFMediaBuffer_Release(Buffer);
 
-			HR(IMFSample_AddBuffer(VideoSample, Buffer));
-			IMFMediaBuffer_Release(Buffer);
+	return VideoSample;
+}
 
-			Encoder->VideoSample[OutputIndex] = VideoSample;
-		}
-	}
+BOOL Encoder_Start(Encoder* Encoder, ID3D11Device* Device, LPWSTR FileName, const EncoderConfig* Config)
+{
+	ID3D11DeviceContext* Context;
+	ID3D11Device_GetImmediateContext(Device, &Context);
 
-	Encoder->InputWidth = Config->Width;
-	Encoder->InputHeight = Config->Height;
-	Encoder->OutputWidth = OutputWidth;
-	Encoder->OutputHeight = OutputHeight;
-	Encoder->FramerateNum = Config->FramerateNum;
-	Encoder->FramerateDen = Config->FramerateDen;
-	Encoder->VideoDiscontinuity = FALSE;
-	Encoder->VideoLastTime = 0x8000000000000000ULL; // some large time in future
+	ID3D11Multithread* Multithread;
 
-	Assert(ENCODER_VIDEO_BUFFER_COUNT <= 64);
-	atomic_init(&Encoder->VideoSampleAvailable, (1ULL << ENCODER_VIDEO_BUFFER_COUNT) - 1);
+	// it is very unclear if this is needed or not, it used to be that D3D11 debug runtime
+	// was complaining if this is not done, but nowadays it doesn't complain anymore? very confusing
+	HR(ID3D11DeviceContext_QueryInterface(Context, &IID_ID3D11Multithread, &Multithread));
+	ID3D11Multithread_SetMultithreadProtected(Multithread, TRUE);
 
-	if (Encoder->AudioStreamIndex >= 0)
-	{
-		// resampler input sample
-		HR(MFCreateSample(&Encoder->AudioInputSample));
+	// HDR input cannot be resized, so max width & height are ignored for it, and there are no branches
+	DWORD InputWidth = Config->Width;
+	DWORD InputHeight = Config->Height;
+	DWORD OutputWidth;
+	DWORD OutputHeight;
+	Encoder__GetOutputSize(InputWidth, InputHeight,
+		Config->HdrInput ? 0 : Config->Config->VideoMaxWidth,
+		Config->HdrInput ? 0 : Config->Config->VideoMaxHeight,
+		&OutputWidth, &OutputHeight);
 
-		// resampler output & audio encoding input buffer/samples
-		for (int i = 0; i < ENCODER_AUDIO_BUFFER_COUNT; i++)
-		{
-			IMFSample* Sample;
-			IMFMediaBuffer* Buffer;
-			IMFTrackedSample* Tracked;
+	DWORD BranchCount = Config->HdrInput ? 0 : Config->BranchCount;
+	Assert(BranchCount <= ENCODER_MAX_BRANCHES);
 
-			HR(MFCreateTrackedSample(&Tracked));
-			HR(IMFTrackedSample_QueryInterface(Tracked, &IID_IMFSample, (LPVOID*)&Sample));
-			HR(MFCreateMemoryBuffer(Config->Config->AudioSamplerate * Config->Config->AudioChannels * sizeof(short), &Buffer));
-			HR(IMFSample_AddBuffer(Sample, Buffer));
-			IMFMediaBuffer_Release(Buffer);
-			IMFTrackedSample_Release(Tracked);
+	for (DWORD BranchIndex = 0; BranchIndex < BranchCount; BranchIndex++)
+	{
+		EncoderBranch* Branch = &Encoder->Branch[BranchIndex];
+		const EncoderBranchConfig* BranchConfig = &Config->Branches[BranchIndex];
+		Encoder__GetOutputSize(InputWidth, InputHeight, BranchConfig->MaxWidth, BranchConfig->MaxHeight, &Branch->OutputWidth, &Branch->OutputHeight);
+		Branch->Writer = NULL;
+	}
 
-			Encoder->AudioSample[i] = Sample;
-		}
+	// must be multiple of 2, round upwards
+	InputWidth = (InputWidth + 1) & ~1;
+	InputHeight = (InputHeight + 1) & ~1;
 
-		Encoder->AudioFrameSize = Config->AudioFormat->nBlockAlign;
-		Encoder->AudioSampleRate = Config->AudioFormat->nSamplesPerSec;
-		Encoder->Resampler = Resampler;
+	BOOL Result = FALSE;
+	IMFSinkWriter* Writer = NULL;
+	IMFTransform* Resampler = NULL;
 
-		Assert(ENCODER_AUDIO_BUFFER_COUNT <= 64);
-		atomic_init(&Encoder->AudioSampleAvailable, (1ULL << ENCODER_AUDIO_BUFFER_COUNT) - 1);
+	Encoder__Format Format;
+	if (Config->Config->VideoCodec == CONFIG_VIDEO_H264)
+	{
+		Format.VideoInputFormat = &MFVideoFormat_NV12;
+		Format.Container = Config->Config->FragmentedOutput ? &MFTranscodeContainerType_FMPEG4 : &MFTranscodeContainerType_MPEG4;
+		Format.Codec = &MFVideoFormat_H264;
+		Format.Profile = ((UINT32[]) { eAVEncH264VProfile_Base, eAVEncH264VProfile_Main, eAVEncH264VProfile_High })[Config->Config->VideoProfile];
 	}
-
-	ID3D11DeviceContext_AddRef(Context);
-	ID3D11Multithread_AddRef(Multithread);
+	else if (Config->Config->VideoCodec == CONFIG_VIDEO_H265 && Config->Config->VideoProfile == CONFIG_VIDEO_MAIN)
+	{
+		Format.VideoInputFormat = &MFVideoFormat_NV12;
+		Format.Container = &MFTranscodeContainerType_MPEG4;
+		Format.Codec = &MFVideoFormat_HEVC;
+		Format.Profile = eAVEncH265VProfile_Main_420_8;
+	}
+	else if (Config->Config->VideoCodec == CONFIG_VIDEO_H265 && Config->Config->VideoProfile == CONFIG_VIDEO_MAIN_10)
+	{
+		Format.VideoInputFormat = &MFVideoFormat_P010;
+		Format.Container = &MFTranscodeContainerType_MPEG4;
+		Format.Codec = &MFVideoFormat_HEVC;
+		Format.Profile = eAVEncH265VProfile_Main_420_10;
+	}
+	else if (Config->Config->VideoCodec == CONFIG_VIDEO_AV1 && Config->Config->VideoProfile == CONFIG_VIDEO_MAIN)
+	{
+		Format.VideoInputFormat = &MFVideoFormat_NV12;
+		Format.Container = &MFTranscodeContainerType_MPEG4;
+		Format.Codec = &MFVideoFormat_AV1;
+		Format.Profile = eAVEncAV1VProfile_Main_420_8;
+	}
+	else if (Config->Config->VideoCodec == CONFIG_VIDEO_AV1 && Config->Config->VideoProfile == CONFIG_VIDEO_MAIN_10)
+	{
+		Format.VideoInputFormat = &MFVideoFormat_P010;
+		Format.Container = &MFTranscodeContainerType_MPEG4;
+		Format.Codec = &MFVideoFormat_AV1;
+		Format.Profile = eAVEncAV1VProfile_Main_420_10;
+	}
+	else
+	{
+		Assert(0);
+	}
+	Assert(!Config->HdrInput || IsEqualGUID(Format.VideoInputFormat, &MFVideoFormat_P010));
+
+	// make sure MFT video encoder exists, some vendors wrongly allow SinkWriter to be created for invalid configuration
+	{
+		bool Ok = false;
+
+		MFT_REGISTER_TYPE_INFO InputType = { MFMediaType_Video, *Format.VideoInputFormat };
+		MFT_REGISTER_TYPE_INFO OutputType = { MFMediaType_Video, *Format.Codec };
+
+		IMFAttributes* EnumAttributes;
+		HR(MFCreateAttributes(&EnumAttributes, 1));
+
+		UINT32 Flags = MFT_ENUM_FLAG_SORTANDFILTER;
+
+		if (Config->Config->HardwareEncoder)
+		{
+			IDXGIDevice* DxgiDevice;
+			HR(ID3D11Device_QueryInterface(Device, &IID_IDXGIDevice, (void**)&DxgiDevice));
+
+			IDXGIAdapter* DxgiAdapter;
+			HR(IDXGIDevice_GetAdapter(DxgiDevice, &DxgiAdapter));
+			IDXGIDevice_Release(DxgiDevice);
+
+			DXGI_ADAPTER_DESC AdapterDesc;
+			IDXGIAdapter_GetDesc(DxgiAdapter, &AdapterDesc);
+			IDXGIAdapter_Release(DxgiAdapter);
+
+			HR(IMFAttributes_SetBlob(EnumAttributes, &MFT_ENUM_ADAPTER_LUID, (UINT8*)&AdapterDesc.AdapterLuid, sizeof(AdapterDesc.AdapterLuid)));
+
+			Flags |= MFT_ENUM_FLAG_ASYNCMFT | MFT_ENUM_FLAG_HARDWARE;
+		}
+		else
+		{
+			Flags |= MFT_ENUM_FLAG_SYNCMFT;
+		}
+
+		UINT32 ActivateCount = 0;
+		IMFActivate** Activate = NULL;
+		if (SUCCEEDED(MFTEnum2(MFT_CATEGORY_VIDEO_ENCODER, Flags, &InputType, &OutputType, EnumAttributes, &Activate, &ActivateCount)) && ActivateCount != 0)
+		{
+			Ok = true;
+		}
+
+		if (Activate)
+		{
+			for (size_t ActivateIndex = 0; ActivateIndex != ActivateCount; ActivateIndex++)
+			{
+				IMFActivate_Release(Activate[ActivateIndex]);
+			}
+			CoTaskMemFree(Activate);
+		}
+		IMFAttributes_Release(EnumAttributes);
+
+		if (!Ok)
+		{
+			MessageBoxW(NULL, L"Cannot find video encoder!", WCAP_TITLE, MB_ICONERROR);
+			goto bail;
+		}
+	}
+
+	if (Config->AudioFormat)
+	{
+		HR(CoCreateInstance(&CLSID_CResamplerMediaObject, NULL, CLSCTX_INPROC_SERVER, &IID_IMFTransform, (LPVOID*)&Resampler));
+
+		// audio resampler input
+		{
+			IMFMediaType* Type;
+			HR(MFCreateMediaType(&Type));
+			HR(MFInitMediaTypeFromWaveFormatEx(Type, Config->AudioFormat, sizeof(*Config->AudioFormat) + Config->AudioFormat->cbSize));
+			HR(IMFTransform_SetInputType(Resampler, 0, Type, 0));
+			IMFMediaType_Release(Type);
+		}
+
+		// audio resampler output
+		{
+			WAVEFORMATEX Format =
+			{
+				.wFormatTag = WAVE_FORMAT_PCM,
+				.nChannels = (WORD)Config->Config->AudioChannels,
+				.nSamplesPerSec = Config->Config->AudioSamplerate,
+				.wBitsPerSample = sizeof(short) * 8,
+			};
+			Format.nBlockAlign = Format.nChannels * Format.wBitsPerSample / 8;
+			Format.nAvgBytesPerSec = Format.nSamplesPerSec * Format.nBlockAlign;
+
+			IMFMediaType* Type;
+			HR(MFCreateMediaType(&Type));
+			HR(MFInitMediaTypeFromWaveFormatEx(Type, &Format, sizeof(Format)));
+			HR(IMFTransform_SetOutputType(Resampler, 0, Type, 0));
+			IMFMediaType_Release(Type);
+		}
+
+		HR(IMFTransform_ProcessMessage(Resampler, MFT_MESSAGE_NOTIFY_BEGIN_STREAMING, 0));
+	}
+
+	// output files, all with same codec & audio
+	Writer = Encoder__CreateWriter(Device, FileName, Config, &Format, OutputWidth, OutputHeight, Config->Config->VideoBitrate, &Encoder->VideoStreamIndex, &Encoder->AudioStreamIndex);
+	if (!Writer)
+	{
+		goto bail;
+	}
+
+	for (DWORD BranchIndex = 0; BranchIndex < BranchCount; BranchIndex++)
+	{
+		EncoderBranch* Branch = &Encoder->Branch[BranchIndex];
+		const EncoderBranchConfig* BranchConfig = &Config->Branches[BranchIndex];
+		Branch->Writer = Encoder__CreateWriter(Device, BranchConfig->FileName, Config, &Format, Branch->OutputWidth, Branch->OutputHeight, BranchConfig->Bitrate, &Branch->VideoStreamIndex, &Branch->AudioStreamIndex);
+		if (!Branch->Writer)
+		{
+			goto bail;
+		}
+	}
+
+	// input texture
+	{
+		// improved conversion needs neighbor chroma values for every pixel, so it cannot be fused with resize
+		bool FusedConvert = !Config->Config->ImprovedColorConversion;
+		TexResize_Create(&Encoder->Resize, Device, InputWidth, InputHeight, OutputWidth, OutputHeight, (ResizeFilter)Config->Config->ResizeFilter, Config->Config->GammaCorrectResize, FusedConvert, Config->HdrInput, D3D11_BIND_RENDER_TARGET, NULL);
+
+		D3D11_RENDER_TARGET_VIEW_DESC InputViewDesc =
+		{
+			.Format = Config->HdrInput ? DXGI_FORMAT_R16G16B16A16_FLOAT : DXGI_FORMAT_B8G8R8A8_UNORM,
+			.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D,
+		};
+		ID3D11Device_CreateRenderTargetView(Device, (ID3D11Resource*)Encoder->Resize.InputTexture, &InputViewDesc, &Encoder->InputView);
+
+		FLOAT Black[] = { 0, 0, 0, 0 };
+		ID3D11DeviceContext_ClearRenderTargetView(Context, Encoder->InputView, Black);
+
+		// hash shader reads only B8G8R8A8 input
+		Encoder->SkipDuplicates = Config->Config->SkipDuplicateFrames && !Config->HdrInput;
+		Encoder->AdaptiveFramerate = Encoder->SkipDuplicates && Config->Config->AdaptiveFramerate;
+		Encoder->SceneKeyframes = Config->Config->SceneKeyframes && !Config->HdrInput;
+		Encoder->HashFrames = Encoder->SkipDuplicates || Encoder->SceneKeyframes;
+		if (Encoder->HashFrames)
+		{
+			FrameHash_Create(&Encoder->Hash, Device, Encoder->Resize.InputTexture, InputWidth, InputHeight);
+		}
+		if (Encoder->SceneKeyframes)
+		{
+			// block luma from frame hash is thumbnail of frame
+			CpuScene_Create(&Encoder->Scene, Encoder->Hash.BlockCount, CpuKernel_Auto);
+			HR(IMFSinkWriter_GetServiceForStream(Writer, 0, &GUID_NULL, &IID_ICodecAPI, (LPVOID*)&Encoder->VideoCodec));
+		}
+	}
+
+	// yuv converter
+	{
+		// HDR is converted in single pass, improved conversion is not used for it
+		YuvColorSpace ColorSpace = Config->HdrInput ? YuvColorSpace_BT2020 : Encoder__IsHD(Config, OutputWidth, OutputHeight) ? YuvColorSpace_BT709 : YuvColorSpace_BT601;
+		bool ImprovedConversion = Config->Config->ImprovedColorConversion && !Config->HdrInput;
+		DXGI_FORMAT ConvertFormat = IsEqualGUID(Format.VideoInputFormat, &MFVideoFormat_NV12) ? DXGI_FORMAT_NV12 : DXGI_FORMAT_P010;
+		YuvConvert_Create(&Encoder->Convert, Device, Encoder->Resize.OutputTexture, OutputWidth, OutputHeight, ConvertFormat, ColorSpace, ImprovedConversion);
+
+		for (size_t OutputIndex = 0; OutputIndex < ENCODER_VIDEO_BUFFER_COUNT; OutputIndex++)
+		{
+			Encoder->VideoSample[OutputIndex] = Encoder__CreateVideoSample(&Encoder->ConvertOutput[OutputIndex], Device, OutputWidth, OutputHeight, ConvertFormat);
+		}
+
+		// branches resize same input texture, so crop copy is done only once for all outputs
+		for (DWORD BranchIndex = 0; BranchIndex < BranchCount; BranchIndex++)
+		{
+			EncoderBranch* Branch = &Encoder->Branch[BranchIndex];
+
+			bool FusedConvert = !ImprovedConversion;
+			TexResize_Create(&Branch->Resize, Device, InputWidth, InputHeight, Branch->OutputWidth, Branch->OutputHeight, (ResizeFilter)Config->Config->ResizeFilter, Config->Config->GammaCorrectResize, FusedConvert, false, 0, Encoder->Resize.InputTexture);
+
+			YuvColorSpace BranchColorSpace = Encoder__IsHD(Config, Branch->OutputWidth, Branch->OutputHeight) ? YuvColorSpace_BT709 : YuvColorSpace_BT601;
+			YuvConvert_Create(&Branch->Convert, Device, Branch->Resize.OutputTexture, Branch->OutputWidth, Branch->OutputHeight, ConvertFormat, BranchColorSpace, ImprovedConversion);
+
+			for (size_t OutputIndex = 0; OutputIndex < ENCODER_VIDEO_BUFFER_COUNT; OutputIndex++)
+			{
+				Branch->VideoSample[OutputIndex] = Encoder__CreateVideoSample(&Branch->ConvertOutput[OutputIndex], Device, Branch->OutputWidth, Branch->OutputHeight, ConvertFormat);
+			}
+
+			if (Encoder->SceneKeyframes)
+			{
+				HR(IMFSinkWriter_GetServiceForStream(Branch->Writer, 0, &GUID_NULL, &IID_ICodecAPI, (LPVOID*)&Branch->VideoCodec));
+			}
+		}
+
+		// overlay converts tiles around cursor, so it works only when input is converted without resizing
+		// branches convert whole input, they would not have cursor drawn
+		Encoder->CursorOverlay = Config->CursorOverlay && BranchCount == 0 && Encoder->Resize.OutputTexture == Encoder->Resize.InputTexture && Encoder->Convert.TilesShader;
+		if (Encoder->CursorOverlay)
+		{
+			CursorOverlay_Create(&Encoder->Cursor, Device, Encoder->Resize.InputTexture, InputWidth, InputHeight);
+		}
+	}
+
+	Encoder->InputWidth = Config->Width;
+	Encoder->InputHeight = Config->Height;
+	Encoder->OutputWidth = OutputWidth;
+	Encoder->OutputHeight = OutputHeight;
+	Encoder->FramerateNum = Config->FramerateNum;
+	Encoder->FramerateDen = Config->FramerateDen;
+	Encoder->BranchCount = BranchCount;
+	Encoder->VideoDiscontinuity = FALSE;
+	Encoder->VideoLastTime = 0x8000000000000000ULL; // some large time in future
+	Encoder->VideoPendingIndex = ENCODER_VIDEO_BUFFER_COUNT;
+	Encoder->VideoDuplicateCount = 0;
+	Encoder->VideoLastIndex = ENCODER_VIDEO_BUFFER_COUNT;
+	Encoder->VideoHashFrame = 0;
+	Encoder->VideoStaticCount = 0;
+	Encoder->VideoSkippedChange = FALSE;
+	CpuRate_Create(&Encoder->VideoRate);
+	Encoder->VideoLastKeyframe = 0;
+	Encoder->VideoKeyframe = FALSE;
+	Encoder->VideoPendingKeyframe = FALSE;
+	Encoder->VideoCursorChanged = FALSE;
+
+	CpuSlots_Create(&Encoder->VideoSampleAvailable, ENCODER_VIDEO_BUFFER_COUNT);
+	atomic_store(&Encoder->SampleCallbacks, 0);
+	CpuDrop_Create(&Encoder->Drop, (CpuDropPolicy)Config->Config->DropPolicy, ENCODER_VIDEO_BUFFER_COUNT);
+	ZeroMemory(Encoder->VideoSubmitTime, sizeof(Encoder->VideoSubmitTime));
+
+	if (Encoder->AudioStreamIndex >= 0)
+	{
+		// resampler input sample
+		HR(MFCreateSample(&Encoder->AudioInputSample));
+
+		// resampler output & audio encoding input buffer/samples
+		for (int i = 0; i < ENCODER_AUDIO_BUFFER_COUNT; i++)
+		{
+			IMFSample* Sample;
+			IMFMediaBuffer* Buffer;
+			IMFTrackedSample* Tracked;
+
+			HR(MFCreateTrackedSample(&Tracked));
+			HR(IMFTrackedSample_QueryInterface(Tracked, &IID_IMFSample, (LPVOID*)&Sample));
+			HR(MFCreateMemoryBuffer(Config->Config->AudioSamplerate * Config->Config->AudioChannels * sizeof(short), &Buffer));
+			HR(IMFSample_AddBuffer(Sample, Buffer));
+			IMFMediaBuffer_Release(Buffer);
+			IMFTrackedSample_Release(Tracked);
+
+			Encoder->AudioSample[i] = Sample;
+		}
+
+		Encoder->AudioFrameSize = Config->AudioFormat->nBlockAlign;
+		Encoder->AudioSampleRate = Config->AudioFormat->nSamplesPerSec;
+		Encoder->Resampler = Resampler;
+
+		CpuSlots_Create(&Encoder->AudioSampleAvailable, ENCODER_AUDIO_BUFFER_COUNT);
+	}
+
+	ID3D11DeviceContext_AddRef(Context);
+	ID3D11Multithread_AddRef(Multithread);
 	Encoder->Context = Context;
 	Encoder->Multithread = Multithread;
 
@@ -735,6 +973,15 @@ bail:
 		IMFSinkWriter_Release(Writer);
 		DeleteFileW(FileName);
 	}
+	for (DWORD BranchIndex = 0; !Result && BranchIndex < BranchCount; BranchIndex++)
+	{
+		EncoderBranch* Branch = &Encoder->Branch[BranchIndex];
+		if (Branch->Writer)
+		{
+			IMFSinkWriter_Release(Branch->Writer);
+			DeleteFileW(Config->Branches[BranchIndex].FileName);
+		}
+	}
 
 	ID3D11Multithread_Release(Multithread);
 	ID3D11DeviceContext_Release(Context);
@@ -742,8 +989,109 @@ bail:
 	return Result;
 }
 
+// submits samples in buffer slot Index to encoders of all outputs
+static void Encoder__WriteVideo(Encoder* Encoder, DWORD Index, BOOL Keyframe)
+{
+	if (Keyframe)
+	{
+		// encoder makes next input frame a keyframe
+		VARIANT Force = { .vt = VT_UI4, .ulVal = 1 };
+		ICodecAPI_SetValue(Encoder->VideoCodec, &CODECAPI_AVEncVideoForceKeyFrame, &Force);
+		for (DWORD BranchIndex = 0; BranchIndex < Encoder->BranchCount; BranchIndex++)
+		{
+			ICodecAPI_SetValue(Encoder->Branch[BranchIndex].VideoCodec, &CODECAPI_AVEncVideoForceKeyFrame, &Force);
+		}
+	}
+
+	LARGE_INTEGER Time;
+	QueryPerformanceCounter(&Time);
+	Encoder->VideoSubmitTime[Index] = Time.QuadPart;
+
+	// must be set before first sample can be returned
+	CpuSlots_SetUsers(&Encoder->VideoSampleAvailable, Index, 1 + Encoder->BranchCount);
+
+	HR(IMFSinkWriter_WriteSample(Encoder->Writer, Encoder->VideoStreamIndex, Encoder->VideoSample[Index]));
+	IMFSample_Release(Encoder->VideoSample[Index]);
+
+	for (DWORD BranchIndex = 0; BranchIndex < Encoder->BranchCount; BranchIndex++)
+	{
+		EncoderBranch* Branch = &Encoder->Branch[BranchIndex];
+		HR(IMFSinkWriter_WriteSample(Branch->Writer, Branch->VideoStreamIndex, Branch->VideoSample[Index]));
+		IMFSample_Release(Branch->VideoSample[Index]);
+	}
+}
+
+// sets duration of sample in buffer slot Index for all outputs, they all have same timestamps
+static void Encoder__SetVideoDuration(Encoder* Encoder, DWORD Index, LONGLONG Duration)
+{
+	HR(IMFSample_SetSampleDuration(Encoder->VideoSample[Index], Duration));
+	for (DWORD BranchIndex = 0; BranchIndex < Encoder->BranchCount; BranchIndex++)
+	{
+		HR(IMFSample_SetSampleDuration(Encoder->Branch[BranchIndex].VideoSample[Index], Duration));
+	}
+}
+
+static void Encoder__SendStreamTick(Encoder* Encoder, LONGLONG Timestamp)
+{
+	HR(IMFSinkWriter_SendStreamTick(Encoder->Writer, Encoder->VideoStreamIndex, Timestamp));
+	for (DWORD BranchIndex = 0; BranchIndex < Encoder->BranchCount; BranchIndex++)
+	{
+		EncoderBranch* Branch = &Encoder->Branch[BranchIndex];
+		HR(IMFSinkWriter_SendStreamTick(Branch->Writer, Branch->VideoStreamIndex, Timestamp));
+	}
+}
+
+static BOOL Encoder__AcquireVideoSample(Encoder* Encoder, uint32_t* Index)
+{
+	if (!CpuSlots_TryAcquire(&Encoder->VideoSampleAvailable, Index))
+	{
+		return FALSE;
+	}
+
+	// latency of previous use of sample is known after encoder has returned it
+	if (Encoder->VideoSubmitTime[*Index] != 0)
+	{
+		CpuDrop_AddLatency(&Encoder->Drop, Encoder->VideoReturnTime[*Index] - Encoder->VideoSubmitTime[*Index]);
+		Encoder->VideoSubmitTime[*Index] = 0;
+	}
+	return TRUE;
+}
+
+static void Encoder__CopyInput(Encoder* Encoder, ID3D11Texture2D* Texture, RECT Rect)
+{
+	ID3D11DeviceContext* Context = Encoder->Context;
+
+	D3D11_BOX Box =
+	{
+		.left = Rect.left,
+		.top = Rect.top,
+		.right = Rect.right,
+		.bottom = Rect.bottom,
+		.front = 0,
+		.back = 1,
+	};
+
+	DWORD Width = Box.right - Box.left;
+	DWORD Height = Box.bottom - Box.top;
+	if (Width < Encoder->InputWidth || Height < Encoder->InputHeight)
+	{
+		FLOAT Black[] = { 0, 0, 0, 0 };
+		ID3D11DeviceContext_ClearRenderTargetView(Context, Encoder->InputView, Black);
+
+		Box.right = Box.left + min(Encoder->InputWidth, Box.right);
+		Box.bottom = Box.top + min(Encoder->InputHeight, Box.bottom);
+	}
+	ID3D11DeviceContext_CopySubresourceRegion(Context, (ID3D11Resource*)Encoder->Resize.InputTexture, 0, 0, 0, 0, (ID3D11Resource*)Texture, 0, &Box);
+}
+
 void Encoder_Stop(Encoder* Encoder)
 {
+	if (Encoder->VideoPendingIndex != ENCODER_VIDEO_BUFFER_COUNT)
+	{
+		// last frame keeps its duration, which includes skipped duplicates after it
+		Encoder__WriteVideo(Encoder, Encoder->VideoPendingIndex, Encoder->VideoPendingKeyframe);
+	}
+
 	if (Encoder->AudioStreamIndex >= 0)
 	{
 		HR(IMFTransform_ProcessMessage(Encoder->Resampler, MFT_MESSAGE_COMMAND_DRAIN, 0));
@@ -753,6 +1101,30 @@ void Encoder_Stop(Encoder* Encoder)
 
 	IMFSinkWriter_Finalize(Encoder->Writer);
 	IMFSinkWriter_Release(Encoder->Writer);
+	for (DWORD BranchIndex = 0; BranchIndex < Encoder->BranchCount; BranchIndex++)
+	{
+		IMFSinkWriter_Finalize(Encoder->Branch[BranchIndex].Writer);
+		IMFSinkWriter_Release(Encoder->Branch[BranchIndex].Writer);
+	}
+
+	// encoder can return last samples on work queue thread even after sink writer is released
+	// so wait until every slot is recycled & no callback is still running, before samples & slot pools are released
+	// slot pool is updated after slot becomes free, that's why callback count is checked after all slots are acquired
+	for (uint32_t Slot = 0; Slot < ENCODER_VIDEO_BUFFER_COUNT; Slot++)
+	{
+		CpuSlots_Acquire(&Encoder->VideoSampleAvailable);
+	}
+	if (Encoder->AudioStreamIndex >= 0)
+	{
+		for (uint32_t Slot = 0; Slot < ENCODER_AUDIO_BUFFER_COUNT; Slot++)
+		{
+			CpuSlots_Acquire(&Encoder->AudioSampleAvailable);
+		}
+	}
+	while (atomic_load(&Encoder->SampleCallbacks) != 0)
+	{
+		SwitchToThread();
+	}
 
 	if (Encoder->AudioStreamIndex >= 0)
 	{
@@ -768,100 +1140,326 @@ void Encoder_Stop(Encoder* Encoder)
 		YuvConvertOutput_Release(&Encoder->ConvertOutput[OutputIndex]);
 		IMFSample_Release(Encoder->VideoSample[OutputIndex]);
 	}
+	for (DWORD BranchIndex = 0; BranchIndex < Encoder->BranchCount; BranchIndex++)
+	{
+		EncoderBranch* Branch = &Encoder->Branch[BranchIndex];
+		for (size_t OutputIndex = 0; OutputIndex < ENCODER_VIDEO_BUFFER_COUNT; OutputIndex++)
+		{
+			YuvConvertOutput_Release(&Branch->ConvertOutput[OutputIndex]);
+			IMFSample_Release(Branch->VideoSample[OutputIndex]);
+		}
+		if (Encoder->SceneKeyframes)
+		{
+			ICodecAPI_Release(Branch->VideoCodec);
+		}
+		YuvConvert_Release(&Branch->Convert);
+		TexResize_Release(&Branch->Resize);
+	}
+	if (Encoder->HashFrames)
+	{
+		FrameHash_Release(&Encoder->Hash);
+	}
+	if (Encoder->SceneKeyframes)
+	{
+		CpuScene_Release(&Encoder->Scene);
+		ICodecAPI_Release(Encoder->VideoCodec);
+	}
+	if (Encoder->CursorOverlay)
+	{
+		CursorOverlay_Release(&Encoder->Cursor);
+	}
 	YuvConvert_Release(&Encoder->Convert);
 	TexResize_Release(&Encoder->Resize);
 	ID3D11RenderTargetView_Release(Encoder->InputView);
 
 	ID3D11Multithread_Release(Encoder->Multithread);
 	ID3D11DeviceContext_Release(Encoder->Context);
+
+	// all slots were acquired above, so nothing can recycle them anymore
+	CpuSlots_Release(&Encoder->VideoSampleAvailable);
+	if (Encoder->AudioStreamIndex >= 0)
+	{
+		CpuSlots_Release(&Encoder->AudioSampleAvailable);
+	}
 }
 
-BOOL Encoder_NewFrame(Encoder* Encoder, ID3D11Texture2D* Texture, RECT Rect, UINT64 Time, UINT64 TimePeriod)
+static LONGLONG Encoder__VideoTimestamp(Encoder* Encoder, UINT64 Time, UINT64 TimePeriod)
 {
-	Encoder->VideoLastTime = Time;
+	return MFllMulDiv(Time - Encoder->StartTime, MF_UNITS_PER_SECOND, TimePeriod, 0);
+}
 
-	uint64_t Available = atomic_load(&Encoder->VideoSampleAvailable);
-	if (Available == 0)
+static void Encoder__WritePendingVideo(Encoder* Encoder, UINT64 Time, UINT64 TimePeriod)
+{
+	DWORD Index = Encoder->VideoPendingIndex;
+	if (Index != ENCODER_VIDEO_BUFFER_COUNT)
 	{
-		// dropped frame
-		LONGLONG Timestamp = MFllMulDiv(Time - Encoder->StartTime, MF_UNITS_PER_SECOND, TimePeriod, 0);
-		HR(IMFSinkWriter_SendStreamTick(Encoder->Writer, Encoder->VideoStreamIndex, Timestamp));
-		Encoder->VideoDiscontinuity = TRUE;
-		return FALSE;
+		// pending frame is shown until Time, this includes all duplicates skipped after it
+		LONGLONG SampleTime;
+		HR(IMFSample_GetSampleTime(Encoder->VideoSample[Index], &SampleTime));
+		Encoder__SetVideoDuration(Encoder, Index, Encoder__VideoTimestamp(Encoder, Time, TimePeriod) - SampleTime);
+
+		Encoder__WriteVideo(Encoder, Index, Encoder->VideoPendingKeyframe);
+		Encoder->VideoPendingIndex = ENCODER_VIDEO_BUFFER_COUNT;
 	}
+}
 
-	DWORD Index;
-	_BitScanForward64(&Index, Available);
-	atomic_fetch_and(&Encoder->VideoSampleAvailable, ~(1ULL << Index));
+// frame at Time is not encoded, pending sample must be written before stream tick
+// next sample is marked as discontinuity, so decoder does not expect frames in gap before it
+static void Encoder__DropVideo(Encoder* Encoder, UINT64 Time, UINT64 TimePeriod)
+{
+	Encoder__WritePendingVideo(Encoder, Time, TimePeriod);
+	if (Encoder->StartTime != 0)
+	{
+		// nothing is written before first frame, so there is no gap to mark
+		Encoder__SendStreamTick(Encoder, Encoder__VideoTimestamp(Encoder, Time, TimePeriod));
+	}
+	Encoder->VideoDiscontinuity = TRUE;
+}
+
+static BOOL Encoder__IsStatic(Encoder* Encoder, UINT64 Time, UINT64 TimePeriod)
+{
+	return CpuRate_IsStatic(&Encoder->VideoRate, Encoder->Hash.DirtyCount, Encoder->Hash.BlockCount, Time, TimePeriod);
+}
+
+static void Encoder__SetupVideoSample(Encoder* Encoder, IMFSample* Sample, LONGLONG Timestamp, LONGLONG Duration, BOOL Discontinuity)
+{
+	HR(IMFSample_SetSampleDuration(Sample, Duration));
+	HR(IMFSample_SetSampleTime(Sample, Timestamp));
 
+	if (Discontinuity)
+	{
+		HR(IMFSample_SetUINT32(Sample, &MFSampleExtension_Discontinuity, TRUE));
+	}
+	else
+	{
+		// don't care about success or no, we just don't want this attribute set at all
+		IMFSample_DeleteItem(Sample, &MFSampleExtension_Discontinuity);
+	}
+
+	IMFTrackedSample* Tracked;
+	HR(IMFSample_QueryInterface(Sample, &IID_IMFTrackedSample, (LPVOID*)&Tracked));
+	IMFTrackedSample_SetAllocator(Tracked, &Encoder->VideoSampleCallback, NULL);
+	IMFTrackedSample_Release(Tracked);
+}
+
+static BOOL Encoder__UseTiles(Encoder* Encoder)
+{
+	// converting tiles separately is slower per pixel, so amount of changes in last compared frame decides
+	// indirect dispatch also has limit on group count, and actual count of dirty blocks is known only on GPU
+	return Encoder->Hash.DirtyCount <= Encoder->Hash.BlockCount / 2 && Encoder->Hash.BlockCount <= D3D11_CS_DISPATCH_MAX_THREAD_GROUPS_PER_DIMENSION;
+}
+
+// resizes, converts & submits current contents of input texture to encoder in ConvertOutput[Index] of all outputs
+// with CursorOnly input is same as for last converted frame, only cursor overlay has changed
+static void Encoder__EncodeInput(Encoder* Encoder, DWORD Index, BOOL CursorOnly, UINT64 Time, UINT64 TimePeriod)
+{
 	ID3D11DeviceContext* Context = Encoder->Context;
 	ID3D11Multithread_Enter(Encoder->Multithread);
 
-	// copy to input texture
+	// resize if needed
+	TexResize_Dispatch(&Encoder->Resize, Context);
+
+	if (Encoder->HashFrames && !CursorOnly)
 	{
-		D3D11_BOX Box =
-		{
-			.left = Rect.left,
-			.top = Rect.top,
-			.right = Rect.right,
-			.bottom = Rect.bottom,
-			.front = 0,
-			.back = 1,
-		};
+		// dirty blocks are found on GPU, hashes compared on CPU would be known only few frames later
+		FrameHash_Compare(&Encoder->Hash, Context);
+		Encoder->VideoHashFrame = Encoder->Hash.Frames;
+	}
 
-		DWORD Width = Box.right - Box.left;
-		DWORD Height = Box.bottom - Box.top;
-		if (Width < Encoder->InputWidth || Height < Encoder->InputHeight)
+	// convert to YUV
+	if (Encoder->Resize.PassConvert)
+	{
+		YuvConvertOutput* Output = &Encoder->ConvertOutput[Index];
+		TexResize_DispatchConvert(&Encoder->Resize, Context, Encoder->Convert.ConstantBuffer, Output->ViewOutY, Output->ViewOutUV);
+	}
+	else if (Encoder->Resize.OutputTexture == Encoder->Resize.InputTexture
+		&& Encoder->Convert.TilesShader
+		&& Encoder->VideoLastIndex != ENCODER_VIDEO_BUFFER_COUNT
+		&& (CursorOnly || (Encoder->HashFrames && Encoder__UseTiles(Encoder))))
+	{
+		// start from previous output & convert only tiles around changed blocks
+		YuvConvertOutput* Output = &Encoder->ConvertOutput[Index];
+		if (Index != Encoder->VideoLastIndex)
 		{
-			FLOAT Black[] = { 0, 0, 0, 0 };
-			ID3D11DeviceContext_ClearRenderTargetView(Context, Encoder->InputView, Black);
-
-			Box.right = Box.left + min(Encoder->InputWidth, Box.right);
-			Box.bottom = Box.top + min(Encoder->InputHeight, Box.bottom);
+			ID3D11DeviceContext_CopyResource(Context, (ID3D11Resource*)Output->Texture, (ID3D11Resource*)Encoder->ConvertOutput[Encoder->VideoLastIndex].Texture);
 		}
-		ID3D11DeviceContext_CopySubresourceRegion(Context, (ID3D11Resource*)Encoder->Resize.InputTexture, 0, 0, 0, 0, (ID3D11Resource*)Texture, 0, &Box);
+		if (!CursorOnly)
+		{
+			YuvConvert_DispatchTilesIndirect(&Encoder->Convert, Context, Output, Encoder->Convert.InputView, Encoder->Hash.DirtyView, Encoder->Hash.DirtyArgs);
+		}
+	}
+	else
+	{
+		YuvConvert_Dispatch(&Encoder->Convert, Context, &Encoder->ConvertOutput[Index]);
+	}
+	if (Encoder->CursorOverlay)
+	{
+		// erases cursor from previous position & draws it at current one
+		CursorOverlay_Dispatch(&Encoder->Cursor, Context, &Encoder->Convert, &Encoder->ConvertOutput[Index]);
+		Encoder->VideoCursorChanged = FALSE;
 	}
+	Encoder->VideoLastIndex = Index;
 
-	// resize if needed
-	TexResize_Dispatch(&Encoder->Resize, Context);
+	// branches always convert whole frame, their input is not hashed
+	for (DWORD BranchIndex = 0; BranchIndex < Encoder->BranchCount; BranchIndex++)
+	{
+		EncoderBranch* Branch = &Encoder->Branch[BranchIndex];
+		YuvConvertOutput* Output = &Branch->ConvertOutput[Index];
 
-	// convert to YUV
-	YuvConvert_Dispatch(&Encoder->Convert, Context, &Encoder->ConvertOutput[Index]);
+		TexResize_Dispatch(&Branch->Resize, Context);
+		if (Branch->Resize.PassConvert)
+		{
+			TexResize_DispatchConvert(&Branch->Resize, Context, Branch->Convert.ConstantBuffer, Output->ViewOutY, Output->ViewOutUV);
+		}
+		else
+		{
+			YuvConvert_Dispatch(&Branch->Convert, Context, Output);
+		}
+	}
 
 	ID3D11DeviceContext_Flush(Context);
 	ID3D11Multithread_Leave(Encoder->Multithread);
 
+	Encoder->VideoSkippedChange = FALSE;
+	CpuRate_Encoded(&Encoder->VideoRate, Time, TimePeriod);
+
 	// setup input time & duration
 	if (Encoder->StartTime == 0)
 	{
 		Encoder->StartTime = Time;
 	}
 
-	IMFSample* Sample = Encoder->VideoSample[Index];
-	HR(IMFSample_SetSampleDuration(Sample, MFllMulDiv(Encoder->FramerateDen, MF_UNITS_PER_SECOND, Encoder->FramerateNum, 0)));
-	HR(IMFSample_SetSampleTime(Sample, MFllMulDiv(Time - Encoder->StartTime, MF_UNITS_PER_SECOND, TimePeriod, 0)));
+	LONGLONG Timestamp = Encoder__VideoTimestamp(Encoder, Time, TimePeriod);
+	LONGLONG Duration = MFllMulDiv(Encoder->FramerateDen, MF_UNITS_PER_SECOND, Encoder->FramerateNum, 0);
 
-	if (Encoder->VideoDiscontinuity)
+	Encoder__SetupVideoSample(Encoder, Encoder->VideoSample[Index], Timestamp, Duration, Encoder->VideoDiscontinuity);
+	for (DWORD BranchIndex = 0; BranchIndex < Encoder->BranchCount; BranchIndex++)
 	{
-		HR(IMFSample_SetUINT32(Sample, &MFSampleExtension_Discontinuity, TRUE));
-		Encoder->VideoDiscontinuity = FALSE;
+		Encoder__SetupVideoSample(Encoder, Encoder->Branch[BranchIndex].VideoSample[Index], Timestamp, Duration, Encoder->VideoDiscontinuity);
 	}
-	else
+	Encoder->VideoDiscontinuity = FALSE;
+
+	BOOL Keyframe = Encoder->VideoKeyframe;
+	Encoder->VideoKeyframe = FALSE;
+
+	if (Encoder->SkipDuplicates)
 	{
-		// don't care about success or no, we just don't want this attribute set at all
-		IMFSample_DeleteItem(Sample, &MFSampleExtension_Discontinuity);
+		// duration of this sample is known only when next different frame arrives
+		Encoder__WritePendingVideo(Encoder, Time, TimePeriod);
+		Encoder->VideoPendingIndex = Index;
+		Encoder->VideoPendingKeyframe = Keyframe;
+		return;
 	}
 
-	IMFTrackedSample* Tracked;
-	HR(IMFSample_QueryInterface(Sample, &IID_IMFTrackedSample, (LPVOID*)&Tracked));
-	IMFTrackedSample_SetAllocator(Tracked, &Encoder->VideoSampleCallback, NULL);
-	IMFTrackedSample_Release(Tracked);
-
 	// submit to encoder which will happen in background
-	HR(IMFSinkWriter_WriteSample(Encoder->Writer, Encoder->VideoStreamIndex, Sample));
+	Encoder__WriteVideo(Encoder, Index, Keyframe);
+}
+
+BOOL Encoder_NewFrame(Encoder* Encoder, ID3D11Texture2D* Texture, RECT Rect, DWORD Queued, UINT64 Time, UINT64 TimePeriod)
+{
+	Encoder->VideoLastTime = Time;
+
+	uint32_t Free = CpuSlots_GetFreeCount(&Encoder->VideoSampleAvailable);
+	UINT64 FramePeriod = TimePeriod * Encoder->FramerateDen / Encoder->FramerateNum;
+	CpuDropAction Action = CpuDrop_Decide(&Encoder->Drop, Queued, Free, Time, FramePeriod);
+
+	if (Action == CpuDropAction_Drop && Free != 0)
+	{
+		// dropped by policy, if no newer frame is waiting then input is still updated
+		// so Encoder_Update can encode it later in case no other frame arrives
+		if (Queued == 0)
+		{
+			ID3D11Multithread_Enter(Encoder->Multithread);
+			Encoder__CopyInput(Encoder, Texture, Rect);
+			if (Encoder->HashFrames)
+			{
+				// hashes must match input, dirty blocks of next conversion are found from them
+				FrameHash_Update(&Encoder->Hash, Encoder->Context);
+			}
+			ID3D11Multithread_Leave(Encoder->Multithread);
+
+			// input does not match last converted output anymore
+			Encoder->VideoLastIndex = ENCODER_VIDEO_BUFFER_COUNT;
+			Encoder->VideoSkippedChange = TRUE;
+		}
+		Encoder__DropVideo(Encoder, Time, TimePeriod);
+		return FALSE;
+	}
+
+	uint32_t Index;
+	if (Action == CpuDropAction_Drop || !Encoder__AcquireVideoSample(Encoder, &Index))
+	{
+		Encoder__DropVideo(Encoder, Time, TimePeriod);
+		return FALSE;
+	}
+
+	ID3D11DeviceContext* Context = Encoder->Context;
+	ID3D11Multithread_Enter(Encoder->Multithread);
 
-	IMFSample_Release(Sample);
+	Encoder__CopyInput(Encoder, Texture, Rect);
+
+	// hashes are compared on CPU only 1 or 2 frames later, so hashing never waits for GPU
+	// when overloaded, frame is hashed only for finding dirty blocks of next conversion
+	UINT64 LastChangedFrame = Encoder->Hash.ChangedFrame;
+	if (Encoder->HashFrames)
+	{
+		FrameHash_Update(&Encoder->Hash, Context);
+	}
+
+	if (Encoder->HashFrames && Action != CpuDropAction_EncodeCheap)
+	{
+		// skip frame while no change after last converted frame is known, frame after discontinuity is always encoded
+		// changed frame skipped this way is encoded when its hashes are compared, by one of next frames or Encoder_Update
+		// while last compared frame has changed, frames not compared yet are expected to change too & are not skipped
+		// with adaptive framerate small changes are skipped too, until next encode time when screen is static
+		BOOL Changed = Encoder->Hash.ChangedFrame > Encoder->VideoHashFrame || Encoder->Hash.ChangedFrame == Encoder->Hash.Compared;
+		BOOL Static = Encoder->AdaptiveFramerate && Encoder__IsStatic(Encoder, Time, TimePeriod);
+
+		// keyframe on scene change makes seeking to it fast, and encoder does not waste bits on predicting from previous scene
+		// Luma is thumbnail of last changed frame, so detector sees every change once
+		if (Encoder->SceneKeyframes && Encoder->Hash.ChangedFrame != LastChangedFrame && CpuScene_Detect(&Encoder->Scene, Encoder->Hash.Luma))
+		{
+			if (Time - Encoder->VideoLastKeyframe >= TimePeriod * ENCODER_SCENE_INTERVAL / 1000)
+			{
+				Encoder->VideoLastKeyframe = Time;
+				Encoder->VideoKeyframe = TRUE;
+			}
+			Static = FALSE;
+		}
 
+		BOOL Skip = FALSE;
+		if (Encoder->SkipDuplicates && Encoder->VideoPendingIndex != ENCODER_VIDEO_BUFFER_COUNT)
+		{
+			if (!Changed && !Encoder->VideoSkippedChange)
+			{
+				Encoder->VideoDuplicateCount++;
+				Skip = TRUE;
+			}
+			else if (Static && Time < Encoder->VideoRate.NextEncode)
+			{
+				Encoder->VideoSkippedChange = TRUE;
+				Encoder->VideoStaticCount++;
+				Skip = TRUE;
+			}
+		}
+
+		if (Skip)
+		{
+			ID3D11Multithread_Leave(Encoder->Multithread);
+			CpuSlots_Recycle(&Encoder->VideoSampleAvailable, Index);
+
+			// extend previous sample to one frame after this time, in case this is last frame
+			LONGLONG SampleTime;
+			HR(IMFSample_GetSampleTime(Encoder->VideoSample[Encoder->VideoPendingIndex], &SampleTime));
+			LONGLONG Duration = MFllMulDiv(Encoder->FramerateDen, MF_UNITS_PER_SECOND, Encoder->FramerateNum, 0);
+			Encoder__SetVideoDuration(Encoder, Encoder->VideoPendingIndex, Encoder__VideoTimestamp(Encoder, Time, TimePeriod) - SampleTime + Duration);
+			return TRUE;
+		}
+	}
+
+	ID3D11Multithread_Leave(Encoder->Multithread);
+
+	Encoder__EncodeInput(Encoder, Index, FALSE, Time, TimePeriod);
 	return TRUE;
 }
 
@@ -977,13 +1575,69 @@ void Encoder_NewSamples(Encoder* Encoder, LPCVOID Samples, DWORD FrameCount, UIN
 
 void Encoder_Update(Encoder* Encoder, UINT64 Time, UINT64 TimePeriod)
 {
+	if (Encoder->HashFrames)
+	{
+		ID3D11Multithread_Enter(Encoder->Multithread);
+		FrameHash_Poll(&Encoder->Hash, Encoder->Context);
+		ID3D11Multithread_Leave(Encoder->Multithread);
+
+		// frame skipped before its hashes were compared has changed, unless screen is static it is encoded now
+		if (Encoder->Hash.ChangedFrame > Encoder->VideoHashFrame && !Encoder->VideoSkippedChange)
+		{
+			Encoder->VideoSkippedChange = TRUE;
+			if (!Encoder->AdaptiveFramerate || !Encoder__IsStatic(Encoder, Time, TimePeriod))
+			{
+				Encoder->VideoRate.NextEncode = Time;
+			}
+		}
+	}
+
+	// encode small changes skipped by adaptive framerate or late hashes, when no new frame has arrived after them
+	if (Encoder->VideoSkippedChange && Time >= Encoder->VideoRate.NextEncode)
+	{
+		uint32_t Index;
+		if (Encoder__AcquireVideoSample(Encoder, &Index))
+		{
+			Encoder->VideoLastTime = Time;
+			Encoder__EncodeInput(Encoder, Index, FALSE, Time, TimePeriod);
+		}
+	}
+
 	// if there was no frame during last second, add discontinuity
 	if ((int64_t)(Time - Encoder->VideoLastTime) >= (int64_t)TimePeriod)
 	{
 		Encoder->VideoLastTime = Time;
-		LONGLONG Timestamp = MFllMulDiv(Time - Encoder->StartTime, MF_UNITS_PER_SECOND, TimePeriod, 0);
-		HR(IMFSinkWriter_SendStreamTick(Encoder->Writer, Encoder->VideoStreamIndex, Timestamp));
-		Encoder->VideoDiscontinuity = TRUE;
+		Encoder__DropVideo(Encoder, Time, TimePeriod);
+	}
+}
+
+void Encoder_UpdateCursor(Encoder* Encoder, POINT Origin, UINT64 Time, UINT64 TimePeriod)
+{
+	if (CursorOverlay_Update(&Encoder->Cursor, Origin))
+	{
+		Encoder->VideoCursorChanged = TRUE;
+	}
+
+	// nothing to draw cursor on before first frame
+	if (!Encoder->VideoCursorChanged || Encoder->StartTime == 0)
+	{
+		return;
+	}
+
+	// cursor changes are encoded at most at video framerate, new frames draw current cursor anyway
+	if ((int64_t)(Time - Encoder->VideoLastTime) * Encoder->FramerateNum < (int64_t)(TimePeriod * Encoder->FramerateDen))
+	{
+		return;
+	}
+
+	// input may have changed after last conversion, when frame was skipped before its hashes were compared
+	BOOL CursorOnly = !Encoder->HashFrames || Encoder->Hash.Frames == Encoder->VideoHashFrame;
+
+	uint32_t Index;
+	if (Encoder__AcquireVideoSample(Encoder, &Index))
+	{
+		Encoder->VideoLastTime = Time;
+		Encoder__EncodeInput(Encoder, Index, CursorOnly, Time, TimePeriod);
 	}
 }
 
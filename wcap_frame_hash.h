@@ -0,0 +1,329 @@
+#pragma once
+
+#include "wcap.h"
+#include "wcap_cpu_hash.h"
+#include <d3d11.h>
+
+//
+// interface
+//
+
+#define FRAME_HASH_STAGING_COUNT 3
+
+typedef struct
+{
+	ID3D11ShaderResourceView* InputView;
+	ID3D11UnorderedAccessView* OutputView;
+	ID3D11UnorderedAccessView* LumaView;
+	ID3D11ComputeShader* Shader;
+	ID3D11ComputeShader* DirtyShader;
+	ID3D11Buffer* Output;
+	ID3D11ShaderResourceView* OutputHashView;
+	ID3D11Buffer* LumaOutput;
+	ID3D11Buffer* Previous; // hashes of frame when FrameHash_Compare was called last time
+	ID3D11ShaderResourceView* PreviousView;
+	ID3D11Buffer* DirtyInfo;
+	ID3D11Buffer* Dirty;
+	ID3D11UnorderedAccessView* DirtyAppendView;
+	ID3D11ShaderResourceView* DirtyView; // positions of dirty blocks for YuvConvert_DispatchTilesIndirect
+	ID3D11Buffer* DirtyArgs;             // dispatch arguments with count of dirty blocks
+	ID3D11Buffer* Staging[FRAME_HASH_STAGING_COUNT]; // hashes followed by luma values
+	uint64_t StagingFrame[FRAME_HASH_STAGING_COUNT];
+	uint64_t Write;        // hashes copied to staging buffers
+	uint64_t Read;         // hashes compared on CPU
+	uint64_t Frames;       // frames hashed, also number of last one
+	uint64_t ChangedFrame; // number of last frame that is known to differ from frame before it
+	uint64_t Compared;     // number of last compared frame
+	uint32_t* Hashes;      // last compared frame, 2 values for every block
+	uint8_t* Luma;         // last changed frame, average luma of every block
+	uint32_t* DirtyBlocks;
+	uint32_t DirtyCount;   // blocks around changes in last compared frame, equal to BlockCount when whole frame changed
+	uint32_t BlockCount;
+	uint32_t BlockCountX;
+	uint32_t BlockCountY;
+	bool Valid;            // false until first frame is compared
+}
+FrameHash;
+
+// hashes blocks of B8G8R8A8 input texture on GPU, values are same as CpuHash_Run would calculate from same pixels
+// together with hashes calculates BlockCountX x BlockCountY thumbnail of frame luma
+static void FrameHash_Create(FrameHash* Hash, ID3D11Device* Device, ID3D11Texture2D* InputTexture, uint32_t Width, uint32_t Height);
+static void FrameHash_Release(FrameHash* Hash);
+
+// hashes current input texture contents & queues copy of hashes to staging buffer, never waits for GPU
+// hashes are compared on CPU to ones of previous frame only when they are mapped 1 or 2 frames later,
+// so ChangedFrame, DirtyCount & Luma describe older frames, current one is number Frames
+static void FrameHash_Update(FrameHash* Hash, ID3D11DeviceContext* Context);
+
+// compares hashes that GPU has finished copying without hashing new frame, for when new frames are not arriving
+static void FrameHash_Poll(FrameHash* Hash, ID3D11DeviceContext* Context);
+
+// compares hashes of last FrameHash_Update with ones from previous call of this function on GPU
+// afterwards DirtyView has blocks that need to be converted again & DirtyArgs has their count, nothing is read back
+static void FrameHash_Compare(FrameHash* Hash, ID3D11DeviceContext* Context);
+
+//
+// implementation
+//
+
+#include <d3dcompiler.h>
+
+#include "shaders/FrameHash.h"
+#include "shaders/FrameHashDirty.h"
+
+void FrameHash_Create(FrameHash* Hash, ID3D11Device* Device, ID3D11Texture2D* InputTexture, uint32_t Width, uint32_t Height)
+{
+	Hash->BlockCountX = DIV_ROUND_UP(Width, CPU_HASH_BLOCK_SIZE);
+	Hash->BlockCountY = DIV_ROUND_UP(Height, CPU_HASH_BLOCK_SIZE);
+	Hash->Write = 0;
+	Hash->Read = 0;
+	Hash->Frames = 0;
+	Hash->ChangedFrame = 0;
+	Hash->Compared = 0;
+	Hash->Valid = false;
+
+	uint32_t BlockCount = Hash->BlockCountX * Hash->BlockCountY;
+	Hash->BlockCount = BlockCount;
+	Hash->DirtyCount = BlockCount;
+	Hash->Hashes = Cpu_Alloc(2 * BlockCount * sizeof(uint32_t));
+	Hash->DirtyBlocks = Cpu_Alloc(BlockCount * sizeof(uint32_t));
+	Hash->Luma = Cpu_Alloc(BlockCount);
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC InputViewDesc =
+	{
+		.Format = DXGI_FORMAT_B8G8R8A8_UNORM,
+		.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D,
+		.Texture2D.MipLevels = -1,
+	};
+	ID3D11Device_CreateShaderResourceView(Device, (ID3D11Resource*)InputTexture, &InputViewDesc, &Hash->InputView);
+
+	D3D11_BUFFER_DESC OutputDesc =
+	{
+		.ByteWidth = 2 * BlockCount * sizeof(uint32_t),
+		.Usage = D3D11_USAGE_DEFAULT,
+		.BindFlags = D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_SHADER_RESOURCE,
+		.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED,
+		.StructureByteStride = 2 * sizeof(uint32_t),
+	};
+	ID3D11Device_CreateBuffer(Device, &OutputDesc, NULL, &Hash->Output);
+
+	D3D11_UNORDERED_ACCESS_VIEW_DESC OutputViewDesc =
+	{
+		.Format = DXGI_FORMAT_UNKNOWN,
+		.ViewDimension = D3D11_UAV_DIMENSION_BUFFER,
+		.Buffer.NumElements = BlockCount,
+	};
+	ID3D11Device_CreateUnorderedAccessView(Device, (ID3D11Resource*)Hash->Output, &OutputViewDesc, &Hash->OutputView);
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC HashViewDesc =
+	{
+		.Format = DXGI_FORMAT_UNKNOWN,
+		.ViewDimension = D3D11_SRV_DIMENSION_BUFFER,
+		.Buffer.NumElements = BlockCount,
+	};
+	ID3D11Device_CreateShaderResourceView(Device, (ID3D11Resource*)Hash->Output, &HashViewDesc, &Hash->OutputHashView);
+
+	D3D11_BUFFER_DESC PreviousDesc = OutputDesc;
+	PreviousDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	ID3D11Device_CreateBuffer(Device, &PreviousDesc, NULL, &Hash->Previous);
+	ID3D11Device_CreateShaderResourceView(Device, (ID3D11Resource*)Hash->Previous, &HashViewDesc, &Hash->PreviousView);
+
+	D3D11_BUFFER_DESC LumaDesc =
+	{
+		.ByteWidth = BlockCount * sizeof(uint32_t),
+		.Usage = D3D11_USAGE_DEFAULT,
+		.BindFlags = D3D11_BIND_UNORDERED_ACCESS,
+		.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED,
+		.StructureByteStride = sizeof(uint32_t),
+	};
+	ID3D11Device_CreateBuffer(Device, &LumaDesc, NULL, &Hash->LumaOutput);
+	ID3D11Device_CreateUnorderedAccessView(Device, (ID3D11Resource*)Hash->LumaOutput, &OutputViewDesc, &Hash->LumaView);
+
+	D3D11_BUFFER_DESC StagingDesc =
+	{
+		.ByteWidth = 3 * BlockCount * sizeof(uint32_t),
+		.Usage = D3D11_USAGE_STAGING,
+		.CPUAccessFlags = D3D11_CPU_ACCESS_READ,
+	};
+	for (uint32_t Slot = 0; Slot < FRAME_HASH_STAGING_COUNT; Slot++)
+	{
+		ID3D11Device_CreateBuffer(Device, &StagingDesc, NULL, &Hash->Staging[Slot]);
+	}
+
+	uint32_t DirtyInfo[4] = { Hash->BlockCountX, Hash->BlockCountY };
+	D3D11_BUFFER_DESC DirtyInfoDesc =
+	{
+		.ByteWidth = sizeof(DirtyInfo),
+		.Usage = D3D11_USAGE_IMMUTABLE,
+		.BindFlags = D3D11_BIND_CONSTANT_BUFFER,
+	};
+	D3D11_SUBRESOURCE_DATA DirtyInfoData = { .pSysMem = DirtyInfo };
+	ID3D11Device_CreateBuffer(Device, &DirtyInfoDesc, &DirtyInfoData, &Hash->DirtyInfo);
+
+	D3D11_BUFFER_DESC DirtyDesc =
+	{
+		.ByteWidth = BlockCount * sizeof(uint32_t),
+		.Usage = D3D11_USAGE_DEFAULT,
+		.BindFlags = D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_SHADER_RESOURCE,
+		.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED,
+		.StructureByteStride = sizeof(uint32_t),
+	};
+	ID3D11Device_CreateBuffer(Device, &DirtyDesc, NULL, &Hash->Dirty);
+
+	D3D11_UNORDERED_ACCESS_VIEW_DESC DirtyAppendViewDesc =
+	{
+		.Format = DXGI_FORMAT_UNKNOWN,
+		.ViewDimension = D3D11_UAV_DIMENSION_BUFFER,
+		.Buffer.NumElements = BlockCount,
+		.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_APPEND,
+	};
+	ID3D11Device_CreateUnorderedAccessView(Device, (ID3D11Resource*)Hash->Dirty, &DirtyAppendViewDesc, &Hash->DirtyAppendView);
+	ID3D11Device_CreateShaderResourceView(Device, (ID3D11Resource*)Hash->Dirty, &HashViewDesc, &Hash->DirtyView);
+
+	// group count Y & Z stay 1, X is overwritten with count of dirty blocks
+	uint32_t DirtyArgs[3] = { 0, 1, 1 };
+	D3D11_BUFFER_DESC DirtyArgsDesc =
+	{
+		.ByteWidth = sizeof(DirtyArgs),
+		.Usage = D3D11_USAGE_DEFAULT,
+		.MiscFlags = D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS,
+	};
+	D3D11_SUBRESOURCE_DATA DirtyArgsData = { .pSysMem = DirtyArgs };
+	ID3D11Device_CreateBuffer(Device, &DirtyArgsDesc, &DirtyArgsData, &Hash->DirtyArgs);
+
+	ID3DBlob* Shader;
+	HR(D3DDecompressShaders(FrameHashShaderBytes, sizeof(FrameHashShaderBytes), 1, 0, NULL, 0, &Shader, NULL));
+	ID3D11Device_CreateComputeShader(Device, ID3D10Blob_GetBufferPointer(Shader), ID3D10Blob_GetBufferSize(Shader), NULL, &Hash->Shader);
+	ID3D10Blob_Release(Shader);
+
+	HR(D3DDecompressShaders(FrameHashDirtyShaderBytes, sizeof(FrameHashDirtyShaderBytes), 1, 0, NULL, 0, &Shader, NULL));
+	ID3D11Device_CreateComputeShader(Device, ID3D10Blob_GetBufferPointer(Shader), ID3D10Blob_GetBufferSize(Shader), NULL, &Hash->DirtyShader);
+	ID3D10Blob_Release(Shader);
+}
+
+void FrameHash_Release(FrameHash* Hash)
+{
+	ID3D11ShaderResourceView_Release(Hash->InputView);
+	ID3D11UnorderedAccessView_Release(Hash->OutputView);
+	ID3D11ShaderResourceView_Release(Hash->OutputHashView);
+	ID3D11UnorderedAccessView_Release(Hash->LumaView);
+	ID3D11ComputeShader_Release(Hash->Shader);
+	ID3D11ComputeShader_Release(Hash->DirtyShader);
+	ID3D11Buffer_Release(Hash->Output);
+	ID3D11Buffer_Release(Hash->LumaOutput);
+	ID3D11ShaderResourceView_Release(Hash->PreviousView);
+	ID3D11Buffer_Release(Hash->Previous);
+	for (uint32_t Slot = 0; Slot < FRAME_HASH_STAGING_COUNT; Slot++)
+	{
+		ID3D11Buffer_Release(Hash->Staging[Slot]);
+	}
+	ID3D11Buffer_Release(Hash->DirtyInfo);
+	ID3D11UnorderedAccessView_Release(Hash->DirtyAppendView);
+	ID3D11ShaderResourceView_Release(Hash->DirtyView);
+	ID3D11Buffer_Release(Hash->Dirty);
+	ID3D11Buffer_Release(Hash->DirtyArgs);
+	Cpu_Free(Hash->Hashes);
+	Cpu_Free(Hash->DirtyBlocks);
+	Cpu_Free(Hash->Luma);
+}
+
+static void FrameHash__Process(FrameHash* Hash, const void* Data, uint64_t Frame)
+{
+	size_t Size = 2 * Hash->BlockCount * sizeof(uint32_t);
+	Hash->Compared = Frame;
+
+	if (Hash->Valid && memcmp(Hash->Hashes, Data, Size) == 0)
+	{
+		Hash->DirtyCount = 0;
+		return;
+	}
+
+	Hash->DirtyCount = CpuHash_DirtyBlocks(Hash->Valid ? Hash->Hashes : NULL, Data, Hash->BlockCountX, Hash->BlockCountY, Hash->DirtyBlocks);
+	memcpy(Hash->Hashes, Data, Size);
+	Hash->Valid = true;
+
+	const uint32_t* Luma = (const uint32_t*)((const uint8_t*)Data + Size);
+	for (uint32_t Index = 0; Index < Hash->BlockCount; Index++)
+	{
+		Hash->Luma[Index] = (uint8_t)Luma[Index];
+	}
+
+	// frame that was not copied to staging buffer can have larger number
+	Hash->ChangedFrame = Frame > Hash->ChangedFrame ? Frame : Hash->ChangedFrame;
+}
+
+static void FrameHash__Read(FrameHash* Hash, ID3D11DeviceContext* Context, bool All)
+{
+	// hashes are compared in order, so newer ones wait while older are not finished
+	while (Hash->Read != Hash->Write && (All || Hash->Write - Hash->Read >= FRAME_HASH_STAGING_COUNT - 1))
+	{
+		uint32_t Slot = (uint32_t)(Hash->Read % FRAME_HASH_STAGING_COUNT);
+
+		D3D11_MAPPED_SUBRESOURCE Mapped;
+		HRESULT hr = ID3D11DeviceContext_Map(Context, (ID3D11Resource*)Hash->Staging[Slot], 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &Mapped);
+		if (hr == DXGI_ERROR_WAS_STILL_DRAWING)
+		{
+			break;
+		}
+		HR(hr);
+
+		FrameHash__Process(Hash, Mapped.pData, Hash->StagingFrame[Slot]);
+
+		ID3D11DeviceContext_Unmap(Context, (ID3D11Resource*)Hash->Staging[Slot], 0);
+		Hash->Read++;
+	}
+}
+
+void FrameHash_Update(FrameHash* Hash, ID3D11DeviceContext* Context)
+{
+	FrameHash__Read(Hash, Context, false);
+
+	ID3D11UnorderedAccessView* OutputViews[] = { Hash->OutputView, Hash->LumaView };
+
+	ID3D11DeviceContext_ClearState(Context);
+	ID3D11DeviceContext_CSSetShader(Context, Hash->Shader, NULL, 0);
+	ID3D11DeviceContext_CSSetShaderResources(Context, 0, 1, &Hash->InputView);
+	ID3D11DeviceContext_CSSetUnorderedAccessViews(Context, 0, ARRAYSIZE(OutputViews), OutputViews, NULL);
+	ID3D11DeviceContext_Dispatch(Context, Hash->BlockCountX, Hash->BlockCountY, 1);
+
+	uint64_t Frame = ++Hash->Frames;
+	if (Hash->Write - Hash->Read == FRAME_HASH_STAGING_COUNT)
+	{
+		// GPU is late with all earlier copies, changes of this frame will be seen only when next one is compared
+		// until then it is treated as changed, so it is not skipped as duplicate
+		Hash->ChangedFrame = Frame;
+		return;
+	}
+
+	uint32_t Slot = (uint32_t)(Hash->Write % FRAME_HASH_STAGING_COUNT);
+	ID3D11Resource* Staging = (ID3D11Resource*)Hash->Staging[Slot];
+
+	size_t Size = 2 * Hash->BlockCount * sizeof(uint32_t);
+	ID3D11DeviceContext_CopySubresourceRegion(Context, Staging, 0, 0, 0, 0, (ID3D11Resource*)Hash->Output, 0, NULL);
+	ID3D11DeviceContext_CopySubresourceRegion(Context, Staging, 0, (UINT)Size, 0, 0, (ID3D11Resource*)Hash->LumaOutput, 0, NULL);
+
+	Hash->StagingFrame[Slot] = Frame;
+	Hash->Write++;
+}
+
+void FrameHash_Poll(FrameHash* Hash, ID3D11DeviceContext* Context)
+{
+	FrameHash__Read(Hash, Context, true);
+}
+
+void FrameHash_Compare(FrameHash* Hash, ID3D11DeviceContext* Context)
+{
+	ID3D11ShaderResourceView* InputViews[] = { Hash->OutputHashView, Hash->PreviousView };
+	UINT InitialCount = 0;
+
+	ID3D11DeviceContext_ClearState(Context);
+	ID3D11DeviceContext_CSSetShader(Context, Hash->DirtyShader, NULL, 0);
+	ID3D11DeviceContext_CSSetConstantBuffers(Context, 0, 1, &Hash->DirtyInfo);
+	ID3D11DeviceContext_CSSetShaderResources(Context, 0, ARRAYSIZE(InputViews), InputViews);
+	ID3D11DeviceContext_CSSetUnorderedAccessViews(Context, 0, 1, &Hash->DirtyAppendView, &InitialCount);
+	ID3D11DeviceContext_Dispatch(Context, DIV_ROUND_UP(Hash->BlockCountX, 8), DIV_ROUND_UP(Hash->BlockCountY, 8), 1);
+	ID3D11DeviceContext_ClearState(Context);
+
+	ID3D11DeviceContext_CopyStructureCount(Context, Hash->DirtyArgs, 0, Hash->DirtyAppendView);
+	ID3D11DeviceContext_CopyResource(Context, (ID3D11Resource*)Hash->Previous, (ID3D11Resource*)Hash->Output);
+}
@@ -0,0 +1,308 @@
+#pragma once
+
+#include "wcap_cpu.h"
+
+//
+// interface
+//
+
+// same order as CONFIG_RESIZE_* values in wcap_config.h
+typedef enum
+{
+	ResizeFilter_Bilinear,
+	ResizeFilter_Area,       // exact pixel area overlap
+	ResizeFilter_CatmullRom, // cubic with B=0, C=1/2
+	ResizeFilter_Mitchell,   // cubic with B=C=1/3
+	ResizeFilter_Lanczos3,
+}
+ResizeFilter;
+
+// filter taps for resizing in one direction, shared by GPU & CPU resizers
+typedef struct
+{
+	uint32_t* Start;    // first input index for each output index
+	float* Weights;     // TapCount normalized weights for each output index
+	uint32_t TapCount;  // same for all outputs, unused taps have zero weight
+	uint32_t InputSize;
+	uint32_t OutputSize;
+}
+ResizeTable;
+
+// large downscales first do exact integer box reduction, then filter passes resize reduced image to output
+// this keeps number of filter taps low instead of growing with scale factor
+typedef struct
+{
+	uint32_t InputWidth;
+	uint32_t InputHeight;
+	uint32_t OutputWidth;
+	uint32_t OutputHeight;
+	ResizeFilter Filter;
+	uint32_t ReduceX;       // box size for reduction, 1 means no reduction in this direction
+	uint32_t ReduceY;
+	uint32_t ReducedWidth;  // input size for filter passes
+	uint32_t ReducedHeight;
+	uint32_t TapCountH;
+	uint32_t TapCountV;
+	bool VerticalFirst;     // order of filter passes, chosen by estimated cost
+	uint32_t MiddleWidth;   // image size between filter passes
+	uint32_t MiddleHeight;
+	uint64_t Cost;          // estimated multiply-adds of filter passes + writing & reading middle image, in pixels
+}
+ResizePlan;
+
+static void ResizePlan_Create(ResizePlan* Plan, uint32_t InputWidth, uint32_t InputHeight, uint32_t OutputWidth, uint32_t OutputHeight, ResizeFilter Filter);
+
+// plan with given box size of integer reduction & order of filter passes, instead of ones chosen by ResizePlan_Create
+// ReduceX & ReduceY must divide input size exactly, 1 means no reduction in this direction
+static void ResizePlan_CreateFixed(ResizePlan* Plan, uint32_t InputWidth, uint32_t InputHeight, uint32_t OutputWidth, uint32_t OutputHeight, ResizeFilter Filter, uint32_t ReduceX, uint32_t ReduceY, bool VerticalFirst);
+
+static void ResizeTable_Create(ResizeTable* Table, uint32_t InputSize, uint32_t OutputSize, ResizeFilter Filter);
+static void ResizeTable_Release(ResizeTable* Table);
+
+//
+// implementation
+//
+
+// filter functions take distance X in output pixels, Scale is size of input pixel in output pixels
+// wcap only downscales, so filters are stretched over input pixels for antialiasing
+
+static float ResizeFilter__Cubic(float X, float B, float C)
+{
+	// https://en.wikipedia.org/wiki/Mitchell%E2%80%93Netravali_filters
+
+	X = fabsf(X);
+
+	if (X < 1.f)
+	{
+		float X2 = X * X;
+		float X3 = X * X2;
+		return ((12 - 9 * B - 6 * C) * X3 + (-18 + 12 * B + 6 * C) * X2 + (6 - 2 * B)) / 6;
+	}
+	else if (X < 2.f)
+	{
+		float X2 = X * X;
+		float X3 = X * X2;
+		return ((-B - 6 * C) * X3 + (6 * B + 30 * C) * X2 + (-12 * B - 48 * C) * X + (8 * B + 24 * C)) / 6;
+	}
+
+	return 0.f;
+}
+
+static float ResizeFilter__Bilinear(float X, float Scale)
+{
+	(void)Scale;
+	X = fabsf(X);
+	return X < 1.f ? 1.f - X : 0.f;
+}
+
+static float ResizeFilter__Area(float X, float Scale)
+{
+	// overlap of output pixel [-0.5, +0.5] with input pixel centered at X
+	float Low = X - 0.5f * Scale;
+	float High = X + 0.5f * Scale;
+	Low = Low > -0.5f ? Low : -0.5f;
+	High = High < 0.5f ? High : 0.5f;
+	return High > Low ? High - Low : 0.f;
+}
+
+static float ResizeFilter__CatmullRom(float X, float Scale)
+{
+	(void)Scale;
+	return ResizeFilter__Cubic(X, 0.f, 0.5f);
+}
+
+static float ResizeFilter__Mitchell(float X, float Scale)
+{
+	(void)Scale;
+	return ResizeFilter__Cubic(X, 1.f / 3.f, 1.f / 3.f);
+}
+
+static float ResizeFilter__Lanczos3(float X, float Scale)
+{
+	(void)Scale;
+	const float Pi = 3.14159265358979f;
+
+	X = fabsf(X);
+
+	if (X < 1e-5f)
+	{
+		return 1.f;
+	}
+	else if (X < 3.f)
+	{
+		return 3.f * sinf(Pi * X) * sinf(Pi * X / 3.f) / (Pi * Pi * X * X);
+	}
+
+	return 0.f;
+}
+
+static float ResizeFilter__Support(ResizeFilter Filter, float Scale)
+{
+	switch (Filter)
+	{
+	case ResizeFilter_Bilinear:   return 1.f;
+	case ResizeFilter_Area:       return 0.5f + 0.5f * Scale;
+	case ResizeFilter_CatmullRom: return 2.f;
+	case ResizeFilter_Mitchell:   return 2.f;
+	case ResizeFilter_Lanczos3:   return 3.f;
+	default: Assert(false); return 2.f;
+	}
+}
+
+static void ResizeFilter__Window(float InputPos, float Size, uint32_t InputSize, uint32_t* Start, uint32_t* End)
+{
+	// filter is 0 outside of [InputPos-Size, InputPos+Size], End is exclusive
+	int32_t StartPos = (int32_t)(InputPos - Size + 0.5f);
+	int32_t EndPos = (int32_t)(InputPos + Size + 0.5f);
+	StartPos = StartPos < 0 ? 0 : StartPos > (int32_t)InputSize - 1 ? (int32_t)InputSize - 1 : StartPos;
+	EndPos = EndPos < StartPos + 1 ? StartPos + 1 : EndPos > (int32_t)InputSize ? (int32_t)InputSize : EndPos;
+	*Start = (uint32_t)StartPos;
+	*End = (uint32_t)EndPos;
+}
+
+static uint32_t ResizeFilter__TapCount(uint32_t InputSize, uint32_t OutputSize, ResizeFilter Filter)
+{
+	float Scale = (float)OutputSize / InputSize;
+	float Size = ResizeFilter__Support(Filter, Scale) / Scale;
+
+	uint32_t TapCount = 1;
+	for (uint32_t Index = 0; Index < OutputSize; Index++)
+	{
+		uint32_t Start, End;
+		ResizeFilter__Window((Index + 0.5f) / Scale, Size, InputSize, &Start, &End);
+		TapCount = End - Start > TapCount ? End - Start : TapCount;
+	}
+	return TapCount;
+}
+
+static uint32_t ResizePlan__ReduceFactor(uint32_t InputSize, uint32_t OutputSize)
+{
+	// reduce only to at least 2x of output size, so filter pass still does the antialiasing
+	// factor must divide input size exactly, otherwise reduced pixel grid would not match input
+	for (uint32_t Factor = InputSize / (2 * OutputSize); Factor >= 2; Factor--)
+	{
+		if (InputSize % Factor == 0)
+		{
+			return Factor;
+		}
+	}
+	return 1;
+}
+
+void ResizePlan_CreateFixed(ResizePlan* Plan, uint32_t InputWidth, uint32_t InputHeight, uint32_t OutputWidth, uint32_t OutputHeight, ResizeFilter Filter, uint32_t ReduceX, uint32_t ReduceY, bool VerticalFirst)
+{
+	Assert(InputWidth % ReduceX == 0 && InputHeight % ReduceY == 0);
+
+	uint32_t ReducedWidth = InputWidth / ReduceX;
+	uint32_t ReducedHeight = InputHeight / ReduceY;
+	uint32_t TapCountH = ResizeFilter__TapCount(ReducedWidth, OutputWidth, Filter);
+	uint32_t TapCountV = ResizeFilter__TapCount(ReducedHeight, OutputHeight, Filter);
+
+	// horizontal first:  ReducedWidth x ReducedHeight -> OutputWidth x ReducedHeight -> OutputWidth x OutputHeight
+	// vertical first:    ReducedWidth x ReducedHeight -> ReducedWidth x OutputHeight -> OutputWidth x OutputHeight
+	uint64_t Middle = VerticalFirst ? (uint64_t)ReducedWidth * OutputHeight : (uint64_t)OutputWidth * ReducedHeight;
+	uint64_t Final = (uint64_t)OutputWidth * OutputHeight;
+	uint64_t Cost = VerticalFirst
+		? Middle * TapCountV + Final * TapCountH + 2 * Middle
+		: Middle * TapCountH + Final * TapCountV + 2 * Middle;
+
+	*Plan = (ResizePlan)
+	{
+		.InputWidth = InputWidth,
+		.InputHeight = InputHeight,
+		.OutputWidth = OutputWidth,
+		.OutputHeight = OutputHeight,
+		.Filter = Filter,
+		.ReduceX = ReduceX,
+		.ReduceY = ReduceY,
+		.ReducedWidth = ReducedWidth,
+		.ReducedHeight = ReducedHeight,
+		.TapCountH = TapCountH,
+		.TapCountV = TapCountV,
+		.VerticalFirst = VerticalFirst,
+		.MiddleWidth = VerticalFirst ? ReducedWidth : OutputWidth,
+		.MiddleHeight = VerticalFirst ? OutputHeight : ReducedHeight,
+		.Cost = Cost,
+	};
+}
+
+void ResizePlan_Create(ResizePlan* Plan, uint32_t InputWidth, uint32_t InputHeight, uint32_t OutputWidth, uint32_t OutputHeight, ResizeFilter Filter)
+{
+	uint32_t ReduceX = ResizePlan__ReduceFactor(InputWidth, OutputWidth);
+	uint32_t ReduceY = ResizePlan__ReduceFactor(InputHeight, OutputHeight);
+
+	// cheaper order of filter passes, same scale in both directions costs same in both orders
+	// then vertical pass goes first, on CPU it reads whole rows & is faster over larger input
+	ResizePlan Vertical;
+	ResizePlan_CreateFixed(Plan, InputWidth, InputHeight, OutputWidth, OutputHeight, Filter, ReduceX, ReduceY, false);
+	ResizePlan_CreateFixed(&Vertical, InputWidth, InputHeight, OutputWidth, OutputHeight, Filter, ReduceX, ReduceY, true);
+	if (Vertical.Cost <= Plan->Cost)
+	{
+		*Plan = Vertical;
+	}
+}
+
+// inlined separately for each filter, so filter function calls & switches are not in the inner loops
+CPU_INLINE void ResizeTable__Create(ResizeTable* Table, uint32_t InputSize, uint32_t OutputSize, ResizeFilter Filter, float (*FilterFunc)(float X, float Scale))
+{
+	float Scale = (float)OutputSize / InputSize;
+	float Size = ResizeFilter__Support(Filter, Scale) / Scale;
+
+	uint32_t TapCount = ResizeFilter__TapCount(InputSize, OutputSize, Filter);
+
+	Table->Start = Cpu_Alloc(OutputSize * sizeof(*Table->Start));
+	Table->Weights = Cpu_Alloc(OutputSize * TapCount * sizeof(*Table->Weights));
+	Table->TapCount = TapCount;
+	Table->InputSize = InputSize;
+	Table->OutputSize = OutputSize;
+
+	for (uint32_t Index = 0; Index < OutputSize; Index++)
+	{
+		float Center = Index + 0.5f;
+
+		uint32_t Start, End;
+		ResizeFilter__Window(Center / Scale, Size, InputSize, &Start, &End);
+
+		float WeightSum = 0;
+		for (uint32_t Pos = Start; Pos < End; Pos++)
+		{
+			WeightSum += FilterFunc(Center - (Pos + 0.5f) * Scale, Scale);
+		}
+
+		// keep all taps inside input, unused ones get zero weight
+		uint32_t Shift = Start + TapCount > InputSize ? Start + TapCount - InputSize : 0;
+
+		float* Weights = Table->Weights + Index * TapCount + Shift;
+		if (WeightSum == 0)
+		{
+			Weights[0] = 1.f;
+		}
+		else
+		{
+			for (uint32_t Pos = Start; Pos < End; Pos++)
+			{
+				*Weights++ = FilterFunc(Center - (Pos + 0.5f) * Scale, Scale) / WeightSum;
+			}
+		}
+		Table->Start[Index] = Start - Shift;
+	}
+}
+
+void ResizeTable_Create(ResizeTable* Table, uint32_t InputSize, uint32_t OutputSize, ResizeFilter Filter)
+{
+	switch (Filter)
+	{
+	case ResizeFilter_Bilinear:   ResizeTable__Create(Table, InputSize, OutputSize, Filter, &ResizeFilter__Bilinear);   break;
+	case ResizeFilter_Area:       ResizeTable__Create(Table, InputSize, OutputSize, Filter, &ResizeFilter__Area);       break;
+	case ResizeFilter_CatmullRom: ResizeTable__Create(Table, InputSize, OutputSize, Filter, &ResizeFilter__CatmullRom); break;
+	case ResizeFilter_Mitchell:   ResizeTable__Create(Table, InputSize, OutputSize, Filter, &ResizeFilter__Mitchell);   break;
+	case ResizeFilter_Lanczos3:   ResizeTable__Create(Table, InputSize, OutputSize, Filter, &ResizeFilter__Lanczos3);   break;
+	default: Assert(false);
+	}
+}
+
+void ResizeTable_Release(ResizeTable* Table)
+{
+	Cpu_Free(Table->Start);
+	Cpu_Free(Table->Weights);
+}
@@ -50,8 +50,10 @@ typedef struct ScreenCapture
 	EventRegistrationToken OnCloseToken;
 
 	__x_ABI_CWindows_CGraphics_CSizeInt32 CurrentSize;
+	__x_ABI_CWindows_CGraphics_CDirectX_CDirectXPixelFormat Format;
 	RECT Rect;
 	HWND Window;
+	HMONITOR Monitor;
 	bool OnlyClientArea;
 
 	bool RestoreWindowCornerPreference;
@@ -71,14 +73,23 @@ static bool ScreenCapture_CanIncludeSecondaryWindows(void);
 static void ScreenCapture_Create(ScreenCapture* Capture, ScreenCapture_OnFrameCallback* OnFrame, bool CallbackOnThread);
 static void ScreenCapture_Release(ScreenCapture* Capture);
 
-static bool ScreenCapture_CreateForWindow(ScreenCapture* Capture, ID3D11Device* Device, HWND Window, bool OnlyClientArea, bool DisableRoundedCorners);
-static bool ScreenCapture_CreateForMonitor(ScreenCapture* Capture, ID3D11Device* Device, HMONITOR Monitor, const RECT* Rect);
+// with HdrFormat frame textures are R16G16B16A16_FLOAT scRGB values, otherwise B8G8R8A8_UNORM
+static bool ScreenCapture_CreateForWindow(ScreenCapture* Capture, ID3D11Device* Device, HWND Window, bool OnlyClientArea, bool DisableRoundedCorners, bool HdrFormat);
+static bool ScreenCapture_CreateForMonitor(ScreenCapture* Capture, ID3D11Device* Device, HMONITOR Monitor, const RECT* Rect, bool HdrFormat);
 static void ScreenCapture_Start(ScreenCapture* Capture, bool WithMouseCursor, bool WithRecordingBorder, bool IncludeSecondaryWindows);
 static void ScreenCapture_Stop(ScreenCapture* Capture);
 
+// returns screen position of top-left pixel in Rect of captured frames, for drawing things like mouse cursor on top of them
+static POINT ScreenCapture_GetOrigin(ScreenCapture* Capture);
+
 static bool ScreenCapture_GetFrame(ScreenCapture* Capture, ScreenCaptureFrame* Frame);
 static void ScreenCapture_ReleaseFrame(ScreenCapture* Capture, ScreenCaptureFrame* Frame);
 
+// keeps copy of Frame valid after ReleaseFrame or after OnFrame callback returns, for using it on other thread
+// frame buffer is not reused for new frames until ReleaseFrameRef is called, which can be done on any thread
+static void ScreenCapture_AddFrameRef(ScreenCaptureFrame* Frame);
+static void ScreenCapture_ReleaseFrameRef(ScreenCaptureFrame* Frame);
+
 //
 // implementation
 //
@@ -94,6 +105,10 @@ static void ScreenCapture_ReleaseFrame(ScreenCapture* Capture, ScreenCaptureFram
 #define SCREEN_CAPTURE_BUFFER_FORMAT DirectXPixelFormat_B8G8R8A8UIntNormalized // same as DXGI_FORMAT_B8G8R8A8_UNORM
 #endif
 
+#ifndef SCREEN_CAPTURE_HDR_BUFFER_FORMAT
+#define SCREEN_CAPTURE_HDR_BUFFER_FORMAT DirectXPixelFormat_R16G16B16A16Float // same as DXGI_FORMAT_R16G16B16A16_FLOAT
+#endif
+
 // this really should be just these three includes, but Microsoft decided to not do proper COM headers that support C :(
 //#include <dispatcherqueue.h>
 //#include <windows.graphics.capture.interop.h>
@@ -307,11 +322,11 @@ static bool ScreenCapture__CreateFramePool(ScreenCapture* Capture, __x_ABI_CWind
 {
 	if (Capture->FramePoolStatics2)
 	{
-		return SUCCEEDED(__x_ABI_CWindows_CGraphics_CCapture_CIDirect3D11CaptureFramePoolStatics2_CreateFreeThreaded(Capture->FramePoolStatics2, Capture->Device, SCREEN_CAPTURE_BUFFER_FORMAT, SCREEN_CAPTURE_BUFFER_COUNT, Size, FramePool));
+		return SUCCEEDED(__x_ABI_CWindows_CGraphics_CCapture_CIDirect3D11CaptureFramePoolStatics2_CreateFreeThreaded(Capture->FramePoolStatics2, Capture->Device, Capture->Format, SCREEN_CAPTURE_BUFFER_COUNT, Size, FramePool));
 	}
 	else
 	{
-		return SUCCEEDED(__x_ABI_CWindows_CGraphics_CCapture_CIDirect3D11CaptureFramePoolStatics_Create(Capture->FramePoolStatics, Capture->Device, SCREEN_CAPTURE_BUFFER_FORMAT, SCREEN_CAPTURE_BUFFER_COUNT, Size, FramePool));
+		return SUCCEEDED(__x_ABI_CWindows_CGraphics_CCapture_CIDirect3D11CaptureFramePoolStatics_Create(Capture->FramePoolStatics, Capture->Device, Capture->Format, SCREEN_CAPTURE_BUFFER_COUNT, Size, FramePool));
 	}
 }
 
@@ -428,8 +443,10 @@ void ScreenCapture_Release(ScreenCapture* Capture)
 	RoUninitialize();
 }
 
-bool ScreenCapture_CreateForWindow(ScreenCapture* Capture, ID3D11Device* Device, HWND Window, bool OnlyClientArea, bool DisableRoundedCorners)
+bool ScreenCapture_CreateForWindow(ScreenCapture* Capture, ID3D11Device* Device, HWND Window, bool OnlyClientArea, bool DisableRoundedCorners, bool HdrFormat)
 {
+	Capture->Format = HdrFormat ? SCREEN_CAPTURE_HDR_BUFFER_FORMAT : SCREEN_CAPTURE_BUFFER_FORMAT;
+
 	IDXGIDevice* DxgiDevice;
 	HR(ID3D11Device_QueryInterface(Device, &IID_IDXGIDevice, (LPVOID*)&DxgiDevice));
 	HR(CreateDirect3D11DeviceFromDXGIDevice(DxgiDevice, (IInspectable**)&Capture->Device));
@@ -476,8 +493,10 @@ bool ScreenCapture_CreateForWindow(ScreenCapture* Capture, ID3D11Device* Device,
 	return false;
 }
 
-bool ScreenCapture_CreateForMonitor(ScreenCapture* Capture, ID3D11Device* Device, HMONITOR Monitor, const RECT* Rect)
+bool ScreenCapture_CreateForMonitor(ScreenCapture* Capture, ID3D11Device* Device, HMONITOR Monitor, const RECT* Rect, bool HdrFormat)
 {
+	Capture->Format = HdrFormat ? SCREEN_CAPTURE_HDR_BUFFER_FORMAT : SCREEN_CAPTURE_BUFFER_FORMAT;
+
 	IDXGIDevice* DxgiDevice;
 	HR(ID3D11Device_QueryInterface(Device, &IID_IDXGIDevice, (LPVOID*)&DxgiDevice));
 	HR(CreateDirect3D11DeviceFromDXGIDevice(DxgiDevice, (IInspectable**)&Capture->Device));
@@ -495,6 +514,7 @@ bool ScreenCapture_CreateForMonitor(ScreenCapture* Capture, ID3D11Device* Device
 			Capture->Item = Item;
 			Capture->FramePool = FramePool;
 			Capture->Window = NULL;
+			Capture->Monitor = Monitor;
 			Capture->CurrentSize = Size;
 			Capture->Rect = Rect ? *Rect : (RECT) { 0, 0, Size.Width, Size.Height };
 
@@ -602,6 +622,36 @@ void ScreenCapture_Stop(ScreenCapture* Capture)
 	}
 }
 
+POINT ScreenCapture_GetOrigin(ScreenCapture* Capture)
+{
+	if (Capture->Window) // capturing window, same offsets as in ScreenCapture__GetRect
+	{
+		RECT WindowRect;
+		if (FAILED(DwmGetWindowAttribute(Capture->Window, DWMWA_EXTENDED_FRAME_BOUNDS, &WindowRect, sizeof(WindowRect))))
+		{
+			return (POINT) { 0 };
+		}
+
+		POINT Origin = { WindowRect.left, WindowRect.top };
+		if (Capture->OnlyClientArea)
+		{
+			POINT TopLeft = { 0, 0 };
+			ClientToScreen(Capture->Window, &TopLeft);
+
+			Origin.x = max(Origin.x, TopLeft.x);
+			Origin.y = max(Origin.y, TopLeft.y);
+		}
+		return Origin;
+	}
+	else // capturing monitor, or region on it
+	{
+		MONITORINFO Info = { .cbSize = sizeof(Info) };
+		GetMonitorInfoW(Capture->Monitor, &Info);
+
+		return (POINT) { Info.rcMonitor.left + Capture->Rect.left, Info.rcMonitor.top + Capture->Rect.top };
+	}
+}
+
 bool ScreenCapture_GetFrame(ScreenCapture* Capture, ScreenCaptureFrame* Frame)
 {
 	__x_ABI_CWindows_CGraphics_CCapture_CIDirect3D11CaptureFrame* NextFrame;
@@ -655,6 +705,18 @@ void ScreenCapture_ReleaseFrame(ScreenCapture* Capture, ScreenCaptureFrame* Fram
 	if (Capture->CurrentSize.Width != Frame->Width || Capture->CurrentSize.Height != Frame->Height)
 	{
 		Capture->CurrentSize = (__x_ABI_CWindows_CGraphics_CSizeInt32){ Frame->Width, Frame->Height };
-		HR(__x_ABI_CWindows_CGraphics_CCapture_CIDirect3D11CaptureFramePool_Recreate(Capture->FramePool, Capture->Device, SCREEN_CAPTURE_BUFFER_FORMAT, SCREEN_CAPTURE_BUFFER_COUNT, Capture->CurrentSize));
+		HR(__x_ABI_CWindows_CGraphics_CCapture_CIDirect3D11CaptureFramePool_Recreate(Capture->FramePool, Capture->Device, Capture->Format, SCREEN_CAPTURE_BUFFER_COUNT, Capture->CurrentSize));
 	}
 }
+
+void ScreenCapture_AddFrameRef(ScreenCaptureFrame* Frame)
+{
+	ID3D11Texture2D_AddRef(Frame->Texture);
+	IUnknown_AddRef(Frame->NextFrame);
+}
+
+void ScreenCapture_ReleaseFrameRef(ScreenCaptureFrame* Frame)
+{
+	ID3D11Texture2D_Release(Frame->Texture);
+	IUnknown_Release(Frame->NextFrame);
+}
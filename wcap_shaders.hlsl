@@ -40,67 +40,57 @@ static uint LinearPackToBGR(float3 Color)
 Texture2D<float3> ResizeIn  : register(t0);
 RWTexture2D<uint> ResizeOut : register(u0);
 
-static float ResizeFilter(float x)
+// filter taps precalculated on CPU side, see ResizeTable in wcap_resize_filter.h
+StructuredBuffer<uint>  ResizeStart   : register(t1);
+StructuredBuffer<float> ResizeWeights : register(t2);
+
+static float3 ResizePass(uint2 OutputPos, uint2 Direction)
 {
-	// https://en.wikipedia.org/wiki/Mitchell%E2%80%93Netravali_filters
-	// with B=C=1/3
+	// there is one start index for each output index in the resize direction
+	uint StartCount, StartStride;
+	ResizeStart.GetDimensions(StartCount, StartStride);
 
-	x = abs(x);
+	uint WeightCount, WeightStride;
+	ResizeWeights.GetDimensions(WeightCount, WeightStride);
 
-	if (x < 1.0)
-	{
-		float x2 = x * x;
-		float x3 = x * x2;
-		x = (21 * x3 - 36 * x2 + 16) / 18;
-	}
-	else if (x < 2.0)
-	{
-		float x2 = x * x;
-		float x3 = x * x2;
-		x = (-7 * x3 + 36 * x2 - 60 * x + 32) / 18;
-	}
-	else
+	// all output pixels use same amount of taps, weights are normalized already
+	uint Index = dot(OutputPos, Direction);
+	uint TapCount = WeightCount / StartCount;
+	uint WeightIndex = Index * TapCount;
+
+	uint2 Pos = OutputPos * Direction.yx + ResizeStart[Index] * Direction;
+
+	float3 ColorSum = 0;
+	for (uint Tap = 0; Tap < TapCount; Tap++)
 	{
-		x = 0.0;
+		ColorSum += ResizeWeights[WeightIndex + Tap] * ResizeIn[Pos];
+		Pos += Direction;
 	}
 
-	return x;
+	return ColorSum;
 }
 
-static float3 ResizePass(uint2 OutputPos, int2 Direction)
+cbuffer ResizeReduce : register(b0)
 {
-	int2 InSize, OutSize;
-	ResizeIn.GetDimensions(InSize.x, InSize.y);
-	ResizeOut.GetDimensions(OutSize.x, OutSize.y);
-
-	float2 Scale = float2(OutSize) / InSize;
-	float2 Size = 2.0 / Scale;
-
-	float2 Center = float2(OutputPos) + 0.5;
-
-	float2 InputPos = Center / Scale;
-	int2 StartPos = clamp(int2(InputPos - Size + 0.5), 0, InSize - 1);
-	int2 EndPos = clamp(int2(InputPos + Size + 0.5), 0, InSize - 1);
+	uint2 ReduceFactor;
+}
 
-	// Start & End values are calculated so ResizeFilter(Offset) in loop below for Start-1 and End+1 values is 0
-	float Start = dot(Direction, StartPos) + 0.5;
-	float End = dot(Direction, EndPos) + 0.5;
-	int2 Pos = StartPos * Direction.xy + int2(InputPos - 0.5) * Direction.yx;
+static float3 ReducePass(uint2 OutputPos)
+{
+	// box filter, input size is exact multiple of ReduceFactor
+	uint2 Start = OutputPos * ReduceFactor;
+	uint2 End = Start + ReduceFactor;
 
-	float WeightSum = 0;
 	float3 ColorSum = 0;
-
-	for (float Index = Start; Index < End; Index += 1.0)
+	for (uint Y = Start.y; Y < End.y; Y++)
 	{
-		float Offset = dot(Direction, Center - Index * Direction * Scale);
-		float Weight = ResizeFilter(Offset);
-
-		ColorSum += Weight * ResizeIn[Pos];
-		WeightSum += Weight;
-		Pos += Direction;
+		for (uint X = Start.x; X < End.x; X++)
+		{
+			ColorSum += ResizeIn[uint2(X, Y)];
+		}
 	}
 
-	return ColorSum / WeightSum;
+	return ColorSum / (ReduceFactor.x * ReduceFactor.y);
 }
 
 // horizontal & vertical passes
@@ -108,13 +98,27 @@ static float3 ResizePass(uint2 OutputPos, int2 Direction)
 [numthreads(16, 16, 1)]
 void ResizePassH(uint3 OutputPos: SV_DispatchThreadID)
 {
-	ResizeOut[OutputPos.xy] = PackToBGR(ResizePass(OutputPos.xy, int2(1, 0)));
+	ResizeOut[OutputPos.xy] = PackToBGR(ResizePass(OutputPos.xy, uint2(1, 0)));
 }
 
 [numthreads(16, 16, 1)]
 void ResizePassV(uint3 OutputPos: SV_DispatchThreadID)
 {
-	ResizeOut[OutputPos.xy] = PackToBGR(ResizePass(OutputPos.xy, int2(0, 1)));
+	ResizeOut[OutputPos.xy] = PackToBGR(ResizePass(OutputPos.xy, uint2(0, 1)));
+}
+
+// integer factor reduction
+
+[numthreads(16, 16, 1)]
+void ResizeReduce(uint3 OutputPos: SV_DispatchThreadID)
+{
+	ResizeOut[OutputPos.xy] = PackToBGR(ReducePass(OutputPos.xy));
+}
+
+[numthreads(16, 16, 1)]
+void ResizeLinearReduce(uint3 OutputPos: SV_DispatchThreadID)
+{
+	ResizeOut[OutputPos.xy] = LinearPackToBGR(ReducePass(OutputPos.xy));
 }
 
 // resize horizontal & vertical passes in linear space
@@ -122,13 +126,13 @@ void ResizePassV(uint3 OutputPos: SV_DispatchThreadID)
 [numthreads(16, 16, 1)]
 void ResizeLinearPassH(uint3 OutputPos: SV_DispatchThreadID)
 {
-	ResizeOut[OutputPos.xy] = LinearPackToBGR(ResizePass(OutputPos.xy, int2(1, 0)));
+	ResizeOut[OutputPos.xy] = LinearPackToBGR(ResizePass(OutputPos.xy, uint2(1, 0)));
 }
 
 [numthreads(16, 16, 1)]
 void ResizeLinearPassV(uint3 OutputPos: SV_DispatchThreadID)
 {
-	ResizeOut[OutputPos.xy] = LinearPackToBGR(ResizePass(OutputPos.xy, int2(0, 1)));
+	ResizeOut[OutputPos.xy] = LinearPackToBGR(ResizePass(OutputPos.xy, uint2(0, 1)));
 }
 
 //
@@ -136,11 +140,13 @@ void ResizeLinearPassV(uint3 OutputPos: SV_DispatchThreadID)
 //
 
 Texture2D<float3>  ConvertIn   : register(t0);
-Texture2D<float2>  ConvertInUV : register(t1);
 
 RWTexture2D<unorm float>  ConvertOutY  : register(u0);
 RWTexture2D<unorm float2> ConvertOutUV : register(u1);
 
+// for *Tiles shaders each group converts one 32x32 tile from this list, positions are packed as Y << 16 | X
+StructuredBuffer<uint> ConvertTiles : register(t1);
+
 cbuffer ConvertMatrix : register(b0)
 {
 	row_major float3x3 RGB_To_YUV;
@@ -173,8 +179,13 @@ static float2 RgbToUV(float3 Color)
 	return mul(RGB_To_YUV, Color).yz;
 }
 
-[numthreads(16, 16, 1)]
-void ConvertSinglePass(uint3 OutputPos: SV_DispatchThreadID)
+static uint2 ConvertTilePos(uint GroupIndex, uint2 GroupPos)
+{
+	uint Tile = ConvertTiles[GroupIndex];
+	return uint2(Tile & 0xffff, Tile >> 16) * 16 + GroupPos;
+}
+
+static void ConvertSinglePassAt(uint2 OutputPos)
 {
 	// OutputPos is ConvertOutUV dimensions (so half of input image)
 	uint4 Pos4 = OutputPos.xyxy * 2 + uint4(0, 0, 1, 1);
@@ -200,40 +211,22 @@ void ConvertSinglePass(uint3 OutputPos: SV_DispatchThreadID)
 }
 
 [numthreads(16, 16, 1)]
-void ConvertPass1(uint3 OutputPos: SV_DispatchThreadID)
+void ConvertSinglePass(uint3 OutputPos: SV_DispatchThreadID)
 {
-	// OutputPos is ConvertOutUV dimensions (so half of input image)
-	uint2 Pos2 = OutputPos.xy * 2;
-
-	float2 InSize;
-	ConvertIn.GetDimensions(InSize.x, InSize.y);
-
-	// bilinear interpolation of RGB color input
-	// this uses horizontally co-sited & vertically centered chroma locations
-	float2 ColorPos = float2(Pos2) / InSize;
-	float3 Color0 = ConvertIn.SampleLevel(LinearSampler, ColorPos, 0, int2(0, 1));
-	float3 Color1 = ConvertIn.SampleLevel(LinearSampler, ColorPos, 0, int2(1, 1));
-	float3 Color = lerp(Color0, Color1, 0.5);
-
-	// output UV values
-	ConvertOutUV[OutputPos.xy] = RgbToUV(Color) * RANGE_UV + OFFSET_UV;
+	ConvertSinglePassAt(OutputPos.xy);
 }
 
 [numthreads(16, 16, 1)]
-void ConvertPass2(uint3 Pos: SV_DispatchThreadID)
+void ConvertSinglePassTiles(uint3 Group: SV_GroupID, uint3 GroupPos: SV_GroupThreadID)
 {
-	float2 InSize;
-	ConvertInUV.GetDimensions(InSize.x, InSize.y);
-
-	// bilinear interpolation of chroma values that decoder is expected to calculate
-	// this uses horizontally co-sited & vertically centered chroma locations
-	float2 PosBase = float2(Pos.xy / 2);
-	float2 PosOffset = (Pos.xy & 1) ? float2(1.0, 0.75) : float2(0.5, 0.25);
-	float2 UV = ConvertInUV.SampleLevel(LinearSampler, (PosBase + PosOffset) / InSize, 0);
+	ConvertSinglePassAt(ConvertTilePos(Group.x, GroupPos.xy));
+}
 
-	// RGB color value, loaded from exact pixel location
-	float3 Color = ConvertIn[Pos.xy];
+// improved conversion adjusts Y values so brightness better matches original RGB input
+// it solves Y for chroma values that decoder is expected to calculate with bilinear interpolation
 
+static float ConvertImprovedY(float3 Color, float2 UV)
+{
 	// now for each pixel we want to solve for Y in the following equation:
 	//   dot(W, F(mul(M, T)) == L
 	// where:
@@ -252,6 +245,407 @@ void ConvertPass2(uint3 Pos: SV_DispatchThreadID)
 	float C = A*A - B + L;
 	float Y = sqrt(C) - A;
 
-	// output Y value
-	ConvertOutY[Pos.xy] = saturate(Y) * RANGE_Y + OFFSET_Y;
+	return saturate(Y) * RANGE_Y + OFFSET_Y;
+}
+
+// each thread calculates one chroma value & solves Y for 2x2 pixels around it
+// group shares chroma values of its tile, plus one row above & below and one column to the right of it
+groupshared float2 ConvertImprovedUV[16 + 2][16 + 1];
+
+static float2 ConvertImprovedChroma(int2 ChromaPos, float2 InSize, float ChromaScale)
+{
+	// position is clamped same way as sampler clamps texture coordinates
+	ChromaPos = clamp(ChromaPos, 0, int2(InSize) / 2 - 1);
+
+	// bilinear interpolation of RGB color input
+	// this uses horizontally co-sited & vertically centered chroma locations
+	float2 ColorPos = float2(ChromaPos * 2) / InSize;
+	float3 Color0 = ConvertIn.SampleLevel(LinearSampler, ColorPos, 0, int2(0, 1));
+	float3 Color1 = ConvertIn.SampleLevel(LinearSampler, ColorPos, 0, int2(1, 1));
+	float3 Color = lerp(Color0, Color1, 0.5);
+
+	// round same as storing to UNORM output
+	float2 UV = RgbToUV(Color) * RANGE_UV + OFFSET_UV;
+	return floor(saturate(UV) * ChromaScale + 0.5) / ChromaScale;
+}
+
+static void ConvertImproved(uint2 GroupPos, uint2 OutputPos, float ChromaScale)
+{
+	// OutputPos is ConvertOutUV dimensions (so half of input image)
+	float2 InSize;
+	ConvertIn.GetDimensions(InSize.x, InSize.y);
+
+	int2 ChromaPos = OutputPos;
+	uint2 Local = GroupPos + uint2(0, 1);
+
+	float2 UV = ConvertImprovedChroma(ChromaPos, InSize, ChromaScale);
+	ConvertImprovedUV[Local.y][Local.x] = UV;
+
+	if (GroupPos.y == 0)
+	{
+		ConvertImprovedUV[0][Local.x] = ConvertImprovedChroma(ChromaPos + int2(0, -1), InSize, ChromaScale);
+	}
+	if (GroupPos.y == 15)
+	{
+		ConvertImprovedUV[17][Local.x] = ConvertImprovedChroma(ChromaPos + int2(0, +1), InSize, ChromaScale);
+	}
+	if (GroupPos.x == 15)
+	{
+		ConvertImprovedUV[Local.y][16] = ConvertImprovedChroma(ChromaPos + int2(1, 0), InSize, ChromaScale);
+		if (GroupPos.y == 0)
+		{
+			ConvertImprovedUV[0][16] = ConvertImprovedChroma(ChromaPos + int2(1, -1), InSize, ChromaScale);
+		}
+		if (GroupPos.y == 15)
+		{
+			ConvertImprovedUV[17][16] = ConvertImprovedChroma(ChromaPos + int2(1, +1), InSize, ChromaScale);
+		}
+	}
+
+	GroupMemoryBarrierWithGroupSync();
+
+	ConvertOutUV[OutputPos] = UV;
+
+	// same weights as bilinear sampling of chroma texture at horizontally co-sited & vertically centered locations
+	// vertically chroma is at 1/4 between rows of pixel pair, horizontally odd pixels are in middle of two chroma values
+	float2 Top0    = lerp(ConvertImprovedUV[Local.y - 1][Local.x + 0], ConvertImprovedUV[Local.y + 0][Local.x + 0], 0.75);
+	float2 Top1    = lerp(ConvertImprovedUV[Local.y - 1][Local.x + 1], ConvertImprovedUV[Local.y + 0][Local.x + 1], 0.75);
+	float2 Bottom0 = lerp(ConvertImprovedUV[Local.y + 0][Local.x + 0], ConvertImprovedUV[Local.y + 1][Local.x + 0], 0.25);
+	float2 Bottom1 = lerp(ConvertImprovedUV[Local.y + 0][Local.x + 1], ConvertImprovedUV[Local.y + 1][Local.x + 1], 0.25);
+
+	// RGB color values loaded from exact pixel locations
+	uint4 Pos4 = OutputPos.xyxy * 2 + uint4(0, 0, 1, 1);
+	ConvertOutY[Pos4.xy] = ConvertImprovedY(ConvertIn[Pos4.xy], Top0);
+	ConvertOutY[Pos4.zy] = ConvertImprovedY(ConvertIn[Pos4.zy], lerp(Top0, Top1, 0.5));
+	ConvertOutY[Pos4.xw] = ConvertImprovedY(ConvertIn[Pos4.xw], Bottom0);
+	ConvertOutY[Pos4.zw] = ConvertImprovedY(ConvertIn[Pos4.zw], lerp(Bottom0, Bottom1, 0.5));
+}
+
+// chroma is rounded to precision of output format, so Y is solved for exactly same values that decoder will see
+
+[numthreads(16, 16, 1)]
+void ConvertImprovedNV12(uint3 GroupPos: SV_GroupThreadID, uint3 OutputPos: SV_DispatchThreadID)
+{
+	ConvertImproved(GroupPos.xy, OutputPos.xy, 255.0);
+}
+
+[numthreads(16, 16, 1)]
+void ConvertImprovedP010(uint3 GroupPos: SV_GroupThreadID, uint3 OutputPos: SV_DispatchThreadID)
+{
+	ConvertImproved(GroupPos.xy, OutputPos.xy, 65535.0);
+}
+
+[numthreads(16, 16, 1)]
+void ConvertImprovedNV12Tiles(uint3 Group: SV_GroupID, uint3 GroupPos: SV_GroupThreadID)
+{
+	ConvertImproved(GroupPos.xy, ConvertTilePos(Group.x, GroupPos.xy), 255.0);
+}
+
+[numthreads(16, 16, 1)]
+void ConvertImprovedP010Tiles(uint3 Group: SV_GroupID, uint3 GroupPos: SV_GroupThreadID)
+{
+	ConvertImproved(GroupPos.xy, ConvertTilePos(Group.x, GroupPos.xy), 65535.0);
+}
+
+// HDR input is scRGB - linear BT.709 primaries with 1.0 for 80 nits, output is PQ encoded BT.2020 in P010
+// chroma is averaged from PQ encoded colors, same as for 8-bit input it is averaged from gamma encoded colors
+
+// https://en.wikipedia.org/wiki/Perceptual_quantizer
+static const float PQ_M1 = 2610.0 / 16384.0;
+static const float PQ_M2 = 2523.0 / 4096.0 * 128.0;
+static const float PQ_C1 = 3424.0 / 4096.0;
+static const float PQ_C2 = 2413.0 / 4096.0 * 32.0;
+static const float PQ_C3 = 2392.0 / 4096.0 * 32.0;
+
+// PQ has 1.0 for 10000 nits
+static const float SCRGB_TO_PQ = 80.0 / 10000.0;
+
+// 10-bit limited range, exact values instead of 8-bit range scaled to 16 bits
+static const float HDR_RANGE_Y   = 876.0;
+static const float HDR_RANGE_UV  = 896.0;
+static const float HDR_OFFSET_Y  = 64.0;
+static const float HDR_OFFSET_UV = 512.0;
+
+static const float3x3 BT709_To_BT2020 =
+{
+	0.627404, 0.329283, 0.043313,
+	0.069097, 0.919540, 0.011362,
+	0.016391, 0.088013, 0.895595,
+};
+
+static float3 LinearToPQ(float3 Value)
+{
+	float3 P = pow(saturate(Value), PQ_M1);
+	return pow((PQ_C1 + PQ_C2 * P) / (1.0 + PQ_C3 * P), PQ_M2);
+}
+
+static float3 ConvertHdrLoad(uint2 Pos)
+{
+	return LinearToPQ(mul(BT709_To_BT2020, ConvertIn[Pos]) * SCRGB_TO_PQ);
+}
+
+// 10-bit value in high bits of R16_UNORM & R16G16_UNORM outputs
+static float QuantizeP010(float Value)
+{
+	return floor(clamp(Value, 0.0, 1023.0) + 0.5) * (64.0 / 65535.0);
+}
+
+static float2 QuantizeP010(float2 Value)
+{
+	return floor(clamp(Value, 0.0, 1023.0) + 0.5) * (64.0 / 65535.0);
+}
+
+[numthreads(16, 16, 1)]
+void ConvertHdr(uint3 OutputPos: SV_DispatchThreadID)
+{
+	// OutputPos is ConvertOutUV dimensions (so half of input image)
+	uint4 Pos4 = OutputPos.xyxy * 2 + uint4(0, 0, 1, 1);
+	uint Left = max(Pos4.x, 1) - 1;
+
+	float3 Color00 = ConvertHdrLoad(Pos4.xy);
+	float3 Color01 = ConvertHdrLoad(Pos4.zy);
+	float3 Color10 = ConvertHdrLoad(Pos4.xw);
+	float3 Color11 = ConvertHdrLoad(Pos4.zw);
+	float3 Left0 = ConvertHdrLoad(uint2(Left, Pos4.y));
+	float3 Left1 = ConvertHdrLoad(uint2(Left, Pos4.w));
+
+	// same weights as bilinear sampling in ConvertSinglePass - horizontally co-sited & vertically centered chroma
+	float3 Color = (Left0 + Left1 + 2.0 * (Color00 + Color10) + Color01 + Color11) / 8.0;
+
+	ConvertOutUV[OutputPos.xy] = QuantizeP010(RgbToUV(Color) * HDR_RANGE_UV + HDR_OFFSET_UV);
+
+	ConvertOutY[Pos4.xy] = QuantizeP010(RgbToY(Color00) * HDR_RANGE_Y + HDR_OFFSET_Y);
+	ConvertOutY[Pos4.zy] = QuantizeP010(RgbToY(Color01) * HDR_RANGE_Y + HDR_OFFSET_Y);
+	ConvertOutY[Pos4.xw] = QuantizeP010(RgbToY(Color10) * HDR_RANGE_Y + HDR_OFFSET_Y);
+	ConvertOutY[Pos4.zw] = QuantizeP010(RgbToY(Color11) * HDR_RANGE_Y + HDR_OFFSET_Y);
+}
+
+//
+// resize + RGB -> YUV converter
+//
+
+// last resize pass writes NV12/P010 output directly, same result as ResizePassH/V followed by ConvertSinglePass
+// each thread resizes 2x2 pixels, left neighbor pixels for chroma are shared through group memory
+groupshared float3 ResizeConvertRight[2][16][16];
+
+static float3 ResizeConvertLoad(uint2 Pos, uint2 Direction, bool LinearSpace)
+{
+	float3 Color = ResizePass(Pos, Direction);
+	Color = LinearSpace ? LinearToGamma(Color) : Color;
+
+	// same quantization as storing to B8G8R8A8 texture in PackToBGR
+	return floor(saturate(Color) * 255 + 0.5) / 255;
+}
+
+static void ResizeConvertPass(uint2 GroupPos, uint2 OutputPos, uint2 Direction, bool LinearSpace)
+{
+	// OutputPos is ConvertOutUV dimensions (so half of resized image)
+	uint4 Pos4 = OutputPos.xyxy * 2 + uint4(0, 0, 1, 1);
+
+	float3 Color00 = ResizeConvertLoad(Pos4.xy, Direction, LinearSpace);
+	float3 Color01 = ResizeConvertLoad(Pos4.zy, Direction, LinearSpace);
+	float3 Color10 = ResizeConvertLoad(Pos4.xw, Direction, LinearSpace);
+	float3 Color11 = ResizeConvertLoad(Pos4.zw, Direction, LinearSpace);
+
+	ResizeConvertRight[0][GroupPos.y][GroupPos.x] = Color01;
+	ResizeConvertRight[1][GroupPos.y][GroupPos.x] = Color11;
+	GroupMemoryBarrierWithGroupSync();
+
+	// pixels to the left, first column in group calculates them itself, clamped at image edge
+	float3 ColorLeft0, ColorLeft1;
+	if (GroupPos.x == 0)
+	{
+		uint LeftX = max(Pos4.x, 1) - 1;
+		ColorLeft0 = ResizeConvertLoad(uint2(LeftX, Pos4.y), Direction, LinearSpace);
+		ColorLeft1 = ResizeConvertLoad(uint2(LeftX, Pos4.w), Direction, LinearSpace);
+	}
+	else
+	{
+		ColorLeft0 = ResizeConvertRight[0][GroupPos.y][GroupPos.x - 1];
+		ColorLeft1 = ResizeConvertRight[1][GroupPos.y][GroupPos.x - 1];
+	}
+
+	// same weights as bilinear sampling in ConvertSinglePass - horizontally co-sited & vertically centered chroma
+	float3 Color = (ColorLeft0 + ColorLeft1 + 2 * (Color00 + Color10) + Color01 + Color11) / 8;
+
+	ConvertOutUV[OutputPos.xy] = RgbToUV(Color) * RANGE_UV + OFFSET_UV;
+
+	ConvertOutY[Pos4.xy] = RgbToY(Color00) * RANGE_Y + OFFSET_Y;
+	ConvertOutY[Pos4.zy] = RgbToY(Color01) * RANGE_Y + OFFSET_Y;
+	ConvertOutY[Pos4.xw] = RgbToY(Color10) * RANGE_Y + OFFSET_Y;
+	ConvertOutY[Pos4.zw] = RgbToY(Color11) * RANGE_Y + OFFSET_Y;
+}
+
+[numthreads(16, 16, 1)]
+void ResizeConvertPassH(uint3 GroupPos: SV_GroupThreadID, uint3 OutputPos: SV_DispatchThreadID)
+{
+	ResizeConvertPass(GroupPos.xy, OutputPos.xy, uint2(1, 0), false);
+}
+
+[numthreads(16, 16, 1)]
+void ResizeConvertPassV(uint3 GroupPos: SV_GroupThreadID, uint3 OutputPos: SV_DispatchThreadID)
+{
+	ResizeConvertPass(GroupPos.xy, OutputPos.xy, uint2(0, 1), false);
+}
+
+[numthreads(16, 16, 1)]
+void ResizeLinearConvertPassH(uint3 GroupPos: SV_GroupThreadID, uint3 OutputPos: SV_DispatchThreadID)
+{
+	ResizeConvertPass(GroupPos.xy, OutputPos.xy, uint2(1, 0), true);
+}
+
+[numthreads(16, 16, 1)]
+void ResizeLinearConvertPassV(uint3 GroupPos: SV_GroupThreadID, uint3 OutputPos: SV_DispatchThreadID)
+{
+	ResizeConvertPass(GroupPos.xy, OutputPos.xy, uint2(0, 1), true);
+}
+
+//
+// cursor overlay
+//
+
+// cursor is premultiplied BGRA, pixels with zero alpha are drawn as difference to background for inverted cursors
+// same calculation as CpuCursor_Blend in wcap_cpu_cursor.h
+
+Texture2D<float4> CursorIn    : register(t0);
+Texture2D<float3> CursorFrame : register(t1);
+RWTexture2D<uint> CursorOut   : register(u0);
+
+cbuffer CursorPosition : register(b0)
+{
+	int2  CursorPos;  // top-left corner of cursor in frame
+	uint2 CursorSize; // cursor texture can be larger than cursor
+}
+
+[numthreads(16, 16, 1)]
+void CursorBlend(uint3 Pos: SV_DispatchThreadID)
+{
+	uint2 Size;
+	CursorOut.GetDimensions(Size.x, Size.y);
+
+	int2 OutputPos = CursorPos + int2(Pos.xy);
+	if (all(Pos.xy < CursorSize) && all(OutputPos >= 0) && all(OutputPos < int2(Size)))
+	{
+		float4 Cursor = CursorIn[Pos.xy];
+		float3 Frame = CursorFrame[OutputPos];
+		float3 Color = Cursor.a == 0 ? abs(Cursor.rgb - Frame) : Cursor.rgb + Frame * (1 - Cursor.a);
+		CursorOut[OutputPos] = PackToBGR(Color);
+	}
+}
+
+//
+// frame hash
+//
+
+// every group hashes 32x32 block of BGRA input, each thread does 2x2 pixels
+// same values as CpuHash_Run calculates, so duplicate frames can be detected by comparing few bytes per block
+// also writes average 8-bit luma of block, this gives small thumbnail of frame for scene change detection
+
+Texture2D<float3>         HashIn   : register(t0);
+RWStructuredBuffer<uint2> HashOut  : register(u0);
+RWStructuredBuffer<uint>  HashLuma : register(u1);
+
+static const uint HASH_SALT  = 0x9e3779b1u;
+static const uint HASH_MUL1  = 0x85ebca6bu;
+static const uint HASH_MUL2  = 0xc2b2ae35u;
+static const uint HASH_BLOCK = 32;
+
+groupshared uint3 HashShared[16 * 16];
+
+static uint HashMix(uint Value)
+{
+	// murmur3 finalizer
+	Value ^= Value >> 16;
+	Value *= HASH_MUL1;
+	Value ^= Value >> 13;
+	Value *= HASH_MUL2;
+	Value ^= Value >> 16;
+	return Value;
+}
+
+[numthreads(16, 16, 1)]
+void FrameHash(uint3 GroupId: SV_GroupID, uint GroupIndex: SV_GroupIndex, uint3 ThreadPos: SV_DispatchThreadID)
+{
+	uint2 Size;
+	HashIn.GetDimensions(Size.x, Size.y);
+
+	// x is sum & y is xor of mixed pixel values, z is sum of luma in 8.8 fixed point, pixels outside of texture add nothing
+	uint3 Hash = 0;
+	for (uint Index = 0; Index < 4; Index++)
+	{
+		uint2 Pos = ThreadPos.xy * 2 + uint2(Index & 1, Index >> 1);
+		if (all(Pos < Size))
+		{
+			uint3 Color = uint3(saturate(HashIn[Pos]) * 255 + 0.5);
+			uint Value = HashMix((Color.b | (Color.g << 8) | (Color.r << 16)) ^ (((Pos.y << 16) | Pos.x) * HASH_SALT));
+			Hash = uint3(Hash.x + Value, Hash.y ^ Value, Hash.z + dot(Color, uint3(77, 150, 29)));
+		}
+	}
+
+	HashShared[GroupIndex] = Hash;
+	GroupMemoryBarrierWithGroupSync();
+
+	[unroll]
+	for (uint Step = 16 * 16 / 2; Step != 0; Step /= 2)
+	{
+		if (GroupIndex < Step)
+		{
+			uint3 Other = HashShared[GroupIndex + Step];
+			HashShared[GroupIndex] = uint3(HashShared[GroupIndex].x + Other.x, HashShared[GroupIndex].y ^ Other.y, HashShared[GroupIndex].z + Other.z);
+		}
+		GroupMemoryBarrierWithGroupSync();
+	}
+
+	if (GroupIndex == 0)
+	{
+		uint BlockCountX = (Size.x + HASH_BLOCK - 1) / HASH_BLOCK;
+		uint Block = GroupId.y * BlockCountX + GroupId.x;
+
+		// blocks on right & bottom edge can be smaller
+		uint2 BlockSize = min(HASH_BLOCK, Size - GroupId.xy * HASH_BLOCK);
+		uint Area = BlockSize.x * BlockSize.y * 256;
+
+		HashOut[Block] = HashShared[0].xy;
+		HashLuma[Block] = (HashShared[0].z + Area / 2) / Area;
+	}
+}
+
+// every thread compares hash of one block with hash of same block from previously converted frame
+// blocks next to changed ones are dirty too, same as CpuHash_DirtyBlocks, but order of appended positions is not defined
+// count of appended positions is copied to indirect dispatch arguments, so CPU never needs to read hashes back
+
+StructuredBuffer<uint2>      DirtyHash     : register(t0);
+StructuredBuffer<uint2>      DirtyPrevious : register(t1);
+AppendStructuredBuffer<uint> DirtyOut      : register(u0);
+
+cbuffer DirtyBlocks : register(b0)
+{
+	uint2 DirtyBlockCount;
+}
+
+[numthreads(8, 8, 1)]
+void FrameHashDirty(uint3 Block: SV_DispatchThreadID)
+{
+	if (any(Block.xy >= DirtyBlockCount))
+	{
+		return;
+	}
+
+	uint2 First = max(Block.xy, 1) - 1;
+	uint2 Last = min(Block.xy + 1, DirtyBlockCount - 1);
+
+	bool Dirty = false;
+	for (uint Y = First.y; Y <= Last.y; Y++)
+	{
+		for (uint X = First.x; X <= Last.x; X++)
+		{
+			uint Index = Y * DirtyBlockCount.x + X;
+			Dirty = Dirty || any(DirtyHash[Index] != DirtyPrevious[Index]);
+		}
+	}
+
+	if (Dirty)
+	{
+		DirtyOut.Append((Block.y << 16) | Block.x);
+	}
 }
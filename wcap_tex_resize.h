@@ -1,6 +1,7 @@
 #pragma once
 
 #include "wcap.h"
+#include "wcap_resize_filter.h"
 #include <d3d11.h>
 
 //
@@ -10,14 +11,22 @@
 typedef struct
 {
 	ID3D11Texture2D* InputTexture;
-	ID3D11Texture2D* OutputTexture;
+	ID3D11Texture2D* OutputTexture; // NULL when last pass is fused with YUV conversion
 
 	ID3D11ShaderResourceView* InputViewIn;
 	ID3D11UnorderedAccessView* OutputViewOut;
+	ID3D11ShaderResourceView* ReducedViewIn; // NULL if plan does not need integer reduction
+	ID3D11UnorderedAccessView* ReducedViewOut;
 	ID3D11ShaderResourceView* MiddleViewIn;
 	ID3D11UnorderedAccessView* MiddleViewOut;
+	ID3D11ShaderResourceView* TableH[2]; // tap start & weight buffers
+	ID3D11ShaderResourceView* TableV[2];
 	ID3D11ComputeShader* PassH;
 	ID3D11ComputeShader* PassV;
+	ID3D11ComputeShader* PassConvert; // last pass writing NV12/P010 output, NULL if not fused
+	ID3D11ComputeShader* Reduce;
+	ID3D11Buffer* ReduceBuffer;
+	ResizePlan Plan;
 	uint32_t InputWidth;
 	uint32_t InputHeight;
 	uint32_t OutputWidth;
@@ -25,11 +34,19 @@ typedef struct
 }
 TexResize;
 
-static void TexResize_Create(TexResize* Resize, ID3D11Device* Device, uint32_t InputWidth, uint32_t InputHeight, uint32_t OutputWidth, uint32_t OutputHeight, bool LinearSpace, D3D11_BIND_FLAG InputUsage);
+// with FusedConvert last resize pass writes YUV output in TexResize_DispatchConvert instead of writing OutputTexture
+// FusedConvert is ignored when there is nothing to resize, check PassConvert to know which one is used
+// HdrInput creates R16G16B16A16_FLOAT input texture instead of B8G8R8A8, resize shaders do not support it so sizes must match
+// SharedInput is used as input instead of creating new texture, when it is not NULL, for multiple resizes of same input
+// it must be InputTexture of other TexResize with same input size & no HdrInput, InputUsage is ignored then
+static void TexResize_Create(TexResize* Resize, ID3D11Device* Device, uint32_t InputWidth, uint32_t InputHeight, uint32_t OutputWidth, uint32_t OutputHeight, ResizeFilter Filter, bool LinearSpace, bool FusedConvert, bool HdrInput, D3D11_BIND_FLAG InputUsage, ID3D11Texture2D* SharedInput);
 static void TexResize_Release(TexResize* Resize);
 
 static void TexResize_Dispatch(TexResize* Resize, ID3D11DeviceContext* Context);
 
+// ConvertMatrix is YuvConvert constant buffer, output views are Y & UV planes of YuvConvertOutput
+static void TexResize_DispatchConvert(TexResize* Resize, ID3D11DeviceContext* Context, ID3D11Buffer* ConvertMatrix, ID3D11UnorderedAccessView* OutputViewY, ID3D11UnorderedAccessView* OutputViewUV);
+
 //
 // implementation
 //
@@ -42,28 +59,94 @@ static void TexResize_Dispatch(TexResize* Resize, ID3D11DeviceContext* Context);
 #include "shaders/ResizeLinearPassH.h"
 #include "shaders/ResizeLinearPassV.h"
 
-void TexResize_Create(TexResize* Resize, ID3D11Device* Device, uint32_t InputWidth, uint32_t InputHeight, uint32_t OutputWidth, uint32_t OutputHeight, bool LinearSpace, D3D11_BIND_FLAG InputUsage)
+#include "shaders/ResizeReduce.h"
+#include "shaders/ResizeLinearReduce.h"
+
+#include "shaders/ResizeConvertPassH.h"
+#include "shaders/ResizeConvertPassV.h"
+#include "shaders/ResizeLinearConvertPassH.h"
+#include "shaders/ResizeLinearConvertPassV.h"
+
+static ID3D11ShaderResourceView* TexResize__CreateBuffer(ID3D11Device* Device, const void* Data, uint32_t Count, uint32_t Stride)
 {
-	D3D11_TEXTURE2D_DESC InputTextureDesc =
+	D3D11_BUFFER_DESC BufferDesc =
+	{
+		.ByteWidth = Count * Stride,
+		.Usage = D3D11_USAGE_IMMUTABLE,
+		.BindFlags = D3D11_BIND_SHADER_RESOURCE,
+		.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED,
+		.StructureByteStride = Stride,
+	};
+
+	D3D11_SUBRESOURCE_DATA BufferData =
+	{
+		.pSysMem = Data,
+	};
+
+	ID3D11Buffer* Buffer;
+	ID3D11Device_CreateBuffer(Device, &BufferDesc, &BufferData, &Buffer);
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC ViewDesc =
 	{
-		.Width = InputWidth,
-		.Height = InputHeight,
-		.MipLevels = 1,
-		.ArraySize = 1,
-		.Format = DXGI_FORMAT_B8G8R8A8_TYPELESS,
-		.SampleDesc = { 1, 0 },
-		.Usage = D3D11_USAGE_DEFAULT,
-		.BindFlags = D3D11_BIND_SHADER_RESOURCE | InputUsage,
+		.Format = DXGI_FORMAT_UNKNOWN,
+		.ViewDimension = D3D11_SRV_DIMENSION_BUFFER,
+		.Buffer.NumElements = Count,
 	};
-	ID3D11Device_CreateTexture2D(Device, &InputTextureDesc, NULL, &Resize->InputTexture);
+
+	ID3D11ShaderResourceView* View;
+	ID3D11Device_CreateShaderResourceView(Device, (ID3D11Resource*)Buffer, &ViewDesc, &View);
+	ID3D11Buffer_Release(Buffer);
+
+	return View;
+}
+
+static void TexResize__CreateTable(ID3D11ShaderResourceView** Views, ID3D11Device* Device, uint32_t InputSize, uint32_t OutputSize, ResizeFilter Filter)
+{
+	// filter weights depend only on sizes, calculate them once instead of for every pixel in every frame
+	ResizeTable Table;
+	ResizeTable_Create(&Table, InputSize, OutputSize, Filter);
+	Views[0] = TexResize__CreateBuffer(Device, Table.Start, OutputSize, sizeof(*Table.Start));
+	Views[1] = TexResize__CreateBuffer(Device, Table.Weights, OutputSize * Table.TapCount, sizeof(*Table.Weights));
+	ResizeTable_Release(&Table);
+}
+
+void TexResize_Create(TexResize* Resize, ID3D11Device* Device, uint32_t InputWidth, uint32_t InputHeight, uint32_t OutputWidth, uint32_t OutputHeight, ResizeFilter Filter, bool LinearSpace, bool FusedConvert, bool HdrInput, D3D11_BIND_FLAG InputUsage, ID3D11Texture2D* SharedInput)
+{
+	Assert(!HdrInput || (InputWidth == OutputWidth && InputHeight == OutputHeight));
+	Assert(!HdrInput || !SharedInput);
+
+	if (SharedInput)
+	{
+		// released in TexResize_Release same as own texture
+		ID3D11Texture2D_AddRef(SharedInput);
+		Resize->InputTexture = SharedInput;
+	}
+	else
+	{
+		D3D11_TEXTURE2D_DESC InputTextureDesc =
+		{
+			.Width = InputWidth,
+			.Height = InputHeight,
+			.MipLevels = 1,
+			.ArraySize = 1,
+			.Format = HdrInput ? DXGI_FORMAT_R16G16B16A16_FLOAT : DXGI_FORMAT_B8G8R8A8_TYPELESS,
+			.SampleDesc = { 1, 0 },
+			.Usage = D3D11_USAGE_DEFAULT,
+			.BindFlags = D3D11_BIND_SHADER_RESOURCE | InputUsage,
+		};
+		ID3D11Device_CreateTexture2D(Device, &InputTextureDesc, NULL, &Resize->InputTexture);
+	}
 
 	if (InputWidth == OutputWidth && InputHeight == OutputHeight)
 	{
 		Resize->InputViewIn = NULL;
 		Resize->OutputTexture = Resize->InputTexture;
+		Resize->PassConvert = NULL;
 	}
 	else
 	{
+		ResizePlan_Create(&Resize->Plan, InputWidth, InputHeight, OutputWidth, OutputHeight, Filter);
+
 		ID3DBlob* Shader;
 
 		HR(D3DDecompressShaders(
@@ -88,19 +171,6 @@ void TexResize_Create(TexResize* Resize, ID3D11Device* Device, uint32_t InputWid
 		};
 		ID3D11Device_CreateShaderResourceView(Device, (ID3D11Resource*)Resize->InputTexture, &ViewInDesc, &Resize->InputViewIn);
 
-		D3D11_TEXTURE2D_DESC OutputTextureDesc =
-		{
-			.Width = OutputWidth,
-			.Height = OutputHeight,
-			.MipLevels = 1,
-			.ArraySize = 1,
-			.Format = DXGI_FORMAT_B8G8R8A8_TYPELESS,
-			.SampleDesc = { 1, 0 },
-			.Usage = D3D11_USAGE_DEFAULT,
-			.BindFlags = D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_SHADER_RESOURCE,
-		};
-		ID3D11Device_CreateTexture2D(Device, &OutputTextureDesc, NULL, &Resize->OutputTexture);
-
 		// because D3D 11.0 does not support B8G8R8A8 for UAV stores, create R32_UINT for packing BGRA bytes manually in shader
 		D3D11_UNORDERED_ACCESS_VIEW_DESC ViewOutDesc =
 		{
@@ -108,12 +178,100 @@ void TexResize_Create(TexResize* Resize, ID3D11Device* Device, uint32_t InputWid
 			.ViewDimension = D3D11_UAV_DIMENSION_TEXTURE2D,
 			.Texture2D.MipSlice = 0,
 		};
-		ID3D11Device_CreateUnorderedAccessView(Device, (ID3D11Resource*)Resize->OutputTexture, &ViewOutDesc, &Resize->OutputViewOut);
+
+		if (FusedConvert)
+		{
+			// YUV output is smaller than BGRA output texture, so no need to write & read it again
+			const uint8_t* ShaderBytes;
+			size_t ShaderSize;
+			if (Resize->Plan.VerticalFirst)
+			{
+				ShaderBytes = LinearSpace ? ResizeLinearConvertPassHShaderBytes : ResizeConvertPassHShaderBytes;
+				ShaderSize = LinearSpace ? sizeof(ResizeLinearConvertPassHShaderBytes) : sizeof(ResizeConvertPassHShaderBytes);
+			}
+			else
+			{
+				ShaderBytes = LinearSpace ? ResizeLinearConvertPassVShaderBytes : ResizeConvertPassVShaderBytes;
+				ShaderSize = LinearSpace ? sizeof(ResizeLinearConvertPassVShaderBytes) : sizeof(ResizeConvertPassVShaderBytes);
+			}
+
+			HR(D3DDecompressShaders(ShaderBytes, ShaderSize, 1, 0, NULL, 0, &Shader, NULL));
+			ID3D11Device_CreateComputeShader(Device, ID3D10Blob_GetBufferPointer(Shader), ID3D10Blob_GetBufferSize(Shader), NULL, &Resize->PassConvert);
+			ID3D10Blob_Release(Shader);
+
+			Resize->OutputTexture = NULL;
+		}
+		else
+		{
+			D3D11_TEXTURE2D_DESC OutputTextureDesc =
+			{
+				.Width = OutputWidth,
+				.Height = OutputHeight,
+				.MipLevels = 1,
+				.ArraySize = 1,
+				.Format = DXGI_FORMAT_B8G8R8A8_TYPELESS,
+				.SampleDesc = { 1, 0 },
+				.Usage = D3D11_USAGE_DEFAULT,
+				.BindFlags = D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_SHADER_RESOURCE,
+			};
+			ID3D11Device_CreateTexture2D(Device, &OutputTextureDesc, NULL, &Resize->OutputTexture);
+			ID3D11Device_CreateUnorderedAccessView(Device, (ID3D11Resource*)Resize->OutputTexture, &ViewOutDesc, &Resize->OutputViewOut);
+
+			Resize->PassConvert = NULL;
+		}
+
+		if (Resize->Plan.ReduceX != 1 || Resize->Plan.ReduceY != 1)
+		{
+			HR(D3DDecompressShaders(
+				LinearSpace ? ResizeLinearReduceShaderBytes : ResizeReduceShaderBytes,
+				LinearSpace ? sizeof(ResizeLinearReduceShaderBytes) : sizeof(ResizeReduceShaderBytes),
+				1, 0, NULL, 0, &Shader, NULL));
+			ID3D11Device_CreateComputeShader(Device, ID3D10Blob_GetBufferPointer(Shader), ID3D10Blob_GetBufferSize(Shader), NULL, &Resize->Reduce);
+			ID3D10Blob_Release(Shader);
+
+			uint32_t ReduceFactor[4] = { Resize->Plan.ReduceX, Resize->Plan.ReduceY };
+
+			D3D11_BUFFER_DESC ReduceBufferDesc =
+			{
+				.ByteWidth = sizeof(ReduceFactor),
+				.Usage = D3D11_USAGE_IMMUTABLE,
+				.BindFlags = D3D11_BIND_CONSTANT_BUFFER,
+			};
+
+			D3D11_SUBRESOURCE_DATA ReduceBufferData =
+			{
+				.pSysMem = ReduceFactor,
+			};
+
+			ID3D11Device_CreateBuffer(Device, &ReduceBufferDesc, &ReduceBufferData, &Resize->ReduceBuffer);
+
+			D3D11_TEXTURE2D_DESC ReducedTextureDesc =
+			{
+				.Width = Resize->Plan.ReducedWidth,
+				.Height = Resize->Plan.ReducedHeight,
+				.MipLevels = 1,
+				.ArraySize = 1,
+				.Format = DXGI_FORMAT_B8G8R8A8_TYPELESS,
+				.SampleDesc = { 1, 0 },
+				.Usage = D3D11_USAGE_DEFAULT,
+				.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS,
+			};
+
+			ID3D11Texture2D* ReducedTexture;
+			ID3D11Device_CreateTexture2D(Device, &ReducedTextureDesc, NULL, &ReducedTexture);
+			ID3D11Device_CreateShaderResourceView(Device, (ID3D11Resource*)ReducedTexture, &ViewInDesc, &Resize->ReducedViewIn);
+			ID3D11Device_CreateUnorderedAccessView(Device, (ID3D11Resource*)ReducedTexture, &ViewOutDesc, &Resize->ReducedViewOut);
+			ID3D11Texture2D_Release(ReducedTexture);
+		}
+		else
+		{
+			Resize->ReducedViewIn = NULL;
+		}
 
 		D3D11_TEXTURE2D_DESC MiddleTextureDesc =
 		{
-			.Width = OutputWidth,
-			.Height = InputHeight,
+			.Width = Resize->Plan.MiddleWidth,
+			.Height = Resize->Plan.MiddleHeight,
 			.MipLevels = 1,
 			.ArraySize = 1,
 			.Format = DXGI_FORMAT_B8G8R8A8_TYPELESS,
@@ -127,6 +285,9 @@ void TexResize_Create(TexResize* Resize, ID3D11Device* Device, uint32_t InputWid
 		ID3D11Device_CreateShaderResourceView(Device, (ID3D11Resource*)MiddleTexture, &ViewInDesc, &Resize->MiddleViewIn);
 		ID3D11Device_CreateUnorderedAccessView(Device, (ID3D11Resource*)MiddleTexture, &ViewOutDesc, &Resize->MiddleViewOut);
 		ID3D11Texture2D_Release(MiddleTexture);
+
+		TexResize__CreateTable(Resize->TableH, Device, Resize->Plan.ReducedWidth, OutputWidth, Filter);
+		TexResize__CreateTable(Resize->TableV, Device, Resize->Plan.ReducedHeight, OutputHeight, Filter);
 	}
 
 	Resize->InputWidth = InputWidth;
@@ -142,12 +303,33 @@ void TexResize_Release(TexResize* Resize)
 	if (Resize->InputViewIn)
 	{
 		ID3D11ShaderResourceView_Release(Resize->InputViewIn);
-		ID3D11UnorderedAccessView_Release(Resize->OutputViewOut);
 
 		ID3D11ShaderResourceView_Release(Resize->MiddleViewIn);
 		ID3D11UnorderedAccessView_Release(Resize->MiddleViewOut);
 
-		ID3D11Texture2D_Release(Resize->OutputTexture);
+		if (Resize->ReducedViewIn)
+		{
+			ID3D11ShaderResourceView_Release(Resize->ReducedViewIn);
+			ID3D11UnorderedAccessView_Release(Resize->ReducedViewOut);
+			ID3D11ComputeShader_Release(Resize->Reduce);
+			ID3D11Buffer_Release(Resize->ReduceBuffer);
+		}
+
+		for (size_t i = 0; i < ARRAYSIZE(Resize->TableH); i++)
+		{
+			ID3D11ShaderResourceView_Release(Resize->TableH[i]);
+			ID3D11ShaderResourceView_Release(Resize->TableV[i]);
+		}
+
+		if (Resize->PassConvert)
+		{
+			ID3D11ComputeShader_Release(Resize->PassConvert);
+		}
+		else
+		{
+			ID3D11UnorderedAccessView_Release(Resize->OutputViewOut);
+			ID3D11Texture2D_Release(Resize->OutputTexture);
+		}
 
 		ID3D11ComputeShader_Release(Resize->PassH);
 		ID3D11ComputeShader_Release(Resize->PassV);
@@ -161,15 +343,59 @@ void TexResize_Dispatch(TexResize* Resize, ID3D11DeviceContext* Context)
 		return;
 	}
 
+	ID3D11ShaderResourceView* PassInput = Resize->InputViewIn;
+
+	if (Resize->ReducedViewIn)
+	{
+		ID3D11DeviceContext_ClearState(Context);
+		ID3D11DeviceContext_CSSetShader(Context, Resize->Reduce, NULL, 0);
+		ID3D11DeviceContext_CSSetConstantBuffers(Context, 0, 1, &Resize->ReduceBuffer);
+		ID3D11DeviceContext_CSSetShaderResources(Context, 0, 1, &Resize->InputViewIn);
+		ID3D11DeviceContext_CSSetUnorderedAccessViews(Context, 0, 1, &Resize->ReducedViewOut, NULL);
+		ID3D11DeviceContext_Dispatch(Context, DIV_ROUND_UP(Resize->Plan.ReducedWidth, 16), DIV_ROUND_UP(Resize->Plan.ReducedHeight, 16), 1);
+
+		PassInput = Resize->ReducedViewIn;
+	}
+
+	ID3D11ComputeShader* FirstPass = Resize->Plan.VerticalFirst ? Resize->PassV : Resize->PassH;
+	ID3D11ComputeShader* SecondPass = Resize->Plan.VerticalFirst ? Resize->PassH : Resize->PassV;
+	ID3D11ShaderResourceView** FirstTable = Resize->Plan.VerticalFirst ? Resize->TableV : Resize->TableH;
+	ID3D11ShaderResourceView** SecondTable = Resize->Plan.VerticalFirst ? Resize->TableH : Resize->TableV;
+
 	ID3D11DeviceContext_ClearState(Context);
-	ID3D11DeviceContext_CSSetShader(Context, Resize->PassH, NULL, 0);
-	ID3D11DeviceContext_CSSetShaderResources(Context, 0, 1, &Resize->InputViewIn);
+	ID3D11DeviceContext_CSSetShader(Context, FirstPass, NULL, 0);
+	ID3D11DeviceContext_CSSetShaderResources(Context, 0, 1, &PassInput);
+	ID3D11DeviceContext_CSSetShaderResources(Context, 1, ARRAYSIZE(Resize->TableH), FirstTable);
 	ID3D11DeviceContext_CSSetUnorderedAccessViews(Context, 0, 1, &Resize->MiddleViewOut, NULL);
-	ID3D11DeviceContext_Dispatch(Context, DIV_ROUND_UP(Resize->OutputWidth, 16), DIV_ROUND_UP(Resize->InputHeight, 16), 1);
+	ID3D11DeviceContext_Dispatch(Context, DIV_ROUND_UP(Resize->Plan.MiddleWidth, 16), DIV_ROUND_UP(Resize->Plan.MiddleHeight, 16), 1);
+
+	if (Resize->PassConvert)
+	{
+		// last pass happens in TexResize_DispatchConvert
+		return;
+	}
 
 	ID3D11DeviceContext_ClearState(Context);
-	ID3D11DeviceContext_CSSetShader(Context, Resize->PassV, NULL, 0);
+	ID3D11DeviceContext_CSSetShader(Context, SecondPass, NULL, 0);
 	ID3D11DeviceContext_CSSetShaderResources(Context, 0, 1, &Resize->MiddleViewIn);
+	ID3D11DeviceContext_CSSetShaderResources(Context, 1, ARRAYSIZE(Resize->TableV), SecondTable);
 	ID3D11DeviceContext_CSSetUnorderedAccessViews(Context, 0, 1, &Resize->OutputViewOut, NULL);
 	ID3D11DeviceContext_Dispatch(Context, DIV_ROUND_UP(Resize->OutputWidth, 16), DIV_ROUND_UP(Resize->OutputHeight, 16), 1);
 }
+
+void TexResize_DispatchConvert(TexResize* Resize, ID3D11DeviceContext* Context, ID3D11Buffer* ConvertMatrix, ID3D11UnorderedAccessView* OutputViewY, ID3D11UnorderedAccessView* OutputViewUV)
+{
+	Assert(Resize->PassConvert);
+
+	ID3D11ShaderResourceView** Table = Resize->Plan.VerticalFirst ? Resize->TableH : Resize->TableV;
+	ID3D11UnorderedAccessView* OutputViews[] = { OutputViewY, OutputViewUV };
+
+	// one thread for each chroma value, so for 2x2 output pixels
+	ID3D11DeviceContext_ClearState(Context);
+	ID3D11DeviceContext_CSSetShader(Context, Resize->PassConvert, NULL, 0);
+	ID3D11DeviceContext_CSSetConstantBuffers(Context, 0, 1, &ConvertMatrix);
+	ID3D11DeviceContext_CSSetShaderResources(Context, 0, 1, &Resize->MiddleViewIn);
+	ID3D11DeviceContext_CSSetShaderResources(Context, 1, ARRAYSIZE(Resize->TableH), Table);
+	ID3D11DeviceContext_CSSetUnorderedAccessViews(Context, 0, ARRAYSIZE(OutputViews), OutputViews, NULL);
+	ID3D11DeviceContext_Dispatch(Context, DIV_ROUND_UP(Resize->OutputWidth / 2, 16), DIV_ROUND_UP(Resize->OutputHeight / 2, 16), 1);
+}
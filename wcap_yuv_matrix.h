@@ -0,0 +1,59 @@
+#pragma once
+
+// color conversion matrices shared by GPU & CPU converters
+
+//
+// interface
+//
+
+typedef enum
+{
+	YuvColorSpace_BT601,
+	YuvColorSpace_BT709,
+	YuvColorSpace_BT2020,
+}
+YuvColorSpace;
+
+// first 3 rows convert RGB to YUV, next 3 rows convert YUV to RGB
+// rows are padded to 4 floats to match ConvertMatrix constant buffer layout in shaders
+static const float YuvMatrix[][6][4] =
+{
+	// https://en.wikipedia.org/wiki/YCbCr#ITU-R_BT.601_conversion
+	[YuvColorSpace_BT601] =
+	{
+		// RGB to YUV
+		{ +0.299000f, +0.587000f, +0.114000f },
+		{ -0.168736f, -0.331264f, +0.500000f },
+		{ +0.500000f, -0.418688f, -0.081312f },
+		// YUV to RGB
+		{ 1.f, +0.000000f, +1.402000f },
+		{ 1.f, -0.344136f, -0.714136f },
+		{ 1.f, +1.772000f, +0.000000f },
+	},
+
+	// https://en.wikipedia.org/wiki/YCbCr#ITU-R_BT.709_conversion
+	[YuvColorSpace_BT709] =
+	{
+		// RGB to YUV
+		{ +0.2126f, +0.7152f, +0.0722f },
+		{ -0.1146f, -0.3854f, +0.5000f },
+		{ +0.5000f, -0.4542f, -0.0458f },
+		// YUV to RGB
+		{ 1.f, +0.0000f, +1.5748f },
+		{ 1.f, -0.1873f, -0.4681f },
+		{ 1.f, +1.8556f, +0.0000f },
+	},
+
+	// https://en.wikipedia.org/wiki/YCbCr#ITU-R_BT.2020_conversion
+	[YuvColorSpace_BT2020] =
+	{
+		// RGB to YUV
+		{ +0.26270f, +0.678000f, +0.0593000f },
+		{ -0.13963f, -0.360370f, +0.5000000f },
+		{ +0.50000f, -0.459786f, -0.0402143f },
+		// YUV to RGB
+		{ 1.f, +0.000000f, +1.474600f },
+		{ 1.f, -0.164553f, -0.571353f },
+		{ 1.f, +1.881400f, +0.000000f },
+	},
+};